@@ -0,0 +1,105 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bit_pack.h"
+#include "node_search.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BIT_PACK_X86
+#include <immintrin.h>
+#endif
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Widest field the AVX2 kernel reads with a single 4 byte gather: the field may start at
+ * any bit of its first byte.
+ */
+const int AVX2_MAX_BITS = 25;
+
+void unpackFields(const unsigned char *packed, const int stride, const int offset, const int bits,
+                  const int first, const int count, const std::uint32_t base, std::uint32_t *out) {
+  int position = first * stride + offset;
+  for (int i = 0; i < count; i++, position += stride)
+    out[i] = base + BitPack::get(packed, position, bits);
+}
+
+#ifdef BIT_PACK_X86
+
+__attribute__((target("avx2")))
+void unpackFieldsAvx2(const unsigned char *packed, const int stride, const int offset, const int bits,
+                      const int first, const int count, const std::uint32_t base, std::uint32_t *out) {
+  if (bits > AVX2_MAX_BITS) {
+    unpackFields(packed, stride, offset, bits, first, count, base, out);
+    return;
+  }
+  // bit positions of the eight fields of a step, and how far they move from step to step
+  __m256i positions = _mm256_add_epi32(_mm256_set1_epi32(first * stride + offset),
+                                       _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride)));
+  __m256i step = _mm256_set1_epi32(8 * stride);
+  __m256i sevens = _mm256_set1_epi32(7);
+  __m256i fieldMask = _mm256_set1_epi32(BitPack::mask(bits));
+  __m256i baseVec = _mm256_set1_epi32(base);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i words = _mm256_i32gather_epi32((const int *)packed, _mm256_srli_epi32(positions, 3), 1);
+    __m256i fields = _mm256_and_si256(_mm256_srlv_epi32(words, _mm256_and_si256(positions, sevens)), fieldMask);
+    _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi32(fields, baseVec));
+    positions = _mm256_add_epi32(positions, step);
+  }
+  unpackFields(packed, stride, offset, bits, first + i, count - i, base, out + i);
+}
+
+#endif
+
+}
+
+void BitPack::unpackScalar(const unsigned char *packed, const int stride, const int offset, const int bits,
+                           const int first, const int count, const std::uint32_t base, std::uint32_t *out) {
+  unpackFields(packed, stride, offset, bits, first, count, base, out);
+}
+
+#ifdef BIT_PACK_X86
+
+void BitPack::unpackAvx2(const unsigned char *packed, const int stride, const int offset, const int bits,
+                         const int first, const int count, const std::uint32_t base, std::uint32_t *out) {
+  unpackFieldsAvx2(packed, stride, offset, bits, first, count, base, out);
+}
+
+#else
+
+void BitPack::unpackAvx2(const unsigned char *packed, const int stride, const int offset, const int bits,
+                         const int first, const int count, const std::uint32_t base, std::uint32_t *out) {
+  unpackFields(packed, stride, offset, bits, first, count, base, out);
+}
+
+#endif
+
+void BitPack::selectImplementation() {
+  unpackImpl.store(NodeSearch::hasAvx2() ? &BitPack::unpackAvx2 : &BitPack::unpackScalar, std::memory_order_relaxed);
+}
+
+void BitPack::resolveUnpack(const unsigned char *packed, const int stride, const int offset, const int bits,
+                            const int first, const int count, const std::uint32_t base, std::uint32_t *out) {
+  selectImplementation();
+  unpack(packed, stride, offset, bits, first, count, base, out);
+}
+
+const char *BitPack::implementationName() {
+  if (unpackImpl.load(std::memory_order_relaxed) == &BitPack::resolveUnpack)
+    selectImplementation();
+  if (unpackImpl.load(std::memory_order_relaxed) == &BitPack::unpackAvx2)
+    return "avx2";
+  return "scalar";
+}
+
+// resolved on first use, so unpacks made by other static initializers work too
+std::atomic<BitUnpackFunc> BitPack::unpackImpl(&BitPack::resolveUnpack);
+
+}
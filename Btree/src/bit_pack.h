@@ -0,0 +1,118 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string.h>
+
+namespace badgerdb {
+
+/**
+ * @brief Signature shared by all implementations of the unpack kernel.
+ *
+ * @param packed  Bit array holding fields of bits bits, stride bits apart.
+ * @param stride  Bits from the start of one field to the start of the next.
+ * @param offset  Bit position of field 0.
+ * @param bits    Width of a field, at most 32.
+ * @param first   First field unpacked.
+ * @param count   Number of fields unpacked.
+ * @param base    Added to every field.
+ * @param out     Receives the count fields plus base.
+ */
+typedef void (*BitUnpackFunc)(const unsigned char *packed, const int stride, const int offset, const int bits,
+                              const int first, const int count, const std::uint32_t base, std::uint32_t *out);
+
+/**
+ * @brief Kernels reading and writing fields of up to 32 bits at any bit position of a byte
+ * array, as the packed leaves of a B+ tree store them. Fields are read and written through
+ * 8 byte words, so PADDING bytes past the last field must be readable.
+ *
+ * unpack() has a portable implementation extracting one field at a time and, on x86, an AVX2
+ * implementation gathering eight fields at once with one shift and mask each. The
+ * implementation is picked once, on first use, like those of NodeSearch.
+ */
+class BitPack {
+ public:
+  /**
+   * Bytes that must be readable past the last byte holding a field.
+   */
+  static const int PADDING = 8;
+
+  /**
+   * Field of bits bits at bit position position.
+   */
+  static std::uint32_t get(const unsigned char *packed, const int position, const int bits) {
+    std::uint64_t word;
+    memcpy(&word, packed + (position >> 3), sizeof(word));
+    return (word >> (position & 7)) & mask(bits);
+  }
+
+  /**
+   * Writes value, which must fit in bits bits, to the field at bit position position.
+   */
+  static void put(unsigned char *packed, const int position, const int bits, const std::uint32_t value) {
+    std::uint64_t word;
+    memcpy(&word, packed + (position >> 3), sizeof(word));
+    word &= ~((std::uint64_t)mask(bits) << (position & 7));
+    word |= (std::uint64_t)value << (position & 7);
+    memcpy(packed + (position >> 3), &word, sizeof(word));
+  }
+
+  /**
+   * Fewest bits holding value.
+   */
+  static int bitsFor(const std::uint32_t value) { return value == 0 ? 0 : 32 - __builtin_clz(value); }
+
+  static std::uint32_t mask(const int bits) { return (std::uint32_t)(((std::uint64_t)1 << bits) - 1); }
+
+  /**
+   * Unpacks count fields from field first on. See BitUnpackFunc.
+   */
+  static void unpack(const unsigned char *packed, const int stride, const int offset, const int bits,
+                     const int first, const int count, const std::uint32_t base, std::uint32_t *out) {
+    unpackImpl.load(std::memory_order_relaxed)(packed, stride, offset, bits, first, count, base, out);
+  }
+
+  /**
+   * Portable implementation of unpack().
+   */
+  static void unpackScalar(const unsigned char *packed, const int stride, const int offset, const int bits,
+                           const int first, const int count, const std::uint32_t base, std::uint32_t *out);
+
+  /**
+   * AVX2 implementation of unpack(). Only call if NodeSearch::hasAvx2() is true.
+   */
+  static void unpackAvx2(const unsigned char *packed, const int stride, const int offset, const int bits,
+                         const int first, const int count, const std::uint32_t base, std::uint32_t *out);
+
+  /**
+   * Name of the implementation picked for unpack().
+   */
+  static const char *implementationName();
+
+ private:
+  /**
+   * Points unpackImpl at the best implementation for the CPU.
+   */
+  static void selectImplementation();
+
+  /**
+   * Initial unpackImpl; selects the implementation and forwards to it.
+   */
+  static void resolveUnpack(const unsigned char *packed, const int stride, const int offset, const int bits,
+                            const int first, const int count, const std::uint32_t base, std::uint32_t *out);
+
+  /**
+   * Implementation behind unpack(), read and written relaxed: it only ever changes from the
+   * resolver to the one implementation selectImplementation() picks, whichever thread calls first.
+   */
+  static std::atomic<BitUnpackFunc> unpackImpl;
+};
+
+}
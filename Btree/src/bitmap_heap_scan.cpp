@@ -0,0 +1,101 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bitmap_heap_scan.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Record ids copied from an index cursor at once.
+ */
+const int RID_BATCH = 256;
+
+/**
+ * Lowest slot number above slot set in the bitmap, or -1 if there is none.
+ */
+int nextSlot(const std::vector<std::uint64_t> &bitmap, const int slot) {
+  int next = slot + 1;
+  for (size_t word = next / 64; word < bitmap.size(); word++, next = word * 64) {
+    std::uint64_t bits = bitmap[word] >> (next % 64);
+    if (bits != 0)
+      return next + __builtin_ctzll(bits);
+  }
+  return -1;
+}
+
+}
+
+BitmapHeapScan::BitmapHeapScan(const std::string &name, BufMgr *bufferMgr) {
+  file = new PageFile(name, false);  // dont create new file
+  bufMgr = bufferMgr;
+  started = false;
+  curPage = NULL;
+}
+
+BitmapHeapScan::~BitmapHeapScan() {
+  if (curPage != NULL)
+    bufMgr->unPinPage(file, curRid.page_number, false);
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+void BitmapHeapScan::add(const RecordId &rid) {
+  std::vector<std::uint64_t> &bitmap = pages[rid.page_number];
+  if (bitmap.size() <= (size_t)rid.slot_number / 64)
+    bitmap.resize(rid.slot_number / 64 + 1);
+  bitmap[rid.slot_number / 64] |= (std::uint64_t)1 << (rid.slot_number % 64);
+}
+
+std::uint32_t BitmapHeapScan::addRange(BTreeIndex *index, const void *lowVal, const Operator lowOp, const void *highVal,
+                                       const Operator highOp) {
+  IndexCursor cursor;
+  try {
+    cursor = index->openScan(lowVal, lowOp, highVal, highOp);
+  } catch (NoSuchKeyFoundException e) {
+    return 0;
+  }
+  std::uint32_t found = 0;
+  RecordId rids[RID_BATCH];
+  int count;
+  while ((count = cursor.scanNextBatch(rids, NULL, RID_BATCH)) > 0) {
+    for (int i = 0; i < count; i++)
+      add(rids[i]);
+    found += count;
+  }
+  return found;
+}
+
+void BitmapHeapScan::scanNext(RecordId &outRid) {
+  if (!started) {
+    started = true;
+    pageIter = pages.begin();
+  }
+  int slot = curPage == NULL ? -1 : nextSlot(pageIter->second, curRid.slot_number);
+  while (slot < 0) {
+    // the current page is done, move on to the next one
+    if (curPage != NULL) {
+      bufMgr->unPinPage(file, curRid.page_number, false);
+      curPage = NULL;
+      ++pageIter;
+    }
+    if (pageIter == pages.end())
+      throw EndOfFileException();
+    curRid.page_number = pageIter->first;
+    bufMgr->readPage(file, curRid.page_number, curPage);
+    slot = nextSlot(pageIter->second, -1);
+  }
+  curRid.slot_number = slot;
+  outRid = curRid;
+}
+
+std::string BitmapHeapScan::getRecord() { return curPage->getRecord(curRid); }
+
+}
@@ -0,0 +1,117 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Reads the records of a relation whose record ids were collected beforehand, such as
+ * those an index scan finds, visiting each page of the relation once and in page order.
+ *
+ * Index scans return record ids in key order, which jumps from page to page of the relation
+ * and reads a page again for every record on it. The record ids added here go into a bitmap
+ * of slots per page, so duplicates fall together, and scanNext() then walks the pages in
+ * order, keeping each pinned while its records are returned: a large range costs one read per
+ * page of the relation it touches, near sequentially. Records come back in record id order
+ * rather than key order.
+ *
+ * Add every record id before the first call to scanNext(). The scan has the interface of
+ * FileScan: scanNext() returns the record id of the next record, getRecord() the record.
+ */
+class BitmapHeapScan
+{
+ public:
+
+  BitmapHeapScan(const std::string &name, BufMgr *bufMgr);
+
+  ~BitmapHeapScan();
+
+  /**
+   * Adds the record id to the bitmap, once however often it is added.
+   */
+  void add(const RecordId &rid);
+
+  /**
+   * Adds the record ids of the entries of index in a range, read from a cursor of its own
+   * leaf by leaf. The bounds and operators are those of BTreeIndex::startScan().
+   * @return Number of entries found in the range.
+   * @throws BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws BadScanrangeException If lowVal > highval
+   */
+  std::uint32_t addRange(BTreeIndex *index, const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+  /**
+   * Number of pages of the relation holding the records added.
+   */
+  std::uint32_t pageCount() const { return pages.size(); }
+
+  /**
+   * Returns the record id of the next record added, in page order and slot order within a page.
+   * @throws EndOfFileException If every record added has been returned.
+   */
+  void scanNext(RecordId &outRid);
+
+  /**
+   * Returns the record last returned by scanNext().
+   */
+  std::string getRecord();
+
+ private:
+  /**
+   * Slots added per page, a bit per slot number.
+   */
+  typedef std::map<PageId, std::vector<std::uint64_t> > PageBitmap;
+
+  /**
+   * File which is being scanned.
+   */
+  PageFile *file;
+
+  /**
+   * Buffer Manager instance used to read pages into the buffer pool.
+   */
+  BufMgr *bufMgr;
+
+  /**
+   * Record ids added, grouped by page.
+   */
+  PageBitmap pages;
+
+  /**
+   * True once scanNext() has been called.
+   */
+  bool started;
+
+  /**
+   * Page being scanned, valid once the scan has started.
+   */
+  PageBitmap::iterator pageIter;
+
+  /**
+   * Current page being scanned, pinned, or NULL.
+   */
+  Page *curPage;
+
+  /**
+   * Record id last returned by scanNext().
+   */
+  RecordId curRid;
+};
+
+}
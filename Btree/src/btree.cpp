@@ -6,6 +6,11 @@
  */
 
 #include "btree.h"
+#include "external_sort.h"
+#include "node_layout.h"
+#include "string_layout.h"
+#include "posting_layout.h"
+#include "packed_layout.h"
 #include "filescan.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
@@ -17,11 +22,348 @@
 #include "exceptions/end_of_file_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 
+#include <algorithm>
+#include <cmath>
+
 using namespace std;
 
 namespace badgerdb
 {
 
+// -----------------------------------------------------------------------------
+// IndexCursor::lowVal / IndexCursor::highVal / IndexCursor::lastVal
+// -----------------------------------------------------------------------------
+
+template <>
+int &IndexCursor::lowVal<int>() { return lowValInt; }
+template <>
+double &IndexCursor::lowVal<double>() { return lowValDouble; }
+template <>
+std::string &IndexCursor::lowVal<std::string>() { return lowValString; }
+template <>
+int &IndexCursor::highVal<int>() { return highValInt; }
+template <>
+double &IndexCursor::highVal<double>() { return highValDouble; }
+template <>
+std::string &IndexCursor::highVal<std::string>() { return highValString; }
+template <>
+int &IndexCursor::lastVal<int>() { return lastValInt; }
+template <>
+double &IndexCursor::lastVal<double>() { return lastValDouble; }
+template <>
+std::string &IndexCursor::lastVal<std::string>() { return lastValString; }
+
+// NormalizedKeys of composite indexes are plain bytes, kept in a buffer wide enough for any of them
+template <class K>
+K &IndexCursor::lowVal() { return *(K *)lowValKey; }
+template <class K>
+K &IndexCursor::highVal() { return *(K *)highValKey; }
+template <class K>
+K &IndexCursor::lastVal() { return *(K *)lastValKey; }
+
+// -----------------------------------------------------------------------------
+// Statistics helpers
+// -----------------------------------------------------------------------------
+
+namespace
+{
+
+// the statistics keep keys as the fixed size sort keys of their layout
+template <class K>
+K sortKeyOf(const K &key) { return key; }
+StringKey sortKeyOf(const std::string &key) { return StringKey::fromChars(key.c_str()); }
+
+template <class L>
+void storeStatisticsKey(const typename L::Key &key, unsigned char *out)
+{
+	typename L::SortKey sortKey = sortKeyOf(key);
+	memcpy(out, &sortKey, sizeof(sortKey));
+}
+
+template <class L>
+typename L::Key loadStatisticsKey(const unsigned char *in)
+{
+	typename L::SortKey sortKey;
+	memcpy(&sortKey, in, sizeof(sortKey));
+	return L::keyFromSortKey(sortKey);
+}
+
+// where key falls between lower and upper, numeric keys interpolated, others taken to be halfway
+double keyFraction(const double lower, const double upper, const double key)
+{
+	if (!(lower < upper))
+		return 1;
+	return std::min(1.0, std::max(0.0, (key - lower) / (upper - lower)));
+}
+double keyFraction(const int lower, const int upper, const int key) { return keyFraction((double)lower, (double)upper, (double)key); }
+template <class K>
+double keyFraction(const K &lower, const K &upper, const K &key) { return lower < key ? 0.5 : 0; }
+
+// cuts keys added in order into the buckets of an equi-depth histogram of about expected entries;
+// a key added may stand for several entries and distinct keys, as a key of a sampled leaf does
+template <class L>
+class HistogramBuilder
+{
+  public:
+	HistogramBuilder(const std::uint64_t expected)
+		: expected(expected), buckets((int)std::min<std::uint64_t>(HISTOGRAM_BUCKETS, std::max<std::uint64_t>(expected, 1))),
+		  bucket(0), rank(0), run(0), distinct(0), bucketDistinct(0)
+	{
+		memset(&computed, 0, sizeof(computed));
+	}
+
+	void add(const typename L::Key &key, const double entries, const double keys)
+	{
+		bool newKey = rank == 0 || last < key;
+		// a full bucket ends with the run of its highest key, so no key spans two buckets
+		if (newKey && rank > 0 && bucket + 1 < buckets && rank >= (bucket + 1) * expected / buckets)
+			endBucket();
+		if (rank == 0)
+			storeStatisticsKey<L>(key, computed.lowestKey);
+		if (newKey)
+		{
+			distinct += keys;
+			bucketDistinct += keys;
+			run = 0;
+		}
+		run += entries;
+		rank += entries;
+		last = key;
+	}
+
+	const IndexStatistics &finish()
+	{
+		if (rank > 0)
+			endBucket();
+		computed.bucketCount = bucket;
+		computed.entryCount = std::llround(rank);
+		computed.distinctCount = std::llround(distinct);
+		return computed;
+	}
+
+  private:
+	void endBucket()
+	{
+		storeStatisticsKey<L>(last, computed.bucketKeys[bucket]);
+		computed.bucketEnds[bucket] = std::llround(rank);
+		computed.bucketRepeats[bucket] = std::llround(run);
+		computed.bucketDistinct[bucket] = std::llround(bucketDistinct);
+		bucketDistinct = 0;
+		bucket++;
+	}
+
+	IndexStatistics computed;
+	std::uint64_t expected;
+	int buckets;
+	int bucket;
+	// entries added, those with the last key, and distinct keys in all and in the open bucket
+	double rank;
+	double run;
+	double distinct;
+	double bucketDistinct;
+	typename L::Key last;
+};
+
+// grows the segments of a learned lookup model over the first entries of keys added in order, each
+// while one line through its first key keeps the position of every key within LEARNED_MAX_ERROR
+class LearnedModelBuilder
+{
+  public:
+	LearnedModelBuilder(std::vector<LearnedSegment> &segments) : segments(segments), started(false), lowSlope(0), highSlope(0)
+	{
+		segments.clear();
+	}
+
+	void add(const int key, const std::uint64_t position)
+	{
+		// the model predicts the first entry of a key, the search finds the duplicates after it
+		if (started && !(segment.lastKey < key))
+			return;
+		if (started)
+		{
+			double run = (double)key - segment.firstKey;
+			double offset = (double)position - (double)segment.firstPosition;
+			double low = (offset - LEARNED_MAX_ERROR) / run;
+			double high = (offset + LEARNED_MAX_ERROR) / run;
+			if (low <= highSlope && high >= lowSlope)
+			{
+				lowSlope = std::max(lowSlope, low);
+				highSlope = std::min(highSlope, high);
+				segment.lastKey = key;
+				return;
+			}
+			endSegment();
+		}
+		segment.firstKey = key;
+		segment.lastKey = key;
+		segment.firstPosition = position;
+		lowSlope = 0;
+		highSlope = HUGE_VAL;
+		started = true;
+	}
+
+	void finish()
+	{
+		if (started)
+			endSegment();
+		started = false;
+	}
+
+  private:
+	void endSegment()
+	{
+		segment.slope = highSlope == HUGE_VAL ? 0 : (lowSlope + highSlope) / 2;
+		segments.push_back(segment);
+	}
+
+	std::vector<LearnedSegment> &segments;
+	// the segment being grown, and the slopes through its first key keeping every key seen within the error
+	LearnedSegment segment;
+	bool started;
+	double lowSlope;
+	double highSlope;
+};
+
+// only INTEGER keys are learned
+void learnKey(LearnedModelBuilder &model, const int key, const std::uint64_t position) { model.add(key, position); }
+template <class K>
+void learnKey(LearnedModelBuilder &model, const K &key, const std::uint64_t position) {}
+
+// adds the entries of a leaf to a learned lookup model at their positions; the first leaf sets the
+// positions per page if they are not set yet
+template <class L>
+void learnLeaf(LearnedModelBuilder &model, std::uint32_t &slots, const PageId pageNo, Page *page)
+{
+	if (slots == 0)
+		slots = std::max(L::leafCount(page), 1);
+	for (int i = 0; i < L::leafCount(page); i++)
+		learnKey(model, L::leafKey(page, i), (std::uint64_t)pageNo * slots + i);
+}
+
+}
+
+// -----------------------------------------------------------------------------
+// IndexCursor::IndexCursor -- Constructors
+// -----------------------------------------------------------------------------
+
+IndexCursor::IndexCursor()
+	: index(NULL), nextEntry(0), currentPageNum(0), currentPageData(NULL), version(0), resumed(false)
+{
+}
+
+IndexCursor::IndexCursor(IndexCursor &&other)
+	: index(NULL)
+{
+	*this = std::move(other);
+}
+
+// -----------------------------------------------------------------------------
+// IndexCursor::operator=
+// -----------------------------------------------------------------------------
+
+IndexCursor &IndexCursor::operator=(IndexCursor &&other)
+{
+	if (this == &other)
+		return *this;
+	if (index != NULL)
+		endScan();
+
+	index = other.index;
+	nextEntry = other.nextEntry;
+	currentPageNum = other.currentPageNum;
+	currentPageData = other.currentPageData;
+	version = other.version;
+	lowValInt = other.lowValInt;
+	lowValDouble = other.lowValDouble;
+	lowValString.swap(other.lowValString);
+	highValInt = other.highValInt;
+	highValDouble = other.highValDouble;
+	highValString.swap(other.highValString);
+	memcpy(lowValKey, other.lowValKey, sizeof(lowValKey));
+	memcpy(highValKey, other.highValKey, sizeof(highValKey));
+	lastValInt = other.lastValInt;
+	lastValDouble = other.lastValDouble;
+	lastValString.swap(other.lastValString);
+	memcpy(lastValKey, other.lastValKey, sizeof(lastValKey));
+	lastRids.swap(other.lastRids);
+	resumed = other.resumed;
+	lowOp = other.lowOp;
+	highOp = other.highOp;
+	direction = other.direction;
+	// the pinned leaf now belongs to this cursor
+	other.index = NULL;
+	return *this;
+}
+
+// -----------------------------------------------------------------------------
+// IndexCursor::~IndexCursor -- destructor
+// -----------------------------------------------------------------------------
+
+IndexCursor::~IndexCursor()
+{
+	try
+	{
+		if (index != NULL)
+			endScan();
+	}
+	catch (...)
+	{
+	}
+}
+
+// -----------------------------------------------------------------------------
+// IndexCursor::scanNext
+// -----------------------------------------------------------------------------
+
+const void IndexCursor::scanNext(RecordId &outRid)
+{
+	if (index == NULL)
+		throw ScanNotInitializedException();
+	(index->*(index->scanNextImpl))(*this, outRid);
+}
+
+// -----------------------------------------------------------------------------
+// IndexCursor::scanNextBatch
+// -----------------------------------------------------------------------------
+
+int IndexCursor::scanNextBatch(RecordId *outRids, void *outKeys, const int maxEntries)
+{
+	if (index == NULL)
+		throw ScanNotInitializedException();
+	// 0 means the range is exhausted, so a batch with no room cannot return it
+	if (maxEntries <= 0)
+		throw BadScanrangeException();
+	return (index->*(index->scanNextBatchImpl))(*this, outRids, outKeys, maxEntries);
+}
+
+// -----------------------------------------------------------------------------
+// IndexCursor::scanNextRecord
+// -----------------------------------------------------------------------------
+
+const void IndexCursor::scanNextRecord(RecordId &outRid, void *outRecord)
+{
+	unsigned char key[MAX_COMPOSITE_KEY_SIZE];
+	if (scanNextBatch(&outRid, key, 1) == 0)
+		throw IndexScanCompletedException();
+	if (index->keyColumns.empty())
+		memcpy((char *)outRecord + index->attrByteOffset, key, CompositeKey::columnSize(index->attributeType));
+	else
+		CompositeKey::toRecord(key, index->keyColumns, (char *)outRecord);
+}
+
+// -----------------------------------------------------------------------------
+// IndexCursor::endScan
+// -----------------------------------------------------------------------------
+
+const void IndexCursor::endScan()
+{
+	if (index == NULL)
+		throw ScanNotInitializedException();
+	BTreeIndex *scanned = index;
+	index = NULL;
+	scanned->bufMgr->unPinPage(scanned->file, currentPageNum, false);
+}
+
 // -----------------------------------------------------------------------------
 // BTreeIndex::BTreeIndex -- Constructor
 // -----------------------------------------------------------------------------
@@ -30,77 +372,202 @@ BTreeIndex::BTreeIndex(const std::string &relationName,
 					   std::string &outIndexName,
 					   BufMgr *bufMgrIn,
 					   const int attrByteOffset,
-					   const Datatype attrType)
+					   const Datatype attrType,
+					   const double fillFactor,
+					   const std::uint32_t sortFrames,
+					   const LeafFormat leafFormat,
+					   const bool pinUpperLevels,
+					   const bool learnedLookup)
 {
 	// Buffer Manager Instance
 	bufMgr = bufMgrIn;
-	// if index scan has been started
-	scanExecuting = false;
-	// # leaf slots
-	leafOccupancy = INTARRAYLEAFSIZE;
-	// # non-leaf slots
-	nodeOccupancy = INTARRAYNONLEAFSIZE;
+	// Datatype of the key
+	attributeType = attrType;
+	this->attrByteOffset = attrByteOffset;
+	searchColumnCount = 0;
+	searchKeySize = 0;
+	// no append seen yet
+	rightmostLeaf = 0;
+	appendRun = 0;
+	this->pinUpperLevels = pinUpperLevels;
+	this->learnedLookup = learnedLookup;
+	learnedValid = false;
+
+	// the only place the key type is looked at
+	switch (attrType)
+	{
+	case INTEGER:
+		if (leafFormat == POSTING_LEAVES)
+			bindLayout<PostingLayout<int> >();
+		else if (leafFormat == PACKED_LEAVES)
+			bindLayout<PackedLayout>();
+		else
+			bindLayout<FixedLayout<int> >();
+		break;
+	case DOUBLE:
+		if (leafFormat == PACKED_LEAVES)
+			throw BadIndexInfoException("packed leaves need INTEGER keys");
+		if (leafFormat == POSTING_LEAVES)
+			bindLayout<PostingLayout<double> >();
+		else
+			bindLayout<FixedLayout<double> >();
+		break;
+	case STRING:
+		if (leafFormat != PLAIN_LEAVES)
+			throw BadIndexInfoException("posting lists and packed leaves need numeric keys");
+		bindLayout<StringLayout>();
+		break;
+	default:
+		throw BadIndexInfoException("unknown attribute type");
+	}
+	if (learnedLookup && (attrType != INTEGER || leafFormat != PLAIN_LEAVES))
+		throw BadIndexInfoException("learned lookups need INTEGER keys and plain leaves");
 
 	// constructing index name
 	std::ostringstream idxStr;
 	idxStr << relationName << '.' << attrByteOffset;
 	outIndexName = idxStr.str();
 
+	openIndexFile(relationName, outIndexName, fillFactor, sortFrames, leafFormat);
+
+	if (learnedLookup)
+	{
+		openLearnedModel();
+		lookupImpl = &BTreeIndex::lookupLearned;
+	}
+}
+
+BTreeIndex::BTreeIndex(const std::string &relationName,
+					   std::string &outIndexName,
+					   BufMgr *bufMgrIn,
+					   const std::vector<KeyColumn> &columns,
+					   const std::vector<KeyColumn> &included,
+					   const double fillFactor,
+					   const std::uint32_t sortFrames,
+					   const bool pinUpperLevels)
+{
+	bufMgr = bufMgrIn;
+	attributeType = COMPOSITE;
+	attrByteOffset = columns.empty() ? 0 : columns[0].attrByteOffset;
+	keyColumns = columns;
+	keyColumns.insert(keyColumns.end(), included.begin(), included.end());
+	searchColumnCount = columns.size();
+	searchKeySize = 0;
+	rightmostLeaf = 0;
+	appendRun = 0;
+	this->pinUpperLevels = pinUpperLevels;
+	learnedLookup = false;
+	learnedValid = false;
+
+	if (columns.empty() || keyColumns.size() > (size_t)MAX_KEY_COLUMNS)
+		throw BadIndexInfoException("composite keys have 1 to MAX_KEY_COLUMNS columns");
+	int keySize = 0;
+	for (size_t i = 0; i < keyColumns.size(); i++)
+	{
+		if (CompositeKey::columnSize(keyColumns[i].attrType) == 0)
+			throw BadIndexInfoException("composite key columns are INTEGER, DOUBLE or STRING");
+		keySize += CompositeKey::columnSize(keyColumns[i].attrType);
+		if (i < columns.size())
+			searchKeySize = keySize;
+	}
+	// keys take the narrowest NormalizedKey that holds them
+	if (keySize <= 16)
+	{
+		bindLayout<FixedLayout<NormalizedKey<16> > >();
+		bulkLoadRelationImpl = &BTreeIndex::bulkLoadComposite<FixedLayout<NormalizedKey<16> > >;
+	}
+	else if (keySize <= MAX_COMPOSITE_KEY_SIZE)
+	{
+		bindLayout<FixedLayout<NormalizedKey<MAX_COMPOSITE_KEY_SIZE> > >();
+		bulkLoadRelationImpl = &BTreeIndex::bulkLoadComposite<FixedLayout<NormalizedKey<MAX_COMPOSITE_KEY_SIZE> > >;
+	}
+	else
+		throw BadIndexInfoException("composite key longer than MAX_COMPOSITE_KEY_SIZE");
+
+	// constructing index name from the offsets of all columns
+	std::ostringstream idxStr;
+	idxStr << relationName << ".composite";
+	for (size_t i = 0; i < columns.size(); i++)
+		idxStr << '.' << columns[i].attrByteOffset;
+	if (!included.empty())
+		idxStr << ".include";
+	for (size_t i = 0; i < included.size(); i++)
+		idxStr << '.' << included[i].attrByteOffset;
+	outIndexName = idxStr.str();
+
+	openIndexFile(relationName, outIndexName, fillFactor, sortFrames, PLAIN_LEAVES);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::openIndexFile
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::openIndexFile(const std::string &relationName, const std::string &indexName, const double fillFactor,
+							   const std::uint32_t sortFrames, const LeafFormat leafFormat)
+{
+	if (!(fillFactor > 0 && fillFactor <= 1))
+		throw BadIndexInfoException("fill factor must be in (0, 1]");
+
 	try
 	{
 		// open file
-		file = new BlobFile(outIndexName, false);
+		file = new BlobFile(indexName, false);
 		// Page number of meta page
 		headerPageNum = file->getFirstPageNo();
 		Page *metaPage;
 		bufMgr->readPage(file, headerPageNum, metaPage);
 		IndexMetaInfo *metaInfo = (IndexMetaInfo *)metaPage;
-		if ((relationName != metaInfo->relationName) || (attrType != metaInfo->attrType) || (attrByteOffset != metaInfo->attrByteOffset))
+		bool sameColumns = (metaInfo->columnCount == (int)keyColumns.size()) &&
+						   (metaInfo->includedCount == (int)keyColumns.size() - searchColumnCount);
+		for (int i = 0; sameColumns && i < metaInfo->columnCount; i++)
+			sameColumns = (metaInfo->columns[i].attrByteOffset == keyColumns[i].attrByteOffset) &&
+						  (metaInfo->columns[i].attrType == keyColumns[i].attrType);
+		if ((relationName != metaInfo->relationName) || (attributeType != metaInfo->attrType) || (attrByteOffset != metaInfo->attrByteOffset) ||
+			(leafFormat != metaInfo->leafFormat) || !sameColumns)
 		{
-			throw BadIndexInfoException(outIndexName);
+			bufMgr->unPinPage(file, headerPageNum, false);
+			throw BadIndexInfoException(indexName);
 		}
 		rootPageNum = metaInfo->rootPageNo;
+		entryCount = metaInfo->entryCount;
+		statistics = metaInfo->statistics;
+		freeListHead = metaInfo->freeListHead;
+		learnedModelPageNo = metaInfo->learnedModelPageNo;
+		learnedSlots = metaInfo->learnedSlots;
 		bufMgr->unPinPage(file, headerPageNum, false);
 	}
 	// create new index file
 	catch (FileNotFoundException e)
 	{
-		file = new BlobFile(outIndexName, true);
-		Page *metaPage, *rootPage;
+		file = new BlobFile(indexName, true);
+		Page *metaPage;
 		bufMgr->allocPage(file, headerPageNum, metaPage);
-		bufMgr->allocPage(file, rootPageNum, rootPage);
 		IndexMetaInfo *metaInfo = (IndexMetaInfo *)metaPage;
 		metaInfo->attrByteOffset = attrByteOffset;
-		metaInfo->attrType = attrType;
-		metaInfo->rootPageNo = rootPageNum;
+		metaInfo->attrType = attributeType;
+		metaInfo->rootPageNo = 0;
+		metaInfo->freeListHead = 0;
+		metaInfo->entryCount = 0;
+		metaInfo->statistics.bucketCount = 0;
+		metaInfo->learnedModelPageNo = 0;
+		metaInfo->learnedSlots = 0;
+		metaInfo->leafFormat = leafFormat;
+		metaInfo->columnCount = keyColumns.size();
+		for (size_t i = 0; i < keyColumns.size(); i++)
+			metaInfo->columns[i] = keyColumns[i];
+		metaInfo->includedCount = keyColumns.size() - searchColumnCount;
+		freeListHead = 0;
+		learnedModelPageNo = 0;
+		learnedSlots = 0;
 		strcpy(metaInfo->relationName, relationName.c_str());
-
-		// root
-		NonLeafNodeInt *root = (NonLeafNodeInt *)rootPage;
-		root->level = 0;
-		root->isLeaf = 0;
-		root->key_count = 0;
-		root->parent = 0;
-
 		bufMgr->unPinPage(file, headerPageNum, true);
-		bufMgr->unPinPage(file, rootPageNum, true);
 
-		FileScan fileScan(relationName, bufMgr);
-		RecordId rid;
-		try
-		{
-			while (1)
-			{
-				fileScan.scanNext(rid);
-				std::string record = fileScan.getRecord();
-				insertEntry(record.c_str() + attrByteOffset, rid);
-			}
-		}
-		catch (EndOfFileException e)
-		{
-			bufMgr->flushFile(file);
-		}
+		(this->*bulkLoadRelationImpl)(relationName, fillFactor, sortFrames);
+		bufMgr->flushFile(file);
 	}
+
+	if (pinUpperLevels)
+		(this->*pinNonLeavesImpl)();
 }
 
 // -----------------------------------------------------------------------------
@@ -109,9 +576,16 @@ BTreeIndex::BTreeIndex(const std::string &relationName,
 
 BTreeIndex::~BTreeIndex()
 {
-	if (scanExecuting)
-		endScan();
+	if (scan.isOpen())
+		scan.endScan();
 
+	// flushing needs every page of the file unpinned
+	for (size_t i = 0; i < pinnedPageNos.size(); i++)
+		bufMgr->unPinPage(file, pinnedPageNos[i], false);
+	Page *metaPage;
+	bufMgr->readPage(file, headerPageNum, metaPage);
+	((IndexMetaInfo *)metaPage)->entryCount = entryCount;
+	bufMgr->unPinPage(file, headerPageNum, true);
 	bufMgr->flushFile(file);
 	delete file;
 }
@@ -122,467 +596,1940 @@ BTreeIndex::~BTreeIndex()
 
 const void BTreeIndex::insertEntry(const void *key, const RecordId rid)
 {
-	insert(key, rootPageNum, rid);
+	learnedValid = false;
+	if (learnedModelPageNo != 0)
+		dropLearnedModel();
+	(this->*insertEntryImpl)(key, rid);
+	entryCount++;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insert
+// BTreeIndex::bindLayout
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::insert(const void *key, const PageId pid, const RecordId rid)
+template <class L>
+void BTreeIndex::bindLayout()
+{
+	bulkLoadRelationImpl = &BTreeIndex::bulkLoadRelation<L>;
+	insertEntryImpl = &BTreeIndex::insertEntryTyped<L>;
+	deleteEntryImpl = &BTreeIndex::deleteEntryTyped<L>;
+	startScanImpl = &BTreeIndex::startScanTyped<L>;
+	scanNextImpl = &BTreeIndex::scanNextTyped<L>;
+	scanNextBatchImpl = &BTreeIndex::scanNextBatchTyped<L>;
+	getNodeCountImpl = &BTreeIndex::getNodeCountTyped<L>;
+	lookupImpl = &BTreeIndex::lookupTyped<L>;
+	pinNonLeavesImpl = &BTreeIndex::pinNonLeaves<L>;
+	countRangeImpl = &BTreeIndex::countRangeTyped<L>;
+	analyzeImpl = &BTreeIndex::analyzeTyped<L>;
+	estimateRangeImpl = &BTreeIndex::estimateRangeTyped<L>;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntryTyped
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::insertEntryTyped(const void *key, const RecordId rid)
 {
-	// is leaf?
-	int isLeaf;
 	// the key value
-	int keyValue = *((int *)key);
-	// page pointer
-	Page *page;
-	bufMgr->readPage(file, pid, page);
-	isLeaf = *((int *)page);
-	if (isLeaf == 0)
-	{
-		NonLeafNodeInt *node = (NonLeafNodeInt *)page;
-		// empty at the begining
-		if (node->key_count == 0)
-		{
-			node->keyArray[0] = keyValue + 1;
-
-			// the left leaf
-			Page *left;
-			PageId leftId;
-			bufMgr->allocPage(file, leftId, left);
-			LeafNodeInt *leftLeaf = (LeafNodeInt *)left;
-
-			// the right leaf
-			Page *right;
-			PageId rightId;
-			bufMgr->allocPage(file, rightId, right);
-			LeafNodeInt *rightLeaf = (LeafNodeInt *)right;
-
-			leftLeaf->isLeaf = 1;
-			leftLeaf->keyArray[0] = keyValue;
-			leftLeaf->ridArray[0] = rid;
-			leftLeaf->key_count = 1;
-			leftLeaf->parent = pid;
-
-			rightLeaf->isLeaf = 1;
-			rightLeaf->key_count = 0;
-			rightLeaf->parent = pid;
-			rightLeaf->rightSibPageNo = 0;
-
-			node->pageNoArray[0] = leftId;
-			node->pageNoArray[1] = rightId;
-			node->level = 1;
-			node->key_count++;
-			leftLeaf->rightSibPageNo = rightId;
-
-			bufMgr->unPinPage(file, leftId, true);
-			bufMgr->unPinPage(file, rightId, true);
-		}
-		else
+	typename L::Key keyValue = L::keyFromPointer(key);
+	// most inserts only change their leaf
+	if (!insertIntoLeaf<L>(keyValue, rid))
+		insertSplitting<L>(keyValue, rid);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::descendToLeaf
+// -----------------------------------------------------------------------------
+
+template <class L>
+std::uint64_t BTreeIndex::descendToLeaf(const typename L::Key &keyValue, const bool upper, PageId &pageNo, Page *&page,
+										std::vector<PageId> *path)
+{
+	while (true)
+	{
+		if (path != NULL)
+			path->clear();
+		std::uint64_t rootVersion = rootLatch.readLock();
+		pageNo = rootPageNum;
+		bool pinned = readNode(pageNo, page);
+		std::uint64_t version = latches[pageNo].readLock();
+		// the node must still have been the root when its version was read
+		bool valid = rootLatch.validate(rootVersion);
+		while (valid)
 		{
-			// location found within the range of existing keys
-			bool placeFound = false;
-			int i;
-			// location
-			int index;
-			for (i = 0; i < node->key_count; i++)
+			// right if the node split after its parent was read, down otherwise
+			PageId nextNo = rightLinkFor<L>(page, keyValue, upper);
+			bool down = (nextNo == 0);
+			if (down)
 			{
-				if (keyValue < node->keyArray[i])
-				{
-					placeFound = true;
-					index = i;
+				if (isLeaf(page))
 					break;
-				}
+				nextNo = L::childAt(page, upper ? L::childUpperBound(page, keyValue) : L::childLowerBound(page, keyValue));
 			}
+			// a page number read from a node that changed meanwhile may be anything
+			valid = latches[pageNo].validate(version);
+			if (!valid)
+				break;
+			if (down && path != NULL)
+				path->push_back(pageNo);
+			Page *next;
+			bool nextPinned = readNode(nextNo, next);
+			std::uint64_t nextVersion = latches[nextNo].readLock();
+			// and the node must still have led there when the version of the next one was read
+			valid = latches[pageNo].validate(version);
+			releaseNode(pageNo, pinned);
+			pageNo = nextNo;
+			page = next;
+			pinned = nextPinned;
+			version = nextVersion;
+		}
+		if (valid)
+		{
+			// the caller unpins the leaf, which it only finds in pinnedNodes if it was a non-leaf
+			// node that got freed and reused since
+			if (!pinned)
+				bufMgr->readPage(file, pageNo, page);
+			return version;
+		}
+		releaseNode(pageNo, pinned);
+	}
+}
 
-			if (placeFound == true)
-			{
-				insert(key, node->pageNoArray[index], rid);
-			}
-			else
-			{
-				insert(key, node->pageNoArray[node->key_count], rid);
-			}
+// -----------------------------------------------------------------------------
+// BTreeIndex::rightLinkFor
+// -----------------------------------------------------------------------------
+
+template <class L>
+PageId BTreeIndex::rightLinkFor(Page *page, const typename L::Key &keyValue, const bool upper)
+{
+	if (isLeaf(page))
+		return L::leafPastHighKey(page, keyValue, upper) ? L::getRightSib(page) : 0;
+	return L::nonLeafPastHighKey(page, keyValue, upper) ? L::nonLeafRightSib(page) : 0;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertIntoLeaf
+// -----------------------------------------------------------------------------
+
+template <class L>
+bool BTreeIndex::insertIntoLeaf(const typename L::Key &keyValue, const RecordId rid)
+{
+	// no node splits or merges until the counts of the ancestors of the leaf are updated too
+	structureLatch.lockShared();
+	// under appends the rightmost leaf is taken without descending to it
+	if (appendRun >= APPEND_RUN && insertIntoRightmost<L>(keyValue, rid))
+	{
+		structureLatch.unlockShared();
+		return true;
+	}
+	// non-leaf nodes descended from, root first
+	std::vector<PageId> path;
+	while (true)
+	{
+		PageId pageNo;
+		Page *page;
+		std::uint64_t version = descendToLeaf<L>(keyValue, true, pageNo, page, &path);
+		// locking fails if another insert or delete changed the leaf since it was reached
+		if (!latches[pageNo].tryUpgrade(version))
+		{
+			bufMgr->unPinPage(file, pageNo, false);
+			continue;
+		}
+		bool append = appendsTo<L>(page, keyValue);
+		if (!append)
+			appendRun = 0;
+		else
+		{
+			rightmostLeaf = pageNo;
+			if (appendRun < APPEND_RUN)
+				appendRun++;
 		}
+		bool inserted = L::leafInsert(page, keyValue, rid);
+		if (inserted)
+			latches[pageNo].writeUnlock();
+		else
+			latches[pageNo].writeUnlockUnchanged();
+		bufMgr->unPinPage(file, pageNo, inserted);
+		if (inserted)
+			addToAncestors<L>(path, pageNo, keyValue, 1);
+		structureLatch.unlockShared();
+		return inserted;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertIntoRightmost
+// -----------------------------------------------------------------------------
+
+template <class L>
+bool BTreeIndex::insertIntoRightmost(const typename L::Key &keyValue, const RecordId rid)
+{
+	PageId pageNo = rightmostLeaf;
+	if (pageNo == 0)
+		return false;
+	Page *page;
+	bufMgr->readPage(file, pageNo, page);
+	latches[pageNo].writeLock();
+	// the hint may be out of date, the page split, freed or reused since
+	bool inserted = isLeaf(page) && appendsTo<L>(page, keyValue) && L::leafInsert(page, keyValue, rid);
+	if (inserted)
+		latches[pageNo].writeUnlock();
+	else
+		latches[pageNo].writeUnlockUnchanged();
+	bufMgr->unPinPage(file, pageNo, inserted);
+	if (inserted)
+		addToRightmostPath<L>(1);
+	return inserted;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::appendsTo
+// -----------------------------------------------------------------------------
+
+template <class L>
+bool BTreeIndex::appendsTo(Page *page, const typename L::Key &keyValue)
+{
+	int count = L::leafCount(page);
+	return L::getRightSib(page) == 0 && count > 0 && !(keyValue < L::leafKey(page, count - 1));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertSplitting
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::insertSplitting(const typename L::Key &keyValue, const RecordId rid)
+{
+	// splits run alone, so the counts of the nodes split are not changed meanwhile; lookups
+	// still run and may find a new node only through the right link of the node split
+	structureLatch.lockExclusive();
+	// non-leaf nodes descended from, root first
+	std::vector<PageId> path;
+	PageId pageNo;
+	Page *page;
+	descendToLeaf<L>(keyValue, true, pageNo, page, &path);
+	latches[pageNo].writeLock();
+	// the leaf may have split since it was reached
+	while (L::leafPastHighKey(page, keyValue, true))
+	{
+		PageId nextNo = L::getRightSib(page);
+		latches[pageNo].writeUnlockUnchanged();
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextNo;
+		bufMgr->readPage(file, pageNo, page);
+		latches[pageNo].writeLock();
+	}
+	// and another thread may have made room in it since it was found full
+	if (L::leafInsert(page, keyValue, rid))
+	{
+		latches[pageNo].writeUnlock();
+		bufMgr->unPinPage(file, pageNo, true);
+		addToAncestors<L>(path, pageNo, keyValue, 1);
+		structureLatch.unlockExclusive();
+		return;
 	}
 
-	else if (isLeaf == 1)
+	// split the leaf; its right sibling gets the new leaf as left sibling, and locks on a level
+	// are only ever waited for from left to right
+	PageId rightNo = L::getRightSib(page);
+	if (rightNo != 0)
+		latches[rightNo].writeLock();
+	PageKeyPair<typename L::Key> separator;
+	splitLeaf<L>(pageNo, page, keyValue, rid, separator);
+	if (rightNo != 0)
+		latches[rightNo].writeUnlock();
+
+	// then link the new node into the parent, which may split in turn
+	while (true)
 	{
-		LeafNodeInt *node = (LeafNodeInt *)page;
-		if (node->key_count < INTARRAYLEAFSIZE)
+		// the entries under the node split and under the new node, one more than were under
+		// the node before
+		std::uint32_t childCount = subtreeCount<L>(page);
+		std::uint32_t newCount = subtreeCount<L>(separator.pageNo);
+		if (pageNo == rootPageNum)
 		{
-			// whether insertion is done
-			bool insertDone = false;
-			int i;
-			for (i = 0; i < node->key_count; i++)
-			{
-				if (keyValue < node->keyArray[i])
-				{
-					memmove(&node->keyArray[i + 1], &node->keyArray[i], (node->key_count - i) * sizeof(int));
-					memmove(&node->ridArray[i + 1], &node->ridArray[i], (node->key_count - i) * sizeof(RecordId));
-					node->keyArray[i] = keyValue;
-					node->ridArray[i] = rid;
-					node->key_count++;
-					insertDone = true;
-					break;
-				}
-			}
-			if (insertDone == false)
-			{
-				node->keyArray[node->key_count] = keyValue;
-				node->ridArray[node->key_count] = rid;
-				node->key_count++;
-			}
+			// the root split, grow the tree by one level before letting go of the old root
+			Page *rootPage;
+			PageId newRootNo;
+			allocNode(newRootNo, rootPage);
+			L::initNonLeaf(rootPage, isLeaf(page) ? 1 : 0, pageNo, childCount);
+			L::nonLeafInsert(rootPage, separator.key, separator.pageNo, newCount);
+			bufMgr->unPinPage(file, newRootNo, true);
+			pinNode(newRootNo);
+			setRoot(newRootNo);
+			latches[pageNo].writeUnlock();
+			bufMgr->unPinPage(file, pageNo, true);
+			break;
 		}
+
+		// the new node is reachable through the right link of the node split from here on
+		PageId childNo = pageNo;
+		latches[pageNo].writeUnlock();
+		bufMgr->unPinPage(file, pageNo, true);
+		if (path.empty())
+			pageNo = leftmostParent<L>(childNo);
 		else
 		{
-			leafSplitInsert(key, pid, rid);
+			pageNo = path.back();
+			path.pop_back();
+		}
+		bufMgr->readPage(file, pageNo, page);
+		latches[pageNo].writeLock();
+		// the parent may have split too, the separator goes next to the child, or where its key
+		// leads if the child was split from a node not linked into the parents yet either
+		while (childIndex<L>(page, childNo, separator.key) < 0 && L::nonLeafPastHighKey(page, separator.key, true))
+		{
+			PageId nextNo = L::nonLeafRightSib(page);
+			latches[pageNo].writeUnlockUnchanged();
+			bufMgr->unPinPage(file, pageNo, false);
+			pageNo = nextNo;
+			bufMgr->readPage(file, pageNo, page);
+			latches[pageNo].writeLock();
 		}
+		L::setChildCount(page, childIndex<L>(page, childNo, separator.key), childCount);
+		if (L::nonLeafInsert(page, separator.key, separator.pageNo, newCount))
+		{
+			latches[pageNo].writeUnlock();
+			bufMgr->unPinPage(file, pageNo, true);
+			// the nodes above only gained the new entry
+			addToAncestors<L>(path, pageNo, keyValue, 1);
+			break;
+		}
+		splitNonLeaf<L>(page, separator, newCount);
+	}
+	structureLatch.unlockExclusive();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::leftmostParent
+// -----------------------------------------------------------------------------
+
+template <class L>
+PageId BTreeIndex::leftmostParent(const PageId childNo)
+{
+	// down the first children from the root; without deletes running a first child stays first
+	PageId pageNo = rootPageNum;
+	while (true)
+	{
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		std::uint64_t version = latches[pageNo].readLock();
+		PageId firstNo = L::childAt(page, 0);
+		bool valid = latches[pageNo].validate(version);
+		bufMgr->unPinPage(file, pageNo, false);
+		if (!valid)
+			continue;
+		if (firstNo == childNo)
+			return pageNo;
+		pageNo = firstNo;
 	}
-	bufMgr->unPinPage(file, pid, true);
 }
 
+// -----------------------------------------------------------------------------
+// BTreeIndex::childIndex
+// -----------------------------------------------------------------------------
+
+template <class L>
+int BTreeIndex::childIndex(Page *page, const PageId childNo, const typename L::Key &keyValue)
+{
+	// a child a key leads to is never left of its lower bound, look there first
+	for (int i = L::childLowerBound(page, keyValue); i <= L::nonLeafCount(page); i++)
+		if (L::childAt(page, i) == childNo)
+			return i;
+	for (int i = 0; i <= L::nonLeafCount(page); i++)
+		if (L::childAt(page, i) == childNo)
+			return i;
+	return -1;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::subtreeCount
+// -----------------------------------------------------------------------------
+
+template <class L>
+std::uint32_t BTreeIndex::subtreeCount(Page *page)
+{
+	if (isLeaf(page))
+		return L::leafCount(page);
+	std::uint32_t count = 0;
+	for (int i = 0; i <= L::nonLeafCount(page); i++)
+		count += L::childCount(page, i);
+	return count;
+}
+
+template <class L>
+std::uint32_t BTreeIndex::subtreeCount(const PageId pageNo)
+{
+	Page *page;
+	bufMgr->readPage(file, pageNo, page);
+	std::uint32_t count = subtreeCount<L>(page);
+	bufMgr->unPinPage(file, pageNo, false);
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::addToAncestors
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::addToAncestors(const std::vector<PageId> &path, PageId childNo, const typename L::Key &keyValue,
+								const int delta)
+{
+	for (std::size_t i = path.size(); i > 0; i--)
+	{
+		PageId pageNo = path[i - 1];
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		L::addChildCount(page, childIndex<L>(page, childNo, keyValue), delta);
+		bufMgr->unPinPage(file, pageNo, true);
+		childNo = pageNo;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::addToRightmostPath
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::addToRightmostPath(const int delta)
+{
+	PageId pageNo = rootPageNum;
+	while (true)
+	{
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		if (isLeaf(page))
+		{
+			bufMgr->unPinPage(file, pageNo, false);
+			return;
+		}
+		int last = L::nonLeafCount(page);
+		L::addChildCount(page, last, delta);
+		PageId childNo = L::childAt(page, last);
+		bool aboveLeaves = L::nonLeafLevel(page) == 1;
+		bufMgr->unPinPage(file, pageNo, true);
+		if (aboveLeaves)
+			return;
+		pageNo = childNo;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lockRoot
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::lockRoot(PageId &pageNo, Page *&page)
+{
+	while (true)
+	{
+		pageNo = rootPageNum;
+		bufMgr->readPage(file, pageNo, page);
+		latches[pageNo].writeLock();
+		// the root is only replaced by a writer holding it
+		if (pageNo == rootPageNum)
+			return;
+		latches[pageNo].writeUnlockUnchanged();
+		bufMgr->unPinPage(file, pageNo, false);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setRoot
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setRoot(const PageId pageNo)
+{
+	rootLatch.writeLock();
+	rootPageNum = pageNo;
+	rootLatch.writeUnlock();
+
+	Page *metaPage;
+	bufMgr->readPage(file, headerPageNum, metaPage);
+	((IndexMetaInfo *)metaPage)->rootPageNo = pageNo;
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntry
+// -----------------------------------------------------------------------------
+
+const void BTreeIndex::deleteEntry(const void *key, const RecordId rid)
+{
+	learnedValid = false;
+	if (learnedModelPageNo != 0)
+		dropLearnedModel();
+	(this->*deleteEntryImpl)(key, rid);
+	entryCount--;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntryTyped
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::deleteEntryTyped(const void *key, const RecordId rid)
+{
+	// the key value
+	typename L::Key keyValue = L::keyFromPointer(key);
+	if (deleteFromLeaf<L>(keyValue, rid))
+		return;
+	// non-leaf nodes on the way from the root to the leaf and the child taken in each
+	std::vector<std::pair<PageId, int> > path;
+	// deletes that may merge run alone, with no split half linked into the parents, and
+	// every node the delete looks at stays locked until it is done
+	std::vector<PageId> latched;
+	PageId pageNo;
+	Page *page;
+	structureLatch.lockExclusive();
+	lockRoot(pageNo, page);
+	latched.push_back(pageNo);
+	while (!isLeaf(page))
+	{
+		// duplicates of the key may sit left of an equal separator
+		int child = L::childLowerBound(page, keyValue);
+		path.push_back(std::make_pair(pageNo, child));
+		PageId childNo = L::childAt(page, child);
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = childNo;
+		latchNode(latched, pageNo);
+		bufMgr->readPage(file, pageNo, page);
+	}
+
+	// look for the record among the entries with the key, which may go on in the leaves to the right
+	int i = L::leafLowerBound(page, keyValue);
+	while (true)
+	{
+		for (; i < L::leafCount(page); i++)
+		{
+			if (L::compareLeafKey(page, i, keyValue) > 0)
+			{
+				bufMgr->unPinPage(file, pageNo, false);
+				unlatchAll(latched);
+				structureLatch.unlockExclusive();
+				throw NoSuchKeyFoundException();
+			}
+			if (L::leafRid(page, i) == rid)
+			{
+				L::leafRemove(page, i);
+				for (std::size_t j = 0; j < path.size(); j++)
+				{
+					Page *parent;
+					bufMgr->readPage(file, path[j].first, parent);
+					L::addChildCount(parent, path[j].second, -1);
+					bufMgr->unPinPage(file, path[j].first, true);
+				}
+				rebalance<L>(path, pageNo, page, latched);
+				unlatchAll(latched);
+				structureLatch.unlockExclusive();
+				return;
+			}
+		}
+		if (!nextLeafOnPath<L>(path, pageNo, page, latched))
+		{
+			unlatchAll(latched);
+			structureLatch.unlockExclusive();
+			throw NoSuchKeyFoundException();
+		}
+		i = 0;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteFromLeaf
+// -----------------------------------------------------------------------------
+
+template <class L>
+bool BTreeIndex::deleteFromLeaf(const typename L::Key &keyValue, const RecordId rid)
+{
+	// no node splits or merges until the counts of the ancestors of the leaf are updated too
+	structureLatch.lockShared();
+	// non-leaf nodes descended from, root first
+	std::vector<PageId> path;
+	while (true)
+	{
+		PageId pageNo;
+		Page *page;
+		std::uint64_t version = descendToLeaf<L>(keyValue, false, pageNo, page, &path);
+		// locking fails if the leaf changed since it was reached, which may have been a split or a merge
+		if (!latches[pageNo].tryUpgrade(version))
+		{
+			bufMgr->unPinPage(file, pageNo, false);
+			continue;
+		}
+		int i = L::leafLowerBound(page, keyValue);
+		while (i < L::leafCount(page) && L::compareLeafKey(page, i, keyValue) == 0 && !(L::leafRid(page, i) == rid))
+			i++;
+		bool removed = false;
+		if (i < L::leafCount(page) && L::compareLeafKey(page, i, keyValue) == 0)
+		{
+			// a root leaf may go down to empty, any other leaf has to stay full enough not to be rebalanced
+			Page saved = *page;
+			L::leafRemove(page, i);
+			removed = pageNo == rootPageNum || L::leafFill(page) >= MIN_NODE_FILL;
+			if (!removed)
+				*page = saved;
+		}
+		if (removed)
+			latches[pageNo].writeUnlock();
+		else
+			latches[pageNo].writeUnlockUnchanged();
+		bufMgr->unPinPage(file, pageNo, removed);
+		if (removed)
+			addToAncestors<L>(path, pageNo, keyValue, -1);
+		structureLatch.unlockShared();
+		return removed;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::nextLeafOnPath
+// -----------------------------------------------------------------------------
+
+template <class L>
+bool BTreeIndex::nextLeafOnPath(std::vector<std::pair<PageId, int> > &path, PageId &pageNo, Page *&page, std::vector<PageId> &latched)
+{
+	bufMgr->unPinPage(file, pageNo, false);
+	// climb to the nearest node with a child right of the one taken
+	PageId childNo = 0;
+	while (!path.empty())
+	{
+		Page *parent;
+		bufMgr->readPage(file, path.back().first, parent);
+		bool hasNext = path.back().second < L::nonLeafCount(parent);
+		if (hasNext)
+			childNo = L::childAt(parent, ++path.back().second);
+		bufMgr->unPinPage(file, path.back().first, false);
+		if (hasNext)
+			break;
+		path.pop_back();
+	}
+	if (path.empty())
+		return false;
+
+	// and down its leftmost children to a leaf
+	pageNo = childNo;
+	latchNode(latched, pageNo);
+	bufMgr->readPage(file, pageNo, page);
+	while (!isLeaf(page))
+	{
+		path.push_back(std::make_pair(pageNo, 0));
+		childNo = L::childAt(page, 0);
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = childNo;
+		latchNode(latched, pageNo);
+		bufMgr->readPage(file, pageNo, page);
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::rebalance
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::rebalance(std::vector<std::pair<PageId, int> > &path, PageId pageNo, Page *page, std::vector<PageId> &latched)
+{
+	while (!path.empty())
+	{
+		bool leaf = isLeaf(page);
+		if ((leaf ? L::leafFill(page) : L::nonLeafFill(page)) >= MIN_NODE_FILL)
+			break;
+
+		// the right sibling under the same parent, or the left one for the last child
+		PageId parentNo = path.back().first;
+		int child = path.back().second;
+		path.pop_back();
+		Page *parent;
+		bufMgr->readPage(file, parentNo, parent);
+		int separatorIndex = (child < L::nonLeafCount(parent)) ? child : child - 1;
+		if (separatorIndex < 0)
+		{
+			// an only child, nothing to merge with
+			bufMgr->unPinPage(file, parentNo, false);
+			bufMgr->unPinPage(file, pageNo, true);
+			return;
+		}
+		PageId siblingNo = L::childAt(parent, (separatorIndex == child) ? child + 1 : child - 1);
+		Page *sibling;
+		latchNode(latched, siblingNo);
+		bufMgr->readPage(file, siblingNo, sibling);
+		PageId leftNo = (separatorIndex == child) ? pageNo : siblingNo;
+		PageId rightNo = (separatorIndex == child) ? siblingNo : pageNo;
+		Page *left = (separatorIndex == child) ? page : sibling;
+		Page *right = (separatorIndex == child) ? sibling : page;
+
+		bool merged;
+		if (leaf)
+		{
+			merged = L::leafMerge(left, right);
+			if (merged)
+			{
+				PageId nextNo = L::getRightSib(right);
+				L::setRightSib(left, nextNo);
+				L::setLeafHighKey(left, L::leafHighKey(right));
+				if (nextNo != 0)
+				{
+					Page *next;
+					latchNode(latched, nextNo);
+					bufMgr->readPage(file, nextNo, next);
+					L::setLeftSib(next, leftNo);
+					bufMgr->unPinPage(file, nextNo, true);
+				}
+			}
+		}
+		else
+		{
+			merged = L::nonLeafMerge(left, L::nonLeafKey(parent, separatorIndex), right);
+			if (merged)
+			{
+				L::setNonLeafRightSib(left, L::nonLeafRightSib(right));
+				L::setNonLeafHighKey(left, L::nonLeafHighKey(right));
+			}
+		}
+
+		if (!merged)
+		{
+			if (leaf)
+				redistributeLeaves<L>(left, right, parent, separatorIndex);
+			else
+				redistributeNonLeaves<L>(left, right, parent, separatorIndex);
+			L::setChildCount(parent, separatorIndex, subtreeCount<L>(left));
+			L::setChildCount(parent, separatorIndex + 1, subtreeCount<L>(right));
+			bufMgr->unPinPage(file, leftNo, true);
+			bufMgr->unPinPage(file, rightNo, true);
+			bufMgr->unPinPage(file, parentNo, true);
+			return;
+		}
+
+		// the right node is gone, its separator leaves the parent, which may now be underfull
+		L::setChildCount(parent, separatorIndex, subtreeCount<L>(left));
+		L::nonLeafRemove(parent, separatorIndex);
+		bufMgr->unPinPage(file, leftNo, true);
+		freeNode(rightNo, right);
+		pageNo = parentNo;
+		page = parent;
+	}
+
+	if (path.empty() && !isLeaf(page) && L::nonLeafCount(page) == 0)
+	{
+		// the root has a single child left, which becomes the root
+		setRoot(L::childAt(page, 0));
+		freeNode(pageNo, page);
+		return;
+	}
+	bufMgr->unPinPage(file, pageNo, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::redistributeLeaves
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::redistributeLeaves(Page *left, Page *right, Page *parent, const int separatorIndex)
+{
+	// a move stops early if the new separator or the entry does not fit, leaving a valid tree
+	while (L::leafFill(left) < L::leafFill(right) && L::leafCount(right) > 1)
+	{
+		typename L::Key key = L::leafKey(right, 0);
+		if (!L::leafInsert(left, key, L::leafRid(right, 0)))
+			break;
+		if (!L::nonLeafSetKey(parent, separatorIndex, L::separatorBetween(key, L::leafKey(right, 1))))
+		{
+			L::leafRemove(left, findLeafEntry<L>(left, key, L::leafRid(right, 0)));
+			break;
+		}
+		L::leafRemove(right, 0);
+	}
+	while (L::leafFill(right) < L::leafFill(left) && L::leafCount(left) > 1)
+	{
+		int last = L::leafCount(left) - 1;
+		typename L::Key key = L::leafKey(left, last);
+		if (!L::leafInsert(right, key, L::leafRid(left, last)))
+			break;
+		if (!L::nonLeafSetKey(parent, separatorIndex, L::separatorBetween(L::leafKey(left, last - 1), key)))
+		{
+			L::leafRemove(right, findLeafEntry<L>(right, key, L::leafRid(left, last)));
+			break;
+		}
+		L::leafRemove(left, last);
+	}
+	L::setLeafHighKey(left, L::nonLeafKey(parent, separatorIndex));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::findLeafEntry
+// -----------------------------------------------------------------------------
+
+template <class L>
+int BTreeIndex::findLeafEntry(Page *page, const typename L::Key &key, const RecordId rid)
+{
+	int i = L::leafLowerBound(page, key);
+	while (!(L::leafRid(page, i) == rid))
+		i++;
+	return i;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::redistributeNonLeaves
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::redistributeNonLeaves(Page *left, Page *right, Page *parent, const int separatorIndex)
+{
+	// the separator in the parent comes down with the child, the next one goes up
+	while (L::nonLeafFill(left) < L::nonLeafFill(right) && L::nonLeafCount(right) > 0)
+	{
+		if (!L::nonLeafInsert(left, L::nonLeafKey(parent, separatorIndex), L::childAt(right, 0), L::childCount(right, 0)))
+			break;
+		if (!L::nonLeafSetKey(parent, separatorIndex, L::nonLeafKey(right, 0)))
+		{
+			L::nonLeafRemove(left, L::nonLeafCount(left) - 1);
+			break;
+		}
+		L::nonLeafRemoveFirst(right);
+	}
+	while (L::nonLeafFill(right) < L::nonLeafFill(left) && L::nonLeafCount(left) > 0)
+	{
+		int last = L::nonLeafCount(left) - 1;
+		if (!L::nonLeafPrepend(right, L::nonLeafKey(parent, separatorIndex), L::childAt(left, last + 1),
+							   L::childCount(left, last + 1)))
+			break;
+		if (!L::nonLeafSetKey(parent, separatorIndex, L::nonLeafKey(left, last)))
+		{
+			L::nonLeafRemoveFirst(right);
+			break;
+		}
+		L::nonLeafRemove(left, last);
+	}
+	L::setNonLeafHighKey(left, L::nonLeafKey(parent, separatorIndex));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::allocNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::allocNode(PageId &pageNo, Page *&page)
+{
+	std::lock_guard<std::mutex> guard(freeListLatch);
+	if (freeListHead == 0)
+	{
+		bufMgr->allocPage(file, pageNo, page);
+		return;
+	}
+	pageNo = freeListHead;
+	bufMgr->readPage(file, pageNo, page);
+	setFreeListHead(((FreeNode *)page)->nextFree);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::freeNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::freeNode(const PageId pageNo, Page *page)
+{
+	unpinNode(pageNo);
+	std::lock_guard<std::mutex> guard(freeListLatch);
+	FreeNode *node = (FreeNode *)page;
+	node->isLeaf = FREE_NODE;
+	node->nextFree = freeListHead;
+	bufMgr->unPinPage(file, pageNo, true);
+	setFreeListHead(pageNo);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setFreeListHead
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::setFreeListHead(const PageId pageNo)
+{
+	freeListHead = pageNo;
+	Page *metaPage;
+	bufMgr->readPage(file, headerPageNum, metaPage);
+	((IndexMetaInfo *)metaPage)->freeListHead = pageNo;
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::pinNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::pinNode(const PageId pageNo)
+{
+	if (!pinUpperLevels)
+		return;
+	std::lock_guard<std::mutex> guard(pinLatch);
+	Page *page;
+	bufMgr->readPage(file, pageNo, page);
+	pinnedNodes[pageNo] = page;
+	pinnedPageNos.push_back(pageNo);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::unpinNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::unpinNode(const PageId pageNo)
+{
+	if (!pinUpperLevels)
+		return;
+	std::lock_guard<std::mutex> guard(pinLatch);
+	std::vector<PageId>::iterator it = std::find(pinnedPageNos.begin(), pinnedPageNos.end(), pageNo);
+	if (it == pinnedPageNos.end())
+		return;
+	pinnedPageNos.erase(it);
+	pinnedNodes[pageNo] = NULL;
+	bufMgr->unPinPage(file, pageNo, false);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readNode
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::readNode(const PageId pageNo, Page *&page)
+{
+	if (pinUpperLevels)
+	{
+		page = pinnedNodes[pageNo];
+		if (page != NULL)
+			return false;
+	}
+	bufMgr->readPage(file, pageNo, page);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::releaseNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::releaseNode(const PageId pageNo, const bool pinned)
+{
+	if (pinned)
+		bufMgr->unPinPage(file, pageNo, false);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::latchNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::latchNode(std::vector<PageId> &latched, const PageId pageNo)
+{
+	if (std::find(latched.begin(), latched.end(), pageNo) != latched.end())
+		return;
+	latches[pageNo].writeLock();
+	latched.push_back(pageNo);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::unlatchAll
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::unlatchAll(std::vector<PageId> &latched)
+{
+	for (std::size_t i = 0; i < latched.size(); i++)
+		latches[latched[i]].writeUnlock();
+	latched.clear();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::getFreePageCount
+// -----------------------------------------------------------------------------
+
+std::uint32_t BTreeIndex::getFreePageCount()
+{
+	std::uint32_t count = 0;
+	for (PageId pageNo = freeListHead; pageNo != 0; count++)
+	{
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		PageId next = ((FreeNode *)page)->nextFree;
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = next;
+	}
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::getNodeCount
+// -----------------------------------------------------------------------------
+
+std::uint32_t BTreeIndex::getNodeCount()
+{
+	return (this->*getNodeCountImpl)();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::getNodeCountTyped
+// -----------------------------------------------------------------------------
+
+template <class L>
+std::uint32_t BTreeIndex::getNodeCountTyped()
+{
+	std::uint32_t count = 1;
+	// non-leaf nodes left to visit
+	std::vector<PageId> pending;
+	pending.push_back(rootPageNum);
+	while (!pending.empty())
+	{
+		PageId pageNo = pending.back();
+		pending.pop_back();
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		if (!isLeaf(page))
+		{
+			int children = L::nonLeafCount(page) + 1;
+			count += children;
+			// children of level 1 nodes are leaves, no need to read them
+			if (L::nonLeafLevel(page) != 1)
+			{
+				for (int i = 0; i < children; i++)
+					pending.push_back(L::childAt(page, i));
+			}
+		}
+		bufMgr->unPinPage(file, pageNo, false);
+	}
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::pinNonLeaves
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::pinNonLeaves()
+{
+	// non-leaf nodes still to visit, depth first
+	std::vector<PageId> pending(1, (PageId)rootPageNum);
+	while (!pending.empty())
+	{
+		PageId pageNo = pending.back();
+		pending.pop_back();
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		if (!isLeaf(page))
+		{
+			pinNode(pageNo);
+			// the children of level 1 nodes are leaves
+			if (L::nonLeafLevel(page) == 0)
+				for (int i = 0; i <= L::nonLeafCount(page); i++)
+					pending.push_back(L::childAt(page, i));
+		}
+		bufMgr->unPinPage(file, pageNo, false);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::bulkLoadRelation
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::bulkLoadRelation(const std::string &relationName, const double fillFactor, const std::uint32_t sortFrames)
+{
+	// entries of all tuples, sorted before they are loaded
+	ExternalSort<typename L::SortKey> entries(file->filename(), bufMgr, sortFrames);
+	entries.addRelation(relationName, attrByteOffset);
+	entries.sort();
+	bulkLoad<L>(entries, fillFactor);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::bulkLoadComposite
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::bulkLoadComposite(const std::string &relationName, const double fillFactor, const std::uint32_t sortFrames)
+{
+	ExternalSort<typename L::SortKey> entries(file->filename(), bufMgr, sortFrames);
+	FileScan fileScan(relationName, bufMgr);
+	RecordId rid;
+	RIDKeyPair<typename L::SortKey> entry;
+	try
+	{
+		while (1)
+		{
+			fileScan.scanNext(rid);
+			std::string record = fileScan.getRecord();
+			CompositeKey key = CompositeKey::fromRecord(record.c_str(), keyColumns);
+			entry.set(rid, L::keyFromPointer(&key));
+			entries.add(entry);
+		}
+	}
+	catch (EndOfFileException e)
+	{
+	}
+	entries.sort();
+	bulkLoad<L>(entries, fillFactor);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::bulkLoad
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::bulkLoad(ExternalSort<typename L::SortKey> &entries, const double fillFactor)
+{
+	typedef typename L::Key Key;
+	// number of entries
+	int count = entries.count();
+	// entry being loaded
+	RIDKeyPair<typename L::SortKey> entry;
+	// levels being built, leaves at index 0; levels above are added as they fill up
+	std::vector<BulkLoadLevel<Key> > levels(1);
+	// last key added to the open leaf
+	Key lastKey = Key();
+	// statistics of the entries, which come in key order
+	HistogramBuilder<L> histogram(count);
+	// learned lookup model of the leaves, with as many positions per page as a full leaf has entries
+	LearnedModelBuilder model(learnedSegments);
+	learnedSlots = 0;
+
+	allocNode(levels[0].pageNo, levels[0].page);
+	L::initLeaf(levels[0].page);
+	levels[0].nodeCount = 1;
+	for (int i = 0; i < count; i++)
+	{
+		entries.scanNext(entry);
+		Key key = L::keyFromSortKey(entry.key);
+		if (!L::leafAppend(levels[0].page, key, entry.rid, fillFactor))
+		{
+			// the leaf is full, link a new one to it and hand it to its parent
+			PageId leafNo = levels[0].pageNo;
+			Page *leaf = levels[0].page;
+			Key lowKey = levels[0].lowKey;
+			allocNode(levels[0].pageNo, levels[0].page);
+			L::initLeaf(levels[0].page);
+			L::setRightSib(leaf, levels[0].pageNo);
+			L::setLeftSib(levels[0].page, leafNo);
+			levels[0].lowKey = L::separatorBetween(lastKey, key);
+			L::setLeafHighKey(leaf, levels[0].lowKey);
+			levels[0].nodeCount++;
+			bulkLoadAddChild<L>(levels, 1, leafNo, lowKey, L::leafCount(leaf), fillFactor);
+			if (learnedLookup)
+				learnLeaf<L>(model, learnedSlots, leafNo, leaf);
+			bufMgr->unPinPage(file, leafNo, true);
+			L::leafAppend(levels[0].page, key, entry.rid, fillFactor);
+		}
+		histogram.add(key, 1, 1);
+		lastKey = key;
+	}
+
+	// hand the open node of every level to the level above; the only node of the top level is the root
+	for (int level = 0; level < (int)levels.size(); level++)
+	{
+		PageId pageNo = levels[level].pageNo;
+		Key lowKey = levels[level].lowKey;
+		if (level == 0 && learnedLookup)
+			learnLeaf<L>(model, learnedSlots, pageNo, levels[level].page);
+		if (level + 1 == (int)levels.size() && levels[level].nodeCount == 1)
+			rootPageNum = pageNo;
+		else
+			bulkLoadAddChild<L>(levels, level + 1, pageNo, lowKey, subtreeCount<L>(levels[level].page), fillFactor);
+		bufMgr->unPinPage(file, pageNo, true);
+	}
+
+	entryCount = count;
+	Page *metaPage;
+	bufMgr->readPage(file, headerPageNum, metaPage);
+	((IndexMetaInfo *)metaPage)->rootPageNo = rootPageNum;
+	((IndexMetaInfo *)metaPage)->entryCount = count;
+	bufMgr->unPinPage(file, headerPageNum, true);
+	setStatistics(histogram.finish());
+	if (learnedLookup)
+	{
+		model.finish();
+		storeLearnedModel();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::bulkLoadAddChild
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::bulkLoadAddChild(std::vector<BulkLoadLevel<typename L::Key> > &levels, const int level,
+								  const PageId childNo, const typename L::Key &lowKey, const std::uint32_t childCount,
+								  const double fillFactor)
+{
+	if (level == (int)levels.size())
+		levels.push_back(BulkLoadLevel<typename L::Key>());
+	PageId fullNo = 0;
+	Page *full = NULL;
+	if (levels[level].page != NULL)
+	{
+		if (L::nonLeafAppend(levels[level].page, lowKey, childNo, childCount, fillFactor))
+			return;
+		// the node is full, hand it to the level above
+		fullNo = levels[level].pageNo;
+		full = levels[level].page;
+		typename L::Key fullLowKey = levels[level].lowKey;
+		bulkLoadAddChild<L>(levels, level + 1, fullNo, fullLowKey, subtreeCount<L>(full), fillFactor);
+	}
+
+	// the child starts a new node, linked to the full one
+	BulkLoadLevel<typename L::Key> &current = levels[level];
+	allocNode(current.pageNo, current.page);
+	L::initNonLeaf(current.page, (level == 1) ? 1 : 0, childNo, childCount);
+	current.lowKey = lowKey;
+	current.nodeCount++;
+	if (full != NULL)
+	{
+		L::setNonLeafRightSib(full, current.pageNo);
+		L::setNonLeafHighKey(full, lowKey);
+		bufMgr->unPinPage(file, fullNo, true);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::splitLeaf
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::splitLeaf(const PageId pageNo, Page *page, const typename L::Key &keyValue, const RecordId rid, PageKeyPair<typename L::Key> &separator)
+{
+	// new leaf
+	Page *newPage;
+	PageId newPageId;
+	allocNode(newPageId, newPage);
+	bool append = appendRun >= APPEND_RUN && appendsTo<L>(page, keyValue);
+	if (append)
+		splitLeafForAppend<L>(page, newPage, keyValue, rid);
+	else
+		L::splitLeaf(page, newPage, keyValue, rid);
+	PageId rightNo = L::getRightSib(page);
+	L::setRightSib(newPage, rightNo);
+	L::setLeftSib(newPage, pageNo);
+	L::setRightSib(page, newPageId);
+	if (rightNo != 0)
+	{
+		Page *right;
+		bufMgr->readPage(file, rightNo, right);
+		L::setLeftSib(right, newPageId);
+		bufMgr->unPinPage(file, rightNo, true);
+	}
+
+	separator.set(newPageId, L::separatorBetween(L::leafKey(page, L::leafCount(page) - 1), L::leafKey(newPage, 0)));
+	// the new leaf takes over the high key, the separator bounds the old one
+	L::setLeafHighKey(newPage, L::leafHighKey(page));
+	L::setLeafHighKey(page, separator.key);
+	bufMgr->unPinPage(file, newPageId, true);
+	if (append)
+		rightmostLeaf = newPageId;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::splitLeafForAppend
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::splitLeafForAppend(Page *page, Page *newPage, const typename L::Key &keyValue, const RecordId rid)
+{
+	L::initLeaf(newPage);
+	// entries taken off the end until the leaf is no more than APPEND_SPLIT_FILL full, last first
+	std::vector<std::pair<typename L::Key, RecordId> > moved;
+	while (L::leafCount(page) > 1 && L::leafFill(page) > APPEND_SPLIT_FILL)
+	{
+		int last = L::leafCount(page) - 1;
+		moved.push_back(std::make_pair(L::leafKey(page, last), L::leafRid(page, last)));
+		L::leafRemove(page, last);
+	}
+	for (size_t i = moved.size(); i > 0; i--)
+		L::leafInsert(newPage, moved[i - 1].first, moved[i - 1].second);
+	L::leafInsert(newPage, keyValue, rid);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::splitNonLeaf
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::splitNonLeaf(Page *page, PageKeyPair<typename L::Key> &separator, const std::uint32_t count)
+{
+	// new non-leaf node
+	Page *newPage;
+	PageId newPageId;
+	allocNode(newPageId, newPage);
+
+	// key pushed up to the parent
+	typename L::Key pushUp;
+	L::splitNonLeaf(page, newPage, separator.key, separator.pageNo, count, pushUp);
+	separator.set(newPageId, pushUp);
+	// the new node takes over the right link and high key, the middle key bounds the old one
+	L::setNonLeafRightSib(newPage, L::nonLeafRightSib(page));
+	L::setNonLeafHighKey(newPage, L::nonLeafHighKey(page));
+	L::setNonLeafRightSib(page, newPageId);
+	L::setNonLeafHighKey(page, pushUp);
+
+	bufMgr->unPinPage(file, newPageId, true);
+	pinNode(newPageId);
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -------------------- SCAN ---------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookup
+// -----------------------------------------------------------------------------
+
+std::uint32_t BTreeIndex::lookup(const void *key, std::vector<RecordId> &outRids)
+{
+	return (this->*lookupImpl)(key, outRids);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupTyped
+// -----------------------------------------------------------------------------
+
+template <class L>
+std::uint32_t BTreeIndex::lookupTyped(const void *key, std::vector<RecordId> &outRids)
+{
+	// entries of a covering index with the key differ in their included values, so they are
+	// the range from the key filled low to the key filled high
+	const void *lowVal = key;
+	const void *highVal = key;
+	CompositeKey low;
+	CompositeKey high;
+	coveringBounds(lowVal, GTE, highVal, LTE, low, high);
+	typename L::Key lowValue = L::keyFromPointer(lowVal);
+	typename L::Key highValue = L::keyFromPointer(highVal);
+	// the entries found, handed out once every leaf they were read from is known unchanged
+	std::vector<RecordId> found;
+	while (true)
+	{
+		// duplicates of the key may sit left of an equal separator
+		PageId pageNo;
+		Page *page;
+		std::uint64_t version = descendToLeaf<L>(lowValue, false, pageNo, page);
+
+		found.clear();
+		if (collectDuplicates<L>(lowValue, highValue, pageNo, page, version, L::leafLowerBound(page, lowValue), found))
+			break;
+	}
+	outRids.insert(outRids.end(), found.begin(), found.end());
+	return found.size();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::collectDuplicates
+// -----------------------------------------------------------------------------
+
+template <class L>
+bool BTreeIndex::collectDuplicates(const typename L::Key &low, const typename L::Key &high, PageId pageNo, Page *page,
+								   std::uint64_t version, int i, std::vector<RecordId> &found)
+{
+	// the entries with the key, which may go on in the leaves to the right
+	bool valid;
+	while (true)
+	{
+		int count = L::leafCount(page);
+		for (; i < count && L::compareLeafKey(page, i, high) <= 0 && L::compareLeafKey(page, i, low) >= 0; i++)
+			found.push_back(L::leafRid(page, i));
+		PageId nextNo = L::getRightSib(page);
+		valid = latches[pageNo].validate(version);
+		if (!valid || i < count || nextNo == 0)
+			break;
+		Page *next;
+		bufMgr->readPage(file, nextNo, next);
+		std::uint64_t nextVersion = latches[nextNo].readLock();
+		valid = latches[pageNo].validate(version);
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextNo;
+		page = next;
+		version = nextVersion;
+		if (!valid)
+			break;
+		i = 0;
+	}
+	bufMgr->unPinPage(file, pageNo, false);
+	return valid;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::openLearnedModel
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::openLearnedModel()
+{
+	typedef FixedLayout<int> L;
+	if (learnedModelPageNo != 0 && learnedSegments.empty())
+	{
+		// kept in the file since the index was built or last trained
+		PageId pageNo = learnedModelPageNo;
+		while (pageNo != 0)
+		{
+			Page *page;
+			bufMgr->readPage(file, pageNo, page);
+			LearnedModelPage *modelPage = (LearnedModelPage *)page;
+			learnedSegments.insert(learnedSegments.end(), modelPage->segments, modelPage->segments + modelPage->segmentCount);
+			PageId nextNo = modelPage->nextPageNo;
+			bufMgr->unPinPage(file, pageNo, false);
+			pageNo = nextNo;
+		}
+	}
+	else if (learnedModelPageNo == 0)
+	{
+		// changed leaves hold any number of entries up to their capacity
+		LearnedModelBuilder model(learnedSegments);
+		learnedSlots = LeafNodeInt::CAPACITY;
+		PageId pageNo = rootPageNum;
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		while (!isLeaf(page))
+		{
+			PageId childNo = L::childAt(page, 0);
+			bufMgr->unPinPage(file, pageNo, false);
+			pageNo = childNo;
+			bufMgr->readPage(file, pageNo, page);
+		}
+		while (true)
+		{
+			learnLeaf<L>(model, learnedSlots, pageNo, page);
+			PageId nextNo = L::getRightSib(page);
+			bufMgr->unPinPage(file, pageNo, false);
+			// positions come from page numbers, so once a split put a leaf in a page past those of
+			// the leaves right of it the index is left without a model and lookups descend
+			if (nextNo != 0 && nextNo < pageNo)
+			{
+				learnedSegments.clear();
+				return;
+			}
+			if (nextNo == 0)
+				break;
+			pageNo = nextNo;
+			bufMgr->readPage(file, pageNo, page);
+		}
+		model.finish();
+		storeLearnedModel();
+	}
+	learnedValid = true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::storeLearnedModel
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::storeLearnedModel()
+{
+	// pages are written last first, so each links to the one after it
+	PageId nextNo = 0;
+	std::size_t pages = (learnedSegments.size() + LearnedModelPage::CAPACITY - 1) / LearnedModelPage::CAPACITY;
+	for (std::size_t i = pages; i > 0; i--)
+	{
+		std::size_t first = (i - 1) * LearnedModelPage::CAPACITY;
+		PageId pageNo;
+		Page *page;
+		allocNode(pageNo, page);
+		LearnedModelPage *modelPage = (LearnedModelPage *)page;
+		modelPage->isLeaf = 0;
+		modelPage->nextPageNo = nextNo;
+		modelPage->segmentCount = std::min<std::size_t>(LearnedModelPage::CAPACITY, learnedSegments.size() - first);
+		std::copy(learnedSegments.begin() + first, learnedSegments.begin() + first + modelPage->segmentCount, modelPage->segments);
+		bufMgr->unPinPage(file, pageNo, true);
+		nextNo = pageNo;
+	}
+	learnedModelPageNo = nextNo;
+	Page *metaPage;
+	bufMgr->readPage(file, headerPageNum, metaPage);
+	((IndexMetaInfo *)metaPage)->learnedModelPageNo = nextNo;
+	((IndexMetaInfo *)metaPage)->learnedSlots = learnedSlots;
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::dropLearnedModel
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::dropLearnedModel()
+{
+	// only the first of several inserts or deletes at once gets the pages
+	PageId pageNo = learnedModelPageNo.exchange(0);
+	if (pageNo == 0)
+		return;
+	Page *metaPage;
+	bufMgr->readPage(file, headerPageNum, metaPage);
+	((IndexMetaInfo *)metaPage)->learnedModelPageNo = 0;
+	bufMgr->unPinPage(file, headerPageNum, true);
+	while (pageNo != 0)
+	{
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		PageId nextNo = ((LearnedModelPage *)page)->nextPageNo;
+		freeNode(pageNo, page);
+		pageNo = nextNo;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupLearned
+// -----------------------------------------------------------------------------
+
+std::uint32_t BTreeIndex::lookupLearned(const void *key, std::vector<RecordId> &outRids)
+{
+	typedef FixedLayout<int> L;
+	if (!learnedValid || learnedSegments.empty())
+		return lookupTyped<L>(key, outRids);
+	int keyValue = L::keyFromPointer(key);
+
+	// the segment of the key starts at or below it; keys below the lowest key have no entries
+	std::vector<LearnedSegment>::const_iterator segment = learnedSegments.end();
+	for (size_t low = 0, high = learnedSegments.size(); low < high;)
+	{
+		size_t mid = (low + high) / 2;
+		if (learnedSegments[mid].firstKey <= keyValue)
+		{
+			segment = learnedSegments.begin() + mid;
+			low = mid + 1;
+		}
+		else
+			high = mid;
+	}
+	// nor do keys between the last key of a segment and the next segment
+	if (segment == learnedSegments.end() || segment->lastKey < keyValue)
+		return 0;
+
+	// positions the first entry with the key may have, none before the first entry of the segment
+	double predicted = segment->firstPosition + segment->slope * ((double)keyValue - segment->firstKey);
+	std::int64_t low = std::max<std::int64_t>((std::int64_t)std::floor(predicted) - LEARNED_MAX_ERROR, segment->firstPosition);
+	std::int64_t high = (std::int64_t)std::ceil(predicted) + LEARNED_MAX_ERROR + 1;
+	PageId pageNo = low / learnedSlots;
+
+	std::vector<RecordId> found;
+	while (true)
+	{
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		std::uint64_t version = latches[pageNo].readLock();
+		if (!isLeaf(page))
+		{
+			// a non-leaf node allocated between two leaves, the window goes on in the page after it
+			bool valid = latches[pageNo].validate(version);
+			bufMgr->unPinPage(file, pageNo, false);
+			pageNo++;
+			if (!valid || (std::int64_t)pageNo * learnedSlots >= high)
+				return lookupTyped<L>(key, outRids);
+			continue;
+		}
+		std::int64_t base = (std::int64_t)pageNo * learnedSlots;
+		int count = L::leafCount(page);
+		int first = std::min<std::int64_t>(std::max<std::int64_t>(low - base, 0), count);
+		int last = std::min<std::int64_t>(high - base, count);
+		while (first < last)
+		{
+			int mid = (first + last) / 2;
+			if (L::compareLeafKey(page, mid, keyValue) < 0)
+				first = mid + 1;
+			else
+				last = mid;
+		}
+		// the window may go on in the next leaf
+		PageId nextNo = L::getRightSib(page);
+		std::int64_t nextBase = (std::int64_t)nextNo * learnedSlots;
+		if (first == count && nextNo != 0 && nextBase < high && nextBase + learnedSlots > low)
+		{
+			bool valid = latches[pageNo].validate(version);
+			bufMgr->unPinPage(file, pageNo, false);
+			if (!valid)
+				return lookupTyped<L>(key, outRids);
+			pageNo = nextNo;
+			continue;
+		}
+		if (!collectDuplicates<L>(keyValue, keyValue, pageNo, page, version, first, found))
+			return lookupTyped<L>(key, outRids);
+		break;
+	}
+	outRids.insert(outRids.end(), found.begin(), found.end());
+	return found.size();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::getLearnedModelSize
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeIndex::getLearnedModelSize() const
+{
+	return learnedSegments.size() * sizeof(LearnedSegment);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::countRange
+// -----------------------------------------------------------------------------
+
+std::uint64_t BTreeIndex::countRange(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp)
+{
+	if (lowOp != GT && lowOp != GTE)
+		throw BadOpcodesException();
+	if (highOp != LT && highOp != LTE)
+		throw BadOpcodesException();
+	CompositeKey low;
+	CompositeKey high;
+	coveringBounds(lowVal, lowOp, highVal, highOp, low, high);
+	return (this->*countRangeImpl)(lowVal, lowOp, highVal, highOp);
+}
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::leafSplitInsert
+// BTreeIndex::countRangeTyped
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::leafSplitInsert(const void *key, const PageId pid, const RecordId rid)
+template <class L>
+std::uint64_t BTreeIndex::countRangeTyped(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp)
 {
-	// the key value
-	int keyValue = *((int *)key);
-	// page pointer
-	Page *page;
-	bufMgr->readPage(file, pid, page);
-	LeafNodeInt *node = (LeafNodeInt *)page;
-	// the middle index
-	int middle = INTARRAYLEAFSIZE / 2;
-	// new leaf
-	Page *newPage;
-	PageId newPageId;
-	bufMgr->allocPage(file, newPageId, newPage);
-	LeafNodeInt *newLeaf = (LeafNodeInt *)newPage;
-	newLeaf->isLeaf = 1;
-	int i;
-	for (i = middle; i < INTARRAYLEAFSIZE; i++)
-	{
-		newLeaf->keyArray[i - middle] = node->keyArray[i];
-		newLeaf->ridArray[i - middle] = node->ridArray[i];
-	}
-	node->key_count = middle;
-	newLeaf->key_count = INTARRAYLEAFSIZE - middle;
-	newLeaf->rightSibPageNo = node->rightSibPageNo;
-	node->rightSibPageNo = newPageId;
+	typename L::Key low = L::keyFromPointer(lowVal);
+	typename L::Key high = L::keyFromPointer(highVal);
+	if (high < low)
+		throw BadScanrangeException();
 
-	// new non-leaf node
-	Page *newNonleaf;
-	PageId newNonleafID;
-	bufMgr->allocPage(file, newNonleafID, newNonleaf);
-	NonLeafNodeInt *nonleaf = (NonLeafNodeInt *)newNonleaf;
-	// the node to combine with the new non-leaf node
-	PageId combineNode = node->parent;
-	nonleaf->isLeaf = 0;
-	nonleaf->level = 1;
-	nonleaf->key_count = 1;
-	nonleaf->keyArray[0] = newLeaf->keyArray[0];
-	nonleaf->pageNoArray[0] = pid;
-	nonleaf->pageNoArray[1] = newPageId;
-	node->parent = newNonleafID;
-	newLeaf->parent = newNonleafID;
-
-	// leaf to store keyValue
-	LeafNodeInt *addLeaf;
-	if (keyValue < nonleaf->keyArray[0])
-		addLeaf = node;
-	else
-		addLeaf = newLeaf;
+	std::uint64_t below = countBelow<L>(low, lowOp == GT);
+	std::uint64_t upTo = countBelow<L>(high, highOp == LTE);
+	// an exclusive high bound equal to an inclusive low one leaves nothing
+	return upTo > below ? upTo - below : 0;
+}
 
-	// insert done
-	bool insertDone = false;
-	for (i = 0; i < addLeaf->key_count; i++)
-	{
-		if (keyValue < addLeaf->keyArray[i])
-		{
-			memmove(&addLeaf->keyArray[i + 1], &addLeaf->keyArray[i], (addLeaf->key_count - i) * sizeof(int));
-			memmove(&addLeaf->ridArray[i + 1], &addLeaf->ridArray[i], (addLeaf->key_count - i) * sizeof(RecordId));
-			addLeaf->keyArray[i] = keyValue;
-			addLeaf->ridArray[i] = rid;
-			addLeaf->key_count++;
-			insertDone = true;
-			break;
-		}
-	}
-	if (insertDone == false)
+// -----------------------------------------------------------------------------
+// BTreeIndex::countBelow
+// -----------------------------------------------------------------------------
+
+template <class L>
+std::uint64_t BTreeIndex::countBelow(const typename L::Key &key, const bool inclusive)
+{
+	std::uint64_t count = 0;
+	PageId pageNo = rootPageNum;
+	Page *page;
+	bufMgr->readPage(file, pageNo, page);
+	while (!isLeaf(page))
 	{
-		addLeaf->keyArray[addLeaf->key_count] = keyValue;
-		addLeaf->ridArray[addLeaf->key_count] = rid;
-		addLeaf->key_count++;
+		// children left of the one the key leads to hold only keys below it
+		int child = inclusive ? L::childUpperBound(page, key) : L::childLowerBound(page, key);
+		for (int i = 0; i < child; i++)
+			count += L::childCount(page, i);
+		PageId childNo = L::childAt(page, child);
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = childNo;
+		bufMgr->readPage(file, pageNo, page);
 	}
+	count += inclusive ? L::leafUpperBound(page, key) : L::leafLowerBound(page, key);
+	bufMgr->unPinPage(file, pageNo, false);
+	return count;
+}
 
-	combineNonleaf(newNonleafID, combineNode);
+// -----------------------------------------------------------------------------
+// BTreeIndex::analyze
+// -----------------------------------------------------------------------------
 
-	bufMgr->unPinPage(file, pid, true);
-	bufMgr->unPinPage(file, newPageId, true);
-	bufMgr->unPinPage(file, newNonleafID, true);
+void BTreeIndex::analyze()
+{
+	(this->*analyzeImpl)();
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::combineNonleaf
+// BTreeIndex::analyzeTyped
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::combineNonleaf(const PageId pid1, const PageId pid2)
+template <class L>
+void BTreeIndex::analyzeTyped()
 {
-	// page1 pointer
-	Page *page1;
-	bufMgr->readPage(file, pid1, page1);
-	NonLeafNodeInt *node1 = (NonLeafNodeInt *)page1;
-	// page2 pointer
-	Page *page2;
-	bufMgr->readPage(file, pid2, page2);
-	NonLeafNodeInt *node2 = (NonLeafNodeInt *)page2;
-
-	if (node2->key_count < INTARRAYNONLEAFSIZE)
+	// every leaf and the entries under it, from the level above the leaves
+	std::vector<PageId> leaves;
+	std::vector<std::uint32_t> counts;
+	PageId pageNo = rootPageNum;
+	Page *page;
+	bufMgr->readPage(file, pageNo, page);
+	if (isLeaf(page))
 	{
-		// found place before the last available key
-		bool foundDone = false;
-		int i;
-		for (i = 0; i < node2->key_count; i++)
-		{
-			if (node2->keyArray[i] > node1->keyArray[0])
-			{
-				foundDone = true;
-				memmove(&node2->keyArray[i + 1], &node2->keyArray[i], (node2->key_count - i) * sizeof(int));
-				memmove(&node2->pageNoArray[i + 2], &node2->pageNoArray[i + 1], (node2->key_count - i) * sizeof(PageId));
-				node2->keyArray[i] = node1->keyArray[0];
-				node2->pageNoArray[i] = node1->pageNoArray[0];
-				node2->pageNoArray[i + 1] = node1->pageNoArray[1];
-				node2->key_count++;
-				break;
-			}
-		}
-		if (foundDone == false)
-		{
-			node2->keyArray[node2->key_count] = node1->keyArray[0];
-			node2->pageNoArray[node2->key_count] = node1->pageNoArray[0];
-			node2->pageNoArray[node2->key_count + 1] = node1->pageNoArray[1];
-			node2->key_count++;
-		}
-		if (node1->level == 1)
-		{
-			// child1 of node1
-			Page *child1;
-			bufMgr->readPage(file, node1->pageNoArray[0], child1);
-			LeafNodeInt *leftChild = (LeafNodeInt *)child1;
-			// child2 of node1
-			Page *child2;
-			bufMgr->readPage(file, node1->pageNoArray[1], child2);
-			LeafNodeInt *rightChild = (LeafNodeInt *)child2;
-			leftChild->parent = pid2;
-			rightChild->parent = pid2;
-			bufMgr->unPinPage(file, node1->pageNoArray[0], true);
-			bufMgr->unPinPage(file, node1->pageNoArray[1], true);
-		}
-		else
-		{
-			// child1 of node1
-			Page *child1;
-			bufMgr->readPage(file, node1->pageNoArray[0], child1);
-			NonLeafNodeInt *leftChild = (NonLeafNodeInt *)child1;
-			// child2 of node1
-			Page *child2;
-			bufMgr->readPage(file, node1->pageNoArray[1], child2);
-			NonLeafNodeInt *rightChild = (NonLeafNodeInt *)child2;
-			leftChild->parent = pid2;
-			rightChild->parent = pid2;
-			bufMgr->unPinPage(file, node1->pageNoArray[0], true);
-			bufMgr->unPinPage(file, node1->pageNoArray[1], true);
-		}
+		leaves.push_back(pageNo);
+		counts.push_back(L::leafCount(page));
+		bufMgr->unPinPage(file, pageNo, false);
 	}
-
 	else
 	{
-		// create a new node
-		Page *newPage1;
-		PageId newNodeID;
-		bufMgr->allocPage(file, newNodeID, newPage1);
-		NonLeafNodeInt *newNode = (NonLeafNodeInt *)newPage1;
-		// create a new parent
-		Page *newPage2;
-		PageId newParentID;
-		bufMgr->allocPage(file, newParentID, newPage2);
-		NonLeafNodeInt *newParent = (NonLeafNodeInt *)newPage2;
-
-		newNode->isLeaf = 0;
-		newNode->level = node2->level;
-		newParent->isLeaf = 0;
-		newParent->level = 0;
-		// split index
-		int splitIndex = INTARRAYNONLEAFSIZE / 2;
-		memmove(&newNode->keyArray[0], &node2->keyArray[splitIndex + 1], (node2->key_count - splitIndex - 1) * sizeof(int));
-		memmove(&newNode->pageNoArray[0], &node2->pageNoArray[splitIndex + 1], (node2->key_count - splitIndex) * sizeof(PageId));
-		newParent->keyArray[0] = node2->keyArray[splitIndex];
-		newParent->pageNoArray[0] = pid2;
-		newParent->pageNoArray[1] = newNodeID;
-		newParent->key_count = 1;
-		node2->key_count = splitIndex;
-		newNode->key_count = INTARRAYNONLEAFSIZE - splitIndex - 1;
-
-		int keyValue = node1->keyArray[0];
-		// the node to include node1
-		NonLeafNodeInt *addNode;
-		if (keyValue < newNode->keyArray[0])
-			addNode = node2;
-		else
-			addNode = newNode;
-
-		int i;
-		// insert done
-		bool insertDone = false;
-		for (i = 0; i < addNode->key_count; i++)
-		{
-			if (keyValue < addNode->keyArray[i])
-			{
-				memmove(&addNode->keyArray[i + 1], &addNode->keyArray[i], (addNode->key_count - i) * sizeof(int));
-				memmove(&addNode->pageNoArray[i + 2], &addNode->pageNoArray[i + 1], (addNode->key_count - i) * sizeof(PageId));
-				addNode->keyArray[i] = keyValue;
-				addNode->pageNoArray[i] = node1->pageNoArray[0];
-				addNode->pageNoArray[i + 1] = node1->pageNoArray[1];
-				addNode->key_count++;
-				insertDone = true;
-				break;
-			}
-		}
-		if (insertDone == false)
-		{
-			addNode->keyArray[addNode->key_count] = keyValue;
-			addNode->pageNoArray[addNode->key_count] = node1->pageNoArray[0];
-			addNode->pageNoArray[addNode->key_count + 1] = node1->pageNoArray[1];
-			addNode->key_count++;
-		}
-
-		// recognizing parents (big drama show)
-		for (i = 0; i < (node2->key_count + 1); i++)
+		while (L::nonLeafLevel(page) != 1)
 		{
-			// child page
-			Page *childPage;
-			bufMgr->readPage(file, node2->pageNoArray[i], childPage);
-			if (node2->level == 1)
-			{
-				LeafNodeInt *child = (LeafNodeInt *)childPage;
-				child->parent = pid2;
-			}
-			else
-			{
-				NonLeafNodeInt *child = (NonLeafNodeInt *)childPage;
-				child->parent = pid2;
-			}
-			bufMgr->unPinPage(file, node2->pageNoArray[i], true);
+			PageId childNo = L::childAt(page, 0);
+			bufMgr->unPinPage(file, pageNo, false);
+			pageNo = childNo;
+			bufMgr->readPage(file, pageNo, page);
 		}
-		for (i = 0; i < (newNode->key_count + 1); i++)
+		while (true)
 		{
-			// child page
-			Page *childPage;
-			bufMgr->readPage(file, newNode->pageNoArray[i], childPage);
-			if (newNode->level == 1)
-			{
-				LeafNodeInt *child = (LeafNodeInt *)childPage;
-				child->parent = newNodeID;
-			}
-			else
+			for (int i = 0; i <= L::nonLeafCount(page); i++)
 			{
-				NonLeafNodeInt *child = (NonLeafNodeInt *)childPage;
-				child->parent = newNodeID;
+				leaves.push_back(L::childAt(page, i));
+				counts.push_back(L::childCount(page, i));
 			}
-			bufMgr->unPinPage(file, newNode->pageNoArray[i], true);
-		}
-		// who's the parent of node2? let's see the test result:
-		PageId n2Parent = node2->parent;
-		// new parent!
-		node2->parent = newParentID;
-		newNode->parent = newParentID;
-		if (n2Parent == 0)
-		{
-			newParent->parent = 0;
-			Page *metaPage;
-			bufMgr->readPage(file, headerPageNum, metaPage);
-			IndexMetaInfo *metaInfo = (IndexMetaInfo *)metaPage;
-			rootPageNum = newParentID;
-			metaInfo->rootPageNo = newParentID;
-			bufMgr->unPinPage(file, headerPageNum, true);
+			PageId nextNo = L::nonLeafRightSib(page);
+			bufMgr->unPinPage(file, pageNo, false);
+			if (nextNo == 0)
+				break;
+			pageNo = nextNo;
+			bufMgr->readPage(file, pageNo, page);
 		}
-		else
-			combineNonleaf(newParentID, n2Parent);
+	}
 
-		bufMgr->unPinPage(file, newNodeID, true);
-		bufMgr->unPinPage(file, newParentID, true);
+	std::uint64_t total = 0;
+	for (std::size_t i = 0; i < counts.size(); i++)
+		total += counts[i];
+	HistogramBuilder<L> histogram(total);
+	// leaves spread evenly, each standing for the leaves up to the next one read
+	std::size_t samples = std::min<std::size_t>(leaves.size(), ANALYZE_SAMPLE_LEAVES);
+	for (std::size_t s = 0; s < samples; s++)
+	{
+		std::size_t first = s * leaves.size() / samples;
+		std::size_t end = (s + 1) * leaves.size() / samples;
+		std::uint64_t entries = 0;
+		for (std::size_t i = first; i < end; i++)
+			entries += counts[i];
+		bufMgr->readPage(file, leaves[first], page);
+		int count = L::leafCount(page);
+		double weight = (double)entries / std::max(count, 1);
+		for (int i = 0; i < count; i++)
+			histogram.add(L::leafKey(page, i), weight, weight);
+		bufMgr->unPinPage(file, leaves[first], false);
 	}
-	bufMgr->unPinPage(file, pid1, true);
-	bufMgr->unPinPage(file, pid2, true);
+	setStatistics(histogram.finish());
 }
 
 // -----------------------------------------------------------------------------
+// BTreeIndex::setStatistics
 // -----------------------------------------------------------------------------
+
+void BTreeIndex::setStatistics(const IndexStatistics &computed)
+{
+	std::lock_guard<std::mutex> lock(statisticsLatch);
+	statistics = computed;
+	Page *metaPage;
+	bufMgr->readPage(file, headerPageNum, metaPage);
+	((IndexMetaInfo *)metaPage)->statistics = computed;
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
+
 // -----------------------------------------------------------------------------
+// BTreeIndex::estimateRange
 // -----------------------------------------------------------------------------
-// -------------------- SCAN ---------------------------------------------------
+
+double BTreeIndex::estimateRange(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp)
+{
+	if (lowOp != GT && lowOp != GTE)
+		throw BadOpcodesException();
+	if (highOp != LT && highOp != LTE)
+		throw BadOpcodesException();
+	CompositeKey low;
+	CompositeKey high;
+	coveringBounds(lowVal, lowOp, highVal, highOp, low, high);
+	return (this->*estimateRangeImpl)(lowVal, lowOp, highVal, highOp);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::estimateRangeTyped
+// -----------------------------------------------------------------------------
+
+template <class L>
+double BTreeIndex::estimateRangeTyped(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp)
+{
+	typename L::Key low = L::keyFromPointer(lowVal);
+	typename L::Key high = L::keyFromPointer(highVal);
+	if (high < low)
+		throw BadScanrangeException();
+
+	std::lock_guard<std::mutex> lock(statisticsLatch);
+	// without statistics any entry may be in range
+	if (statistics.bucketCount == 0 || statistics.entryCount == 0)
+		return entryCount;
+	double estimate = entriesBelow<L>(high, highOp == LTE) - entriesBelow<L>(low, lowOp == GT);
+	return std::max(0.0, estimate) * entryCount / statistics.entryCount;
+}
+
 // -----------------------------------------------------------------------------
+// BTreeIndex::entriesBelow
 // -----------------------------------------------------------------------------
+
+template <class L>
+double BTreeIndex::entriesBelow(const typename L::Key &key, const bool inclusive)
+{
+	typename L::Key lower = loadStatisticsKey<L>(statistics.lowestKey);
+	if (key < lower)
+		return 0;
+	double below = 0;
+	for (int i = 0; i < statistics.bucketCount; i++)
+	{
+		typename L::Key upper = loadStatisticsKey<L>(statistics.bucketKeys[i]);
+		if (upper < key)
+		{
+			below = statistics.bucketEnds[i];
+			lower = upper;
+			continue;
+		}
+		if (!(key < upper))
+			return inclusive ? statistics.bucketEnds[i] : statistics.bucketEnds[i] - statistics.bucketRepeats[i];
+		// the other keys of the bucket spread its other entries evenly between its bounds
+		double others = statistics.bucketEnds[i] - statistics.bucketRepeats[i] - below;
+		double perKey = others / std::max<std::uint32_t>(statistics.bucketDistinct[i] - 1, 1);
+		return below + (others - perKey) * keyFraction(lower, upper, key) + (inclusive ? perKey : 0);
+	}
+	return below;
+}
+
 // -----------------------------------------------------------------------------
+// BTreeIndex::getDistinctKeyEstimate
 // -----------------------------------------------------------------------------
 
+std::uint64_t BTreeIndex::getDistinctKeyEstimate()
+{
+	std::lock_guard<std::mutex> lock(statisticsLatch);
+	return statistics.distinctCount;
+}
+
 // -----------------------------------------------------------------------------
-// BTreeIndex::startScan
+// BTreeIndex::openScan
 // -----------------------------------------------------------------------------
 
-const void BTreeIndex::startScan(const void *lowValParm,
+IndexCursor BTreeIndex::openScan(const void *lowValParm,
 								 const Operator lowOpParm,
 								 const void *highValParm,
-								 const Operator highOpParm)
+								 const Operator highOpParm,
+								 const ScanDirection direction)
 {
 	if (lowOpParm != GT && lowOpParm != GTE)
 		throw BadOpcodesException();
 	if (highOpParm != LT && highOpParm != LTE)
 		throw BadOpcodesException();
 
-	lowValInt = *((int *)lowValParm);
-	highValInt = *((int *)highValParm);
-	if (lowValInt > highValInt)
+	CompositeKey low;
+	CompositeKey high;
+	coveringBounds(lowValParm, lowOpParm, highValParm, highOpParm, low, high);
+
+	IndexCursor cursor;
+	cursor.lowOp = lowOpParm;
+	cursor.highOp = highOpParm;
+	cursor.direction = direction;
+	(this->*startScanImpl)(cursor, lowValParm, highValParm);
+	return cursor;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::coveringBounds
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::coveringBounds(const void *&lowVal, const Operator lowOp, const void *&highVal, const Operator highOp,
+								CompositeKey &low, CompositeKey &high)
+{
+	if (searchColumnCount == (int)keyColumns.size())
+		return;
+	// bounds on a covering index name the attributes searched on, the included ones are filled
+	// in low or high as the operators need
+	low = *(const CompositeKey *)lowVal;
+	low.truncate(searchKeySize);
+	if (lowOp == GT)
+		low.fillHigh();
+	high = *(const CompositeKey *)highVal;
+	high.truncate(searchKeySize);
+	if (highOp == LTE)
+		high.fillHigh();
+	lowVal = &low;
+	highVal = &high;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScan
+// -----------------------------------------------------------------------------
+
+const void BTreeIndex::startScan(const void *lowValParm,
+								 const Operator lowOpParm,
+								 const void *highValParm,
+								 const Operator highOpParm,
+								 const ScanDirection direction)
+{
+	if (scan.isOpen())
+		scan.endScan();
+	scan = openScan(lowValParm, lowOpParm, highValParm, highOpParm, direction);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScanTyped
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::startScanTyped(IndexCursor &cursor, const void *lowValParm, const void *highValParm)
+{
+	typename L::Key &low = cursor.lowVal<typename L::Key>();
+	typename L::Key &high = cursor.highVal<typename L::Key>();
+	low = L::keyFromPointer(lowValParm);
+	high = L::keyFromPointer(highValParm);
+	if (low > high)
 		throw BadScanrangeException();
 
-	lowOp = lowOpParm;
-	highOp = highOpParm;
+	cursor.index = this;
+	cursor.lastRids.clear();
+	positionScan<L>(cursor);
 
-	scanExecuting = true;
-	Page *metaPage;
-	bufMgr->readPage(file, headerPageNum, metaPage);
-	IndexMetaInfo *metaInfo = (IndexMetaInfo *)metaPage;
-	currentPageNum = metaInfo->rootPageNo;
-	bufMgr->unPinPage(file, headerPageNum, false);
-	setPageIdForScan();
-	setEntryIndexForScan();
-
-	LeafNodeInt *node = (LeafNodeInt *)currentPageData;
-	RecordId outRid = node->ridArray[nextEntry];
-	if ((outRid.page_number == 0 && outRid.slot_number == 0) ||
-		node->keyArray[nextEntry] > highValInt ||
-		(node->keyArray[nextEntry] == highValInt && highOp == LT))
+	bool empty;
+	while (true)
 	{
-		endScan();
+		Page *page = cursor.currentPageData;
+		int nextEntry = cursor.nextEntry;
+		if (cursor.direction == DESCENDING)
+			empty = nextEntry < 0 ||
+					L::compareLeafKey(page, nextEntry, low) < 0 ||
+					(L::compareLeafKey(page, nextEntry, low) == 0 && cursor.lowOp == GT);
+		else
+			empty = nextEntry >= L::leafCount(page) ||
+					(L::leafRid(page, nextEntry).page_number == 0 && L::leafRid(page, nextEntry).slot_number == 0) ||
+					L::compareLeafKey(page, nextEntry, high) > 0 ||
+					(L::compareLeafKey(page, nextEntry, high) == 0 && cursor.highOp == LT);
+		if (latches[cursor.currentPageNum].validate(cursor.version))
+			break;
+		resumeScan<L>(cursor);
+	}
+	if (empty)
+	{
+		cursor.endScan();
 		throw NoSuchKeyFoundException();
 	}
 }
 
+// -----------------------------------------------------------------------------
+// BTreeIndex::positionScan
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::positionScan(IndexCursor &cursor)
+{
+	cursor.resumed = !cursor.lastRids.empty();
+	while (true)
+	{
+		setPageIdForScan<L>(cursor);
+		if (setEntryIndexForScan<L>(cursor))
+			return;
+		bufMgr->unPinPage(file, cursor.currentPageNum, false);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::resumeScan
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::resumeScan(IndexCursor &cursor)
+{
+	bufMgr->unPinPage(file, cursor.currentPageNum, false);
+	positionScan<L>(cursor);
+}
+
 // -----------------------------------------------------------------------------
 // BTreeIndex::isLeaf
 // -----------------------------------------------------------------------------
 
 /**
- * check if this node is a leaf node
+ * check if this node is a leaf node. Packed leaves keep isLeaf in a byte, so only the first
+ * byte of the int of the other nodes is looked at.
  */
 bool BTreeIndex::isLeaf(Page *page)
 {
-	return *((int *)page) == 1;
+	return *((std::uint8_t *)page) == 1;
 }
 
 // -----------------------------------------------------------------------------
@@ -590,18 +2537,22 @@ bool BTreeIndex::isLeaf(Page *page)
 // -----------------------------------------------------------------------------
 
 /**
- * Recursively find the page id of the first element larger than or equal to the
- * lower bound given.
+ * Descend from the root to the leaf holding the first element larger than or equal to the lower
+ * bound given, or the last element up to the upper bound for a descending scan. A scan that
+ * returned entries already descends to the first or the last entry with the last key it returned.
  */
-void BTreeIndex::setPageIdForScan()
+template <class L>
+void BTreeIndex::setPageIdForScan(IndexCursor &cursor)
 {
-	bufMgr->readPage(file, currentPageNum, currentPageData);
-	if (isLeaf(currentPageData))
-		return;
-	NonLeafNodeInt *node = (NonLeafNodeInt *)currentPageData;
-	bufMgr->unPinPage(file, currentPageNum, false);
-	currentPageNum = node->pageNoArray[findIndexNonLeaf(node, lowValInt)];
-	setPageIdForScan();
+	bool resumed = cursor.resumed;
+	// duplicates of the low value may sit left of an equal separator, the last entry up to the
+	// high value is in the rightmost leaf that may hold it
+	if (cursor.direction == DESCENDING)
+		cursor.version = descendToLeaf<L>(resumed ? cursor.lastVal<typename L::Key>() : cursor.highVal<typename L::Key>(),
+										  resumed || cursor.highOp == LTE, cursor.currentPageNum, cursor.currentPageData);
+	else
+		cursor.version = descendToLeaf<L>(resumed ? cursor.lastVal<typename L::Key>() : cursor.lowVal<typename L::Key>(),
+										  !resumed && cursor.lowOp == GT, cursor.currentPageNum, cursor.currentPageData);
 }
 
 // -----------------------------------------------------------------------------
@@ -609,104 +2560,190 @@ void BTreeIndex::setPageIdForScan()
 // -----------------------------------------------------------------------------
 
 /**
- * scan for the next entry. 
+ * scan for the next entry.
  * if reaches the last element in this page, set the current scanning page to the next page.
  */
-void BTreeIndex::setNextEntry()
+template <class L>
+void BTreeIndex::setNextEntry(IndexCursor &cursor)
 {
-	nextEntry++;
-	LeafNodeInt *node = (LeafNodeInt *)currentPageData;
-	if (nextEntry >= node->key_count ||
-		node->ridArray[nextEntry].page_number == 0)
+	cursor.nextEntry++;
+	if (cursor.nextEntry >= L::leafCount(cursor.currentPageData) ||
+		L::leafRid(cursor.currentPageData, cursor.nextEntry).page_number == 0)
 	{
-		moveToNextPage(node);
+		if (!moveToNextPage<L>(cursor))
+			resumeScan<L>(cursor);
 	}
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::findIndexNonLeaf
+// BTreeIndex::setEntryIndexForScan
 // -----------------------------------------------------------------------------
 
 /**
- *	Find the index of the first key smaller than the given key
+ * Find the first element in the currently scanning page, or the first entry with the last key
+ * returned once the scan returned any.
  */
-int BTreeIndex::findIndexNonLeaf(NonLeafNodeInt *node, int key)
+template <class L>
+bool BTreeIndex::setEntryIndexForScan(IndexCursor &cursor)
 {
-	int i;
-	// the value to be returned
-	int retVal;
-	// whether there is a key greater than the given key
-	bool found = false;
-	for (i = 0; i < node->key_count; i++)
+	bool resumed = cursor.resumed;
+	if (cursor.direction == DESCENDING)
 	{
-		if (node->keyArray[i] > key)
+		const typename L::Key &key = resumed ? cursor.lastVal<typename L::Key>() : cursor.highVal<typename L::Key>();
+		// last entry up to the key, which may be in the left sibling
+		if (resumed || cursor.highOp == LTE)
+			cursor.nextEntry = L::leafUpperBound(cursor.currentPageData, key) - 1;
+		else
+			cursor.nextEntry = L::leafLowerBound(cursor.currentPageData, key) - 1;
+		while (true)
 		{
-			retVal = i;
-			found = true;
-			break;
+			if (cursor.nextEntry >= 0 || L::getLeftSib(cursor.currentPageData) == 0)
+				break;
+			if (!moveToPrevPage<L>(cursor))
+				return false;
 		}
 	}
-	if (found == false)
+	else
 	{
-		retVal = node->key_count;
+		const typename L::Key &key = resumed ? cursor.lastVal<typename L::Key>() : cursor.lowVal<typename L::Key>();
+		if (resumed || cursor.lowOp == GTE)
+			cursor.nextEntry = L::leafLowerBound(cursor.currentPageData, key);
+		else
+			cursor.nextEntry = L::leafUpperBound(cursor.currentPageData, key);
+		while (true)
+		{
+			if (cursor.nextEntry < L::leafCount(cursor.currentPageData) || L::getRightSib(cursor.currentPageData) == 0)
+				break;
+			if (!moveToNextPage<L>(cursor))
+				return false;
+		}
 	}
-	return retVal;
+	return latches[cursor.currentPageNum].validate(cursor.version);
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::setEntryIndexForScan
+// BTreeIndex::skipReturned
 // -----------------------------------------------------------------------------
 
-/**
- * Find the first element in the currently scanning page
- */
-void BTreeIndex::setEntryIndexForScan()
+template <class L>
+bool BTreeIndex::skipReturned(IndexCursor &cursor)
 {
-	LeafNodeInt *node = (LeafNodeInt *)currentPageData;
-	int entryIndex;
-	int i;
-	// found?
-	bool found = false;
-	for (i = 0; i < node->key_count; i++)
+	const typename L::Key &last = cursor.lastVal<typename L::Key>();
+	while (true)
 	{
-		if ((lowOp == GTE) && (node->keyArray[i] >= lowValInt))
-		{
-			entryIndex = i;
-			found = true;
-			break;
-		}
-		if ((lowOp != GTE) && (node->keyArray[i] > lowValInt))
+		Page *page = cursor.currentPageData;
+		int i = cursor.nextEntry;
+		if (cursor.direction == DESCENDING ? i < 0 : i >= L::leafCount(page))
 		{
-			entryIndex = i;
-			found = true;
-			break;
+			// no entries left in the last leaf in this direction
+			PageId sibling = cursor.direction == DESCENDING ? L::getLeftSib(page) : L::getRightSib(page);
+			if (sibling == 0)
+			{
+				cursor.resumed = false;
+				return latches[cursor.currentPageNum].validate(cursor.version);
+			}
+			if (!(cursor.direction == DESCENDING ? moveToPrevPage<L>(cursor) : moveToNextPage<L>(cursor)))
+				return false;
+			continue;
 		}
+		// an entry with another key ends the entries that may have been returned
+		bool returned = false;
+		if (L::compareLeafKey(page, i, last) == 0)
+			returned = std::find(cursor.lastRids.begin(), cursor.lastRids.end(), L::leafRid(page, i)) != cursor.lastRids.end();
+		else
+			cursor.resumed = false;
+		if (!latches[cursor.currentPageNum].validate(cursor.version))
+			return false;
+		if (!returned)
+			return true;
+		cursor.nextEntry += cursor.direction == DESCENDING ? -1 : 1;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::moveToNextPage
+// -----------------------------------------------------------------------------
+
+template <class L>
+bool BTreeIndex::moveToNextPage(IndexCursor &cursor)
+{
+	Page *page = cursor.currentPageData;
+	PageId nextNo = L::getRightSib(page);
+	int count = L::leafCount(page);
+	// a page number read from a leaf that changed meanwhile may be anything
+	if (!latches[cursor.currentPageNum].validate(cursor.version))
+		return false;
+	// rightmost leaf, stay on it with no entries left
+	if (nextNo == 0)
+	{
+		cursor.nextEntry = count;
+		return true;
 	}
-	if (found == false)
+	Page *next;
+	bufMgr->readPage(file, nextNo, next);
+	std::uint64_t nextVersion = latches[nextNo].readLock();
+	// and the leaf must still have led there when the version of the sibling was read
+	if (!latches[cursor.currentPageNum].validate(cursor.version))
 	{
-		entryIndex = -1;
+		bufMgr->unPinPage(file, nextNo, false);
+		return false;
 	}
+	bufMgr->unPinPage(file, cursor.currentPageNum, false);
+	cursor.currentPageNum = nextNo;
+	cursor.currentPageData = next;
+	cursor.version = nextVersion;
+	cursor.nextEntry = 0;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::moveToPrevPage
+// -----------------------------------------------------------------------------
 
-	if (entryIndex == -1)
+template <class L>
+bool BTreeIndex::moveToPrevPage(IndexCursor &cursor)
+{
+	PageId prevNo = L::getLeftSib(cursor.currentPageData);
+	if (!latches[cursor.currentPageNum].validate(cursor.version))
+		return false;
+	// leftmost leaf, stay on it with no entries left
+	if (prevNo == 0)
 	{
-		moveToNextPage(node);
+		cursor.nextEntry = -1;
+		return true;
 	}
-	else
+	Page *prev;
+	bufMgr->readPage(file, prevNo, prev);
+	std::uint64_t prevVersion = latches[prevNo].readLock();
+	// splits of the left sibling relink the leaf, so it still points at the sibling if unchanged
+	if (!latches[cursor.currentPageNum].validate(cursor.version))
 	{
-		nextEntry = entryIndex;
+		bufMgr->unPinPage(file, prevNo, false);
+		return false;
 	}
+	bufMgr->unPinPage(file, cursor.currentPageNum, false);
+	cursor.currentPageNum = prevNo;
+	cursor.currentPageData = prev;
+	cursor.version = prevVersion;
+	cursor.nextEntry = L::leafCount(prev) - 1;
+	return true;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::moveToNextPage
+// BTreeIndex::noteReturned
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::moveToNextPage(LeafNodeInt *node)
+template <class L>
+void BTreeIndex::noteReturned(IndexCursor &cursor, const typename L::Key &key, const RecordId *rids, const int run, const int count)
 {
-	bufMgr->unPinPage(file, currentPageNum, false);
-	currentPageNum = node->rightSibPageNo;
-	bufMgr->readPage(file, currentPageNum, currentPageData);
-	nextEntry = 0;
+	typename L::Key &last = cursor.lastVal<typename L::Key>();
+	// a whole batch with the key the scan returned last goes on that run
+	if (cursor.lastRids.empty() || run < count || key < last || last < key)
+	{
+		last = key;
+		cursor.lastRids.clear();
+	}
+	cursor.lastRids.insert(cursor.lastRids.end(), rids + count - run, rids + count);
 }
 
 // -----------------------------------------------------------------------------
@@ -715,23 +2752,173 @@ void BTreeIndex::moveToNextPage(LeafNodeInt *node)
 
 const void BTreeIndex::scanNext(RecordId &outRid)
 {
-	if (!scanExecuting)
-		throw ScanNotInitializedException();
+	scan.scanNext(outRid);
+}
 
-	LeafNodeInt *node = (LeafNodeInt *)currentPageData;
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextTyped
+// -----------------------------------------------------------------------------
+
+template <class L>
+void BTreeIndex::scanNextTyped(IndexCursor &cursor, RecordId &outRid)
+{
+	while (true)
+	{
+		// a leaf that changed since the scan reached it may not even be a leaf any more
+		if (!latches[cursor.currentPageNum].validate(cursor.version) ||
+			(cursor.resumed && !skipReturned<L>(cursor)))
+		{
+			resumeScan<L>(cursor);
+			continue;
+		}
+		Page *page = cursor.currentPageData;
+		int nextEntry = cursor.nextEntry;
+		bool ended;
+		RecordId rid;
+		if (cursor.direction == DESCENDING)
+		{
+			// no entries left in the leftmost leaf, or below the low value
+			ended = nextEntry < 0;
+			if (!ended)
+			{
+				int c = L::compareLeafKey(page, nextEntry, cursor.lowVal<typename L::Key>());
+				ended = c < 0 || (c == 0 && cursor.lowOp == GT);
+			}
+		}
+		else
+		{
+			// no entries left in the rightmost leaf, or the record ID is empty or the value reaches
+			// the higher end
+			ended = nextEntry >= L::leafCount(page);
+			if (!ended)
+			{
+				RecordId entryRid = L::leafRid(page, nextEntry);
+				int c = L::compareLeafKey(page, nextEntry, cursor.highVal<typename L::Key>());
+				ended = (entryRid.page_number == 0 && entryRid.slot_number == 0) || c > 0 || (c == 0 && cursor.highOp == LT);
+			}
+		}
+		typename L::Key key;
+		if (!ended)
+		{
+			rid = L::leafRid(page, nextEntry);
+			key = L::leafKey(page, nextEntry);
+		}
+		// nothing read from the leaf counts unless it is unchanged
+		if (!latches[cursor.currentPageNum].validate(cursor.version))
+		{
+			resumeScan<L>(cursor);
+			continue;
+		}
+		if (ended)
+			throw IndexScanCompletedException();
+
+		outRid = rid;
+		noteReturned<L>(cursor, key, &outRid, 1, 1);
+		if (cursor.direction == DESCENDING)
+		{
+			if (--cursor.nextEntry < 0 && !moveToPrevPage<L>(cursor))
+				resumeScan<L>(cursor);
+		}
+		else
+			setNextEntry<L>(cursor);
+		return;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextBatch
+// -----------------------------------------------------------------------------
+
+int BTreeIndex::scanNextBatch(RecordId *outRids, void *outKeys, const int maxEntries)
+{
+	return scan.scanNextBatch(outRids, outKeys, maxEntries);
+}
 
-	outRid = node->ridArray[nextEntry];
-	int val = node->keyArray[nextEntry];
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextBatchTyped
+// -----------------------------------------------------------------------------
 
-	// if current record ID is empty or value is out of range or value reaches the higher end
-	if ((outRid.page_number == 0 &&
-		 outRid.slot_number == 0) ||
-		val > highValInt ||
-		(val == highValInt && highOp == LT))
+template <class L>
+int BTreeIndex::scanNextBatchTyped(IndexCursor &cursor, RecordId *outRids, void *outKeys, const int maxEntries)
+{
+	while (true)
 	{
-		throw IndexScanCompletedException();
+		// a leaf that changed since the scan reached it may not even be a leaf any more
+		if (!latches[cursor.currentPageNum].validate(cursor.version) ||
+			(cursor.resumed && !skipReturned<L>(cursor)))
+		{
+			resumeScan<L>(cursor);
+			continue;
+		}
+		Page *page = cursor.currentPageData;
+		int count;
+		// last key copied, and the entries with it that end the batch
+		typename L::Key key;
+		int run = 0;
+		// after descending again, entries with the last key returned may be followed by ones
+		// returned already, so each goes out on its own
+		int most = cursor.resumed ? 1 : maxEntries;
+		if (cursor.direction == DESCENDING)
+		{
+			// entries in range end at the last key before the low value
+			const typename L::Key &low = cursor.lowVal<typename L::Key>();
+			int first = cursor.lowOp == GT ? L::leafUpperBound(page, low) : L::leafLowerBound(page, low);
+			count = std::min(cursor.nextEntry + 1 - first, most);
+			if (count > 0)
+			{
+				L::leafCopy(page, cursor.nextEntry, count, outRids, outKeys, true);
+				int last = cursor.nextEntry - count + 1;
+				key = L::leafKey(page, last);
+				run = std::min(cursor.nextEntry + 1, L::leafUpperBound(page, key)) - last;
+			}
+		}
+		else
+		{
+			// entries in range end at the first key past the high value
+			const typename L::Key &high = cursor.highVal<typename L::Key>();
+			int end = cursor.highOp == LT ? L::leafLowerBound(page, high) : L::leafUpperBound(page, high);
+			count = std::min(end - cursor.nextEntry, most);
+			if (count > 0)
+			{
+				L::leafCopy(page, cursor.nextEntry, count, outRids, outKeys, false);
+				int last = cursor.nextEntry + count - 1;
+				key = L::leafKey(page, last);
+				run = last + 1 - std::max(cursor.nextEntry, L::leafLowerBound(page, key));
+			}
+		}
+		// what was copied only counts if the leaf did not change meanwhile
+		if (!latches[cursor.currentPageNum].validate(cursor.version))
+		{
+			resumeScan<L>(cursor);
+			continue;
+		}
+		if (count <= 0)
+			return 0;
+
+		noteReturned<L>(cursor, key, outRids, run, count);
+		if (cursor.direction == DESCENDING)
+		{
+			cursor.nextEntry -= count;
+			if (cursor.nextEntry < 0 && !moveToPrevPage<L>(cursor))
+				resumeScan<L>(cursor);
+		}
+		else
+		{
+			cursor.nextEntry += count;
+			if (cursor.nextEntry >= L::leafCount(page) && !moveToNextPage<L>(cursor))
+				resumeScan<L>(cursor);
+		}
+		return count;
 	}
-	setNextEntry();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextRecord
+// -----------------------------------------------------------------------------
+
+const void BTreeIndex::scanNextRecord(RecordId &outRid, void *outRecord)
+{
+	scan.scanNextRecord(outRid, outRecord);
 }
 
 // -----------------------------------------------------------------------------
@@ -740,10 +2927,7 @@ const void BTreeIndex::scanNext(RecordId &outRid)
 
 const void BTreeIndex::endScan()
 {
-	if (!scanExecuting)
-		throw ScanNotInitializedException();
-	scanExecuting = false;
-	bufMgr->unPinPage(file, currentPageNum, false);
+	scan.endScan();
 }
 
 } // namespace badgerdb
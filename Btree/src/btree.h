@@ -11,11 +11,16 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <mutex>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "node_latch.h"
 
 namespace badgerdb
 {
@@ -27,7 +32,18 @@ enum Datatype
 {
 	INTEGER = 0,
 	DOUBLE = 1,
-	STRING = 2
+	STRING = 2,
+	COMPOSITE = 3	/* several attributes, see KeyColumn */
+};
+
+/**
+ * @brief Format of the leaves of an index. Passed to the BTreeIndex constructor and kept in the meta page.
+ */
+enum LeafFormat
+{
+	PLAIN_LEAVES = 0,	/* A key and a RecordId per entry */
+	POSTING_LEAVES = 1,	/* Each key once per leaf followed by the sorted record ids of its entries, INTEGER and DOUBLE only */
+	PACKED_LEAVES = 2	/* Keys and record ids bit-packed as deltas from per-leaf bases, INTEGER only */
 };
 
 /**
@@ -41,18 +57,328 @@ enum Operator
 	GT		/* Greater Than */
 };
 
+/**
+ * @brief Order in which a scan returns the entries of its range. Passed to BTreeIndex::startScan() method.
+ */
+enum ScanDirection
+{
+	ASCENDING,	/* Increasing key order, following right siblings */
+	DESCENDING	/* Decreasing key order, following left siblings */
+};
+
+
+/**
+ * @brief Maximum size of a String key. Longer strings are indexed on their first STRINGSIZE characters.
+ */
+const  int STRINGSIZE = 64;
+
+/**
+ * @brief Most attributes the key of a composite index may be made of.
+ */
+const int MAX_KEY_COLUMNS = 8;
+
+/**
+ * @brief Most bytes the normalized key of a composite index may take: a STRING attribute and
+ * 16 bytes of INTEGER and DOUBLE attributes.
+ */
+const int MAX_COMPOSITE_KEY_SIZE = STRINGSIZE + 16;
+
+/**
+ * @brief Bytes taken by the fields every node starts with: isLeaf, the protection arrays and key_count.
+ */
+//                                  isLeaf, key_count       protection1/2
+const  int NODEHEADERSIZE = 2 * sizeof( int ) + 20 * sizeof( int );
+
+/**
+ * @brief Default fraction of each node's slots filled when an index is bulk loaded.
+ */
+const double DEFAULT_FILL_FACTOR = 1.0;
+
+/**
+ * @brief Default number of buffer frames the sort of a new index may use.
+ */
+const std::uint32_t DEFAULT_SORT_FRAMES = 32;
+
+/**
+ * @brief Inserts in a row past the last key of the rightmost leaf after which an index takes
+ * its inserts to be appends: they go to the rightmost leaf without a descent from the root,
+ * and it is split leaving the old leaf APPEND_SPLIT_FILL full rather than half full.
+ */
+const int APPEND_RUN = 8;
+
+/**
+ * @brief Fill of the old leaf after a split under appends.
+ */
+const double APPEND_SPLIT_FILL = 0.9;
+
+/**
+ * @brief Fraction of its space a node other than the root keeps in use. A delete leaving a
+ * node below it merges the node with a sibling, or moves entries over from the sibling if
+ * the two do not fit in one node.
+ */
+const double MIN_NODE_FILL = 0.5;
+
+/**
+ * @brief Most buckets of the equi-depth histogram of an index, see IndexStatistics.
+ */
+const int HISTOGRAM_BUCKETS = 64;
+
+/**
+ * @brief Most leaves BTreeIndex::analyze() reads, see IndexStatistics.
+ */
+const int ANALYZE_SAMPLE_LEAVES = 100;
+
+/**
+ * @brief Most positions the rank a learned lookup model predicts for a key of the index may be off by.
+ */
+const int LEARNED_MAX_ERROR = 32;
+
+/**
+ * @brief Value of the first int of a page on the free list of the index file, where nodes
+ * have their isLeaf flag.
+ */
+const int FREE_NODE = -1;
+
+template <class T> class ExternalSort;
+
+/**
+ * @brief Fixed-width character key. Strings are cut or padded with NULs to N bytes and
+ * compare byte by byte, so a key sorts like the first N characters of its string.
+ */
+template <int N>
+struct FixedKey{
+  /**
+   * Characters of the key, NUL padded.
+   */
+	char data[ N ];
+
+  /**
+   * Builds the key from the first N characters of a string.
+   */
+	static FixedKey fromChars( const char *chars )
+	{
+		FixedKey key;
+		strncpy( key.data, chars, N );
+		return key;
+	}
+};
+
+template <int N>
+bool operator<( const FixedKey<N>& k1, const FixedKey<N>& k2 ) { return memcmp( k1.data, k2.data, N ) < 0; }
+template <int N>
+bool operator>( const FixedKey<N>& k1, const FixedKey<N>& k2 ) { return memcmp( k1.data, k2.data, N ) > 0; }
+template <int N>
+bool operator<=( const FixedKey<N>& k1, const FixedKey<N>& k2 ) { return memcmp( k1.data, k2.data, N ) <= 0; }
+template <int N>
+bool operator>=( const FixedKey<N>& k1, const FixedKey<N>& k2 ) { return memcmp( k1.data, k2.data, N ) >= 0; }
+template <int N>
+bool operator==( const FixedKey<N>& k1, const FixedKey<N>& k2 ) { return memcmp( k1.data, k2.data, N ) == 0; }
+template <int N>
+bool operator!=( const FixedKey<N>& k1, const FixedKey<N>& k2 ) { return memcmp( k1.data, k2.data, N ) != 0; }
+
+template <int N>
+std::ostream& operator<<( std::ostream& out, const FixedKey<N>& key ) { return out.write( key.data, strnlen( key.data, N ) ); }
+
+/**
+ * @brief Fixed-width form of STRING keys, used where entries need a fixed size, such as the
+ * runs of the external sort. The nodes of the tree store strings with their actual length.
+ */
+typedef FixedKey<STRINGSIZE> StringKey;
+
+/**
+ * @brief Reads keys of type T from the untyped pointers passed to the index and from records.
+ */
+template <class T>
+struct KeyTraits{
+	static T fromPointer( const void *key ) { return *( (const T *)key ); }
+};
+
+template <int N>
+struct KeyTraits< FixedKey<N> >{
+	static FixedKey<N> fromPointer( const void *key ) { return FixedKey<N>::fromChars( (const char *)key ); }
+};
+
+/**
+ * @brief Fixed-width form of the keys of composite indexes: N bytes of a CompositeKey,
+ * compared byte by byte.
+ */
+template <int N>
+struct NormalizedKey : FixedKey<N>{
+};
 
 /**
- * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ * @brief One attribute of the key of a composite index.
  */
-//                                                  sibling ptr             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+struct KeyColumn{
+  /**
+   * Offset of the attribute inside the records.
+   */
+	int attrByteOffset;
+
+  /**
+   * Type of the attribute, INTEGER, DOUBLE or STRING.
+   */
+	Datatype attrType;
+};
 
 /**
- * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ * @brief Key of a composite index, built by adding the values of its attributes in the order
+ * of its KeyColumns. Values are stored normalized, so keys compare byte by byte in the
+ * order of their first attribute, then their second and so on: INTEGER and DOUBLE values
+ * big-endian with their sign flipped (and the rest of a negative DOUBLE too), STRING values
+ * as their first STRINGSIZE characters padded with NULs.
+ *
+ * A key with fewer values than the index has attributes stands for the lowest key starting
+ * with them, or after fillHigh() for the highest, so scans can bound leading attributes only.
+ * Pass a pointer to the CompositeKey wherever the index takes a key.
  */
-//                                                     level     extra pageNo                  key       pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+class CompositeKey{
+public:
+	CompositeKey() : length( 0 ), fill( 0 ) {}
+
+	CompositeKey& add( const int value )
+	{
+		return append( (std::uint32_t)value ^ 0x80000000u, 4 );
+	}
+
+	CompositeKey& add( const double value )
+	{
+		// -0.0 is equal to 0.0, so it has the same key
+		double nonNegativeZero = ( value == 0 ) ? 0.0 : value;
+		std::uint64_t bits;
+		memcpy( &bits, &nonNegativeZero, sizeof( bits ) );
+		return append( ( bits >> 63 ) ? ~bits : bits ^ ( (std::uint64_t)1 << 63 ), 8 );
+	}
+
+	CompositeKey& add( const char *value )
+	{
+		char padded[ STRINGSIZE ];
+		strncpy( padded, value, STRINGSIZE );
+		for( int i = 0; i < STRINGSIZE && length < MAX_COMPOSITE_KEY_SIZE; i++ )
+			bytes[ length++ ] = (unsigned char)padded[ i ];
+		return *this;
+	}
+
+  /**
+   * Makes the attributes not added take their highest values rather than their lowest.
+   */
+	CompositeKey& fillHigh()
+	{
+		fill = 0xFF;
+		return *this;
+	}
+
+  /**
+   * Drops the values past the first size bytes of the key.
+   */
+	CompositeKey& truncate( const int size )
+	{
+		if( size < length )
+			length = size;
+		return *this;
+	}
+
+  /**
+   * Key of the record, from its attributes at the offsets of the columns.
+   */
+	static CompositeKey fromRecord( const char *record, const std::vector<KeyColumn> &columns )
+	{
+		CompositeKey key;
+		for( size_t i = 0; i < columns.size(); i++ )
+		{
+			const char *attribute = record + columns[ i ].attrByteOffset;
+			if( columns[ i ].attrType == INTEGER )
+				key.add( KeyTraits<int>::fromPointer( attribute ) );
+			else if( columns[ i ].attrType == DOUBLE )
+				key.add( KeyTraits<double>::fromPointer( attribute ) );
+			else
+				key.add( attribute );
+		}
+		return key;
+	}
+
+  /**
+   * Writes the values of a normalized key back to the attributes of a record at the offsets of
+   * the columns, in the form fromRecord() read them in. STRING attributes get their first
+   * STRINGSIZE characters, padded with NULs.
+   */
+	static void toRecord( const unsigned char *normalized, const std::vector<KeyColumn> &columns, char *record )
+	{
+		for( size_t i = 0; i < columns.size(); i++ )
+		{
+			char *attribute = record + columns[ i ].attrByteOffset;
+			int size = columnSize( columns[ i ].attrType );
+			if( columns[ i ].attrType == STRING )
+			{
+				memcpy( attribute, normalized, size );
+				normalized += size;
+				continue;
+			}
+			std::uint64_t bits = 0;
+			for( int j = 0; j < size; j++ )
+				bits = ( bits << 8 ) | *normalized++;
+			if( columns[ i ].attrType == INTEGER )
+			{
+				std::int32_t value = (std::int32_t)( (std::uint32_t)bits ^ 0x80000000u );
+				memcpy( attribute, &value, sizeof( value ) );
+			}
+			else
+			{
+				bits = ( bits >> 63 ) ? bits ^ ( (std::uint64_t)1 << 63 ) : ~bits;
+				memcpy( attribute, &bits, sizeof( bits ) );
+			}
+		}
+	}
+
+  /**
+   * Bytes the normalized value of an attribute of the type takes, 0 for types that cannot be part of a key.
+   */
+	static int columnSize( const Datatype type )
+	{
+		return ( type == INTEGER ) ? 4 : ( type == DOUBLE ) ? 8 : ( type == STRING ) ? STRINGSIZE : 0;
+	}
+
+  /**
+   * The key in N bytes, filled up after the values added.
+   */
+	template <int N>
+	NormalizedKey<N> normalized() const
+	{
+		NormalizedKey<N> key;
+		int copied = ( length < N ) ? length : N;
+		memcpy( key.data, bytes, copied );
+		memset( key.data + copied, fill, N - copied );
+		return key;
+	}
+
+private:
+	CompositeKey& append( std::uint64_t value, const int size )
+	{
+		for( int i = size - 1; i >= 0 && length < MAX_COMPOSITE_KEY_SIZE; i-- )
+			bytes[ length++ ] = (unsigned char)( value >> ( 8 * i ) );
+		return *this;
+	}
+
+  /**
+   * Normalized values added so far.
+   */
+	unsigned char bytes[ MAX_COMPOSITE_KEY_SIZE ];
+
+  /**
+   * Number of bytes in bytes.
+   */
+	int length;
+
+  /**
+   * Byte the key is filled up with after its values.
+   */
+	unsigned char fill;
+};
+
+template <int N>
+struct KeyTraits< NormalizedKey<N> >{
+	static NormalizedKey<N> fromPointer( const void *key ) { return ( (const CompositeKey *)key )->normalized<N>(); }
+};
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
@@ -100,6 +426,125 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 		return r1.rid.page_number < r2.rid.page_number;
 }
 
+/**
+ * @brief Statistics of the keys of an index, kept in its meta page, from which
+ * BTreeIndex::estimateRange() estimates the entries of a range without reading it.
+ *
+ * An equi-depth histogram: the entries in key order are cut into bucketCount buckets of
+ * about the same number of entries, each described by the highest key in it, the number of
+ * entries up to its end, the number of distinct keys in it and the number of entries with its
+ * highest key. A bucket is cut only where the key changes, so a key repeated many times fills
+ * buckets of its own and is estimated exactly. Keys are stored as the fixed size sort keys of
+ * the node layout of the index.
+ *
+ * Bulk loading builds the histogram from the sorted entries as it writes them. analyze() builds it
+ * from at most ANALYZE_SAMPLE_LEAVES leaves spread evenly over the index, each key read standing for
+ * the entries of the leaves up to the next one read, which the subtree counts one level above the
+ * leaves give; an index of no more leaves than that is read whole and its histogram is exact.
+ */
+struct IndexStatistics{
+  /**
+   * Number of entries when the statistics were computed.
+   */
+	std::uint64_t entryCount;
+
+  /**
+   * Number of distinct keys when the statistics were computed.
+   */
+	std::uint64_t distinctCount;
+
+  /**
+   * Number of buckets in use, 0 if there are no statistics.
+   */
+	int bucketCount;
+
+  /**
+   * Lowest key of the index.
+   */
+	unsigned char lowestKey[ MAX_COMPOSITE_KEY_SIZE ];
+
+  /**
+   * Highest key of each bucket.
+   */
+	unsigned char bucketKeys[ HISTOGRAM_BUCKETS ][ MAX_COMPOSITE_KEY_SIZE ];
+
+  /**
+   * Number of entries up to the end of each bucket.
+   */
+	std::uint64_t bucketEnds[ HISTOGRAM_BUCKETS ];
+
+  /**
+   * Number of distinct keys in each bucket.
+   */
+	std::uint32_t bucketDistinct[ HISTOGRAM_BUCKETS ];
+
+  /**
+   * Number of entries of each bucket with its highest key.
+   */
+	std::uint64_t bucketRepeats[ HISTOGRAM_BUCKETS ];
+};
+
+/**
+ * @brief Line of a learned lookup model, predicting the position of the first entry with a key,
+ * for keys from firstKey to lastKey. The position of an entry is the page number of its leaf times
+ * the slots of the model, plus its index in the leaf, so a prediction names the leaf directly.
+ */
+struct LearnedSegment{
+  /**
+   * Lowest key the segment predicts for.
+   */
+	int firstKey;
+
+  /**
+   * Highest key the segment predicts for. No entry has a key between it and the firstKey of the
+   * next segment.
+   */
+	int lastKey;
+
+  /**
+   * Position of the first entry with firstKey.
+   */
+	std::uint64_t firstPosition;
+
+  /**
+   * Positions the prediction grows by per key.
+   */
+	double slope;
+};
+
+/**
+ * @brief Page of the segments of a learned lookup model, chained from the meta page.
+ */
+struct LearnedModelPage{
+  /**
+   * Number of segments a page holds.
+   */
+//                                                   isLeaf           next page           segmentCount     padding
+	static const int CAPACITY = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) - sizeof( int ) - sizeof( std::uint32_t ) ) / sizeof( LearnedSegment );
+
+  /**
+   * Always 0, so a learned lookup never takes the page for a leaf.
+   */
+	int isLeaf;
+
+  /**
+   * Page number of the next page of the model, 0 for the last one.
+   */
+	PageId nextPageNo;
+
+  /**
+   * Number of segments on this page.
+   */
+	int segmentCount;
+
+  /**
+   * Segments of this page, by firstKey.
+   */
+	LearnedSegment segments[ CAPACITY ];
+};
+
+static_assert( sizeof( LearnedModelPage ) <= Page::SIZE, "LearnedModelPage must fit in a page" );
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
@@ -110,274 +555,1651 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 */
 struct IndexMetaInfo{
   /**
-   * Name of base relation.
+   * Name of base relation.
+   */
+	char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored in pages.
+   */
+	int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+	Datatype attrType;
+
+  /**
+   * Page number of root page of the B+ Tree inside the file index file.
+   */
+	PageId rootPageNo;
+
+  /**
+   * Page number of the first page on the free list, 0 if the list is empty.
+   */
+	PageId freeListHead;
+
+  /**
+   * Format of the leaves of the index.
+   */
+	LeafFormat leafFormat;
+
+  /**
+   * Number of attributes of the key of a COMPOSITE index, 0 for other indexes.
+   */
+	int columnCount;
+
+  /**
+   * Attributes of the key of a COMPOSITE index, followed by its included attributes.
+   */
+	KeyColumn columns[ MAX_KEY_COLUMNS ];
+
+  /**
+   * Number of attributes at the end of columns that a COMPOSITE index includes in its entries
+   * without searching on them.
+   */
+	int includedCount;
+
+  /**
+   * Number of entries in the index when it was last closed.
+   */
+	std::uint64_t entryCount;
+
+  /**
+   * Statistics of the keys, as last computed.
+   */
+	IndexStatistics statistics;
+
+  /**
+   * Page number of the first page of the learned lookup model, 0 if the index has none.
+   */
+	PageId learnedModelPageNo;
+
+  /**
+   * Positions per page of the learned lookup model.
+   */
+	std::uint32_t learnedSlots;
+};
+
+static_assert( sizeof( IndexMetaInfo ) <= Page::SIZE, "IndexMetaInfo must fit in a page" );
+
+/**
+ * @brief A page of the index file freed by a delete. Free pages are chained into a list
+ * starting at the meta page, and reused by splits before the file grows.
+*/
+struct FreeNode{
+  /**
+   * Always FREE_NODE.
+   */
+	int isLeaf;
+
+  /**
+   * Page number of the next page on the free list, 0 for the last one.
+   */
+	PageId nextFree;
+};
+
+/**
+ * @brief State of one level of the tree while it is being bulk loaded. Nodes of a level are
+ * filled left to right, each until it holds fillFactor of its space, and handed to the level
+ * above once full.
+*/
+template <class K>
+struct BulkLoadLevel{
+  /**
+   * Number of nodes started on this level.
+   */
+	int nodeCount;
+
+  /**
+   * Page number of the node currently being filled.
+   */
+	PageId pageNo;
+
+  /**
+   * Node currently being filled, NULL if none is open.
+   */
+	Page *page;
+
+  /**
+   * Separator between the node currently being filled and the node before it on the level.
+   */
+	K lowKey;
+
+	BulkLoadLevel() : nodeCount( 0 ), pageNo( 0 ), page( NULL ), lowKey() {}
+};
+
+/*
+Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
+These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
+node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
+at this level are just above the leaf nodes. Otherwise set to 0.
+The structures are templated on the key type; the number of key slots is worked out from the key size at compile time.
+Every node links to its right neighbour on its level and keeps the low key of that neighbour as its high key (a B-link
+tree, after Lehman and Yao), so a node that split is found through the link before its parent knows of the new node.
+*/
+
+/**
+ * @brief Structure for all non-leaf nodes with keys of type T.
+*/
+template <class T>
+struct NonLeafNode{
+  /**
+   * Number of key slots in the node.
+   */
+//                                                         level     extra pageNo    right link               extra count                   high key               key       pageNo                   count
+	static const int CAPACITY = ( Page::SIZE - NODEHEADERSIZE - sizeof( int ) - 2 * sizeof( PageId ) - sizeof( std::uint32_t ) - sizeof( T ) ) / ( sizeof( T ) + sizeof( PageId ) + sizeof( std::uint32_t ) );
+
+  /**
+   * is leaf?
+   */
+	int isLeaf;
+
+  /**
+   * protection1
+   */
+    int protection1[10];
+
+  /**
+   * Level of the node in the tree.
+   */
+	int level;
+	
+  /**
+   * number of keys in the node.
+   */
+	int key_count;
+
+  /**
+   * Page number of the node on the right side on the same level, 0 for the last one.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Upper bound of the keys under the node, the low key of its right sibling. Meaningless in
+	 * the last node of a level.
+   */
+	T highKey;
+
+  /**
+   * Stores keys.
+   */
+	T keyArray[ CAPACITY ];
+
+  /**
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   */
+	PageId pageNoArray[ CAPACITY + 1 ];
+
+  /**
+   * Number of entries in the subtree of each child, for counting the entries of a key range
+	 * without reading the leaves it spans.
+   */
+	std::uint32_t countArray[ CAPACITY + 1 ];
+	
+  /**
+   * protection2
+   */
+    int protection2[10];
+};
+
+
+/**
+ * @brief Structure for all leaf nodes with keys of type T.
+*/
+template <class T>
+struct LeafNode{
+  /**
+   * Number of key slots in the leaf.
+   */
+//                                                      sibling ptrs          high key              key               rid
+	static const int CAPACITY = ( Page::SIZE - NODEHEADERSIZE - 2 * sizeof( PageId ) - sizeof( T ) ) / ( sizeof( T ) + sizeof( RecordId ) );
+
+  /**
+   * is leaf?
+   */
+	int isLeaf;
+	
+  /**
+   * protection1
+   */
+    int protection1[10];
+
+  /**
+   * number of keys in the node.
+   */
+	int key_count;
+	
+  /**
+   * Page number of the leaf on the right side.
+	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side, for scans in descending key order.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * Upper bound of the keys in the leaf, the low key of its right sibling. Meaningless in the
+	 * last leaf.
+   */
+	T highKey;
+	
+  /**
+   * Stores keys.
+   */
+	T keyArray[ CAPACITY ];
+
+  /**
+   * Stores RecordIds.
+   */
+	RecordId ridArray[ CAPACITY ];
+	
+  /**
+   * protection2
+   */
+    int protection2[10];
+};
+
+typedef NonLeafNode<int> NonLeafNodeInt;
+typedef LeafNode<int> LeafNodeInt;
+typedef NonLeafNode<double> NonLeafNodeDouble;
+typedef LeafNode<double> LeafNodeDouble;
+
+static_assert( sizeof( NonLeafNodeInt ) <= Page::SIZE, "NonLeafNodeInt must fit in a page" );
+static_assert( sizeof( LeafNodeInt ) <= Page::SIZE, "LeafNodeInt must fit in a page" );
+static_assert( sizeof( NonLeafNodeDouble ) <= Page::SIZE, "NonLeafNodeDouble must fit in a page" );
+static_assert( sizeof( LeafNodeDouble ) <= Page::SIZE, "LeafNodeDouble must fit in a page" );
+
+/**
+ * @brief Directory entry of a group of a PostingLeafNode: a key and a run of its record ids,
+ * whose pages are close enough together to be stored as deltas from a base page.
+*/
+template <class T>
+struct PostingGroup{
+  /**
+   * Key of every entry of the group.
+   */
+	T key;
+
+  /**
+   * Page number no record of the group is below, which the page deltas are counted from.
+   */
+	PageId basePage;
+
+  /**
+   * Number of the first entry of the group in the leaf. The group runs to the first entry of the next one.
+   */
+	std::uint16_t first;
+};
+
+/**
+ * @brief Structure for leaf nodes with keys of type T storing each key once followed by its
+ * posting list, the record ids of its entries in sorted order. Groups are a directory growing
+ * from the start of the data area, read with memcpy as they need not be aligned, and the
+ * record id of every entry, in entry order and packed in three bytes, fills the data area
+ * from its end.
+*/
+template <class T>
+struct PostingLeafNode{
+  /**
+   * Bytes of the data area.
+   */
+//                                                             sibling ptrs          high key        group_count
+	static const int DATA_SIZE = Page::SIZE - NODEHEADERSIZE - 2 * sizeof( PageId ) - sizeof( T ) - sizeof( int );
+
+  /**
+   * is leaf?
+   */
+	int isLeaf;
+
+  /**
+   * protection1
+   */
+    int protection1[10];
+
+  /**
+   * number of entries in the node, one per record id.
+   */
+	int key_count;
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * Upper bound of the keys in the leaf, the low key of its right sibling. Meaningless in the
+	 * last leaf.
+   */
+	T highKey;
+
+  /**
+   * Number of groups in the directory.
+   */
+	int group_count;
+
+  /**
+   * Group directory followed by free space and the record ids.
+   */
+	char data[ DATA_SIZE ];
+
+  /**
+   * protection2
+   */
+    int protection2[10];
+};
+
+static_assert( sizeof( PostingLeafNode<int> ) <= Page::SIZE, "PostingLeafNode<int> must fit in a page" );
+static_assert( sizeof( PostingLeafNode<double> ) <= Page::SIZE, "PostingLeafNode<double> must fit in a page" );
+
+/**
+ * @brief Structure for leaf nodes with INTEGER keys in the PACKED_LEAVES format. Entries are
+ * bit-packed, one after the other from the start of the data area: the key less baseKey in
+ * keyBits bits, the page of the record less basePage in pageBits bits and the slot of the
+ * record in slotBits bits, the widths being the fewest that hold every entry of the leaf.
+ * The header drops the protection arrays and keeps isLeaf in a byte, the first of the page
+ * as in every other node.
+*/
+struct PackedLeafNodeInt{
+  /**
+   * Bytes of the data area.
+   */
+//                                        isLeaf..key_count           sibling ptrs, high key, bases                    widths
+	static const int DATA_SIZE = Page::SIZE - 2 * sizeof( std::uint8_t ) - sizeof( std::uint16_t ) - 5 * sizeof( int ) - 4 * sizeof( std::uint8_t );
+
+  /**
+   * is leaf? Always 1.
+   */
+	std::uint8_t isLeaf;
+
+  /**
+   * Version of the encoding of the leaf, PACKED_LEAVES.
+   */
+	std::uint8_t format;
+
+  /**
+   * number of entries in the node.
+   */
+	std::uint16_t key_count;
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * Upper bound of the keys in the leaf, the low key of its right sibling. Meaningless in the
+	 * last leaf.
+   */
+	int highKey;
+
+  /**
+   * Lowest key of the leaf, which the packed keys are counted from.
+   */
+	int baseKey;
+
+  /**
+   * Lowest page of a record of the leaf, which the packed pages are counted from.
+   */
+	PageId basePage;
+
+  /**
+   * Bits of a packed key.
+   */
+	std::uint8_t keyBits;
+
+  /**
+   * Bits of a packed page.
+   */
+	std::uint8_t pageBits;
+
+  /**
+   * Bits of a packed slot.
+   */
+	std::uint8_t slotBits;
+
+  /**
+   * Unused, keeps the data area aligned.
+   */
+	std::uint8_t padding;
+
+  /**
+   * Packed entries followed by free space.
+   */
+	char data[ DATA_SIZE ];
+};
+
+static_assert( sizeof( PackedLeafNodeInt ) <= Page::SIZE, "PackedLeafNodeInt must fit in a page" );
+
+/**
+ * @brief Directory entry of a key in a LeafNodeString.
+*/
+struct LeafSlotString{
+  /**
+   * Record of the entry.
+   */
+	RecordId rid;
+
+  /**
+   * Offset in the data area of the key bytes following the prefix of the leaf.
+   */
+	std::uint16_t offset;
+
+  /**
+   * Number of key bytes following the prefix of the leaf.
+   */
+	std::uint16_t length;
+};
+
+/**
+ * @brief Structure for leaf nodes with STRING keys. The node is slotted: a directory of
+ * LeafSlotString entries, in key order, grows from the start of the data area and the key
+ * bytes grow from its end. The prefix shared by all keys of the leaf is stored once and the
+ * slots only hold what follows it.
+*/
+struct LeafNodeString{
+  /**
+   * Bytes of the data area.
+   */
+//                                                             sibling ptrs             high key                                  prefixOffset..heapBytes
+	static const int DATA_SIZE = Page::SIZE - NODEHEADERSIZE - 2 * sizeof( PageId ) - sizeof( std::uint32_t ) - STRINGSIZE - 4 * sizeof( std::uint16_t );
+
+  /**
+   * is leaf?
+   */
+	int isLeaf;
+
+  /**
+   * protection1
+   */
+    int protection1[10];
+
+  /**
+   * number of keys in the node.
+   */
+	int key_count;
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * Length of highKey, four bytes so the data area stays aligned for the slots.
+   */
+	std::uint32_t highKeyLength;
+
+  /**
+   * Upper bound of the keys in the leaf, the low key of its right sibling. Meaningless in the
+	 * last leaf.
+   */
+	char highKey[ STRINGSIZE ];
+
+  /**
+   * Offset in the data area of the prefix shared by all keys of the leaf.
+   */
+	std::uint16_t prefixOffset;
+
+  /**
+   * Length of the prefix shared by all keys of the leaf.
+   */
+	std::uint16_t prefixLength;
+
+  /**
+   * Offset in the data area of the lowest key byte; free space ends here.
+   */
+	std::uint16_t heapStart;
+
+  /**
+   * Key bytes still in use, prefix included. Bytes between heapStart and the end of the data
+   * area not counted here were freed and are reclaimed by compacting the node.
+   */
+	std::uint16_t heapBytes;
+
+  /**
+   * Slot directory followed by free space and key bytes.
+   */
+	char data[ DATA_SIZE ];
+
+  /**
+   * protection2
+   */
+    int protection2[10];
+};
+
+/**
+ * @brief Directory entry of a separator in a NonLeafNodeString.
+*/
+struct NonLeafSlotString{
+  /**
+   * Page number of the child right of the separator.
+   */
+	PageId child;
+
+  /**
+   * Number of entries in the subtree of the child.
+   */
+	std::uint32_t count;
+
+  /**
+   * Offset in the data area of the separator bytes.
+   */
+	std::uint16_t offset;
+
+  /**
+   * Length of the separator.
+   */
+	std::uint16_t length;
+};
+
+/**
+ * @brief Structure for non-leaf nodes with STRING keys, slotted like LeafNodeString. Separators
+ * are cut to the shortest prefix that still tells the two children apart.
+*/
+struct NonLeafNodeString{
+  /**
+   * Bytes of the data area.
+   */
+//                                                             level             first child, right link     first count, high key                                     heapStart, heapBytes
+	static const int DATA_SIZE = Page::SIZE - NODEHEADERSIZE - sizeof( int ) - 2 * sizeof( PageId ) - 2 * sizeof( std::uint32_t ) - STRINGSIZE - 2 * sizeof( std::uint16_t );
+
+  /**
+   * is leaf?
+   */
+	int isLeaf;
+
+  /**
+   * protection1
+   */
+    int protection1[10];
+
+  /**
+   * Level of the node in the tree.
+   */
+	int level;
+
+  /**
+   * number of keys in the node.
+   */
+	int key_count;
+
+  /**
+   * Page number of the child left of every separator.
+   */
+	PageId firstChild;
+
+  /**
+   * Number of entries in the subtree of the first child.
+   */
+	std::uint32_t firstCount;
+
+  /**
+   * Page number of the node on the right side on the same level, 0 for the last one.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Length of highKey.
+   */
+	std::uint32_t highKeyLength;
+
+  /**
+   * Upper bound of the keys under the node, the low key of its right sibling. Meaningless in
+	 * the last node of a level.
+   */
+	char highKey[ STRINGSIZE ];
+
+  /**
+   * Offset in the data area of the lowest separator byte; free space ends here.
+   */
+	std::uint16_t heapStart;
+
+  /**
+   * Separator bytes still in use.
+   */
+	std::uint16_t heapBytes;
+
+  /**
+   * Slot directory followed by free space and separator bytes.
+   */
+	char data[ DATA_SIZE ];
+
+  /**
+   * protection2
+   */
+    int protection2[10];
+};
+
+static_assert( sizeof( NonLeafNodeString ) <= Page::SIZE, "NonLeafNodeString must fit in a page" );
+static_assert( sizeof( LeafNodeString ) <= Page::SIZE, "LeafNodeString must fit in a page" );
+
+
+class BTreeIndex;
+
+/**
+ * @brief IndexCursor class. The state of one range scan over a BTreeIndex: the bounds of the
+ * range, the leaf being scanned, which stays pinned while the scan is open, and the next entry
+ * in it. Each cursor owns its own leaf, so any number of scans may be open on an index at once,
+ * each pinning one buffer frame. Cursors are opened by BTreeIndex::openScan() and can be moved
+ * but not copied. A cursor still open when it is destroyed ends its scan.
+ * Scans may run alongside inserts and deletes: a cursor keeps the version its leaf had when it
+ * reached it and checks it before using anything it copied from the leaf. If the leaf changed,
+ * the cursor descends again to the last key it returned and skips the entries with that key it
+ * returned already. Every cursor has to be ended before its index is destroyed.
+ */
+class IndexCursor {
+
+  friend class BTreeIndex;
+
+ private:
+
+  /**
+   * Index being scanned, null if no scan is open.
+   */
+	BTreeIndex	*index;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+	int			nextEntry;
+
+  /**
+   * Page number of current page being scanned.
+   */
+	PageId	currentPageNum;
+
+  /**
+   * Current Page being scanned.
+   */
+	Page		*currentPageData;
+
+  /**
+   * Version of the current page when the scan reached it, checked before anything read from the
+   * page is used.
+   */
+	std::uint64_t	version;
+
+  /**
+   * Last key returned, for a scan of INTEGER, DOUBLE, STRING or composite keys.
+   */
+	int			lastValInt;
+	double	lastValDouble;
+	std::string	lastValString;
+	unsigned char	lastValKey[ MAX_COMPOSITE_KEY_SIZE ];
+
+  /**
+   * Record IDs returned with the last key, none before the scan returned any.
+   */
+	std::vector<RecordId>	lastRids;
+
+  /**
+   * Whether the scan descended again since the entries with the last key it returned, which may
+   * include ones returned already at any place among the entries with that key.
+   */
+	bool		resumed;
+
+  /**
+   * Low INTEGER value for scan.
+   */
+	int			lowValInt;
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+	double	lowValDouble;
+
+  /**
+   * Low STRING value for scan.
+   */
+	std::string	lowValString;
+
+  /**
+   * High INTEGER value for scan.
+   */
+	int			highValInt;
+
+  /**
+   * High DOUBLE value for scan.
+   */
+	double	highValDouble;
+
+  /**
+   * High STRING value for scan.
+   */
+	std::string	highValString;
+
+  /**
+   * Low and high NormalizedKey of a scan on a composite index.
+   */
+	unsigned char	lowValKey[ MAX_COMPOSITE_KEY_SIZE ];
+	unsigned char	highValKey[ MAX_COMPOSITE_KEY_SIZE ];
+
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+	Operator	lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+	Operator	highOp;
+
+  /**
+   * Order the entries are returned in. A descending scan starts at the high end of the range
+   * and nextEntry moves down.
+   */
+	ScanDirection	direction;
+
+  /**
+   * Low value of the scan, in the member for keys of type K.
+   */
+	template <class K>
+	K &lowVal();
+
+  /**
+   * High value of the scan, in the member for keys of type K.
+   */
+	template <class K>
+	K &highVal();
+
+  /**
+   * Last key returned, in the member for keys of type K.
+   */
+	template <class K>
+	K &lastVal();
+
+	IndexCursor(const IndexCursor &) = delete;
+	IndexCursor &operator=(const IndexCursor &) = delete;
+
+ public:
+
+  /**
+   * Constructs a cursor with no scan open.
+   */
+	IndexCursor();
+
+  /**
+   * Takes over the scan of another cursor, which is left with no scan open.
+   */
+	IndexCursor(IndexCursor &&other);
+
+  /**
+   * Ends the scan of this cursor, if any, and takes over the scan of another cursor, which is
+   * left with no scan open.
+   */
+	IndexCursor &operator=(IndexCursor &&other);
+
+  /**
+   * Ends the scan if it is still open. Does not throw.
+   */
+	~IndexCursor();
+
+  /**
+   * @return	True while a scan is open on this cursor.
+   */
+	bool isOpen() const { return index != NULL; }
+
+  /**
+	 * Fetch the record id of the next index entry that matches the scan, moving on to the right
+	 * sibling of the current leaf once it has been scanned entirely, or the left one for a descending scan.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws ScanNotInitializedException If no scan is open on this cursor.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	const void scanNext(RecordId& outRid);
+
+  /**
+	 * Fetch the record ids, and optionally the keys, of the entries that match the scan from the rest of the current
+	 * leaf in one go, at most maxEntries of them, and move on to the right sibling once the leaf has been scanned
+	 * entirely. A call returns no more than one leaf holds, so large ranges take one call per leaf. A descending
+	 * scan copies the entries in decreasing key order and moves on to the left sibling.
+   * @param outRids	array of at least maxEntries record ids the entries are copied to
+   * @param outKeys	array of at least maxEntries keys the keys are copied to, or null. Keys are ints or doubles,
+   *					or STRINGSIZE characters each, padded with NUL characters, for a STRING index.
+   * @param maxEntries	most entries to copy
+   * @return	Number of entries copied, 0 once no more records satisfying the scan criteria are left.
+	 * @throws ScanNotInitializedException If no scan is open on this cursor.
+	 * @throws BadScanrangeException If maxEntries is not positive.
+	**/
+	int scanNextBatch(RecordId *outRids, void *outKeys, const int maxEntries);
+
+  /**
+	 * Fetch the record id of the next entry that matches the scan, like scanNext(), and write the attributes
+	 * the entry holds to outRecord at their offsets in the records of the relation, so queries that need
+	 * nothing else skip reading the record: the key attribute of a single attribute index, the columns
+	 * and included attributes of a composite one. Other bytes of outRecord are left alone.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @param outRecord	buffer the size of a record of the relation
+	 * @throws ScanNotInitializedException If no scan is open on this cursor.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	const void scanNextRecord(RecordId &outRid, void *outRecord);
+
+  /**
+	 * Terminate the scan and unpin its leaf.
+	 * @throws ScanNotInitializedException If no scan is open on this cursor.
+	**/
+	const void endScan();
+};
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation. Any number of scans may be open on it at once, each in its own IndexCursor from
+ * openScan(); startScan(), scanNext() and endScan() run one scan kept in the index itself.
+ * The attribute may be an INTEGER, a DOUBLE or a STRING, indexed on its first STRINGSIZE
+ * characters. The internals are templated on a node layout (see node_layout.h) and the
+ * constructor binds the instantiations for attrType once, so no operation branches on the
+ * type afterwards. INTEGER and DOUBLE indexes may store posting lists (see posting_layout.h)
+ * for keys that repeat many times, and INTEGER indexes bit-packed leaves (see
+ * packed_layout.h). insertEntry(), deleteEntry(), lookup() and scans on IndexCursors may be
+ * called from any number of threads at once, with optimistic lock coupling on the nodes and
+ * splits linked in the B-link way (see insertSplitting()); the other operations expect the
+ * index to be left alone while they run.
+*/
+class BTreeIndex {
+
+  friend class IndexCursor;
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file. Changed with rootLatch locked.
+   */
+	std::atomic<PageId>	rootPageNum;
+
+  /**
+   * Page number of the first page on the free list, mirrored in the meta page.
+   */
+	PageId	freeListHead;
+
+  /**
+   * Number of entries in the index, kept in the meta page while the index is closed.
+   */
+	std::atomic<std::uint64_t>	entryCount;
+
+  /**
+   * Statistics of the keys, a copy of those in the meta page.
+   */
+	IndexStatistics	statistics;
+
+  /**
+   * Held while reading or replacing statistics.
+   */
+	std::mutex	statisticsLatch;
+
+
+	// MEMBERS SPECIFIC TO CONCURRENCY
+
+  /**
+   * Latch of every node, by page number. A node is changed only with its latch locked.
+   */
+	NodeLatchTable	latches;
+
+  /**
+   * Latch of rootPageNum, which readers validate after reading the version of the root.
+   */
+	NodeLatch	rootLatch;
+
+  /**
+   * Held while taking pages from or putting pages on the free list.
+   */
+	std::mutex	freeListLatch;
+
+  /**
+   * Held shared by inserts and deletes that change only a leaf, until they have updated the subtree
+	 * counts of its ancestors, and exclusively by inserts that split and deletes that may merge, which
+	 * set the counts of the nodes they change. A shared holder finds every node of its path in place.
+   */
+	SharedLatch	structureLatch;
+
+
+	// MEMBERS SPECIFIC TO APPENDS
+
+  /**
+   * Page number of the rightmost leaf when an insert last appended to it, 0 before any did.
+   * Only a hint, checked under the latch of the page before it is used.
+   */
+	std::atomic<PageId>	rightmostLeaf;
+
+  /**
+   * Inserts in a row that appended to the rightmost leaf, counted up to APPEND_RUN.
+   */
+	std::atomic<int>	appendRun;
+
+
+	// MEMBERS SPECIFIC TO PINNED UPPER LEVELS
+
+  /**
+   * True if the non-leaf nodes stay pinned in the buffer pool while the index is open.
+   */
+	bool	pinUpperLevels;
+
+  /**
+   * Frame of every non-leaf node kept pinned, by page number, null for any other page. Descents
+   * read the upper levels through it rather than through the hash table of the buffer manager.
+   */
+	PageTable<std::atomic<Page *> >	pinnedNodes;
+
+  /**
+   * Page numbers of the nodes in pinnedNodes, so they can be unpinned when the index is closed.
+   */
+	std::vector<PageId>	pinnedPageNos;
+
+  /**
+   * Held while pinning or unpinning a node for pinnedNodes.
+   */
+	std::mutex	pinLatch;
+
+
+	// MEMBERS SPECIFIC TO LEARNED LOOKUPS
+
+  /**
+   * True if lookup() goes through a learned lookup model; a new index then gets one as it is bulk loaded.
+   */
+	bool	learnedLookup;
+
+  /**
+   * Segments of the learned lookup model, by firstKey, empty if the index has none.
+   */
+	std::vector<LearnedSegment>	learnedSegments;
+
+  /**
+   * Positions per page of the learned lookup model: the entries of a full leaf for a model trained
+	 * as the index was bulk loaded, the capacity of a leaf for one trained on changed leaves.
+   */
+	std::uint32_t	learnedSlots;
+
+  /**
+   * Page number of the first page of the learned lookup model kept in the file, mirrored in the meta
+	 * page. Cleared by the first insert or delete, which frees the pages.
+   */
+	std::atomic<PageId>	learnedModelPageNo;
+
+  /**
+   * True while the leaves are as the model was trained on. The first insert or delete clears it for good.
+   */
+	std::atomic<bool>	learnedValid;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. 
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Attributes of the entries of a COMPOSITE index, empty for other indexes: the attributes of
+   * its key, then those it includes.
+   */
+	std::vector<KeyColumn>	keyColumns;
+
+  /**
+   * Number of attributes at the start of keyColumns that scans and lookups search on.
+   */
+	int			searchColumnCount;
+
+  /**
+   * Bytes of the entries of a COMPOSITE index taken by the attributes searched on.
+   */
+	int			searchKeySize;
+
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * Scan started by startScan(), the one scan of the single-scan interface.
+   */
+	IndexCursor	scan;
+
+
+	// OPERATIONS BOUND TO THE KEY TYPE AT CONSTRUCTION
+
+  /**
+   * Instantiation of bulkLoadRelation for the key type.
+   */
+	void		(BTreeIndex::*bulkLoadRelationImpl)(const std::string &relationName, const double fillFactor, const std::uint32_t sortFrames);
+
+  /**
+   * Instantiation of insertEntryTyped for the key type.
+   */
+	void		(BTreeIndex::*insertEntryImpl)(const void *key, const RecordId rid);
+
+  /**
+   * Instantiation of deleteEntryTyped for the key type.
+   */
+	void		(BTreeIndex::*deleteEntryImpl)(const void *key, const RecordId rid);
+
+  /**
+   * Instantiation of startScanTyped for the key type.
+   */
+	void		(BTreeIndex::*startScanImpl)(IndexCursor &cursor, const void *lowVal, const void *highVal);
+
+  /**
+   * Instantiation of scanNextTyped for the key type.
+   */
+	void		(BTreeIndex::*scanNextImpl)(IndexCursor &cursor, RecordId &outRid);
+
+  /**
+   * Instantiation of scanNextBatchTyped for the key type.
+   */
+	int			(BTreeIndex::*scanNextBatchImpl)(IndexCursor &cursor, RecordId *outRids, void *outKeys, const int maxEntries);
+
+  /**
+   * Instantiation of lookupTyped for the key type.
+   */
+	std::uint32_t	(BTreeIndex::*lookupImpl)(const void *key, std::vector<RecordId> &outRids);
+
+  /**
+   * Instantiation of getNodeCountTyped for the key type.
+   */
+	std::uint32_t	(BTreeIndex::*getNodeCountImpl)();
+
+  /**
+   * Instantiation of pinNonLeaves for the key type.
+   */
+	void		(BTreeIndex::*pinNonLeavesImpl)();
+
+  /**
+   * Instantiation of countRangeTyped for the key type.
+   */
+	std::uint64_t	(BTreeIndex::*countRangeImpl)(const void *lowVal, const Operator lowOp, const void *highVal,
+												  const Operator highOp);
+
+  /**
+   * Instantiation of analyzeTyped for the key type.
+   */
+	void		(BTreeIndex::*analyzeImpl)();
+
+  /**
+   * Instantiation of estimateRangeTyped for the key type.
+   */
+	double	(BTreeIndex::*estimateRangeImpl)(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+
+  /**
+   * bindLayout
+	 * Points the operations above at their instantiations for the node layout L.
    */
-	char relationName[20];
+	template <class L>
+	void bindLayout();
 
   /**
-   * Offset of attribute, over which index is built, inside the record stored in pages.
+   * bulkLoadRelation
+	 * Sorts the entries of every tuple of the relation with an external merge sort and bulk
+	 * loads the tree from them.
+   *
+   * @param relationName	name of the relation
+   * @param fillFactor		fraction of the space of each node to fill, in (0, 1]
+   * @param sortFrames		number of buffer frames the sort may use
    */
-	int attrByteOffset;
+	template <class L>
+	void bulkLoadRelation(const std::string &relationName, const double fillFactor, const std::uint32_t sortFrames);
 
   /**
-   * Type of the attribute over which index is built.
+   * bulkLoadComposite
+	 * Like bulkLoadRelation(), for a COMPOSITE index: the key of each tuple is built from its
+	 * attributes in keyColumns.
    */
-	Datatype attrType;
+	template <class L>
+	void bulkLoadComposite(const std::string &relationName, const double fillFactor, const std::uint32_t sortFrames);
 
   /**
-   * Page number of root page of the B+ Tree inside the file index file.
+   * openIndexFile
+	 * Opens the index file, checking its meta page matches the index, or creates and bulk loads
+	 * it if it does not exist. Called by the constructors once the layout is bound.
+   *
+   * @throws  BadIndexInfoException     If the meta page does not match or fillFactor is outside (0, 1].
    */
-	PageId rootPageNo;
-};
+	void openIndexFile(const std::string &relationName, const std::string &indexName, const double fillFactor,
+					   const std::uint32_t sortFrames, const LeafFormat leafFormat);
 
-/*
-Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
-These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
-node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
-at this level are just above the leaf nodes. Otherwise set to 0.
-*/
+	template <class L>
+	void insertEntryTyped(const void *key, const RecordId rid);
+
+	template <class L>
+	void deleteEntryTyped(const void *key, const RecordId rid);
+
+	template <class L>
+	void startScanTyped(IndexCursor &cursor, const void *lowVal, const void *highVal);
+
+	template <class L>
+	void scanNextTyped(IndexCursor &cursor, RecordId &outRid);
+
+	template <class L>
+	int scanNextBatchTyped(IndexCursor &cursor, RecordId *outRids, void *outKeys, const int maxEntries);
+
+	template <class L>
+	std::uint32_t getNodeCountTyped();
 
-/**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
-*/
-struct NonLeafNodeInt{
   /**
-   * is leaf?
+   * pinNonLeaves
+	 * Pins every non-leaf node of the tree for pinnedNodes, level by level from the root.
    */
-	int isLeaf;
+	template <class L>
+	void pinNonLeaves();
+
+	template <class L>
+	std::uint32_t lookupTyped(const void *key, std::vector<RecordId> &outRids);
 
   /**
-   * protection1
+   * Appends the record ids of the entries with keys from low to high from entry i of a leaf read
+	 * at version on, following right siblings while they go on. Low and high are one key, or for a
+	 * covering index the key filled low and filled high. Unpins the last leaf read.
+   * @return	False if a leaf changed while it was read, and the entries found may be wrong.
    */
-    int protection1[10];
+	template <class L>
+	bool collectDuplicates(const typename L::Key &low, const typename L::Key &high, PageId pageNo, Page *page,
+						   std::uint64_t version, int i, std::vector<RecordId> &found);
 
   /**
-   * Level of the node in the tree.
+   * Reads the learned lookup model of an INTEGER index from the file, or trains it on the leaves, read
+	 * left to right, and keeps it in the file if the index has none: each segment is grown while one
+	 * line through its first key keeps the position of every key within LEARNED_MAX_ERROR.
+	 * No model is trained if the page numbers of the leaves do not rise from left to right, as the
+	 * positions of the keys come from them.
    */
-	int level;
-	
+	void openLearnedModel();
+
   /**
-   * number of keys in the node.
+   * Writes learnedSegments to newly allocated pages of the file and links them from the meta page.
    */
-	int key_count;
-	
+	void storeLearnedModel();
+
   /**
-   * parent of the node.
+   * Frees the pages of the learned lookup model kept in the file, which no longer matches the leaves.
    */
-	PageId parent;
+	void dropLearnedModel();
 
   /**
-   * Stores keys.
+   * lookup() through the learned lookup model: the model predicts the position of the key, the leaves
+	 * holding the positions within LEARNED_MAX_ERROR of it are searched for the key without descending
+	 * from the root, and the duplicates are read on from there. Falls back to lookupTyped once the index
+	 * was changed or if a leaf changed while it was read.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	std::uint32_t lookupLearned(const void *key, std::vector<RecordId> &outRids);
 
   /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   * Counts the entries of a range as the entries below its high bound less those below its low bound.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
-	
+	template <class L>
+	std::uint64_t countRangeTyped(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
   /**
-   * protection2
+   * Number of entries with keys below key, or up to key if inclusive: the subtree counts of the
+	 * children left of the path from the root to the leaf the key leads to, and the entries below
+	 * the key in that leaf.
    */
-    int protection2[10];
-};
+	template <class L>
+	std::uint64_t countBelow(const typename L::Key &key, const bool inclusive);
+
+  /**
+   * Computes the statistics from a sample of the leaves, read left to right, and stores them in the meta page.
+   */
+	template <class L>
+	void analyzeTyped();
 
+	template <class L>
+	double estimateRangeTyped(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
 
-/**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
-*/
-struct LeafNodeInt{
   /**
-   * is leaf?
+   * Estimated number of entries with keys below key, or up to key if inclusive, from the histogram.
    */
-	int isLeaf;
-	
+	template <class L>
+	double entriesBelow(const typename L::Key &key, const bool inclusive);
+
   /**
-   * protection1
+   * Replaces bounds on a covering index with CompositeKeys in low and high that name the
+	 * attributes searched on, filled in low or high as the operators need. Leaves the bounds of
+	 * other indexes alone.
    */
-    int protection1[10];
+	void coveringBounds(const void *&lowVal, const Operator lowOp, const void *&highVal, const Operator highOp,
+						CompositeKey &low, CompositeKey &high);
 
   /**
-   * number of keys in the node.
+   * splitLeaf
+	 * Moves the upper half of a full leaf to a new right sibling and inserts a new record into
+	 * the half it belongs to, or only what leaves the leaf APPEND_SPLIT_FILL full if the record
+	 * is one of a run of appends (see splitLeafForAppend()). The leaf and its old right sibling
+	 * are locked by the caller.
+   *
+   * @param pageNo		page number of the full leaf
+   * @param page		the full leaf, stays pinned
+   * @param keyValue	the key value to insert
+   * @param rid			the id of the record
+   * @param separator	returns the separator between the two leaves and the page number of the new one
    */
-	int key_count;
+	template <class L>
+	void splitLeaf(const PageId pageNo, Page *page, const typename L::Key &keyValue, const RecordId rid, PageKeyPair<typename L::Key> &separator);
 
   /**
-   * parent of the node.
+   * splitLeafForAppend
+	 * Moves entries off the end of the rightmost leaf to the newly allocated page newPage until
+	 * the leaf is no more than APPEND_SPLIT_FILL full, and appends the new record to newPage. Under
+	 * appends no entry goes into the old leaf again, so it stays that full instead of half full.
    */
-	PageId parent;
-	
+	template <class L>
+	void splitLeafForAppend(Page *page, Page *newPage, const typename L::Key &keyValue, const RecordId rid);
+
   /**
-   * Page number of the leaf on the right side.
-	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   * splitNonLeaf
+	 * Moves the upper half of a full non-leaf node to a new node and inserts a separator into the
+	 * half it belongs to. The middle key moves up and is returned as the separator for the parent.
+   *
+   * @param page		the full non-leaf node, stays pinned
+   * @param separator	the separator to insert, returns the separator for the parent
+   * @param count		entries under the child the separator points to
    */
-	PageId rightSibPageNo;
-	
+	template <class L>
+	void splitNonLeaf(Page *page, PageKeyPair<typename L::Key> &separator, const std::uint32_t count);
+
   /**
-   * Stores keys.
+   * bulkLoad
+	 * Builds the tree bottom-up from a sorted run of entries. Leaves are written left to right,
+	 * each filled up to fillFactor of its space, and every non-leaf level is built from the
+	 * level below it while that level is being written. The last node of a level takes
+	 * whatever is left and may be less full.
+   *
+   * @param entries		sort holding the key-rid pairs, ready to be scanned in key order
+   * @param fillFactor	fraction of the space of each node to fill, in (0, 1]
    */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	template <class L>
+	void bulkLoad(ExternalSort<typename L::SortKey> &entries, const double fillFactor);
 
   /**
-   * Stores RecordIds.
+   * bulkLoadAddChild
+	 * Appends a completed node to the open non-leaf node of the level above it, opening a new
+	 * node if there is none or the open one is full. A full node is handed to the level above.
+   *
+   * @param levels		build state of every level, leaves at index 0
+   * @param level		level receiving the child
+   * @param childNo		page number of the completed child
+   * @param lowKey		separator between the child and the child before it
+   * @param childCount	entries under the child
+   * @param fillFactor	fraction of the space of each node to fill, in (0, 1]
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
-	
+	template <class L>
+	void bulkLoadAddChild(std::vector<BulkLoadLevel<typename L::Key> > &levels, const int level,
+						  const PageId childNo, const typename L::Key &lowKey, const std::uint32_t childCount,
+						  const double fillFactor);
+
   /**
-   * protection2
+   * deleteFromLeaf
+	 * Deletes an entry from the leftmost leaf that may hold its key with only the leaf locked, if the
+	 * entry is in that leaf and the leaf stays full enough not to need rebalancing.
+   *
+   * @return	false, with nothing changed, if the delete has to go through deleteEntryTyped
    */
-    int protection2[10];
-};
+	template <class L>
+	bool deleteFromLeaf(const typename L::Key &keyValue, const RecordId rid);
 
+  /**
+   * nextLeafOnPath
+	 * Moves from a leaf to its right sibling, keeping the path of non-leaf nodes from the root
+	 * to the leaf and the index of the child taken in each up to date.
+   *
+   * @param path		non-leaf nodes above the leaf and the child taken in each, root first
+   * @param pageNo		page number of the leaf, pinned; returns the right sibling
+   * @param page		the leaf; returns the right sibling, pinned
+   * @param latched	nodes locked by the delete, the ones reached here are added
+   * @return	false, with the leaf unpinned, if it is the rightmost leaf
+   */
+	template <class L>
+	bool nextLeafOnPath(std::vector<std::pair<PageId, int> > &path, PageId &pageNo, Page *&page, std::vector<PageId> &latched);
 
-/**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
-*/
-class BTreeIndex {
+  /**
+   * rebalance
+	 * Restores MIN_NODE_FILL in a node entries were removed from, merging it with a sibling or
+	 * moving entries over from it, and goes on with the parent when a merge takes a separator
+	 * from it. A root left with a single child is replaced by that child.
+   *
+   * @param path		non-leaf nodes above the node and the child taken in each, root first
+   * @param pageNo		page number of the node, pinned; unpinned on return
+   * @param page		the node
+   * @param latched	nodes locked by the delete, siblings reached here are added
+   */
+	template <class L>
+	void rebalance(std::vector<std::pair<PageId, int> > &path, PageId pageNo, Page *page, std::vector<PageId> &latched);
 
- private:
+  /**
+   * redistributeLeaves
+	 * Moves entries between two neighbouring leaves, one at a time from the fuller one, until
+	 * they are about as full, and updates the separator between them in their parent.
+   *
+   * @param left		the left leaf
+   * @param right		the right leaf
+   * @param parent		the parent of both
+   * @param separatorIndex	index of the separator between them in the parent
+   */
+	template <class L>
+	void redistributeLeaves(Page *left, Page *right, Page *parent, const int separatorIndex);
 
   /**
-   * File object for the index file.
+   * findLeafEntry
+	 * Index of the entry of a leaf with the key and record, which must be in the leaf. Where
+	 * leafInsert() puts an entry among those with its key depends on the layout.
+   *
+   * @param page		the leaf
+   * @param key		key of the entry
+   * @param rid		record of the entry
+   * @return			index of the entry in the leaf
    */
-	File		*file;
+	template <class L>
+	int findLeafEntry(Page *page, const typename L::Key &key, const RecordId rid);
 
   /**
-   * Buffer Manager Instance.
+   * redistributeNonLeaves
+	 * Rotates children through the parent between two neighbouring non-leaf nodes, one at a
+	 * time from the fuller one, until they are about as full.
+   *
+   * @param left		the left node
+   * @param right		the right node
+   * @param parent		the parent of both
+   * @param separatorIndex	index of the separator between them in the parent
    */
-	BufMgr	*bufMgr;
+	template <class L>
+	void redistributeNonLeaves(Page *left, Page *right, Page *parent, const int separatorIndex);
 
   /**
-   * Page number of meta page.
+   * allocNode
+	 * Takes a page for a new node from the free list, or allocates one at the end of the file if
+	 * the list is empty.
+   *
+   * @param pageNo		returns the page number of the node
+   * @param page		returns the page, pinned
    */
-	PageId	headerPageNum;
+	void allocNode(PageId &pageNo, Page *&page);
 
   /**
-   * page number of root page of B+ tree inside index file.
+   * freeNode
+	 * Puts a node no longer in the tree on the free list and unpins it.
+   *
+   * @param pageNo		page number of the node
+   * @param page		the node, pinned
    */
-	PageId	rootPageNum;
+	void freeNode(const PageId pageNo, Page *page);
 
   /**
-   * Datatype of attribute over which index is built.
+   * setFreeListHead
+	 * Changes the first page of the free list, here and in the meta page. Called with
+	 * freeListLatch held.
    */
-	Datatype	attributeType;
+	void setFreeListHead(const PageId pageNo);
 
   /**
-   * Offset of attribute, over which index is built, inside records. 
+   * pinNode
+	 * Pins a non-leaf node for pinnedNodes if upper levels are kept pinned. Changes to it still
+	 * go through readPage() and unPinPage(), which keep track of the page being dirty.
    */
-	int 		attrByteOffset;
+	void pinNode(const PageId pageNo);
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * unpinNode
+	 * Drops the pin pinnedNodes holds on a node about to be freed, if it holds one.
    */
-	int			leafOccupancy;
+	void unpinNode(const PageId pageNo);
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * readNode
+	 * Reads a node from pinnedNodes, or pins it through the buffer manager if it is not there.
+   *
+   * @return	true if the node was pinned here and has to be released with releaseNode()
    */
-	int			nodeOccupancy;
+	bool readNode(const PageId pageNo, Page *&page);
 
+  /**
+   * releaseNode
+	 * Unpins a node read with readNode() if that pinned it.
+   */
+	void releaseNode(const PageId pageNo, const bool pinned);
 
-	// MEMBERS SPECIFIC TO SCANNING
+  /**
+   * setStatistics
+	 * Replaces the statistics, here and in the meta page.
+   */
+	void setStatistics(const IndexStatistics &computed);
 
   /**
-   * True if an index scan has been started.
+   * setRoot
+	 * Makes a node the root, here and in the meta page. The old root is locked by the caller.
    */
-	bool		scanExecuting;
+	void setRoot(const PageId pageNo);
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * descendToLeaf
+	 * Finds the leaf for a key without locking anything, validating the version of every node
+	 * before following a page number read from it and restarting from the root when a node
+	 * changed under it. A node the key is past the high key of split after its parent was
+	 * read, and the descent moves right to its sibling rather than down.
+   *
+   * @param keyValue	the key
+   * @param upper		descend by upper bound, to the leaf an entry with the key is inserted in,
+   *					rather than by lower bound, to the leftmost leaf that may hold the key
+   * @param pageNo		returns the page number of the leaf
+   * @param page		returns the leaf, pinned
+   * @param path		if not NULL, returns the non-leaf nodes descended from, root first
+   * @return	version of the leaf, to validate what is read from it against
    */
-	int			nextEntry;
+	template <class L>
+	std::uint64_t descendToLeaf(const typename L::Key &keyValue, const bool upper, PageId &pageNo, Page *&page,
+								std::vector<PageId> *path = NULL);
 
   /**
-   * Page number of current page being scanned.
+   * rightLinkFor
+	 * Page number of the right sibling of a node if the key is past its high key, 0 otherwise.
    */
-	PageId	currentPageNum;
+	template <class L>
+	PageId rightLinkFor(Page *page, const typename L::Key &keyValue, const bool upper);
 
   /**
-   * Current Page being scanned.
+   * insertIntoLeaf
+	 * Inserts an entry into its leaf with only the leaf locked, if the leaf has room for it.
+   *
+   * @return	false, with nothing changed, if the leaf is full
    */
-	Page		*currentPageData;
+	template <class L>
+	bool insertIntoLeaf(const typename L::Key &keyValue, const RecordId rid);
 
   /**
-   * Low INTEGER value for scan.
+   * insertIntoRightmost
+	 * Inserts an entry into the leaf rightmostLeaf names, if it still is the rightmost leaf, the
+	 * entry goes after its last one and it has room.
+   *
+   * @return	false, with nothing changed, otherwise
    */
-	int			lowValInt;
+	template <class L>
+	bool insertIntoRightmost(const typename L::Key &keyValue, const RecordId rid);
 
   /**
-   * Low DOUBLE value for scan.
+   * appendsTo
+	 * True if the leaf is the rightmost one and the key is not below its last key.
    */
-	double	lowValDouble;
+	template <class L>
+	bool appendsTo(Page *page, const typename L::Key &keyValue);
 
   /**
-   * Low STRING value for scan.
+   * insertSplitting
+	 * Inserts an entry into a full leaf, the B-link way. The leaf is split under its own lock
+	 * and unlocked before the separator goes to the parent: the new node is reachable through
+	 * the right link of the old one from then on, and a descent that reaches the old one with
+	 * a key past its high key moves right. The parent remembered on the way down is locked
+	 * next and split in turn if it has no room. So a split holds one node at a time, besides
+	 * the right sibling of a leaf while its left link is changed and the root while a new root
+	 * is put above it, and lookups run on meanwhile. Splits hold the structure latch exclusively
+	 * and run one at a time, so the subtree counts each sets are not changed under it.
    */
-	std::string	lowValString;
+	template <class L>
+	void insertSplitting(const typename L::Key &keyValue, const RecordId rid);
 
   /**
-   * High INTEGER value for scan.
+   * leftmostParent
+	 * Finds the parent of the leftmost node of a level, which was the root when an insert went
+	 * down and has been put under a new root since.
    */
-	int			highValInt;
+	template <class L>
+	PageId leftmostParent(const PageId childNo);
 
   /**
-   * High DOUBLE value for scan.
+   * childIndex
+	 * Index of the child in a non-leaf node, looked for first where the key leads, or -1 if the
+	 * node does not have the child.
    */
-	double	highValDouble;
+	template <class L>
+	int childIndex(Page *page, const PageId childNo, const typename L::Key &keyValue);
 
   /**
-   * High STRING value for scan.
+   * subtreeCount
+	 * Number of entries under a node: the entries of a leaf, or the sum of the subtree counts of
+	 * the children of a non-leaf node.
    */
-	std::string highValString;
-	
+	template <class L>
+	std::uint32_t subtreeCount(Page *page);
+
+	template <class L>
+	std::uint32_t subtreeCount(const PageId pageNo);
+
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * addToAncestors
+	 * Adds delta to the subtree count of every node on the path from the root down to the child,
+	 * bottom-up. The structure latch must be held so that no node on the path moves meanwhile.
+   *
+   * @param path		non-leaf nodes above the child, root first
+   * @param childNo	node an entry was inserted into or deleted from
+   * @param keyValue	key of the entry, where to look for the child in its parent
    */
-	Operator	lowOp;
+	template <class L>
+	void addToAncestors(const std::vector<PageId> &path, PageId childNo, const typename L::Key &keyValue,
+						const int delta);
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * addToRightmostPath
+	 * Adds delta to the subtree count of the last child of every non-leaf node from the root down
+	 * to the rightmost leaf, for entries appended to that leaf without descending to it.
    */
-	Operator	highOp;
+	template <class L>
+	void addToRightmostPath(const int delta);
 
+  /**
+   * lockRoot
+	 * Pins the root and locks it, waiting for other writers. The root does not change while
+	 * it is locked.
+   *
+   * @param pageNo		returns the page number of the root
+   * @param page		returns the root, pinned
+   */
+	void lockRoot(PageId &pageNo, Page *&page);
 
   /**
-   * insert
-	 * The actual insert method that inserts an record and its rid. It searches from the node indicated by
-	 * pid and add the leaf to the correct place.
+   * latchNode
+	 * Locks a node for a delete, waiting for other writers, unless the delete holds it already.
    *
-   * @param key        the key value to insert.
-   * @param pid        the page for insertion.
-   * @param rid			the id of the record
+   * @param latched	nodes locked by the delete, the node is added
+   * @param pageNo		page number of the node
+   */
+	void latchNode(std::vector<PageId> &latched, const PageId pageNo);
+
+  /**
+   * unlatchAll
+	 * Unlocks the nodes a delete locked.
+   */
+	void unlatchAll(std::vector<PageId> &latched);
+
+  /**
+   * positionScan
+	 * Descends to the first entry of the scan of a cursor that holds no leaf, or to the entry after
+	 * the last one it returned, with setPageIdForScan() and setEntryIndexForScan(), until it gets
+	 * there with no leaf changing on the way.
    */
-	void insert(const void * key, const PageId pid, const RecordId rid);
+	template <class L>
+	void positionScan(IndexCursor &cursor);
 
   /**
-   * leafSplitInsert
-	 * The method that split a full leaf node and inserts a new record
+   * resumeScan
+	 * Unpins the leaf of a cursor that changed since the cursor reached it and positions the scan
+	 * again (see positionScan()).
+   */
+	template <class L>
+	void resumeScan(IndexCursor &cursor);
+
+	template <class L>
+	void setPageIdForScan(IndexCursor &cursor);
+
+  /**
+   * @return	false if a leaf changed while the entry was looked for, and the cursor has to be positioned again
+   */
+	template <class L>
+	bool setEntryIndexForScan(IndexCursor &cursor);
+
+  /**
+   * skipReturned
+	 * Moves a cursor that descended again past the entries with the last key it returned that it
+	 * returned already. Inserts and deletes move entries with equal keys around, so each one is
+	 * looked for among the record IDs returned.
    *
-   * @param key        the key value to insert.
-   * @param pid        the page for insertion.
-   * @param rid			the id of the record
+   * @return	false if a leaf changed meanwhile, and the cursor has to be positioned again
    */
-	void leafSplitInsert(const void * key, const PageId pid, const RecordId rid);
-	
+	template <class L>
+	bool skipReturned(IndexCursor &cursor);
+
   /**
-   * combineNonleaf
-	 * The method that combines two non-leaf nodes. It is assumed that page 1 contains only 1 key and page 2 is not full
+   * moveToNextPage / moveToPrevPage
+	 * Move a cursor to the first entry of the right sibling of its leaf, or to the last entry of the
+	 * left sibling. A cursor on the last leaf in that direction stays on it with no entries left.
    *
-   * @param pid1        the pid of page1, with only 1 key
-   * @param pid2		the pid of page2, not full
-   */	
-	void combineNonleaf(const PageId  pid1, const PageId pid2);
-	
-	void setPageIdForScan();
-	void setEntryIndexForScan();
-	void moveToNextPage(LeafNodeInt *node);
-	void setNextEntry();
+   * @return	false, with the cursor left on its leaf, if the leaf changed since the cursor reached it
+   */
+	template <class L>
+	bool moveToNextPage(IndexCursor &cursor);
+	template <class L>
+	bool moveToPrevPage(IndexCursor &cursor);
+
+	template <class L>
+	void setNextEntry(IndexCursor &cursor);
+
+  /**
+   * noteReturned
+	 * Records that a cursor returned the count entries in rids, the last run of them with key. The
+	 * cursor goes on from there if its leaf changes.
+   */
+	template <class L>
+	void noteReturned(IndexCursor &cursor, const typename L::Key &key, const RecordId *rids, const int run, const int count);
+
 	bool isLeaf(Page *page);
-	int findIndexNonLeaf(NonLeafNodeInt *node, int key);	
 
 
  public:
@@ -385,22 +2207,77 @@ class BTreeIndex {
   /**
    * BTreeIndex Constructor. 
 	 * Check to see if the corresponding index file exists. If so, open the file.
-	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * If not, create it, sort the entries of every tuple in the base relation, read using FileScan class,
+	 * with an external merge sort and bulk load the tree from the sorted entries.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
-   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * @param fillFactor					Fraction of each node filled when a new index is bulk loaded, in (0, 1]
+   * @param sortFrames					Number of buffer frames the external sort of the entries of a new index may use, at least 3
+   * @param leafFormat					Format of the leaves: POSTING_LEAVES for indexes where keys repeat many times,
+	 *														PACKED_LEAVES for INTEGER indexes read far more than written
+   * @param pinUpperLevels			Keep the non-leaf nodes pinned in the buffer pool while the index is open, so a
+	 *														descent from the root only reads its leaf through the buffer manager
+   * @param learnedLookup				For INTEGER indexes with plain leaves that are read only once built: train a
+	 *														piecewise linear model of the leaves as the index is bulk loaded and keep it in
+	 *														the file, so lookup() goes straight to the leaf of a key instead of descending
+	 *														from the root. The model takes sizeof(LearnedSegment) bytes of memory per segment
+	 *														and nothing per leaf, see getLearnedModelSize(). The first insert or delete turns
+	 *														it off and drops it from the file; an index opened without one is trained on
+	 *														its leaves once.
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type, leaf format etc.) do not match with values received through constructor parameters.
+   * @throws  BadIndexInfoException     If fillFactor is outside (0, 1].
+   * @throws  BadIndexInfoException     If leafFormat is not available for attrType.
+   * @throws  BadIndexInfoException     If learnedLookup is set for an index that is not INTEGER with plain leaves.
+   * @throws  BufferExceededException   If sortFrames is less than 3.
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const double fillFactor = DEFAULT_FILL_FACTOR,
+						const std::uint32_t sortFrames = DEFAULT_SORT_FRAMES,
+						const LeafFormat leafFormat = PLAIN_LEAVES,
+						const bool pinUpperLevels = false,
+						const bool learnedLookup = false);
+
+  /**
+   * BTreeIndex Constructor for a composite index, keyed on several attributes compared in
+	 * order. Keys passed to the index are CompositeKeys; see there for bounding scans on the
+	 * leading attributes only. The index file is named after the relation and the offsets of the
+	 * attributes, and opened or created like that of a single attribute index.
+	 *
+	 * An index with included attributes covers them: its entries are keyed on the columns
+	 * followed by the included attributes, so insertEntry() and deleteEntry() take keys with the
+	 * values of both, while scans and lookup() take keys with the values of the columns only.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param columns							Attributes of the key, most significant first
+   * @param included						Attributes stored in each entry after the key without being searched on, so
+	 *														scans can return them through IndexCursor::scanNextRecord() instead of
+	 *														reading the records from the relation
+   * @param fillFactor					Fraction of each node filled when a new index is bulk loaded, in (0, 1]
+   * @param sortFrames					Number of buffer frames the external sort of the entries of a new index may use, at least 3
+   * @param pinUpperLevels			Keep the non-leaf nodes pinned in the buffer pool while the index is open
+   * @throws  BadIndexInfoException     If there are no columns or more than MAX_KEY_COLUMNS columns and included attributes,
+	 *																		one is not INTEGER, DOUBLE or STRING, or they take more than MAX_COMPOSITE_KEY_SIZE bytes.
+   * @throws  BadIndexInfoException     If the index file already exists but its meta page does not match.
+   * @throws  BadIndexInfoException     If fillFactor is outside (0, 1].
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const std::vector<KeyColumn> &columns,
+						const std::vector<KeyColumn> &included = std::vector<KeyColumn>(),
+						const double fillFactor = DEFAULT_FILL_FACTOR,
+						const std::uint32_t sortFrames = DEFAULT_SORT_FRAMES,
+						const bool pinUpperLevels = false);
 	
 
   /**
    * BTreeIndex Destructor. 
-	 * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
+	 * End any scan started with startScan(), flush index file, after unpinning any pinned pages, from the buffer manager
 	 * and delete file instance thereby closing the index file.
 	 * Destructor should not throw any exceptions. All exceptions should be caught in here itself. 
 	 * */
@@ -409,32 +2286,86 @@ class BTreeIndex {
 
   /**
 	 * Insert a new entry using the pair <value,rid>. 
-	 * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
-	 * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
-	 * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
-	 * Make sure to unpin pages as soon as you can.
+	 * Descend from the root to the leaf to insert the entry in, remembering the non-leaf nodes on the way. The insertion may
+	 * cause splitting of leaf node. This splitting adds the new leaf page number into the parent non-leaf taken from that path,
+	 * which may in-turn get split. This may continue all the way upto the root causing the root to get split, in which case
+	 * a new root is allocated and the metapage changed accordingly. Only the nodes on the path are read.
+	 * An entry that fits in its leaf is inserted with the leaf locked alone, and a split locks one node at
+	 * a time on its way up.
    * @param key			Key to insert, pointer to integer/double/char string
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
 	**/
 	const void insertEntry(const void* key, const RecordId rid);
 
 
+  /**
+	 * Delete the entry <value,rid>.
+	 * Descend from the root to the leftmost leaf that may hold the value and look for the entry from there to the
+	 * right, as duplicates of the value may span several leaves. A leaf left less than MIN_NODE_FILL full is merged
+	 * with a sibling, or takes entries over from it if the two do not fit in one leaf. Merges remove a separator from
+	 * the parent, which may in turn be merged, up to the root. A root left with a single child is replaced by it.
+	 * Pages of merged nodes go on the free list of the index file and are reused by later splits.
+	 * Every node looked at stays locked until the delete is done, and deletes run one at a time.
+   * @param key			Key to delete, pointer to integer/double/char string
+   * @param rid			Record ID of the record whose entry is getting deleted.
+	 * @throws  NoSuchKeyFoundException If the index has no entry with this key and record ID.
+	**/
+	const void deleteEntry(const void* key, const RecordId rid);
+
+
+  /**
+	 * Find the record ids of every entry with the key. Descends from the cached root page straight to the
+	 * leftmost leaf that may hold the key and reads the entries from there, following right siblings while
+	 * duplicates go on, without keeping any scan state. Finding no entry is not an error. Locks nothing:
+	 * each node is checked unchanged after it was read, and the lookup starts over if one was not.
+	 * The key of a covering index names the attributes searched on, and every entry with them is found.
+   * @param key			Key to look up, pointer to integer/double/char string
+   * @param outRids	The record ids found are appended to this, in index order.
+   * @return	Number of record ids found.
+	**/
+	std::uint32_t lookup(const void* key, std::vector<RecordId> &outRids);
+
+
+  /**
+	 * Open a filtered scan of the index in a cursor of its own, leaving any other scan open.
+	 * The bounds, operators and direction are those of startScan(). The first leaf holding an entry
+	 * in range stays pinned in the buffer pool until the cursor is ended or destroyed.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @param direction	Order to return the entries in
+   * @return	Cursor to read the matching record ids from.
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	**/
+	IndexCursor openScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+						 const ScanDirection direction = ASCENDING);
+
+
   /**
 	 * Begin a filtered scan of the index.  For instance, if the method is called 
 	 * using ("a",GT,"d",LTE) then we should seek all entries with a value 
 	 * greater than "a" and less than or equal to "d".
-	 * If another scan is already executing, that needs to be ended here.
+	 * If another scan started here is already executing, that needs to be ended here. Scans opened with
+	 * openScan() are not affected.
 	 * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
 	 * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+	 * A DESCENDING scan starts from the last entry of the range instead, descending by the high value, and
+	 * returns the entries in decreasing key order by following the left sibling links of the leaves, so it only
+	 * reads the leaves holding the entries taken from it.
    * @param lowVal	Low value of range, pointer to integer / double / char string
    * @param lowOp		Low operator (GT/GTE)
    * @param highVal	High value of range, pointer to integer / double / char string
    * @param highOp	High operator (LT/LTE)
+   * @param direction	Order to return the entries in, ASCENDING unless given
    * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
    * @throws  BadScanrangeException If lowVal > highval
 	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
 	**/
-	const void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+	const void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+						 const ScanDirection direction = ASCENDING);
 
 
   /**
@@ -447,11 +2378,130 @@ class BTreeIndex {
 	const void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Fetch the entries that match the scan started with startScan() from the rest of the current leaf in one go.
+	 * See IndexCursor::scanNextBatch().
+   * @param outRids	array of at least maxEntries record ids the entries are copied to
+   * @param outKeys	array of at least maxEntries keys the keys are copied to, or null
+   * @param maxEntries	most entries to copy
+   * @return	Number of entries copied, 0 once no more records satisfying the scan criteria are left.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws BadScanrangeException If maxEntries is not positive.
+	**/
+	int scanNextBatch(RecordId *outRids, void *outKeys, const int maxEntries);
+
+
+  /**
+	 * Fetch the next entry that matches the scan started with startScan() and the attributes it holds.
+	 * See IndexCursor::scanNextRecord().
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @param outRecord	buffer the size of a record of the relation the attributes are written to
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	const void scanNextRecord(RecordId &outRid, void *outRecord);
+
+
+  /**
+	 * Key of the entry of a composite index for a record: the values of its columns and of the
+	 * attributes it includes, as insertEntry() and deleteEntry() take them.
+   * @param record	the record, laid out as in the relation
+	**/
+	CompositeKey entryKey(const char *record) const { return CompositeKey::fromRecord(record, keyColumns); }
+
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
 	**/
 	const void endScan();
+
+
+  /**
+	 * Count the nodes of the tree by walking it from the root. Together with the meta page, the
+	 * free list and the pages of a learned lookup model they are every page the index file holds,
+	 * as splits allocate no other pages.
+   * @return	Number of leaf and non-leaf nodes in the tree.
+	**/
+	std::uint32_t getNodeCount();
+
+
+  /**
+	 * Count the entries of a range without returning them. The bounds and operators are those of
+	 * startScan(). Every non-leaf node holds the number of entries under each of its children, so
+	 * only the two root-to-leaf paths of the bounds are read, however many leaves the range spans.
+	 * Expects the index to be left alone while it runs.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return	Number of entries in the range, 0 if there are none.
+	 * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+	 * @throws  BadScanrangeException If lowVal > highval
+	**/
+	std::uint64_t countRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Number of entries in the index, kept up to date by inserts and deletes without reading it.
+	**/
+	std::uint64_t getEntryCount() const { return entryCount; }
+
+
+  /**
+	 * Compute the statistics estimateRange() works from and keep them in the meta page: an
+	 * equi-depth histogram of HISTOGRAM_BUCKETS buckets and the number of distinct keys. Reads the
+	 * nodes one level above the leaves and at most ANALYZE_SAMPLE_LEAVES leaves, see IndexStatistics.
+	 * A new index gets its statistics as it is bulk loaded; call this again once inserts and deletes
+	 * have changed the spread of the keys.
+	**/
+	void analyze();
+
+
+  /**
+	 * Estimate the number of entries of a range from the statistics, without reading the index, to
+	 * choose between scanning the index and the relation. The bounds and operators are those of
+	 * startScan(). Numeric keys are interpolated within the buckets of the histogram, other keys
+	 * count half of a bucket the bounds fall in. Estimates scale with the entries inserted and
+	 * deleted since the statistics were computed.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return	Estimated number of entries in the range.
+	 * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+	 * @throws  BadScanrangeException If lowVal > highval
+	**/
+	double estimateRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Number of distinct keys when the statistics were last computed.
+	**/
+	std::uint64_t getDistinctKeyEstimate();
+
+
+  /**
+	 * True if lookup() goes through a learned lookup model, until the first insert or delete.
+	**/
+	bool isLearned() const { return learnedValid; }
+
+
+  /**
+	 * Bytes of memory taken by the learned lookup model, 0 if the index has none: sizeof(LearnedSegment)
+	 * per segment. A segment ends where a line no longer keeps every key within LEARNED_MAX_ERROR
+	 * positions, and at a page between two leaves that is not a leaf. A bulk loaded index has about
+	 * one such page per NonLeafNodeInt::CAPACITY leaves, so evenly spread keys take one segment per
+	 * that many leaves; there is never more than one segment per distinct key.
+	**/
+	std::size_t getLearnedModelSize() const;
+
+
+  /**
+	 * Count the pages on the free list of the index file.
+   * @return	Number of pages freed by deletes and not reused yet.
+	**/
+	std::uint32_t getFreePageCount();
 };
 
 }
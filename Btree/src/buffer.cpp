@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <iostream>
+#include <thread>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
@@ -33,7 +34,12 @@ BufMgr::BufMgr(std::uint32_t bufs)
   bufPool = new Page[bufs];
 
   int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  numPartitions = BUF_HASH_PARTITIONS;
+  partitions = new BufPartition[numPartitions];
+  for (std::uint32_t i = 0; i < numPartitions; i++)
+  {
+    partitions[i].hashTable = new BufHashTbl (htsize / numPartitions + 1);  // allocate the buffer hash table
+  }
 
   clockHand = bufs - 1;
 }
@@ -46,10 +52,15 @@ BufMgr::~BufMgr() {
   	BufDesc* tmpbuf = &bufDescTable[i];
   	if (tmpbuf->valid == true && tmpbuf->dirty == true)
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+			tmpbuf->file.load()->writePage(tmpbuf->pageNo, bufPool[i]);
   	}
   }
 
+  for (std::uint32_t i = 0; i < numPartitions; i++)
+  {
+    delete partitions[i].hashTable;
+  }
+  delete [] partitions;
   delete [] bufDescTable;
   delete [] bufPool;
 }
@@ -58,95 +69,191 @@ void BufMgr::allocBuf(FrameId & frame)
 {
   // perform first part of clock algorithm to search for 
   // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
-
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  for (std::uint32_t numScanned = 0; numScanned < 2*numBufs; numScanned++)	//Need to scn twice
   {
     // advance the clock
-    advanceClock();
-    numScanned++;
+    const FrameId frameNo = advanceClock();
+    BufDesc &desc = bufDescTable[frameNo];
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+    // is valid, check referenced bit
+    if (desc.valid && desc.refbit.exchange(false))
     {
-      break;
+      // has been referenced, the bit is now clear
+      bufStats.accesses++;
+      continue;
     }
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+    // claim the frame unless someone has it pinned
+    int unpinned = 0;
+    if (! desc.pinCnt.compare_exchange_strong(unpinned, 1))
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
-      {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
-      }
+      continue;
     }
-    else
+
+    // hasn't been referenced and is not pinned, use it, flushing any
+    // existing changes to disk if necessary
+    if (evictFrame(frameNo))
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      // return new frame number
+      frame = frameNo;
+      return;
     }
+    desc.pinCnt--;
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+
+  // the buffer pool is full
+  throw BufferExceededException();
+} // end allocBuf
+
+
+bool BufMgr::evictFrame(const FrameId frameNo)
+{
+  BufDesc &desc = bufDescTable[frameNo];
+  if (! desc.valid)
   {
-    throw BufferExceededException();
+    return true;
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+
+  // the page of a frame only changes under a pin, which the caller holds
+  File* file = desc.file;
+  const PageId pageNo = desc.pageNo;
+  BufPartition &partition = partitionOf(file, pageNo);
+  std::unique_lock<std::mutex> guard(partition.latch);
+  if (! desc.valid)
+  {
+    return true;
+  }
+  if (desc.pinCnt != 1)
+  {
+    return false;
+  }
+
+  if (desc.dirty)
   {
+    // write the page out of the latch; whoever pins the frame meanwhile
+    // waits for the write to finish
+    desc.dirty = false;
+    desc.io = true;
+    guard.unlock();
+    try
+    {
+      file->writePage(pageNo, bufPool[frameNo]);
+    }
+    catch (...)
+    {
+      desc.dirty = true;
+      desc.io = false;
+      desc.pinCnt--;
+      throw;
+    }
     bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    guard.lock();
+    desc.io = false;
+    if (! desc.valid)
+    {
+      return true;
+    }
+    if (desc.pinCnt != 1)
+    {
+      return false;
+    }
   }
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  // remove the entry from the hash table and reset the frame, leaving the
+  // caller's pin on it
+  partition.hashTable->remove(file, pageNo);
+  desc.file = NULL;
+  desc.pageNo = Page::INVALID_NUMBER;
+  desc.refbit = false;
+  desc.valid = false;
+  return true;
+}
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
+
+void BufMgr::waitForIo(const FrameId frameNo)
+{
+  while (bufDescTable[frameNo].io)
+  {
+    std::this_thread::yield();
+  }
+}
 
 	
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
-  // check to see if it is already in the buffer pool
-  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
-  FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
-
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
-  }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+  BufPartition &partition = partitionOf(file, pageNo);
+  while (true)
   {
+    // check to see if it is already in the buffer pool
+    std::unique_lock<std::mutex> guard(partition.latch);
+    FrameId frameNo = 0;
+    try
+    {
+      partition.hashTable->lookup(file, pageNo, frameNo);
+
+      // set the referenced bit
+      bufDescTable[frameNo].refbit = true;
+      bufDescTable[frameNo].pinCnt++;
+      guard.unlock();
+
+      // the page may still be on its way in or out
+      waitForIo(frameNo);
+      if (bufDescTable[frameNo].valid)
+      {
+        page = &bufPool[frameNo];
+        return;
+      }
+
+      // reading the page in failed, try again
+      bufDescTable[frameNo].pinCnt--;
+      continue;
+    }
+    catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+    {
+    }
+    guard.unlock();
+
     // alloc a new frame
     allocBuf(frameNo);
 
+    guard.lock();
+    try
+    {
+      // someone else read the page meanwhile, use theirs
+      FrameId otherFrameNo = 0;
+      partition.hashTable->lookup(file, pageNo, otherFrameNo);
+      bufDescTable[frameNo].pinCnt--;
+      continue;
+    }
+    catch(HashNotFoundException e)
+    {
+    }
+
+    // set up the entry properly and insert it in the hash table before
+    // reading, so nobody else reads the page too
+    bufDescTable[frameNo].Set(file, pageNo, true);
+    partition.hashTable->insert(file, pageNo, frameNo);
+    guard.unlock();
+
     // read the page into the new frame
+    try
+    {
+      bufPool[frameNo] = file->readPage(pageNo);
+    }
+    catch (...)
+    {
+      guard.lock();
+      partition.hashTable->remove(file, pageNo);
+      bufDescTable[frameNo].file = NULL;
+      bufDescTable[frameNo].valid = false;
+      bufDescTable[frameNo].io = false;
+      bufDescTable[frameNo].pinCnt--;
+      throw;
+    }
     bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
-
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
+    bufDescTable[frameNo].io = false;
     page = &bufPool[frameNo];
-
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+    return;
   }
 }
 
@@ -154,9 +261,11 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
 {
+  BufPartition &partition = partitionOf(file, pageNo);
+  std::lock_guard<std::mutex> guard(partition.latch);
   // lookup in hashtable
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  partition.hashTable->lookup(file, pageNo, frameNo);
 
   if (dirty == true) bufDescTable[frameNo].dirty = dirty;
 
@@ -173,37 +282,55 @@ void BufMgr::flushFile(const File* file)
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
-		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
-
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
-
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
+  	if (tmpbuf->file != file)
+  		continue;
+
+  	if (tmpbuf->valid == false)
   		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+
+  	// claiming the frame fails if the page is pinned
+  	int unpinned = 0;
+  	if (! tmpbuf->pinCnt.compare_exchange_strong(unpinned, 1))
+  		throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+
+  	// writes the page out if it is dirty and unmaps it
+  	if (! evictFrame(i))
+  	{
+  		tmpbuf->pinCnt--;
+  		throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+  	}
+  	tmpbuf->pinCnt--;
   }
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo) 
 {
-	//Deallocate from file altogether
-  //See if it is in the buffer pool
-  FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
-
-	// clear the page
-	bufDescTable[frameNo].Clear();
+  BufPartition &partition = partitionOf(file, pageNo);
+  while (true)
+  {
+    std::unique_lock<std::mutex> guard(partition.latch);
+    //Deallocate from file altogether
+    //See if it is in the buffer pool
+    FrameId frameNo = 0;
+    partition.hashTable->lookup(file, pageNo, frameNo);
+
+    // let a write of the page in progress finish first
+    if (bufDescTable[frameNo].io)
+    {
+      guard.unlock();
+      std::this_thread::yield();
+      continue;
+    }
 
-	hashTable->remove(file, pageNo);
+    // clear the page
+    partition.hashTable->remove(file, pageNo);
+    bufDescTable[frameNo].file = NULL;
+    bufDescTable[frameNo].pageNo = Page::INVALID_NUMBER;
+    bufDescTable[frameNo].dirty = false;
+    bufDescTable[frameNo].refbit = false;
+    bufDescTable[frameNo].valid = false;
+    break;
+  }
 
   // deallocate it in the file	
   file->deletePage(pageNo);
@@ -218,15 +345,22 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
   allocBuf(frameNo);
 
   // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
+  try
+  {
+    bufPool[frameNo] = file->allocatePage(pageNo);
+  }
+  catch (...)
+  {
+    bufDescTable[frameNo].pinCnt--;
+    throw;
+  }
   page = &bufPool[frameNo];
 
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
-
-  // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+  // set up the entry properly and insert it in the hash table
+  BufPartition &partition = partitionOf(file, pageNo);
+  std::lock_guard<std::mutex> guard(partition.latch);
+  bufDescTable[frameNo].Set(file, pageNo, false);
+  partition.hashTable->insert(file, pageNo, frameNo);
 }
 
 void BufMgr::printSelf(void) 
@@ -9,10 +9,18 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <mutex>
 
 namespace badgerdb {
 
+/**
+ * @brief Number of partitions of the buffer hash table, each with its own latch.
+ */
+const std::uint32_t BUF_HASH_PARTITIONS = 16;
+
 /**
 * forward declaration of BufMgr class 
 */
@@ -29,12 +37,12 @@ class BufDesc {
 	/**
    * Pointer to file to which corresponding frame is assigned
 	 */
-  File* file;
+  std::atomic<File*> file;
 
 	/**
    * Page within file to which corresponding frame is assigned
 	 */
-  PageId pageNo;
+  std::atomic<PageId> pageNo;
 
 	/**
    * Frame number of the frame, in the buffer pool, being used
@@ -42,24 +50,31 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * Number of times this page has been pinned. A frame is claimed for a new page by raising it
+   * from 0 to 1, so a frame is never reused while someone has it pinned.
 	 */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
 	/**
    * True if page is dirty;  false otherwise
 	 */
-  bool dirty;
+  std::atomic<bool> dirty;
 
 	/**
    * True if page is valid
 	 */
-  bool valid;
+  std::atomic<bool> valid;
 
 	/**
    * Has this buffer frame been reference recently
 	 */
-  bool refbit;
+  std::atomic<bool> refbit;
+
+	/**
+   * True while the page is read into the frame or written out of it, outside of any latch.
+   * Whoever pins the frame meanwhile waits for it to become false.
+	 */
+  std::atomic<bool> io;
 
 	/**
    * Initialize buffer frame for a new user
@@ -72,6 +87,7 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+		io = false;
   };
 
 	/**
@@ -80,22 +96,25 @@ class BufDesc {
 	 *
 	 * @param filePtr	File object
 	 * @param pageNum	Page number in the file
+	 * @param inIo	True if the page is yet to be read into the frame
 	 */
-  void Set(File* filePtr, PageId pageNum)
+  void Set(File* filePtr, PageId pageNum, bool inIo)
 	{ 
 		file = filePtr;
     pageNo = pageNum;
     pinCnt = 1;
     dirty = false;
+    io = inIo;
     valid = true;
     refbit = true;
   }
 
   void Print()
 	{
-		if(file != NULL)
+		File* filePtr = file;
+		if(filePtr != NULL)
 		{
-			std::cout << "file:" << file->filename() << " ";
+			std::cout << "file:" << filePtr->filename() << " ";
 			std::cout << "pageNo:" << pageNo << " ";
 		}
 		else
@@ -104,7 +123,8 @@ class BufDesc {
 		std::cout << "valid:" << valid << " ";
 		std::cout << "pinCnt:" << pinCnt << " ";
 		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "refbit:" << refbit << " ";
+		std::cout << "io:" << io << "\n";
   }
 
 	/**
@@ -125,17 +145,17 @@ struct BufStats
 	/**
    * Total number of accesses to buffer pool
 	 */
-  int accesses;
+  std::atomic<int> accesses;
 
 	/**
    * Number of pages read from disk (including allocs)
 	 */
-  int diskreads;
+  std::atomic<int> diskreads;
 
 	/**
    * Number of pages written back to disk
 	 */
-  int diskwrites;
+  std::atomic<int> diskwrites;
 
 	/**
    * Clear all values 
@@ -161,10 +181,21 @@ struct BufStats
 class BufMgr 
 {
  private:
+	/**
+   * A partition of the hash table mapping (File, page) to frame, and the latch guarding it.
+   * Partitions are padded apart so their latches do not share a cache line.
+	 */
+  struct BufPartition
+  {
+    std::mutex latch;
+    BufHashTbl *hashTable;
+    char padding[64];
+  };
+
 	/**
    * Current position of clockhand in our buffer pool
 	 */
-  FrameId clockHand;
+  std::atomic<FrameId> clockHand;
 
 	/**
    * Number of frames in the buffer pool
@@ -172,9 +203,17 @@ class BufMgr
   std::uint32_t numBufs;
 	
 	/**
-   * Hash table mapping (File, page) to frame
+   * Partitions of the hash table mapping (File, page) to frame. A page is mapped in the
+   * partition partitionOf() picks for it, and its frame is pinned, found or unmapped only
+   * under the latch of that partition. Disk reads and writes are done outside of the
+   * latches, with the io flag of the frame set.
+	 */
+  BufPartition *partitions;
+
+	/**
+   * Number of partitions of the hash table
 	 */
-  BufHashTbl *hashTable;
+  std::uint32_t numPartitions;
 
 	/**
    * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
@@ -187,7 +226,15 @@ class BufMgr
   BufStats bufStats;
 
 	/**
-	 * Allocate a free frame.  
+   * Partition of the hash table the page is mapped in.
+	 */
+  BufPartition &partitionOf(const File* file, const PageId pageNo)
+  {
+    return partitions[(((std::uintptr_t)file >> 4) * 31 + pageNo) % numPartitions];
+  }
+
+	/**
+	 * Allocate a free frame. The frame is returned pinned once and invalid, so no other thread takes it.
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
@@ -195,11 +242,24 @@ class BufMgr
   void allocBuf(FrameId & frame);
 
 	/**
+	 * Unmaps the page of a frame the caller has pinned once, writing it out first if it is dirty.
+	 *
+	 * @param frame   	Frame ID of the frame
+	 * @return False, with the page still mapped, if someone else pinned the frame meanwhile.
+	 */
+  bool evictFrame(const FrameId frame);
+
+	/**
+	 * Waits for a read or write of the page of a frame pinned by the caller to finish.
+	 */
+  void waitForIo(const FrameId frame);
+
+	/**
    * Advance clock to next frame in the buffer pool
 	 */
-  void advanceClock()
+  FrameId advanceClock()
   {
-		clockHand = (clockHand + 1) % numBufs;
+		return (clockHand.fetch_add(1) + 1) % numBufs;
   }
 
 
@@ -264,6 +324,7 @@ class BufMgr
 	/**
 	 * Delete page from file and also from buffer pool if present.
 	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 * The page should not be pinned, as its frame may be reused as soon as it is unmapped.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number
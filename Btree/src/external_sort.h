@@ -0,0 +1,477 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "buffer.h"
+#include "file.h"
+#include "filescan.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Layout of a page of a sorted run. Runs are temporary BlobFiles whose pages are
+ * cast to this structure, the same way index nodes are.
+ */
+template <class T>
+struct SortRunPage {
+  /**
+   * Number of entries that fit in one page.
+   */
+  static const int CAPACITY = (Page::SIZE - sizeof(int)) / sizeof(RIDKeyPair<T>);
+
+  /**
+   * Number of entries stored in the page.
+   */
+  int count;
+
+  /**
+   * Stores the entries, sorted.
+   */
+  RIDKeyPair<T> entries[CAPACITY];
+};
+
+/**
+ * @brief External merge sort of key-rid pairs on top of the buffer manager.
+ *
+ * Entries are collected in memory until the budget is used up, then sorted and spilled
+ * as a run into a temporary BlobFile through the buffer manager. Once all entries are
+ * added, runs are merged with a tournament (loser) tree until few enough are left to
+ * merge them all at once while the result is read with scanNext(). When all entries fit
+ * in memory nothing is written at all.
+ *
+ * The sort never holds more than maxFrames pages: run generation buffers maxFrames - 1
+ * pages of entries on the heap and spills through one frame, and every merge pins one
+ * frame per input run plus one for its output.
+ */
+template <class T>
+class ExternalSort {
+ public:
+  /**
+   * Constructs an empty sort.
+   *
+   * @param name        Prefix for the names of the temporary run files.
+   * @param bufMgrIn    Buffer manager the runs are written and read through.
+   * @param maxFrames   Number of page frames the sort may use, at least 3.
+   * @throws  BufferExceededException If maxFrames is less than 3.
+   */
+  ExternalSort(const std::string &name, BufMgr *bufMgrIn, const std::uint32_t maxFrames)
+      : namePrefix(name),
+        bufMgr(bufMgrIn),
+        fanIn(maxFrames - 1),
+        entryCount(0),
+        nextRunNo(0),
+        bufferPos(0) {
+    if (maxFrames < 3) {
+      throw BufferExceededException();
+    }
+    bufferCapacity = (maxFrames - 1) * SortRunPage<T>::CAPACITY;
+    buffer.reserve(bufferCapacity);
+  }
+
+  /**
+   * Removes all run files that are left.
+   */
+  ~ExternalSort() {
+    for (std::size_t i = 0; i < cursors.size(); i++) {
+      if (cursors[i].page != NULL) {
+        bufMgr->unPinPage(runs[cursors[i].run].file, cursors[i].pageNo, false);
+      }
+    }
+    for (std::size_t i = 0; i < runs.size(); i++) {
+      dropRun(runs[i]);
+    }
+  }
+
+  /**
+   * Adds an entry to the sort.
+   *
+   * @param entry   Key-rid pair to add.
+   */
+  void add(const RIDKeyPair<T> &entry) {
+    if (buffer.size() == bufferCapacity) {
+      spill();
+    }
+    buffer.push_back(entry);
+    entryCount++;
+  }
+
+  /**
+   * Adds the key-rid pair of every tuple of a relation, read with FileScan.
+   *
+   * @param relationName    Name of the relation file.
+   * @param attrByteOffset  Offset of the key inside the records.
+   */
+  void addRelation(const std::string &relationName, const int attrByteOffset) {
+    FileScan fileScan(relationName, bufMgr);
+    RecordId rid;
+    RIDKeyPair<T> entry;
+    try {
+      while (1) {
+        fileScan.scanNext(rid);
+        std::string record = fileScan.getRecord();
+        entry.set(rid, KeyTraits<T>::fromPointer(record.c_str() + attrByteOffset));
+        add(entry);
+      }
+    } catch (EndOfFileException e) {
+    }
+  }
+
+  /**
+   * Ends the input. Merges the spilled runs down to a number that can be merged in one
+   * pass and prepares that final merge for scanNext().
+   */
+  void sort() {
+    if (runs.empty()) {
+      std::sort(buffer.begin(), buffer.end());
+      return;
+    }
+    if (!buffer.empty()) {
+      spill();
+    }
+    std::vector<RIDKeyPair<T> >().swap(buffer);
+
+    while (runs.size() > fanIn) {
+      std::vector<SortRun> inputs(runs.begin(), runs.begin() + fanIn);
+      runs.erase(runs.begin(), runs.begin() + fanIn);
+      SortRun output = mergeRuns(inputs);
+      runs.push_back(output);
+    }
+    openCursors(runs);
+  }
+
+  /**
+   * Number of entries added to the sort.
+   */
+  int count() const { return entryCount; }
+
+  /**
+   * Returns the next entry in sorted order.
+   *
+   * @param outEntry    Next entry returned in this.
+   * @throws  EndOfFileException  If all entries have been returned.
+   */
+  void scanNext(RIDKeyPair<T> &outEntry) {
+    if (runs.empty()) {
+      if (bufferPos == buffer.size()) {
+        throw EndOfFileException();
+      }
+      outEntry = buffer[bufferPos++];
+      return;
+    }
+    if (!nextFromCursors(outEntry)) {
+      throw EndOfFileException();
+    }
+  }
+
+ private:
+  /**
+   * @brief A sorted run stored in a temporary file.
+   */
+  struct SortRun {
+    /**
+     * File holding the run; its pages are numbered 1 to pageCount in order.
+     */
+    File *file;
+
+    /**
+     * Name of the run file.
+     */
+    std::string name;
+
+    /**
+     * Number of pages in the run.
+     */
+    PageId pageCount;
+  };
+
+  /**
+   * @brief Read position inside a run during a merge.
+   */
+  struct RunCursor {
+    /**
+     * Index of the run in the runs being merged.
+     */
+    std::size_t run;
+
+    /**
+     * Page currently pinned, NULL once the run is exhausted.
+     */
+    SortRunPage<T> *page;
+
+    /**
+     * Page number of the pinned page.
+     */
+    PageId pageNo;
+
+    /**
+     * Index of the current entry in the pinned page.
+     */
+    int pos;
+  };
+
+  /**
+   * Creates a new, empty run file.
+   */
+  SortRun createRun() {
+    std::ostringstream runName;
+    runName << namePrefix << ".sort." << nextRunNo++;
+    SortRun run;
+    run.name = runName.str();
+    try {
+      File::remove(run.name);
+    } catch (FileNotFoundException e) {
+    }
+    run.file = new BlobFile(run.name, true);
+    run.pageCount = 0;
+    return run;
+  }
+
+  /**
+   * Closes and removes a run file.
+   */
+  void dropRun(SortRun &run) {
+    bufMgr->flushFile(run.file);
+    delete run.file;
+    File::remove(run.name);
+  }
+
+  /**
+   * Sorts the in-memory entries and writes them out as a new run.
+   */
+  void spill() {
+    std::sort(buffer.begin(), buffer.end());
+    SortRun run = createRun();
+    PageId pageNo = 0;
+    SortRunPage<T> *page = NULL;
+    for (std::size_t i = 0; i < buffer.size(); i++) {
+      appendToRun(run, pageNo, page, buffer[i]);
+    }
+    if (page != NULL) {
+      bufMgr->unPinPage(run.file, pageNo, true);
+    }
+    runs.push_back(run);
+    buffer.clear();
+  }
+
+  /**
+   * Appends an entry to the run being written, starting a new page when the current one
+   * is full.
+   */
+  void appendToRun(SortRun &run, PageId &pageNo, SortRunPage<T> *&page, const RIDKeyPair<T> &entry) {
+    if (page != NULL && page->count == SortRunPage<T>::CAPACITY) {
+      bufMgr->unPinPage(run.file, pageNo, true);
+      page = NULL;
+    }
+    if (page == NULL) {
+      Page *newPage;
+      bufMgr->allocPage(run.file, pageNo, newPage);
+      page = (SortRunPage<T> *)newPage;
+      page->count = 0;
+      run.pageCount++;
+    }
+    page->entries[page->count++] = entry;
+  }
+
+  /**
+   * Merges the given runs into one new run and removes them.
+   */
+  SortRun mergeRuns(std::vector<SortRun> &inputs) {
+    openCursors(inputs);
+    SortRun output = createRun();
+    PageId pageNo = 0;
+    SortRunPage<T> *page = NULL;
+    RIDKeyPair<T> entry;
+    while (nextFromCursors(entry)) {
+      appendToRun(output, pageNo, page, entry);
+    }
+    if (page != NULL) {
+      bufMgr->unPinPage(output.file, pageNo, true);
+    }
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+      dropRun(inputs[i]);
+    }
+    cursors.clear();
+    return output;
+  }
+
+  /**
+   * Pins the first page of every run and builds the tournament tree over them.
+   */
+  void openCursors(std::vector<SortRun> &inputs) {
+    merged = &inputs;
+    cursors.resize(inputs.size());
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+      cursors[i].run = i;
+      cursors[i].pageNo = 0;
+      cursors[i].page = NULL;
+      cursors[i].pos = 0;
+      advanceCursor(cursors[i]);
+    }
+
+    // every inner node of the tree starts empty, the first leaf to reach it waits there
+    loserTree.assign(inputs.size(), -1);
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+      int winner = i;
+      std::size_t node = (i + inputs.size()) / 2;
+      for (; node > 0; node /= 2) {
+        if (loserTree[node] == -1) {
+          loserTree[node] = winner;
+          break;
+        }
+        if (beats(loserTree[node], winner)) {
+          std::swap(loserTree[node], winner);
+        }
+      }
+      if (node == 0) {
+        loserTree[0] = winner;
+      }
+    }
+  }
+
+  /**
+   * Moves a cursor to the next entry of its run, reading the next page when the current one
+   * is used up. The page is NULL afterwards if the run has no entries left.
+   */
+  void advanceCursor(RunCursor &cursor) {
+    SortRun &run = (*merged)[cursor.run];
+    if (cursor.page != NULL) {
+      cursor.pos++;
+      if (cursor.pos < cursor.page->count) {
+        return;
+      }
+      bufMgr->unPinPage(run.file, cursor.pageNo, false);
+      cursor.page = NULL;
+    }
+    if (cursor.pageNo < run.pageCount) {
+      cursor.pageNo++;
+      Page *page;
+      bufMgr->readPage(run.file, cursor.pageNo, page);
+      cursor.page = (SortRunPage<T> *)page;
+      cursor.pos = 0;
+    }
+  }
+
+  /**
+   * True if the current entry of cursor a sorts before the one of cursor b. Exhausted
+   * cursors lose against everything; ties go to the lower cursor.
+   */
+  bool beats(const int a, const int b) const {
+    const RunCursor &ca = cursors[a];
+    const RunCursor &cb = cursors[b];
+    if (ca.page == NULL) {
+      return false;
+    }
+    if (cb.page == NULL) {
+      return true;
+    }
+    const RIDKeyPair<T> &ea = ca.page->entries[ca.pos];
+    const RIDKeyPair<T> &eb = cb.page->entries[cb.pos];
+    if (ea < eb) {
+      return true;
+    }
+    if (eb < ea) {
+      return false;
+    }
+    return a < b;
+  }
+
+  /**
+   * Takes the smallest entry off the merge and replays the tournament for its run.
+   *
+   * @return  False if all runs are exhausted.
+   */
+  bool nextFromCursors(RIDKeyPair<T> &outEntry) {
+    int winner = loserTree[0];
+    RunCursor &cursor = cursors[winner];
+    if (cursor.page == NULL) {
+      return false;
+    }
+    outEntry = cursor.page->entries[cursor.pos];
+    advanceCursor(cursor);
+
+    for (std::size_t node = (winner + cursors.size()) / 2; node > 0; node /= 2) {
+      if (beats(loserTree[node], winner)) {
+        std::swap(loserTree[node], winner);
+      }
+    }
+    loserTree[0] = winner;
+    return true;
+  }
+
+  /**
+   * Prefix of the run file names.
+   */
+  std::string namePrefix;
+
+  /**
+   * Buffer manager the runs go through.
+   */
+  BufMgr *bufMgr;
+
+  /**
+   * Most runs merged at once.
+   */
+  std::size_t fanIn;
+
+  /**
+   * Most entries kept in memory before they are spilled.
+   */
+  std::size_t bufferCapacity;
+
+  /**
+   * Number of entries added.
+   */
+  int entryCount;
+
+  /**
+   * Number given to the next run file.
+   */
+  int nextRunNo;
+
+  /**
+   * Entries not yet spilled; holds everything if nothing was spilled.
+   */
+  std::vector<RIDKeyPair<T> > buffer;
+
+  /**
+   * Next entry of buffer returned when nothing was spilled.
+   */
+  std::size_t bufferPos;
+
+  /**
+   * Runs written so far and not yet merged away.
+   */
+  std::vector<SortRun> runs;
+
+  /**
+   * Runs read by the current merge.
+   */
+  std::vector<SortRun> *merged;
+
+  /**
+   * One cursor per run of the current merge.
+   */
+  std::vector<RunCursor> cursors;
+
+  /**
+   * Tournament tree over the cursors. Entry 0 holds the winner, the others the loser of the
+   * match played at that node.
+   */
+  std::vector<int> loserTree;
+};
+
+}
@@ -11,6 +11,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
 
 #include "page.h"
 
@@ -68,7 +69,9 @@ struct FileHeader {
  * detects this (by looking in the open_streams_ map) and just returns a file object with
  * the already created stream for the file without actually opening the UNIX file again. 
  *
- * @warning This class is not threadsafe.
+ * Reading and writing pages and allocating and deleting them hold a latch shared
+ * by the File objects of the stream, so the buffer manager may do its disk I/O
+ * from several threads. Opening and closing files is not threadsafe.
  */
 
 
@@ -212,6 +215,7 @@ class File {
 
   typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string, std::shared_ptr<std::recursive_mutex> > LatchMap;
 
   /**
    * Streams for opened files.
@@ -223,6 +227,11 @@ class File {
    */
   static CountMap open_counts_;
 
+  /**
+   * Latches of the streams for opened files.
+   */
+  static LatchMap open_latches_;
+
   /**
    * Name of the file this object represents.
    */
@@ -233,6 +242,11 @@ class File {
    */
   std::shared_ptr<std::fstream> stream_;
 
+  /**
+   * Held while using the stream, which every seek and read or write moves.
+   */
+  std::shared_ptr<std::recursive_mutex> latch_;
+
   friend class FileIterator;
 };
 
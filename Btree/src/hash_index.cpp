@@ -0,0 +1,443 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "hash_index.h"
+#include "filescan.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/end_of_file_exception.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace badgerdb {
+
+static_assert(sizeof(HashIndexMetaInfo) <= Page::SIZE, "hash index meta info must fit in a page");
+static_assert(sizeof(HashBucket) <= Page::SIZE, "hash bucket must fit in a page");
+
+namespace {
+
+/**
+ * Bytes of a record id in an entry, without the padding of RecordId.
+ */
+const int RID_SIZE = sizeof(PageId) + sizeof(SlotId);
+
+/**
+ * Largest entry of any key type.
+ */
+const int MAX_ENTRY_SIZE = STRINGSIZE + RID_SIZE;
+
+void storeRid(char *out, const RecordId &rid) {
+  memcpy(out, &rid.page_number, sizeof(PageId));
+  memcpy(out + sizeof(PageId), &rid.slot_number, sizeof(SlotId));
+}
+
+RecordId loadRid(const char *in) {
+  RecordId rid;
+  memcpy(&rid.page_number, in, sizeof(PageId));
+  memcpy(&rid.slot_number, in + sizeof(PageId), sizeof(SlotId));
+  return rid;
+}
+
+/**
+ * Mask of the low depth bits of a hash.
+ */
+std::uint32_t lowBits(const int depth) { return ((std::uint32_t)1 << depth) - 1; }
+
+}
+
+HashIndex::HashIndex(const std::string &relationName, std::string &outIndexName, BufMgr *bufMgrIn,
+                     const int attrByteOffset, const Datatype attrType) {
+  bufMgr = bufMgrIn;
+  attributeType = attrType;
+  this->attrByteOffset = attrByteOffset;
+  switch (attrType) {
+    case INTEGER:
+      keySize = sizeof(int);
+      break;
+    case DOUBLE:
+      keySize = sizeof(double);
+      break;
+    case STRING:
+      keySize = STRINGSIZE;
+      break;
+    default:
+      throw BadIndexInfoException("hash indexes need INTEGER, DOUBLE or STRING keys");
+  }
+  entrySize = keySize + RID_SIZE;
+  bucketCapacity = sizeof(((HashBucket *)0)->entries) / entrySize;
+
+  // constructing index name
+  std::ostringstream idxStr;
+  idxStr << relationName << ".hash." << attrByteOffset;
+  outIndexName = idxStr.str();
+
+  try {
+    // open file
+    file = new BlobFile(outIndexName, false);
+    headerPageNum = file->getFirstPageNo();
+    Page *metaPage;
+    bufMgr->readPage(file, headerPageNum, metaPage);
+    HashIndexMetaInfo *metaInfo = (HashIndexMetaInfo *)metaPage;
+    if ((relationName != metaInfo->relationName) || (attributeType != metaInfo->attrType) ||
+        (attrByteOffset != metaInfo->attrByteOffset)) {
+      bufMgr->unPinPage(file, headerPageNum, false);
+      bufMgr->flushFile(file);
+      delete file;
+      throw BadIndexInfoException(outIndexName);
+    }
+    globalDepth = metaInfo->globalDepth;
+    freeListHead = metaInfo->freeListHead;
+    entryCount = metaInfo->entryCount;
+    int pages = ((1 << globalDepth) + DIRECTORY_SLOTS_PER_PAGE - 1) / DIRECTORY_SLOTS_PER_PAGE;
+    directoryPages.assign(metaInfo->directoryPages, metaInfo->directoryPages + pages);
+    bufMgr->unPinPage(file, headerPageNum, false);
+    loadDirectory();
+  }
+  // create new index file
+  catch (FileNotFoundException e) {
+    file = new BlobFile(outIndexName, true);
+    Page *metaPage;
+    bufMgr->allocPage(file, headerPageNum, metaPage);
+    HashIndexMetaInfo *metaInfo = (HashIndexMetaInfo *)metaPage;
+    strcpy(metaInfo->relationName, relationName.c_str());
+    metaInfo->attrByteOffset = attrByteOffset;
+    metaInfo->attrType = attributeType;
+    bufMgr->unPinPage(file, headerPageNum, true);
+
+    // a directory of one slot pointing to one empty bucket
+    globalDepth = 0;
+    freeListHead = 0;
+    entryCount = 0;
+    PageId pageNo;
+    Page *page;
+    bufMgr->allocPage(file, pageNo, page);
+    bufMgr->unPinPage(file, pageNo, true);
+    directoryPages.push_back(pageNo);
+    allocBucket(pageNo, page, 0);
+    bufMgr->unPinPage(file, pageNo, true);
+    directory.push_back(pageNo);
+    storeDirectory(0, 1, 1);
+    storeMetaInfo();
+
+    FileScan fileScan(relationName, bufMgr);
+    RecordId rid;
+    try {
+      while (1) {
+        fileScan.scanNext(rid);
+        std::string record = fileScan.getRecord();
+        insertEntry(record.c_str() + attrByteOffset, rid);
+      }
+    } catch (EndOfFileException e) {
+    }
+    storeMetaInfo();
+    bufMgr->flushFile(file);
+  }
+}
+
+HashIndex::~HashIndex() {
+  storeMetaInfo();
+  bufMgr->flushFile(file);
+  delete file;
+}
+
+void HashIndex::insertEntry(const void *key, const RecordId rid) {
+  char entry[MAX_ENTRY_SIZE];
+  normalizeKey(key, entry);
+  storeRid(entry + keySize, rid);
+  std::uint32_t hash = hashKey(entry);
+
+  latch.lockExclusive();
+  while (true) {
+    PageId bucketNo = directory[hash & lowBits(globalDepth)];
+    Page *page;
+    bufMgr->readPage(file, bucketNo, page);
+    HashBucket *bucket = (HashBucket *)page;
+    // a full bucket splits if some entry of it would leave, else its overflow chain takes the entry
+    std::uint32_t mask = lowBits(MAX_GLOBAL_DEPTH);
+    bool full = bucket->count == bucketCapacity;
+    int localDepth = bucket->localDepth;
+    bool separable = false;
+    if (full && localDepth < MAX_GLOBAL_DEPTH) {
+      PageId pageNo = bucketNo;
+      while (true) {
+        for (int i = 0; !separable && i < bucket->count; i++)
+          separable = (hash & mask) != (hashKey(bucket->entries + i * entrySize) & mask);
+        PageId nextNo = bucket->overflowPageNo;
+        bufMgr->unPinPage(file, pageNo, false);
+        pageNo = nextNo;
+        if (separable || pageNo == 0)
+          break;
+        bufMgr->readPage(file, pageNo, page);
+        bucket = (HashBucket *)page;
+      }
+    } else {
+      bufMgr->unPinPage(file, bucketNo, false);
+    }
+    if (!separable) {
+      appendEntry(bucketNo, entry);
+      break;
+    }
+    if (localDepth == globalDepth)
+      doubleDirectory();
+    splitBucket(hash & lowBits(globalDepth));
+  }
+  entryCount++;
+  latch.unlockExclusive();
+}
+
+void HashIndex::deleteEntry(const void *key, const RecordId rid) {
+  char entry[MAX_ENTRY_SIZE];
+  normalizeKey(key, entry);
+  storeRid(entry + keySize, rid);
+  std::uint32_t hash = hashKey(entry);
+
+  latch.lockExclusive();
+  PageId prevNo = 0;
+  PageId pageNo = directory[hash & lowBits(globalDepth)];
+  while (pageNo != 0) {
+    Page *page;
+    bufMgr->readPage(file, pageNo, page);
+    HashBucket *bucket = (HashBucket *)page;
+    PageId nextNo = bucket->overflowPageNo;
+    for (int i = 0; i < bucket->count; i++) {
+      char *found = bucket->entries + i * entrySize;
+      if (memcmp(found, entry, entrySize) != 0)
+        continue;
+      bucket->count--;
+      memmove(found, bucket->entries + bucket->count * entrySize, entrySize);
+      bool emptyOverflow = bucket->count == 0 && prevNo != 0;
+      bufMgr->unPinPage(file, pageNo, true);
+      // unlink an overflow page left empty from its chain
+      if (emptyOverflow) {
+        Page *prevPage;
+        bufMgr->readPage(file, prevNo, prevPage);
+        ((HashBucket *)prevPage)->overflowPageNo = nextNo;
+        bufMgr->unPinPage(file, prevNo, true);
+        freeBucket(pageNo);
+      }
+      entryCount--;
+      latch.unlockExclusive();
+      return;
+    }
+    bufMgr->unPinPage(file, pageNo, false);
+    prevNo = pageNo;
+    pageNo = nextNo;
+  }
+  latch.unlockExclusive();
+  throw NoSuchKeyFoundException();
+}
+
+std::uint32_t HashIndex::lookup(const void *key, std::vector<RecordId> &outRids) {
+  char normalized[STRINGSIZE];
+  normalizeKey(key, normalized);
+  std::uint32_t hash = hashKey(normalized);
+
+  latch.lockShared();
+  std::uint32_t found = 0;
+  PageId pageNo = directory[hash & lowBits(globalDepth)];
+  while (pageNo != 0) {
+    Page *page;
+    bufMgr->readPage(file, pageNo, page);
+    HashBucket *bucket = (HashBucket *)page;
+    for (int i = 0; i < bucket->count; i++) {
+      const char *entry = bucket->entries + i * entrySize;
+      if (memcmp(entry, normalized, keySize) == 0) {
+        outRids.push_back(loadRid(entry + keySize));
+        found++;
+      }
+    }
+    PageId nextNo = bucket->overflowPageNo;
+    bufMgr->unPinPage(file, pageNo, false);
+    pageNo = nextNo;
+  }
+  latch.unlockShared();
+  return found;
+}
+
+void HashIndex::normalizeKey(const void *key, char *out) const {
+  if (attributeType == STRING) {
+    memset(out, 0, STRINGSIZE);
+    strncpy(out, (const char *)key, STRINGSIZE);
+  } else if (attributeType == DOUBLE) {
+    // -0.0 equals 0.0 and must hash alike
+    double value = *(const double *)key;
+    if (value == 0)
+      value = 0;
+    memcpy(out, &value, sizeof(double));
+  } else {
+    memcpy(out, key, sizeof(int));
+  }
+}
+
+std::uint32_t HashIndex::hashKey(const char *key) const {
+  // FNV-1a, then the finalizer of MurmurHash3 so the low bits the directory uses are well mixed
+  std::uint32_t hash = 2166136261u;
+  for (int i = 0; i < keySize; i++) {
+    hash ^= (unsigned char)key[i];
+    hash *= 16777619u;
+  }
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+void HashIndex::loadDirectory() {
+  directory.resize((size_t)1 << globalDepth);
+  for (size_t i = 0; i < directoryPages.size(); i++) {
+    Page *page;
+    bufMgr->readPage(file, directoryPages[i], page);
+    size_t first = i * DIRECTORY_SLOTS_PER_PAGE;
+    size_t slots = std::min((size_t)DIRECTORY_SLOTS_PER_PAGE, directory.size() - first);
+    memcpy(&directory[first], page, slots * sizeof(PageId));
+    bufMgr->unPinPage(file, directoryPages[i], false);
+  }
+}
+
+void HashIndex::storeDirectory(const std::uint32_t first, const std::uint32_t end, const std::uint32_t step) {
+  Page *page = NULL;
+  std::uint32_t pageIndex = 0;
+  for (std::uint32_t slot = first; slot < end; slot += step) {
+    if (page == NULL || slot / DIRECTORY_SLOTS_PER_PAGE != pageIndex) {
+      if (page != NULL)
+        bufMgr->unPinPage(file, directoryPages[pageIndex], true);
+      pageIndex = slot / DIRECTORY_SLOTS_PER_PAGE;
+      bufMgr->readPage(file, directoryPages[pageIndex], page);
+    }
+    ((PageId *)page)[slot % DIRECTORY_SLOTS_PER_PAGE] = directory[slot];
+  }
+  if (page != NULL)
+    bufMgr->unPinPage(file, directoryPages[pageIndex], true);
+}
+
+void HashIndex::storeMetaInfo() {
+  Page *metaPage;
+  bufMgr->readPage(file, headerPageNum, metaPage);
+  HashIndexMetaInfo *metaInfo = (HashIndexMetaInfo *)metaPage;
+  metaInfo->globalDepth = globalDepth;
+  metaInfo->freeListHead = freeListHead;
+  metaInfo->entryCount = entryCount;
+  for (size_t i = 0; i < directoryPages.size(); i++)
+    metaInfo->directoryPages[i] = directoryPages[i];
+  bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+void HashIndex::allocBucket(PageId &pageNo, Page *&page, const int localDepth) {
+  if (freeListHead == 0) {
+    bufMgr->allocPage(file, pageNo, page);
+  } else {
+    pageNo = freeListHead;
+    bufMgr->readPage(file, pageNo, page);
+    freeListHead = ((HashBucket *)page)->overflowPageNo;
+    storeMetaInfo();
+  }
+  HashBucket *bucket = (HashBucket *)page;
+  bucket->localDepth = localDepth;
+  bucket->count = 0;
+  bucket->overflowPageNo = 0;
+}
+
+void HashIndex::freeBucket(const PageId pageNo) {
+  Page *page;
+  bufMgr->readPage(file, pageNo, page);
+  HashBucket *bucket = (HashBucket *)page;
+  bucket->count = 0;
+  bucket->overflowPageNo = freeListHead;
+  bufMgr->unPinPage(file, pageNo, true);
+  freeListHead = pageNo;
+  storeMetaInfo();
+}
+
+void HashIndex::appendEntry(const PageId bucketNo, const char *entry) {
+  PageId pageNo = bucketNo;
+  Page *page;
+  bufMgr->readPage(file, pageNo, page);
+  HashBucket *bucket = (HashBucket *)page;
+  while (bucket->count == bucketCapacity) {
+    PageId nextNo = bucket->overflowPageNo;
+    if (nextNo == 0) {
+      // the chain is full, add a page at its end
+      Page *nextPage;
+      allocBucket(nextNo, nextPage, bucket->localDepth);
+      bucket->overflowPageNo = nextNo;
+      bufMgr->unPinPage(file, pageNo, true);
+      page = nextPage;
+    } else {
+      bufMgr->unPinPage(file, pageNo, false);
+      bufMgr->readPage(file, nextNo, page);
+    }
+    pageNo = nextNo;
+    bucket = (HashBucket *)page;
+  }
+  memcpy(bucket->entries + bucket->count * entrySize, entry, entrySize);
+  bucket->count++;
+  bufMgr->unPinPage(file, pageNo, true);
+}
+
+void HashIndex::doubleDirectory() {
+  std::uint32_t size = directory.size();
+  directory.resize(2 * size);
+  std::copy(directory.begin(), directory.begin() + size, directory.begin() + size);
+  globalDepth++;
+  while (directoryPages.size() * DIRECTORY_SLOTS_PER_PAGE < directory.size()) {
+    PageId pageNo;
+    Page *page;
+    bufMgr->allocPage(file, pageNo, page);
+    bufMgr->unPinPage(file, pageNo, true);
+    directoryPages.push_back(pageNo);
+  }
+  storeDirectory(size, 2 * size, 1);
+  storeMetaInfo();
+}
+
+void HashIndex::splitBucket(const std::uint32_t slot) {
+  PageId bucketNo = directory[slot];
+  Page *page;
+  bufMgr->readPage(file, bucketNo, page);
+  HashBucket *bucket = (HashBucket *)page;
+  int localDepth = bucket->localDepth;
+
+  // take every entry out of the bucket, freeing its overflow chain
+  std::vector<char> entries(bucket->entries, bucket->entries + bucket->count * entrySize);
+  PageId pageNo = bucket->overflowPageNo;
+  bucket->localDepth = localDepth + 1;
+  bucket->count = 0;
+  bucket->overflowPageNo = 0;
+  bufMgr->unPinPage(file, bucketNo, true);
+  while (pageNo != 0) {
+    bufMgr->readPage(file, pageNo, page);
+    bucket = (HashBucket *)page;
+    entries.insert(entries.end(), bucket->entries, bucket->entries + bucket->count * entrySize);
+    PageId nextNo = bucket->overflowPageNo;
+    bufMgr->unPinPage(file, pageNo, false);
+    freeBucket(pageNo);
+    pageNo = nextNo;
+  }
+
+  // the slots of the bucket with bit localDepth set now point to the new bucket
+  PageId newNo;
+  Page *newPage;
+  allocBucket(newNo, newPage, localDepth + 1);
+  bufMgr->unPinPage(file, newNo, true);
+  std::uint32_t first = (slot & lowBits(localDepth)) | ((std::uint32_t)1 << localDepth);
+  std::uint32_t step = (std::uint32_t)1 << (localDepth + 1);
+  for (std::uint32_t i = first; i < directory.size(); i += step)
+    directory[i] = newNo;
+  storeDirectory(first, directory.size(), step);
+
+  for (size_t i = 0; i < entries.size(); i += entrySize) {
+    const char *entry = &entries[i];
+    appendEntry((hashKey(entry) >> localDepth) & 1 ? newNo : bucketNo, entry);
+  }
+}
+
+}
@@ -0,0 +1,300 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "btree.h"
+#include "node_latch.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Most bits of the hash of a key a hash index directory is indexed on.
+ */
+const int MAX_GLOBAL_DEPTH = 20;
+
+/**
+ * @brief Directory slots held by a directory page.
+ */
+const int DIRECTORY_SLOTS_PER_PAGE = Page::SIZE / sizeof(PageId);
+
+/**
+ * @brief Most directory pages a hash index has, enough for a directory of MAX_GLOBAL_DEPTH bits.
+ */
+const int MAX_DIRECTORY_PAGES = (1 << MAX_GLOBAL_DEPTH) / DIRECTORY_SLOTS_PER_PAGE;
+
+/**
+ * @brief The meta page, which holds metadata for the hash index, is always the first page of the index file.
+ */
+struct HashIndexMetaInfo {
+  /**
+   * Name of base relation.
+   */
+  char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored in pages.
+   */
+  int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+  Datatype attrType;
+
+  /**
+   * Number of bits of the hash of a key the directory is indexed on.
+   */
+  int globalDepth;
+
+  /**
+   * Page number of the first page on the free list, 0 if the list is empty.
+   */
+  PageId freeListHead;
+
+  /**
+   * Number of entries in the index, as of the last time it was closed.
+   */
+  std::uint64_t entryCount;
+
+  /**
+   * Pages holding the directory, in slot order. Only the first ones up to the size of the directory are used.
+   */
+  PageId directoryPages[MAX_DIRECTORY_PAGES];
+};
+
+/**
+ * @brief Page of a bucket, or of the overflow chain of one. Entries are keys of the size of the key
+ * type, strings padded with zeros, each followed by the record id of its record.
+ */
+struct HashBucket {
+  /**
+   * Number of bits of the hash the keys of the bucket have in common, on the first page of the bucket.
+   */
+  int localDepth;
+
+  /**
+   * Number of entries on this page.
+   */
+  int count;
+
+  /**
+   * Next page of the overflow chain, 0 on the last page. Next page of the free list for a free page.
+   */
+  PageId overflowPageNo;
+
+  /**
+   * Entries of this page.
+   */
+  char entries[Page::SIZE - 2 * sizeof(int) - sizeof(PageId)];
+};
+
+/**
+ * @brief Extendible hash index on a single attribute, for equality lookups only.
+ *
+ * A directory of 2^globalDepth slots, indexed on the low bits of the hash of a key, points to bucket
+ * pages; a bucket of local depth d is pointed to by every slot sharing its low d bits. When a full bucket
+ * takes an entry it splits in two on its next bit, and only when its local depth is the global depth does the
+ * directory double first, by copying itself: the index grows a bucket at a time and is never rehashed
+ * as a whole. Entries whose hashes agree on every bit the directory may use, which splitting cannot
+ * separate, such as the duplicates of one key, go on an overflow chain of pages behind the bucket.
+ *
+ * The directory is kept in memory and in directory pages of the file, so a lookup reads the one page
+ * of its bucket, and its overflow chain if there is one. Buckets are not merged when entries are deleted;
+ * overflow pages left empty go on a free list of the file and are reused.
+ *
+ * Lookups may run concurrently with each other; insertEntry() and deleteEntry() run one at a time and
+ * exclude lookups.
+ */
+class HashIndex {
+ public:
+  /**
+   * Opens the index of the attribute of the relation, or builds it by inserting every record of the
+   * relation if the file does not exist yet. The index file is named relationName.hash.attrByteOffset.
+   * @param relationName   Name of file.
+   * @param outIndexName   Return the name of index file.
+   * @param bufMgrIn       Buffer Manager Instance
+   * @param attrByteOffset Offset of attribute, over which index is to be built, in the record
+   * @param attrType       Datatype of attribute over which index is built
+   * @throws BadIndexInfoException If the index file exists and its meta page disagrees with the arguments
+   */
+  HashIndex(const std::string &relationName, std::string &outIndexName, BufMgr *bufMgrIn, const int attrByteOffset,
+            const Datatype attrType);
+
+  /**
+   * Writes the meta page, flushes the index file and closes it.
+   */
+  ~HashIndex();
+
+  /**
+   * Insert a new entry using the pair <value,rid>.
+   * @param key Key to insert, pointer to integer/double/char string
+   * @param rid Record ID of a record whose entry is getting inserted into the index.
+   */
+  void insertEntry(const void *key, const RecordId rid);
+
+  /**
+   * Delete the entry <value,rid>. The last entry of its page takes its place.
+   * @param key Key to delete, pointer to integer/double/char string
+   * @param rid Record ID of the record whose entry is getting deleted.
+   * @throws NoSuchKeyFoundException If the index has no entry with this key and record ID.
+   */
+  void deleteEntry(const void *key, const RecordId rid);
+
+  /**
+   * Find the record ids of every entry with the key, reading its bucket and the overflow chain of the
+   * bucket. Finding no entry is not an error.
+   * @param key     Key to look up, pointer to integer/double/char string
+   * @param outRids The record ids found are appended to this, in no particular order.
+   * @return Number of record ids found.
+   */
+  std::uint32_t lookup(const void *key, std::vector<RecordId> &outRids);
+
+  /**
+   * Number of bits of the hash of a key the directory is indexed on.
+   */
+  int getGlobalDepth() const { return globalDepth; }
+
+  /**
+   * Number of entries in the index.
+   */
+  std::uint64_t getEntryCount() const { return entryCount; }
+
+ private:
+  /**
+   * Copies the key into a key of keySize bytes as the bucket pages hold it.
+   */
+  void normalizeKey(const void *key, char *out) const;
+
+  /**
+   * Hash of a key as normalizeKey() returns it.
+   */
+  std::uint32_t hashKey(const char *key) const;
+
+  /**
+   * Reads the directory from the directory pages.
+   */
+  void loadDirectory();
+
+  /**
+   * Writes the directory slots from first up to end, step apart, to the directory pages.
+   */
+  void storeDirectory(const std::uint32_t first, const std::uint32_t end, const std::uint32_t step);
+
+  /**
+   * Writes the global depth, the directory pages and the head of the free list to the meta page.
+   */
+  void storeMetaInfo();
+
+  /**
+   * Allocates a page of a bucket or overflow chain, from the free list if it is not empty. The page is
+   * returned pinned and empty, with local depth localDepth.
+   */
+  void allocBucket(PageId &pageNo, Page *&page, const int localDepth);
+
+  /**
+   * Puts an unpinned overflow page on the free list.
+   */
+  void freeBucket(const PageId pageNo);
+
+  /**
+   * Adds the entry to the first page of the bucket with room for it, adding a page to its overflow
+   * chain if there is none.
+   */
+  void appendEntry(const PageId bucketNo, const char *entry);
+
+  /**
+   * Doubles the directory, each new slot pointing to the bucket its lower half counterpart points to.
+   */
+  void doubleDirectory();
+
+  /**
+   * Splits the bucket pointed to by the slot on its next bit into itself and a new bucket, moving the
+   * entries of its overflow chain along.
+   */
+  void splitBucket(const std::uint32_t slot);
+
+  /**
+   * File object for the index file.
+   */
+  File *file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+  BufMgr *bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+  PageId headerPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+  Datatype attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records.
+   */
+  int attrByteOffset;
+
+  /**
+   * Bytes of a key on a bucket page.
+   */
+  int keySize;
+
+  /**
+   * Bytes of an entry on a bucket page, the key followed by a record id.
+   */
+  int entrySize;
+
+  /**
+   * Entries a bucket page holds.
+   */
+  int bucketCapacity;
+
+  /**
+   * Number of bits of the hash of a key the directory is indexed on.
+   */
+  int globalDepth;
+
+  /**
+   * Bucket page of each slot of the directory.
+   */
+  std::vector<PageId> directory;
+
+  /**
+   * Pages holding the directory, in slot order.
+   */
+  std::vector<PageId> directoryPages;
+
+  /**
+   * Page number of the first page on the free list, 0 if the list is empty.
+   */
+  PageId freeListHead;
+
+  /**
+   * Number of entries in the index.
+   */
+  std::uint64_t entryCount;
+
+  /**
+   * Held shared by lookups and exclusively by inserts and deletes.
+   */
+  SharedLatch latch;
+};
+
+}
@@ -6,9 +6,17 @@
  */
 
 #include <vector>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <thread>
 #include "btree.h"
+#include "node_search.h"
+#include "bit_pack.h"
 #include "page.h"
 #include "filescan.h"
+#include "bitmap_heap_scan.h"
+#include "hash_index.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
 #include "exceptions/insufficient_space_exception.h"
@@ -19,6 +27,7 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_index_info_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -60,6 +69,18 @@ std::string dbRecord1;
 
 BufMgr * bufMgr = new BufMgr(100);
 
+// Keys first, first + step, ... up to last handled by one thread of test_concurrent, and the
+// operations on them that went wrong
+struct ConcurrentWork
+{
+    BTreeIndex *index;
+    const std::vector<RecordId> *rids;
+    int first;
+    int last;
+    int step;
+    int errors;
+};
+
 // -----------------------------------------------------------------------------
 // Forward declarations
 // -----------------------------------------------------------------------------
@@ -71,8 +92,22 @@ void randomlyCreateRelationInSize(int size);
 void forwardCreateRelationInSize(int size);
 void backwardCreateRelationInSize(int size);
 void forwardCreateRelationInRange(int left, int right);
+void duplicateCreateRelationInSize(int size, int distinct);
+void compositeCreateRelationInSize(int size, int distinct);
+void squaresCreateRelationInSize(int size, int repeats);
 void intTests();
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void doubleTests();
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
+void stringTests();
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int scanCount(BTreeIndex *index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp);
+int bitmapRecords(BitmapHeapScan &heapScan, int lowVal, int highVal);
+bool estimateClose(BTreeIndex *index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp, double tolerance);
+int coveredMatches(BTreeIndex *index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp);
+int compositeMatches(BTreeIndex *index, const CompositeKey &low, Operator lowOp, const CompositeKey &high, Operator highOp,
+                     int i, double lowD, double highD);
+int intKeys(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, ScanDirection direction, std::vector<int> &keys);
 void indexTests();
 void  test_type(int num);
 void test_size_10000();
@@ -81,6 +116,42 @@ void test_no_split();
 void test_huge_num();
 void test_range();
 void test_split();
+void test_bulk_load(double fillFactor);
+void test_external_sort();
+void test_node_search();
+void test_inner_split();
+void test_page_accounting();
+void test_string_keys();
+void test_delete();
+void test_cursors();
+void test_scan_batch();
+void test_reverse_scan();
+void test_lookup();
+void test_concurrent();
+void concurrentInserts(ConcurrentWork *work);
+void concurrentDeletes(ConcurrentWork *work);
+void concurrentLookups(ConcurrentWork *work);
+void test_concurrent_scans();
+void concurrentChurn(ConcurrentWork *work);
+void concurrentScans(ConcurrentWork *work);
+void coveringChurn(ConcurrentWork *work);
+void coveringLookups(ConcurrentWork *work);
+void test_blink();
+void concurrentStringInserts(ConcurrentWork *work);
+void test_posting_lists();
+void test_packed_leaves();
+void test_appends();
+void test_pinned_upper_levels();
+void test_composite_keys();
+void test_covering_indexes();
+void test_count_range();
+void test_bitmap_heap_scan();
+void test_statistics();
+void test_hash_index();
+void test_learned_lookup();
+bool ridBefore(const RecordId &r1, const RecordId &r2);
+int indexFilePages();
+void insertRelationInRange(BTreeIndex *index, int left, int right);
 void test1();
 void test2();
 void test3();
@@ -89,13 +160,39 @@ void test5();
 void test6();
 void test7();
 void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+void test30();
+void test31();
+void test32();
+void test33();
+void test34();
 void errorTests();
 void deleteRelation();
 
 int main(int argc, char **argv)
 {
 	
-  std::cout << "leaf size:" << INTARRAYLEAFSIZE << " non-leaf size:" << INTARRAYNONLEAFSIZE << std::endl;
+  std::cout << "leaf size:" << LeafNodeInt::CAPACITY << " non-leaf size:" << NonLeafNodeInt::CAPACITY << std::endl;
 
   // Clean up from any previous runs that crashed.
   try
@@ -169,6 +266,58 @@ int main(int argc, char **argv)
 	std::cout << "Finish Test Seven" << std::endl;
 	test8();
 	std::cout << "Finish Test Eight" << std::endl;
+	test9();
+	std::cout << "Finish Test Nine" << std::endl;
+	test10();
+	std::cout << "Finish Test Ten" << std::endl;
+	test11();
+	std::cout << "Finish Test Eleven" << std::endl;
+	test12();
+	std::cout << "Finish Test Twelve" << std::endl;
+	test13();
+	std::cout << "Finish Test Thirteen" << std::endl;
+	test14();
+	std::cout << "Finish Test Fourteen" << std::endl;
+	test15();
+	std::cout << "Finish Test Fifteen" << std::endl;
+	test16();
+	std::cout << "Finish Test Sixteen" << std::endl;
+	test17();
+	std::cout << "Finish Test Seventeen" << std::endl;
+	test18();
+	std::cout << "Finish Test Eighteen" << std::endl;
+	test19();
+	std::cout << "Finish Test Nineteen" << std::endl;
+	test20();
+	std::cout << "Finish Test Twenty" << std::endl;
+	test21();
+	std::cout << "Finish Test Twenty One" << std::endl;
+	test22();
+	std::cout << "Finish Test Twenty Two" << std::endl;
+	test23();
+	std::cout << "Finish Test Twenty Three" << std::endl;
+	test24();
+	std::cout << "Finish Test Twenty Four" << std::endl;
+	test25();
+	std::cout << "Finish Test Twenty Five" << std::endl;
+	test26();
+	std::cout << "Finish Test Twenty Six" << std::endl;
+	test27();
+	std::cout << "Finish Test Twenty Seven" << std::endl;
+	test28();
+	std::cout << "Finish Test Twenty Eight" << std::endl;
+	test29();
+	std::cout << "Finish Test Twenty Nine" << std::endl;
+	test30();
+	std::cout << "Finish Test Thirty" << std::endl;
+	test31();
+	std::cout << "Finish Test Thirty One" << std::endl;
+	test32();
+	std::cout << "Finish Test Thirty Two" << std::endl;
+	test33();
+	std::cout << "Finish Test Thirty Three" << std::endl;
+	test34();
+	std::cout << "Finish Test Thirty Four" << std::endl;
 	errorTests();
 	std::cout << "Finish Error Test" << std::endl;
 
@@ -258,6 +407,273 @@ void test8()
      test_type(8);
     deleteRelation();
 }
+void test9()
+{
+    // Bulk load a relation in random order into full leaves, then insert
+    // entries below and above the loaded keys
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for bulk loading with full nodes" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(9);
+    deleteRelation();
+}
+void test10()
+{
+    // Bulk load a relation in random order into half full nodes, then insert
+    // entries below and above the loaded keys
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for bulk loading with half full nodes" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(10);
+    deleteRelation();
+}
+void test11()
+{
+    // Create a relation with tuples valued 0 to the given number in random order
+    // and build its index with a sort that has to spill and merge several times
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for building an index with an external sort" << std::endl;
+    randomlyCreateRelationInSize(20000);
+     test_type(11);
+    deleteRelation();
+}
+void test12()
+{
+    // Create a relation with tuples valued 0 to the given number in random order,
+    // check the node search kernels and scan a key duplicated over several leaves
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for searching nodes with binary and SIMD kernels" << std::endl;
+    randomlyCreateRelationInSize(5000);
+     test_type(12);
+    deleteRelation();
+}
+void test13()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and
+    // insert enough entries into its index for the splits to reach the root
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for splitting non-leaf nodes on insert" << std::endl;
+    randomlyCreateRelationInSize(1000);
+     test_type(13);
+    deleteRelation();
+}
+void test14()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and
+    // check that the index file only grows by the nodes its splits add
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for accounting the pages of the index file" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(14);
+    deleteRelation();
+}
+void test15()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and
+    // index whole strings, then insert long keys sharing a prefix
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for string keys with prefix compression" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(15);
+    deleteRelation();
+}
+void test16()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and
+    // delete their entries until the tree shrinks back to a single leaf
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for deleting entries" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(16);
+    deleteRelation();
+}
+void test17()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and
+    // run several scans on one index at once
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for concurrent scan cursors" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(17);
+    deleteRelation();
+}
+void test18()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and
+    // scan it a leaf at a time
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for batched scans" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(18);
+    deleteRelation();
+}
+void test19()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and
+    // scan it in decreasing key order while leaves split and merge
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for descending scans" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(19);
+    deleteRelation();
+}
+void test20()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and
+    // look keys up without a scan
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for point lookups" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(20);
+    deleteRelation();
+}
+void test21()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and
+    // insert, delete and look keys up from several threads at once
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for concurrent inserts, deletes and lookups" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(21);
+    deleteRelation();
+}
+void test22()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and
+    // split nodes from many threads at once
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for concurrent splits" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(22);
+    deleteRelation();
+}
+void test23()
+{
+    // Create a relation whose tuples repeat ten values and compare indexes storing posting
+    // lists with indexes storing a key per record
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for posting lists" << std::endl;
+    duplicateCreateRelationInSize(40000, 10);
+     test_type(23);
+    deleteRelation();
+}
+void test24()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and compare
+    // an index with packed leaves with a plain one
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for packed leaves" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(24);
+    deleteRelation();
+}
+void test25()
+{
+    // Create a relation with tuples valued 0 to the given number in order and append to
+    // its index
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for appends" << std::endl;
+    forwardCreateRelationInSize(10000);
+     test_type(25);
+    deleteRelation();
+}
+void test26()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and index
+    // it with the upper levels of the tree pinned
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for pinned upper levels" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(26);
+    deleteRelation();
+}
+
+void test27()
+{
+    // Create a relation whose tuples repeat ten values of i, each with its own values of d,
+    // and index it on (i, d)
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for composite keys" << std::endl;
+    compositeCreateRelationInSize(10000, 10);
+     test_type(27);
+    deleteRelation();
+}
+
+void test28()
+{
+    // Create the relation of test 27 and index it on i, including d and s in the entries
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for covering indexes" << std::endl;
+    compositeCreateRelationInSize(10000, 10);
+     test_type(28);
+    deleteRelation();
+}
+
+void test29()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and count
+    // ranges of an index on it without scanning them
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for counting ranges" << std::endl;
+    randomlyCreateRelationInSize(20000);
+     test_type(29);
+    deleteRelation();
+}
+
+void test30()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and fetch
+    // the records of ranges of an index on it page by page
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for bitmap heap scans" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(30);
+    deleteRelation();
+}
+
+void test31()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and estimate
+    // ranges of indexes on it from their statistics
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for index statistics" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(31);
+    deleteRelation();
+}
+
+void test32()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and test a
+    // hash index on it
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for hash indexes" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(32);
+    deleteRelation();
+}
+
+void test33()
+{
+    // Create a relation with tuples valued with the squares of 0 to the given number, each
+    // repeated, and test learned lookups on it
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for learned lookups" << std::endl;
+    squaresCreateRelationInSize(30000, 3);
+     test_type(33);
+    deleteRelation();
+}
+
+void test34()
+{
+    // Create a relation with tuples valued 0 to the given number in random order and scan
+    // it from several threads while others insert and delete entries in the range scanned
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for scans concurrent with inserts and deletes" << std::endl;
+    randomlyCreateRelationInSize(10000);
+     test_type(34);
+    deleteRelation();
+}
 void  test_type(int num)
 {
     if(testNum == 1)
@@ -280,6 +696,84 @@ void  test_type(int num)
             case 8:
                 test_split();
                 break;
+            case 9:
+                test_bulk_load(1.0);
+                break;
+            case 10:
+                test_bulk_load(0.5);
+                break;
+            case 11:
+                test_external_sort();
+                break;
+            case 12:
+                test_node_search();
+                break;
+            case 13:
+                test_inner_split();
+                break;
+            case 14:
+                test_page_accounting();
+                break;
+            case 15:
+                test_string_keys();
+                break;
+            case 16:
+                test_delete();
+                break;
+            case 17:
+                test_cursors();
+                break;
+            case 18:
+                test_scan_batch();
+                break;
+            case 19:
+                test_reverse_scan();
+                break;
+            case 20:
+                test_lookup();
+                break;
+            case 21:
+                test_concurrent();
+                break;
+            case 22:
+                test_blink();
+                break;
+            case 23:
+                test_posting_lists();
+                break;
+            case 24:
+                test_packed_leaves();
+                break;
+            case 25:
+                test_appends();
+                break;
+            case 26:
+                test_pinned_upper_levels();
+                break;
+            case 27:
+                test_composite_keys();
+                break;
+            case 28:
+                test_covering_indexes();
+                break;
+            case 29:
+                test_count_range();
+                break;
+            case 30:
+                test_bitmap_heap_scan();
+                break;
+            case 31:
+                test_statistics();
+                break;
+            case 32:
+                test_hash_index();
+                break;
+            case 33:
+                test_learned_lookup();
+                break;
+            case 34:
+                test_concurrent_scans();
+                break;
             default:
                 break;
         }
@@ -290,85 +784,2194 @@ void  test_type(int num)
         catch(FileNotFoundException e)
         {
         }
+        try
+        {
+            File::remove(stringIndexName);
+        }
+        catch(FileNotFoundException e)
+        {
+        }
+    }
+}
+
+
+void test_size_10000()
+{
+    // Test for the given size 10000
+    std::cout << "----- test_size_10000 -----" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    checkPassFail(intScan(&index,25,GT,40,LT), 14)
+    checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+    checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+    checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+    checkPassFail(intScan(&index,0,GT,1,LT), 0)
+    checkPassFail(intScan(&index,300,GT,400,LT), 99)
+    checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+}
+
+void test_no_split()
+{
+    // Test for a small given size, for which the root will not split
+    std::cout << "---------- test_no_split ---------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    checkPassFail(intScan(&index,25,GT,40,LT), 14)
+    checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+    checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+    checkPassFail(intScan(&index,200,GTE,250,LTE), 51)
+    checkPassFail(intScan(&index,0,GT,1,LT), 0)
+    checkPassFail(intScan(&index,300,GT,400,LT), 0)
+    checkPassFail(intScan(&index,3000,GTE,4000,LT), 0)
+}
+void test_huge_num()
+{
+    // Test for huge data
+    std::cout << "---------- testHugeNum ---------- " << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    checkPassFail(intScan(&index,25,GT,40,LT), 14)
+    checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+    checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+    checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+    checkPassFail(intScan(&index,0,GT,1,LT), 0)
+    checkPassFail(intScan(&index,300,GT,400,LT), 99)
+    checkPassFail(intScan(&index,0,GTE, 1000000,LT), 1000000)
+}
+
+void test_range()
+{
+    // Test for given a range for creating relation
+    std::cout << "----------- test_range -----------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    checkPassFail(intScan(&index,25,GT,40,LT), 14)
+    checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+    checkPassFail(intScan(&index,-3,GT,3,LT), 5)
+    checkPassFail(intScan(&index,-300,GTE,300,LTE), 601)
+    checkPassFail(intScan(&index,0,GT,1,LT), 0)
+    checkPassFail(intScan(&index,300,GT,400,LT), 99)
+    checkPassFail(intScan(&index,-1,GTE,0,LT), 1)
+}
+void test_split()
+{
+    // Test for the root just split
+    std::cout << "----------- test_range -----------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    checkPassFail(intScan(&index,430,GTE,432,LTE), 3)
+    checkPassFail(intScan(&index,431,GT,432,LTE), 1)
+    checkPassFail(intScan(&index,0,GT,432,LTE), 432)
+}
+void test_bulk_load(double fillFactor)
+{
+    // Test for a bulk loaded tree and inserts into it afterwards
+    std::cout << "--------- test_bulk_load ---------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, fillFactor);
+
+    checkPassFail(intScan(&index,25,GT,40,LT), 14)
+    checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+    checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+    checkPassFail(intScan(&index,0,GTE,10000,LT), 10000)
+
+    insertRelationInRange(&index, -1000, -1);
+    insertRelationInRange(&index, 10000, 10999);
+
+    checkPassFail(intScan(&index,-3,GT,3,LT), 5)
+    checkPassFail(intScan(&index,-1000,GTE,-990,LT), 10)
+    checkPassFail(intScan(&index,9990,GTE,10010,LT), 20)
+    checkPassFail(intScan(&index,-1000,GTE,11000,LT), 12000)
+}
+
+void test_external_sort()
+{
+    // Test for an index built with a sort limited to 3 frames
+    std::cout << "------- test_external_sort -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1.0, 3);
+
+    checkPassFail(intScan(&index,25,GT,40,LT), 14)
+    checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+    checkPassFail(intScan(&index,19990,GTE,20000,LT), 10)
+    checkPassFail(intScan(&index,0,GTE,20000,LT), 20000)
+    checkPassFail(File::exists(intIndexName + ".sort.0"), false)
+}
+
+void test_node_search()
+{
+    // Test that every kernel agrees with the standard library on sorted arrays
+    // with duplicates, then scan a key whose duplicates straddle several leaves
+    std::cout << "------- test_node_search -------" << std::endl;
+    std::cout << "node search implementation: " << NodeSearch::implementationName() << std::endl;
+    std::vector<int> keys;
+    bool agree = true;
+    for(int count = 0; count <= NonLeafNodeInt::CAPACITY; count += 1 + count / 8)
+    {
+        keys.clear();
+        for(int i = 0; i < count; i++)
+            keys.push_back(i / 3 * 2);
+        const int *data = keys.empty() ? NULL : &keys[0];
+        for(int key = -1; key <= count; key++)
+        {
+            int lower = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+            int upper = std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+            agree = agree &&
+                NodeSearch::lowerBoundBinary(data, count, key) == lower &&
+                NodeSearch::upperBoundBinary(data, count, key) == upper &&
+                NodeSearch::lowerBoundSse(data, count, key) == lower &&
+                NodeSearch::upperBoundSse(data, count, key) == upper &&
+                NodeSearch::lowerBound(data, count, key) == lower &&
+                NodeSearch::upperBound(data, count, key) == upper;
+            if(NodeSearch::hasAvx2())
+                agree = agree &&
+                    NodeSearch::lowerBoundAvx2(data, count, key) == lower &&
+                    NodeSearch::upperBoundAvx2(data, count, key) == upper;
+        }
+    }
+    checkPassFail(agree, true)
+
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    for(int i = 0; i < 2 * LeafNodeInt::CAPACITY; i++)
+        insertRelationInRange(&index, 2500, 2500);
+
+    checkPassFail(intScan(&index,2500,GTE,2500,LTE), 2 * LeafNodeInt::CAPACITY + 1)
+    checkPassFail(intScan(&index,2499,GT,2500,LTE), 2 * LeafNodeInt::CAPACITY + 1)
+    checkPassFail(intScan(&index,2500,GT,2510,LT), 9)
+    checkPassFail(intScan(&index,2490,GTE,2500,LT), 10)
+    checkPassFail(intScan(&index,0,GTE,5000,LT), 5000 + 2 * LeafNodeInt::CAPACITY)
+}
+
+void test_inner_split()
+{
+    // Test for inserts splitting the root after it has become a non-leaf node. Every
+    // inserted entry points at the record of key 0, scans only count them.
+    std::cout << "------- test_inner_split -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    int lowVal = 0;
+    RecordId zeroRid;
+    index.startScan(&lowVal, GTE, &lowVal, LTE);
+    index.scanNext(zeroRid);
+    index.endScan();
+
+    // ascending inserts leave half full leaves, so this is more leaves than a root holds
+    int count = NonLeafNodeInt::CAPACITY * LeafNodeInt::CAPACITY / 2 + 20000;
+    for(int i = 1000; i < 1000 + count; i++)
+        index.insertEntry(&i, zeroRid);
+    for(int i = -1; i >= -20000; i--)
+        index.insertEntry(&i, zeroRid);
+
+    checkPassFail(intScan(&index,0,GTE,1000,LT), 1000)
+    checkPassFail(intScan(&index,-20000,GTE,0,LT), 20000)
+    checkPassFail(intScan(&index,999,GT,1000 + count,LT), count)
+    checkPassFail(intScan(&index,900 + count,GTE,1000 + count,LT), 100)
+    checkPassFail(intScan(&index,-20001,GT,1000 + count,LTE), count + 21000)
+}
+
+void test_page_accounting()
+{
+    // Test that the index file holds the meta page and the nodes of the tree and nothing
+    // else, after bulk loading and after many leaf splits
+    std::cout << "------- test_page_accounting -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail(indexFilePages(), (int)index.getNodeCount() + 1)
+
+    int nodesBefore = index.getNodeCount();
+    insertRelationInRange(&index, 10000, 59999);
+    insertRelationInRange(&index, -20000, -1);
+    checkPassFail(intScan(&index,-20000,GTE,60000,LT), 80000)
+    checkPassFail(indexFilePages(), (int)index.getNodeCount() + 1)
+    checkPassFail(((int)index.getNodeCount() > nodesBefore), true)
+}
+
+void test_string_keys()
+{
+    // Test that STRING keys are whole strings and that slotted nodes with a shared prefix
+    // hold more keys than fixed STRINGSIZE slots would
+    std::cout << "------- test_string_keys -------" << std::endl;
+    BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+    checkPassFail(stringScan(&index,42,GTE,42,LTE), 1)
+    checkPassFail(stringScan(&index,0,GTE,9999,LTE), 10000)
+    checkPassFail(((int)index.getNodeCount() < 10000 / LeafNode<StringKey>::CAPACITY), true)
+
+    char key[STRINGSIZE + 1];
+    char highKey[STRINGSIZE + 1];
+    sprintf(key, "%05d string record", 0);
+    RecordId zeroRid;
+    index.startScan(key, GTE, key, LTE);
+    index.scanNext(zeroRid);
+    index.endScan();
+
+    // keys differing only after their first 44 characters, inserted out of order
+    for(int i = 0; i < 20000; i++)
+    {
+        sprintf(key, "a prefix shared by all of the inserted keys %06d", (i * 7919) % 20000);
+        index.insertEntry(key, zeroRid);
+    }
+    sprintf(key, "a prefix shared by all of the inserted keys %06d", 1000);
+    sprintf(highKey, "a prefix shared by all of the inserted keys %06d", 2000);
+    checkPassFail(scanCount(&index, key, GTE, highKey, LT), 1000)
+    sprintf(key, "a prefix");
+    sprintf(highKey, "a prefix shared by all of the inserted keys 999999");
+    checkPassFail(scanCount(&index, key, GT, highKey, LTE), 20000)
+    checkPassFail(stringScan(&index,0,GTE,9999,LTE), 10000)
+
+    // keys longer than STRINGSIZE are cut to it
+    std::string longKey(2 * STRINGSIZE, 'z');
+    index.insertEntry(longKey.c_str(), zeroRid);
+    checkPassFail(scanCount(&index, longKey.c_str(), GTE, longKey.c_str(), LTE), 1)
+    checkPassFail(scanCount(&index, longKey.substr(0, STRINGSIZE).c_str(), GTE, longKey.c_str(), LTE), 1)
+}
+
+void test_delete()
+{
+    // Test deletes merging and redistributing nodes down to an empty root leaf, with the
+    // freed pages accounted for on the free list and reused by later splits
+    std::cout << "------- test_delete -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+    // keys are unique, so a full scan gives the record of every key in key order
+    std::vector<RecordId> rids;
+    int lowVal = 0;
+    int highVal = 9999;
+    RecordId scanRid;
+    index.startScan(&lowVal, GTE, &highVal, LTE);
+    try
+    {
+        while(1)
+        {
+            index.scanNext(scanRid);
+            rids.push_back(scanRid);
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    index.endScan();
+    checkPassFail((int)rids.size(), 10000)
+
+    int nodesBefore = index.getNodeCount();
+    for(int i = 0; i < 10000; i += 2)
+        index.deleteEntry(&i, rids[i]);
+    checkPassFail(intScan(&index,0,GTE,10000,LT), 5000)
+    checkPassFail(intScan(&index,2000,GTE,2000,LTE), 0)
+    checkPassFail(intScan(&index,2000,GTE,2001,LTE), 1)
+    checkPassFail(indexFilePages(), (int)(index.getNodeCount() + index.getFreePageCount()) + 1)
+
+    // an entry already deleted, and a key with another record
+    bool thrown = false;
+    int missing = 2000;
+    try
+    {
+        index.deleteEntry(&missing, rids[2000]);
+    }
+    catch(NoSuchKeyFoundException e)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+    thrown = false;
+    missing = 2001;
+    try
+    {
+        index.deleteEntry(&missing, rids[2003]);
+    }
+    catch(NoSuchKeyFoundException e)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+
+    // duplicates spanning leaves are found past the first leaf holding the key
+    int duplicate = 20000;
+    for(int i = 0; i < 3 * LeafNodeInt::CAPACITY; i++)
+        index.insertEntry(&duplicate, rids[i % 10 == 0 ? 1 : 3]);
+    for(int i = 0; i < 3 * LeafNodeInt::CAPACITY; i += 10)
+        index.deleteEntry(&duplicate, rids[1]);
+    checkPassFail(intScan(&index,20000,GTE,20000,LTE), 3 * LeafNodeInt::CAPACITY * 9 / 10)
+    for(int i = 0; i < 3 * LeafNodeInt::CAPACITY * 9 / 10; i++)
+        index.deleteEntry(&duplicate, rids[3]);
+    checkPassFail(intScan(&index,20000,GTE,20000,LTE), 0)
+
+    for(int i = 1; i < 10000; i += 2)
+        index.deleteEntry(&i, rids[i]);
+    checkPassFail(intScan(&index,-1,GT,20000,LTE), 0)
+    checkPassFail((int)index.getNodeCount(), 1)
+    checkPassFail(indexFilePages(), (int)(index.getNodeCount() + index.getFreePageCount()) + 1)
+
+    // splits take the freed pages before the file grows
+    int freeBefore = index.getFreePageCount();
+    int pagesBefore = indexFilePages();
+    for(int i = 0; i < 10000; i++)
+        index.insertEntry(&i, rids[i]);
+    checkPassFail(intScan(&index,0,GTE,10000,LT), 10000)
+    checkPassFail(((int)index.getFreePageCount() < freeBefore), true)
+    checkPassFail(((int)index.getNodeCount() > nodesBefore / 2), true)
+    checkPassFail((indexFilePages() - pagesBefore), std::max(0, (int)index.getNodeCount() - 1 - freeBefore))
+
+    // string keys, with prefix compressed leaves and truncated separators
+    char key[STRINGSIZE + 1];
+    for(int i = 0; i < 7500; i++)
+    {
+        sprintf(key, "%05d string record", i);
+        stringIndex.deleteEntry(key, rids[i]);
+    }
+    checkPassFail(stringScan(&stringIndex,0,GTE,9999,LTE), 2500)
+    checkPassFail(stringScan(&stringIndex,7499,GTE,7500,LTE), 1)
+    for(int i = 7500; i < 10000; i++)
+    {
+        sprintf(key, "%05d string record", i);
+        stringIndex.deleteEntry(key, rids[i]);
+    }
+    checkPassFail((int)stringIndex.getNodeCount(), 1)
+}
+
+void test_cursors()
+{
+    // Test scans in cursors of their own, interleaved with each other and with the scan
+    // started on the index
+    std::cout << "------- test_cursors -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // two ranges read in turns
+    int low1 = 0, high1 = 1000, low2 = 5000, high2 = 5999;
+    IndexCursor first = index.openScan(&low1, GTE, &high1, LT);
+    IndexCursor second = index.openScan(&low2, GTE, &high2, LTE);
+    RecordId rid1, rid2;
+    int count1 = 0, count2 = 0;
+    bool done1 = false, done2 = false;
+    while(!done1 || !done2)
+    {
+        try
+        {
+            if(!done1)
+            {
+                first.scanNext(rid1);
+                count1++;
+            }
+        }
+        catch(IndexScanCompletedException e)
+        {
+            done1 = true;
+        }
+        try
+        {
+            if(!done2)
+            {
+                second.scanNext(rid2);
+                count2++;
+            }
+        }
+        catch(IndexScanCompletedException e)
+        {
+            done2 = true;
+        }
+    }
+    first.endScan();
+    second.endScan();
+    checkPassFail(count1, 1000)
+    checkPassFail(count2, 1000)
+
+    // a self-join on the key, with an equality scan for every entry of the outer range
+    int lowVal = 100, highVal = 199;
+    IndexCursor outer = index.openScan(&lowVal, GTE, &highVal, LTE);
+    int matches = 0;
+    RecordId outerRid, innerRid;
+    try
+    {
+        for(int key = lowVal; ; key++)
+        {
+            outer.scanNext(outerRid);
+            IndexCursor inner = index.openScan(&key, GTE, &key, LTE);
+            inner.scanNext(innerRid);
+            if(innerRid.page_number == outerRid.page_number && innerRid.slot_number == outerRid.slot_number)
+                matches++;
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    outer.endScan();
+    checkPassFail(matches, 100)
+
+    // startScan neither ends nor is ended by a cursor
+    index.startScan(&low1, GTE, &high1, LT);
+    IndexCursor moved = index.openScan(&low2, GTE, &high2, LTE);
+    IndexCursor cursor(std::move(moved));
+    checkPassFail(moved.isOpen(), false)
+    index.scanNext(rid1);
+    cursor.scanNext(rid2);
+    index.endScan();
+    count2 = 1;
+    try
+    {
+        while(1)
+        {
+            cursor.scanNext(rid2);
+            count2++;
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    checkPassFail(count2, 1000)
+    cursor.endScan();
+
+    bool thrown = false;
+    try
+    {
+        cursor.scanNext(rid2);
+    }
+    catch(ScanNotInitializedException e)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+    checkPassFail(intScan(&index,0,GTE,10000,LT), 10000)
+}
+
+void test_scan_batch()
+{
+    // Test batches return the entries scanNext returns one at a time, with their keys,
+    // and a count of 0 at the end of the range
+    std::cout << "------- test_scan_batch -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+    std::vector<RecordId> rids;
+    int lowVal = 0;
+    int highVal = 9999;
+    RecordId scanRid;
+    index.startScan(&lowVal, GTE, &highVal, LTE);
+    try
+    {
+        while(1)
+        {
+            index.scanNext(scanRid);
+            rids.push_back(scanRid);
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    index.endScan();
+
+    // batches never span leaves, so the whole range takes one call per leaf
+    RecordId batchRids[LeafNodeInt::CAPACITY];
+    int batchKeys[LeafNodeInt::CAPACITY];
+    int total = 0;
+    int calls = 0;
+    bool inOrder = true;
+    IndexCursor cursor = index.openScan(&lowVal, GTE, &highVal, LTE);
+    int count;
+    while((count = cursor.scanNextBatch(batchRids, batchKeys, LeafNodeInt::CAPACITY)) > 0)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            RecordId &expected = rids[total + i];
+            if(batchKeys[i] != total + i || batchRids[i].page_number != expected.page_number ||
+               batchRids[i].slot_number != expected.slot_number)
+                inOrder = false;
+        }
+        total += count;
+        calls++;
+    }
+    checkPassFail(total, 10000)
+    checkPassFail(inOrder, true)
+    checkPassFail(calls, (int)index.getNodeCount() - 1)
+    checkPassFail(cursor.scanNextBatch(batchRids, batchKeys, LeafNodeInt::CAPACITY), 0)
+    cursor.endScan();
+
+    // small batches, open bounds and no keys
+    lowVal = 25;
+    highVal = 4000;
+    index.startScan(&lowVal, GT, &highVal, LT);
+    total = 0;
+    while((count = index.scanNextBatch(batchRids, NULL, 7)) > 0)
+        total += count;
+    index.endScan();
+    checkPassFail(total, 3974)
+
+    // a batch with no room is an error rather than the end of the range
+    bool thrown = false;
+    index.startScan(&lowVal, GT, &highVal, LT);
+    try
+    {
+        index.scanNextBatch(batchRids, NULL, 0);
+    }
+    catch(BadScanrangeException e)
+    {
+        thrown = true;
+    }
+    checkPassFail(thrown, true)
+    checkPassFail(index.scanNextBatch(batchRids, NULL, 7), 7)
+    index.endScan();
+
+    // string keys are written out in full, padded to STRINGSIZE
+    char low[STRINGSIZE + 1], high[STRINGSIZE + 1], expected[STRINGSIZE];
+    sprintf(low, "%05d string record", 2000);
+    sprintf(high, "%05d string record", 2999);
+    char stringKeys[50][STRINGSIZE];
+    IndexCursor strings = stringIndex.openScan(low, GTE, high, LTE);
+    total = 0;
+    inOrder = true;
+    while((count = strings.scanNextBatch(batchRids, stringKeys, 50)) > 0)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            memset(expected, 0, STRINGSIZE);
+            sprintf(expected, "%05d string record", 2000 + total + i);
+            if(memcmp(stringKeys[i], expected, STRINGSIZE) != 0)
+                inOrder = false;
+        }
+        total += count;
+    }
+    strings.endScan();
+    checkPassFail(total, 1000)
+    checkPassFail(inOrder, true)
+}
+
+void test_reverse_scan()
+{
+    // Test descending scans return the entries of ascending ones in reverse, starting from
+    // the high end of the range, with the left sibling links kept through splits and merges
+    std::cout << "------- test_reverse_scan -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+    std::vector<int> ascending, descending;
+    checkPassFail(intKeys(&index,0,GTE,9999,LTE,ASCENDING,ascending), 10000)
+    checkPassFail(intKeys(&index,0,GTE,9999,LTE,DESCENDING,descending), 10000)
+    std::reverse(descending.begin(), descending.end());
+    checkPassFail((ascending == descending), true)
+    checkPassFail(intKeys(&index,25,GT,40,LT,DESCENDING,descending), 14)
+    checkPassFail(descending.front(), 39)
+    checkPassFail(descending.back(), 26)
+    checkPassFail(intKeys(&index,-3,GT,3,LT,DESCENDING,descending), 3)
+    checkPassFail(intKeys(&index,3000,GTE,4000,LT,DESCENDING,descending), 1000)
+
+    // the latest keys below a value, in a batch and one record at a time
+    int lowVal = 0;
+    int highVal = 5000;
+    int latestKeys[10];
+    RecordId latestRids[10];
+    IndexCursor latest = index.openScan(&lowVal, GTE, &highVal, LT, DESCENDING);
+    checkPassFail(latest.scanNextBatch(latestRids, latestKeys, 10), 10)
+    latest.endScan();
+    checkPassFail(latestKeys[0], 4999)
+    checkPassFail(latestKeys[9], 4990)
+    RecordId rid;
+    index.startScan(&lowVal, GTE, &highVal, LT, DESCENDING);
+    index.scanNext(rid);
+    index.endScan();
+    checkPassFail((rid.page_number == latestRids[0].page_number && rid.slot_number == latestRids[0].slot_number), true)
+
+    // splits link new leaves both ways
+    insertRelationInRange(&index, 10000, 19999);
+    checkPassFail(intKeys(&index,0,GTE,20000,LT,ASCENDING,ascending), 20000)
+    checkPassFail(intKeys(&index,0,GTE,20000,LT,DESCENDING,descending), 20000)
+    std::reverse(descending.begin(), descending.end());
+    checkPassFail((ascending == descending), true)
+
+    // and merges relink the leaves around the one taken out
+    std::vector<RecordId> rids;
+    lowVal = 0;
+    highVal = 19999;
+    index.startScan(&lowVal, GTE, &highVal, LTE);
+    try
+    {
+        while(1)
+        {
+            index.scanNext(rid);
+            rids.push_back(rid);
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    index.endScan();
+    for(int i = 0; i < 20000; i++)
+        if(i % 4 != 0)
+            index.deleteEntry(&i, rids[i]);
+    checkPassFail(intKeys(&index,0,GTE,20000,LT,ASCENDING,ascending), 5000)
+    checkPassFail(intKeys(&index,0,GTE,20000,LT,DESCENDING,descending), 5000)
+    checkPassFail(descending.front(), 19996)
+    std::reverse(descending.begin(), descending.end());
+    checkPassFail((ascending == descending), true)
+    checkPassFail(intKeys(&index,1,GTE,3,LTE,DESCENDING,descending), 0)
+
+    // string keys in batches, highest first
+    char low[STRINGSIZE + 1], high[STRINGSIZE + 1], expected[STRINGSIZE];
+    sprintf(low, "%05d string record", 2000);
+    sprintf(high, "%05d string record", 2999);
+    RecordId batchRids[50];
+    char stringKeys[50][STRINGSIZE];
+    IndexCursor strings = stringIndex.openScan(low, GT, high, LTE, DESCENDING);
+    int total = 0;
+    int count;
+    bool inOrder = true;
+    while((count = strings.scanNextBatch(batchRids, stringKeys, 50)) > 0)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            memset(expected, 0, STRINGSIZE);
+            sprintf(expected, "%05d string record", 2999 - total - i);
+            if(memcmp(stringKeys[i], expected, STRINGSIZE) != 0)
+                inOrder = false;
+        }
+        total += count;
+    }
+    strings.endScan();
+    checkPassFail(total, 999)
+    checkPassFail(inOrder, true)
+}
+
+void test_lookup()
+{
+    // Test lookups find the record of every key a scan finds, every duplicate of a key
+    // spanning leaves, and nothing for a missing key
+    std::cout << "------- test_lookup -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+    std::vector<RecordId> rids;
+    int lowVal = 0;
+    int highVal = 9999;
+    RecordId scanRid;
+    index.startScan(&lowVal, GTE, &highVal, LTE);
+    try
+    {
+        while(1)
+        {
+            index.scanNext(scanRid);
+            rids.push_back(scanRid);
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    index.endScan();
+
+    std::vector<RecordId> found;
+    int matches = 0;
+    for(int i = 0; i < 10000; i++)
+    {
+        found.clear();
+        if(index.lookup(&i, found) == 1 && found[0].page_number == rids[i].page_number &&
+           found[0].slot_number == rids[i].slot_number)
+            matches++;
+    }
+    checkPassFail(matches, 10000)
+    int missing = 10000;
+    found.clear();
+    checkPassFail((int)index.lookup(&missing, found), 0)
+    missing = -1;
+    checkPassFail((int)index.lookup(&missing, found), 0)
+    checkPassFail((int)found.size(), 0)
+
+    // duplicates spanning leaves, appended after what the vector holds
+    int duplicate = 5000;
+    for(int i = 0; i < 3 * LeafNodeInt::CAPACITY; i++)
+        index.insertEntry(&duplicate, rids[i]);
+    found.assign(1, rids[0]);
+    checkPassFail((int)index.lookup(&duplicate, found), 3 * LeafNodeInt::CAPACITY + 1)
+    checkPassFail((int)found.size(), 3 * LeafNodeInt::CAPACITY + 2)
+
+    // and still after inserts split the leaves
+    insertRelationInRange(&index, 10000, 10000 + 20 * LeafNodeInt::CAPACITY);
+    matches = 0;
+    for(int i = 0; i <= 10000 + 20 * LeafNodeInt::CAPACITY; i += 7)
+    {
+        found.clear();
+        if(index.lookup(&i, found) == (i == duplicate ? 3 * LeafNodeInt::CAPACITY + 1 : 1))
+            matches++;
+    }
+    checkPassFail(matches, (10000 + 20 * LeafNodeInt::CAPACITY) / 7 + 1)
+
+    char key[STRINGSIZE + 1];
+    sprintf(key, "%05d string record", 1234);
+    found.clear();
+    checkPassFail((int)stringIndex.lookup(key, found), 1)
+    checkPassFail((found[0].page_number == rids[1234].page_number && found[0].slot_number == rids[1234].slot_number), true)
+    sprintf(key, "%05d string recor", 1234);
+    checkPassFail((int)stringIndex.lookup(key, found), 0)
+}
+
+void test_concurrent()
+{
+    // Test threads inserting and deleting keys while others look keys up, on a tree that
+    // splits and merges under them, find every key that is in it throughout and leave
+    // the tree holding what they put there
+    std::cout << "------- test_concurrent -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    std::vector<RecordId> rids;
+    int lowVal = 0;
+    int highVal = 9999;
+    RecordId scanRid;
+    index.startScan(&lowVal, GTE, &highVal, LTE);
+    try
+    {
+        while(1)
+        {
+            index.scanNext(scanRid);
+            rids.push_back(scanRid);
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    index.endScan();
+
+    // four threads insert 10000 to 29999 between them, one deletes 0 to 1999 and two look
+    // up 2000 to 9999, which stay in the tree
+    ConcurrentWork work[7];
+    for(int t = 0; t < 4; t++)
+    {
+        ConcurrentWork inserts = {&index, &rids, 10000 + t, 29999, 4, 0};
+        work[t] = inserts;
+    }
+    ConcurrentWork deletes = {&index, &rids, 0, 1999, 1, 0};
+    work[4] = deletes;
+    for(int t = 5; t < 7; t++)
+    {
+        ConcurrentWork lookups = {&index, &rids, 2000 + t, 9999, 3, 0};
+        work[t] = lookups;
+    }
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; t++)
+        threads.push_back(std::thread(concurrentInserts, &work[t]));
+    threads.push_back(std::thread(concurrentDeletes, &work[4]));
+    for(int t = 5; t < 7; t++)
+        threads.push_back(std::thread(concurrentLookups, &work[t]));
+    int errors = 0;
+    for(int t = 0; t < 7; t++)
+    {
+        threads[t].join();
+        errors += work[t].errors;
+    }
+    checkPassFail(errors, 0)
+
+    std::vector<RecordId> found;
+    int matches = 0;
+    for(int i = 0; i < 30000; i++)
+    {
+        found.clear();
+        if(index.lookup(&i, found) == (i < 2000 ? 0u : 1u) &&
+           (i < 2000 || found[0].page_number == rids[i % 10000].page_number))
+            matches++;
+    }
+    checkPassFail(matches, 30000)
+    checkPassFail(scanCount(&index, &lowVal, GTE, &matches, LT), 28000)
+    checkPassFail((int)index.countRange(&lowVal, GTE, &matches, LT), 28000)
+}
+
+void test_concurrent_scans()
+{
+    // Test cursors scanning up and down, entry by entry and in batches, while other threads
+    // add and delete entries all over the range they scan, splitting and merging the leaves
+    // under them, return the entries in key order and every entry that stays in the tree
+    // exactly once
+    std::cout << "------- test_concurrent_scans -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    std::vector<RecordId> rids;
+    int lowVal = 0;
+    int highVal = 9999;
+    RecordId scanRid;
+    index.startScan(&lowVal, GTE, &highVal, LTE);
+    try
+    {
+        while(1)
+        {
+            index.scanNext(scanRid);
+            rids.push_back(scanRid);
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    index.endScan();
+
+    // four threads add and delete a second entry for each key, a quarter of the keys each,
+    // while three scan 0 to 9999 in batches of 1, 7 and 64 entries
+    ConcurrentWork work[7];
+    for(int t = 0; t < 4; t++)
+    {
+        ConcurrentWork churn = {&index, &rids, t, 9999, 4, 0};
+        work[t] = churn;
+    }
+    int steps[3] = {1, 7, 64};
+    for(int t = 4; t < 7; t++)
+    {
+        ConcurrentWork scans = {&index, &rids, 0, 9999, steps[t - 4], 0};
+        work[t] = scans;
+    }
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; t++)
+        threads.push_back(std::thread(concurrentChurn, &work[t]));
+    for(int t = 4; t < 7; t++)
+        threads.push_back(std::thread(concurrentScans, &work[t]));
+    int errors = 0;
+    for(int t = 0; t < 7; t++)
+    {
+        threads[t].join();
+        errors += work[t].errors;
+    }
+    checkPassFail(errors, 0)
+
+    std::vector<RecordId> found;
+    int matches = 0;
+    for(int i = 0; i < 10000; i++)
+    {
+        found.clear();
+        if(index.lookup(&i, found) == 1 && found[0].page_number == rids[i].page_number &&
+           found[0].slot_number == rids[i].slot_number)
+            matches++;
+    }
+    checkPassFail(matches, 10000)
+    checkPassFail((int)index.countRange(&lowVal, GTE, &highVal, LTE), 10000)
+}
+
+void test_blink()
+{
+    // Test many threads splitting leaves and the nodes above them at once, each linking its
+    // splits into the parents on its own while others look keys up, leave every key
+    // reachable from the root and the leaves chained in order both ways
+    std::cout << "------- test_blink -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+    std::vector<RecordId> rids;
+    int lowVal = 0;
+    int highVal = 9999;
+    RecordId scanRid;
+    index.startScan(&lowVal, GTE, &highVal, LTE);
+    try
+    {
+        while(1)
+        {
+            index.scanNext(scanRid);
+            rids.push_back(scanRid);
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    index.endScan();
+
+    // eight threads insert 10000 to 69999 between them, in turns so they split the same
+    // leaves, two insert 10000 to 29999 into the string index and two look up 0 to 9999
+    ConcurrentWork work[12];
+    for(int t = 0; t < 8; t++)
+    {
+        ConcurrentWork inserts = {&index, &rids, 10000 + t, 69999, 8, 0};
+        work[t] = inserts;
+    }
+    for(int t = 8; t < 10; t++)
+    {
+        ConcurrentWork inserts = {&stringIndex, &rids, 10000 + t - 8, 29999, 2, 0};
+        work[t] = inserts;
+    }
+    for(int t = 10; t < 12; t++)
+    {
+        ConcurrentWork lookups = {&index, &rids, t - 10, 9999, 2, 0};
+        work[t] = lookups;
+    }
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 8; t++)
+        threads.push_back(std::thread(concurrentInserts, &work[t]));
+    for(int t = 8; t < 10; t++)
+        threads.push_back(std::thread(concurrentStringInserts, &work[t]));
+    for(int t = 10; t < 12; t++)
+        threads.push_back(std::thread(concurrentLookups, &work[t]));
+    int errors = 0;
+    for(int t = 0; t < 12; t++)
+    {
+        threads[t].join();
+        errors += work[t].errors;
+    }
+    checkPassFail(errors, 0)
+
+    std::vector<RecordId> found;
+    int matches = 0;
+    for(int i = 0; i < 70000; i++)
+    {
+        found.clear();
+        if(index.lookup(&i, found) == 1)
+            matches++;
+    }
+    checkPassFail(matches, 70000)
+    checkPassFail((int)index.countRange(&lowVal, GTE, &matches, LT), 70000)
+
+    std::vector<int> ascending;
+    std::vector<int> descending;
+    checkPassFail(intKeys(&index,0,GTE,70000,LT,ASCENDING,ascending), 70000)
+    checkPassFail(intKeys(&index,0,GTE,70000,LT,DESCENDING,descending), 70000)
+    bool inOrder = true;
+    for(int i = 0; i < 70000; i++)
+        inOrder = inOrder && ascending[i] == i && descending[i] == 69999 - i;
+    checkPassFail(inOrder, true)
+
+    char lowKey[STRINGSIZE + 1];
+    char highKey[STRINGSIZE + 1];
+    sprintf(lowKey, "%05d string record", 0);
+    sprintf(highKey, "%05d string record", 29999);
+    checkPassFail(scanCount(&stringIndex, lowKey, GTE, highKey, LTE), 30000)
+}
+
+void test_posting_lists()
+{
+    // Test an index storing each key once per leaf with a posting list of its records is
+    // several times smaller than one storing a key per record, and finds the same records
+    // through scans and lookups, before and after inserts and deletes
+    std::cout << "------- test_posting_lists -------" << std::endl;
+    int plainNodes;
+    std::vector<RecordId> plainRids;
+    int key = 3;
+    {
+        BTreeIndex plain(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        plainNodes = plain.getNodeCount();
+        plain.lookup(&key, plainRids);
+    }
+    File::remove(intIndexName);
+
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER,
+                     DEFAULT_FILL_FACTOR, DEFAULT_SORT_FRAMES, POSTING_LEAVES);
+    checkPassFail(((int)index.getNodeCount() * 3 <= plainNodes), true)
+    checkPassFail(intScan(&index,0,GTE,9,LTE), 40000)
+    checkPassFail(intScan(&index,2,GT,5,LT), 8000)
+    std::vector<int> descending;
+    checkPassFail(intKeys(&index,0,GTE,9,LTE,DESCENDING,descending), 40000)
+    checkPassFail((descending[0] == 9 && descending[39999] == 0), true)
+
+    std::vector<RecordId> found;
+    checkPassFail((int)index.lookup(&key, found), 4000)
+    std::sort(plainRids.begin(), plainRids.end(), ridBefore);
+    std::sort(found.begin(), found.end(), ridBefore);
+    checkPassFail((found == plainRids), true)
+
+    // the records of 7 inserted under 3 too, splitting its posting lists, then deleted again
+    std::vector<RecordId> moved;
+    int other = 7;
+    index.lookup(&other, moved);
+    for(size_t i = 0; i < moved.size(); i++)
+        index.insertEntry(&key, moved[i]);
+    found.clear();
+    checkPassFail((int)index.lookup(&key, found), 8000)
+    checkPassFail(intScan(&index,0,GTE,9,LTE), 44000)
+    for(size_t i = 0; i < moved.size(); i += 2)
+        index.deleteEntry(&key, moved[i]);
+    found.clear();
+    checkPassFail((int)index.lookup(&key, found), 6000)
+    for(size_t i = 1; i < moved.size(); i += 2)
+        index.deleteEntry(&key, moved[i]);
+    found.clear();
+    index.lookup(&key, found);
+    std::sort(found.begin(), found.end(), ridBefore);
+    checkPassFail((found == plainRids), true)
+    checkPassFail(intScan(&index,0,GTE,9,LTE), 40000)
+
+    {
+        BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE,
+                               DEFAULT_FILL_FACTOR, DEFAULT_SORT_FRAMES, POSTING_LEAVES);
+        checkPassFail(doubleScan(&doubleIndex,2,GTE,4,LTE), 12000)
+    }
+    File::remove(doubleIndexName);
+
+    bool rejected = false;
+    try
+    {
+        BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING,
+                               DEFAULT_FILL_FACTOR, DEFAULT_SORT_FRAMES, POSTING_LEAVES);
+    }
+    catch(BadIndexInfoException e)
+    {
+        rejected = true;
+    }
+    checkPassFail(rejected, true)
+}
+
+void test_packed_leaves()
+{
+    // Test an index with packed leaves is at most half the size of a plain one and finds the
+    // same records through scans and lookups, before and after inserts into the middle of
+    // leaves and deletes, and that the unpack kernels agree
+    std::cout << "------- test_packed_leaves -------" << std::endl;
+    int plainNodes;
+    std::vector<RecordId> rids;
+    {
+        BTreeIndex plain(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        plainNodes = plain.getNodeCount();
+        for(int i = 0; i < 10000; i++)
+            plain.lookup(&i, rids);
+    }
+    File::remove(intIndexName);
+
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER,
+                     DEFAULT_FILL_FACTOR, DEFAULT_SORT_FRAMES, PACKED_LEAVES);
+    checkPassFail(((int)index.getNodeCount() * 2 <= plainNodes), true)
+    checkPassFail(intScan(&index,25,GT,40,LT), 14)
+    checkPassFail(intScan(&index,0,GTE,9999,LTE), 10000)
+    std::vector<int> descending;
+    checkPassFail(intKeys(&index,0,GTE,9999,LTE,DESCENDING,descending), 10000)
+    checkPassFail((descending[0] == 9999 && descending[9999] == 0), true)
+
+    std::vector<RecordId> found;
+    int matches = 0;
+    for(int i = 0; i < 10000; i++)
+    {
+        found.clear();
+        if(index.lookup(&i, found) == 1 && found[0].page_number == rids[i].page_number &&
+           found[0].slot_number == rids[i].slot_number)
+            matches++;
+    }
+    checkPassFail(matches, 10000)
+
+    // every third key inserted again from the top down, each into the middle of a leaf
+    for(int i = 9999; i >= 0; i--)
+        if(i % 3 == 0)
+            index.insertEntry(&i, rids[9999 - i]);
+    checkPassFail(intScan(&index,0,GTE,9999,LTE), 13334)
+    int key = 1236;
+    found.clear();
+    checkPassFail((int)index.lookup(&key, found), 2)
+    checkPassFail((found[1].page_number == rids[9999 - key].page_number && found[1].slot_number == rids[9999 - key].slot_number), true)
+    for(int i = 0; i < 10000; i += 3)
+        index.deleteEntry(&i, rids[9999 - i]);
+    checkPassFail(intScan(&index,0,GTE,9999,LTE), 10000)
+    insertRelationInRange(&index, 10000, 12000);
+    checkPassFail(intScan(&index,9000,GTE,11999,LTE), 3000)
+
+    bool rejected = false;
+    try
+    {
+        BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE,
+                               DEFAULT_FILL_FACTOR, DEFAULT_SORT_FRAMES, PACKED_LEAVES);
+    }
+    catch(BadIndexInfoException e)
+    {
+        rejected = true;
+    }
+    checkPassFail(rejected, true)
+
+    // fields of every width at every bit offset, compared between the two kernels
+    bool agree = true;
+    if(NodeSearch::hasAvx2())
+    {
+        std::vector<unsigned char> packed(64 * 8 + BitPack::PADDING);
+        for(size_t i = 0; i < packed.size(); i++)
+            packed[i] = (unsigned char)(i * 151 + 7);
+        std::uint32_t scalar[61];
+        std::uint32_t avx2[61];
+        for(int bits = 0; bits <= 32; bits++)
+            for(int offset = 0; offset < 8; offset++)
+            {
+                BitPack::unpackScalar(&packed[0], bits + 1, offset, bits, 2, 61, 5, scalar);
+                BitPack::unpackAvx2(&packed[0], bits + 1, offset, bits, 2, 61, 5, avx2);
+                agree = agree && std::equal(scalar, scalar + 61, avx2);
+            }
+    }
+    checkPassFail(agree, true)
+}
+
+void test_appends()
+{
+    // Test keys inserted in increasing order fill the leaves they leave behind to 90 percent
+    // rather than half, and the index finds them all, also after inserts that are not appends
+    std::cout << "------- test_appends -------" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    int nodesBefore = index.getNodeCount();
+    int appended = 40 * LeafNodeInt::CAPACITY;
+    insertRelationInRange(&index, 10000, 10000 + appended - 1);
+    int nodesAdded = index.getNodeCount() - nodesBefore;
+    checkPassFail((nodesAdded > appended / LeafNodeInt::CAPACITY && nodesAdded <= appended / (0.9 * LeafNodeInt::CAPACITY) + 3), true)
+    checkPassFail(intScan(&index,0,GTE,10000 + appended,LT), 10000 + appended)
+
+    std::vector<RecordId> found;
+    int matches = 0;
+    for(int i = 10000; i < 10000 + appended; i += 7)
+    {
+        found.clear();
+        if(index.lookup(&i, found) == 1)
+            matches++;
+    }
+    checkPassFail(matches, (appended - 1) / 7 + 1)
+
+    // inserts below the last key end the run, the leaves they go to split in half
+    RecordId rid;
+    rid.page_number = 1;
+    rid.slot_number = 1;
+    for(int i = 10000 + appended - 1; i >= 10000; i -= 2)
+        index.insertEntry(&i, rid);
+    checkPassFail(intScan(&index,0,GTE,10000 + appended,LT), 10000 + appended + appended / 2)
+    std::vector<int> keys;
+    intKeys(&index,0,GTE,10000 + appended,LT,ASCENDING,keys);
+    checkPassFail(std::is_sorted(keys.begin(), keys.end()), true)
+}
+
+void test_pinned_upper_levels()
+{
+    // Test an index keeping its non-leaf nodes pinned finds what one reading them through the
+    // buffer manager finds, while its root splits and its nodes merge, and is closed and
+    // opened again with every pin dropped
+    std::cout << "------- test_pinned_upper_levels -------" << std::endl;
+    int plainNodes;
+    {
+        BTreeIndex plain(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        plainNodes = plain.getNodeCount();
+    }
+    File::remove(intIndexName);
+
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER,
+                         DEFAULT_FILL_FACTOR, DEFAULT_SORT_FRAMES, PLAIN_LEAVES, true);
+        checkPassFail((int)index.getNodeCount(), plainNodes)
+        checkPassFail(intScan(&index,25,GT,40,LT), 14)
+        std::vector<RecordId> found;
+        int matches = 0;
+        for(int i = 0; i < 10000; i++)
+        {
+            found.clear();
+            if(index.lookup(&i, found) == 1)
+                matches++;
+        }
+        checkPassFail(matches, 10000)
+
+        // far more leaves than buffer frames, then back down to fewer than before
+        insertRelationInRange(&index, 10000, 10000 + 200 * LeafNodeInt::CAPACITY);
+        checkPassFail(intScan(&index,0,GTE,10000 + 200 * LeafNodeInt::CAPACITY,LTE), 10001 + 200 * LeafNodeInt::CAPACITY)
+        std::vector<RecordId> rids;
+        int low = 10000;
+        int high = 10000 + 200 * LeafNodeInt::CAPACITY;
+        index.startScan(&low, GTE, &high, LTE);
+        RecordId rid;
+        try
+        {
+            while(1)
+            {
+                index.scanNext(rid);
+                rids.push_back(rid);
+            }
+        }
+        catch(IndexScanCompletedException e)
+        {
+        }
+        index.endScan();
+        for(int i = 0; i < (int)rids.size(); i++)
+        {
+            int key = 10000 + i;
+            index.deleteEntry(&key, rids[i]);
+        }
+        checkPassFail(intScan(&index,0,GTE,10000 + 200 * LeafNodeInt::CAPACITY,LTE), 10000)
+    }
+
+    BTreeIndex reopened(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER,
+                        DEFAULT_FILL_FACTOR, DEFAULT_SORT_FRAMES, PLAIN_LEAVES, true);
+    checkPassFail(intScan(&reopened,0,GTE,9999,LTE), 10000)
+    std::vector<int> descending;
+    checkPassFail(intKeys(&reopened,0,GTE,9999,LTE,DESCENDING,descending), 10000)
+    checkPassFail((descending[0] == 9999 && descending[9999] == 0), true)
+
+    // down to a single leaf, freeing the pinned root, and up again through a new one
+    std::vector<RecordId> rids;
+    int low = 0;
+    int high = 9999;
+    reopened.startScan(&low, GTE, &high, LTE);
+    RecordId rid;
+    try
+    {
+        while(1)
+        {
+            reopened.scanNext(rid);
+            rids.push_back(rid);
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    reopened.endScan();
+    for(int i = 100; i < 10000; i++)
+        reopened.deleteEntry(&i, rids[i]);
+    checkPassFail((int)reopened.getNodeCount(), 1)
+    insertRelationInRange(&reopened, 10000, 10000 + 3 * LeafNodeInt::CAPACITY);
+    checkPassFail(intScan(&reopened,0,GTE,10000 + 3 * LeafNodeInt::CAPACITY,LTE), 101 + 3 * LeafNodeInt::CAPACITY)
+}
+
+void test_composite_keys()
+{
+    // Test an index on (i, d) finds the records matching predicates on both attributes and on
+    // i alone, also after inserts and deletes and once opened again, and that an index on
+    // (d, s) and the checks of the columns work too
+    std::cout << "------- test_composite_keys -------" << std::endl;
+    std::vector<KeyColumn> columns(2);
+    columns[0].attrByteOffset = offsetof(tuple,i);
+    columns[0].attrType = INTEGER;
+    columns[1].attrByteOffset = offsetof(tuple,d);
+    columns[1].attrType = DOUBLE;
+    std::string compositeIndexName;
+    {
+        BTreeIndex index(relationName, compositeIndexName, bufMgr, columns);
+
+        // i = 3 and d from -0 to 100, with and without the bounds
+        CompositeKey low = CompositeKey().add(3).add(-0.0);
+        CompositeKey high = CompositeKey().add(3).add(100.0);
+        checkPassFail(scanCount(&index, &low, GTE, &high, LTE), 101)
+        checkPassFail(compositeMatches(&index, low, GTE, high, LTE, 3, 0, 100), 101)
+        checkPassFail(compositeMatches(&index, low, GT, high, LT, 3, 0.5, 99.5), 99)
+
+        // i = 3 with any d, i from 3 to 5, and no i
+        CompositeKey prefix = CompositeKey().add(3);
+        CompositeKey prefixHigh = CompositeKey().add(3).fillHigh();
+        checkPassFail(compositeMatches(&index, prefix, GTE, prefixHigh, LTE, 3, -500, 499), 1000)
+        CompositeKey wideHigh = CompositeKey().add(5).fillHigh();
+        checkPassFail(scanCount(&index, &prefix, GTE, &wideHigh, LTE), 3000)
+        CompositeKey negative = CompositeKey().add(-1).fillHigh();
+        CompositeKey first = CompositeKey().add(0);
+        checkPassFail(scanCount(&index, &negative, GT, &first, LT), 0)
+
+        std::vector<RecordId> found;
+        CompositeKey exact = CompositeKey().add(7).add(-250.0);
+        checkPassFail((int)index.lookup(&exact, found), 1)
+        CompositeKey key = CompositeKey().add(3).add(1000.5);
+        index.insertEntry(&key, found[0]);
+        checkPassFail(scanCount(&index, &prefix, GTE, &prefixHigh, LTE), 1001)
+        index.deleteEntry(&key, found[0]);
+        checkPassFail(scanCount(&index, &prefix, GTE, &prefixHigh, LTE), 1000)
+    }
+    {
+        BTreeIndex index(relationName, compositeIndexName, bufMgr, columns);
+        CompositeKey prefix = CompositeKey().add(9);
+        CompositeKey prefixHigh = CompositeKey().add(9).fillHigh();
+        checkPassFail(scanCount(&index, &prefix, GTE, &prefixHigh, LTE), 1000)
+    }
+    File::remove(compositeIndexName);
+
+    // a double and a string take the wider keys
+    std::vector<KeyColumn> wideColumns(2);
+    wideColumns[0] = columns[1];
+    wideColumns[1].attrByteOffset = offsetof(tuple,s);
+    wideColumns[1].attrType = STRING;
+    {
+        BTreeIndex index(relationName, compositeIndexName, bufMgr, wideColumns);
+        CompositeKey low = CompositeKey().add(-500.0);
+        CompositeKey high = CompositeKey().add(-499.0).fillHigh();
+        checkPassFail(scanCount(&index, &low, GTE, &high, LTE), 20)
+        CompositeKey exact = CompositeKey().add(-500.0).add("00003 string record");
+        checkPassFail(scanCount(&index, &exact, GTE, &exact, LTE), 1)
+    }
+    File::remove(compositeIndexName);
+
+    bool rejected = false;
+    try
+    {
+        BTreeIndex index(relationName, compositeIndexName, bufMgr, std::vector<KeyColumn>());
+    }
+    catch(BadIndexInfoException e)
+    {
+        rejected = true;
+    }
+    checkPassFail(rejected, true)
+    rejected = false;
+    try
+    {
+        wideColumns.push_back(wideColumns[1]);
+        BTreeIndex index(relationName, compositeIndexName, bufMgr, wideColumns);
+    }
+    catch(BadIndexInfoException e)
+    {
+        rejected = true;
+    }
+    checkPassFail(rejected, true)
+}
+
+void test_covering_indexes()
+{
+    // Test scans of an index on i including d and s return the attributes of the records they
+    // find, with bounds and lookups on i alone, also after an entry is replaced and while
+    // entries around them come and go, that a single attribute index returns its key the same
+    // way, and that included attributes count towards the size of the key
+    std::cout << "------- test_covering_indexes -------" << std::endl;
+    std::vector<KeyColumn> columns(1);
+    columns[0].attrByteOffset = offsetof(tuple,i);
+    columns[0].attrType = INTEGER;
+    std::vector<KeyColumn> included(2);
+    included[0].attrByteOffset = offsetof(tuple,d);
+    included[0].attrType = DOUBLE;
+    included[1].attrByteOffset = offsetof(tuple,s);
+    included[1].attrType = STRING;
+    std::string coveringIndexName;
+    {
+        BTreeIndex index(relationName, coveringIndexName, bufMgr, columns, included);
+        CompositeKey three = CompositeKey().add(3);
+        checkPassFail(coveredMatches(&index, &three, GTE, &three, LTE), 1000)
+        CompositeKey two = CompositeKey().add(2);
+        CompositeKey four = CompositeKey().add(4);
+        checkPassFail(coveredMatches(&index, &two, GT, &four, LT), 1000)
+        checkPassFail(coveredMatches(&index, &two, GTE, &four, LTE), 3000)
+
+        std::vector<RecordId> found;
+        checkPassFail((int)index.lookup(&three, found), 1000)
+
+        // the entry of a record that changed its d and s replaced
+        RECORD record;
+        Page *page;
+        bufMgr->readPage(file1, found[0].page_number, page);
+        record = *(reinterpret_cast<const RECORD*>(page->getRecord(found[0]).data()));
+        bufMgr->unPinPage(file1, found[0].page_number, false);
+        CompositeKey oldKey = index.entryKey((char *)&record);
+        record.d = 12345.5;
+        strcpy(record.s, "changed string record");
+        CompositeKey newKey = index.entryKey((char *)&record);
+        index.insertEntry(&newKey, found[0]);
+        index.deleteEntry(&oldKey, found[0]);
+        found.clear();
+        checkPassFail((int)index.lookup(&three, found), 1000)
+        index.startScan(&three, GTE, &three, LTE, DESCENDING);
+        RecordId rid;
+        RECORD covered;
+        index.scanNextRecord(rid, &covered);
+        index.endScan();
+        checkPassFail((covered.i == 3 && covered.d == 12345.5 && strcmp(covered.s, record.s) == 0), true)
+
+        // lookups of 3 while entries of 2 and 4 come and go in the leaves around them
+        ConcurrentWork work[4];
+        for(int t = 0; t < 4; t++)
+        {
+            ConcurrentWork covering = {&index, NULL, 2 + 2 * (t % 2), 2000, 1, 0};
+            work[t] = covering;
+        }
+        std::vector<std::thread> threads;
+        threads.push_back(std::thread(coveringChurn, &work[0]));
+        threads.push_back(std::thread(coveringChurn, &work[1]));
+        threads.push_back(std::thread(coveringLookups, &work[2]));
+        threads.push_back(std::thread(coveringLookups, &work[3]));
+        int errors = 0;
+        for(int t = 0; t < 4; t++)
+        {
+            threads[t].join();
+            errors += work[t].errors;
+        }
+        checkPassFail(errors, 0)
+    }
+    File::remove(coveringIndexName);
+
+    std::string intIndexName;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        int low = 3;
+        int high = 5;
+        checkPassFail(coveredMatches(&index, &low, GTE, &high, LTE), 3000)
+    }
+    File::remove(intIndexName);
+
+    bool rejected = false;
+    try
+    {
+        included[0] = included[1];
+        BTreeIndex index(relationName, coveringIndexName, bufMgr, columns, included);
+    }
+    catch(BadIndexInfoException e)
+    {
+        rejected = true;
+    }
+    checkPassFail(rejected, true)
+}
+
+void test_count_range()
+{
+    // Test countRange() agrees with scans over ranges inside one leaf, across many and at the
+    // ends of the index, and that the entry count follows inserts and deletes and is kept
+    // while the index is closed
+    std::cout << "------- test_count_range -------" << std::endl;
+    int deleted = 0;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail((int)index.getEntryCount(), 20000)
+        int lows[] = {25, 0, -100, 1000, 19990, 5000};
+        int highs[] = {40, 19999, 30000, 15000, 25000, 5000};
+        for(int i = 0; i < 6; i++)
+        {
+            int low = lows[i];
+            int high = highs[i];
+            checkPassFail((int)index.countRange(&low, GT, &high, LT), intScan(&index, low, GT, high, LT))
+            checkPassFail((int)index.countRange(&low, GTE, &high, LTE), intScan(&index, low, GTE, high, LTE))
+        }
+        int low = 20000;
+        int high = 30000;
+        checkPassFail((int)index.countRange(&low, GTE, &high, LTE), 0)
+
+        // duplicates of the same key spread over several leaves
+        insertRelationInRange(&index, 0, 20000);
+        int key = 777;
+        RecordId rid;
+        rid.page_number = 1;
+        for(rid.slot_number = 1; rid.slot_number <= 2000; rid.slot_number++)
+            index.insertEntry(&key, rid);
+        checkPassFail((int)index.getEntryCount(), 42001)
+        checkPassFail((int)index.countRange(&key, GTE, &key, LTE), 2002)
+        rid.slot_number = 1;
+        index.deleteEntry(&key, rid);
+        checkPassFail((int)index.countRange(&key, GTE, &key, LTE), 2001)
+
+        // deletes that empty leaves enough to merge them and the nodes above
+        for(rid.slot_number = 2; rid.slot_number <= 2000; rid.slot_number++)
+            index.deleteEntry(&key, rid);
+        checkPassFail((int)index.countRange(&key, GTE, &key, LTE), 2)
+        std::vector<RecordId> found;
+        for(int i = 3000; i < 15000; i++)
+        {
+            if(i % 10 == 0)
+                continue;
+            found.clear();
+            index.lookup(&i, found);
+            for(size_t j = 0; j < found.size(); j++)
+                index.deleteEntry(&i, found[j]);
+            deleted += found.size();
+        }
+        for(int i = 0; i < 6; i++)
+        {
+            int low = lows[i];
+            int high = highs[i];
+            checkPassFail((int)index.countRange(&low, GT, &high, LT), intScan(&index, low, GT, high, LT))
+        }
+        low = -1;
+        high = 20000;
+        checkPassFail((int)index.countRange(&low, GTE, &high, LTE), 40001 - deleted)
+    }
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail((int)index.getEntryCount(), 40001 - deleted)
+    }
+    File::remove(intIndexName);
+}
+
+void test_bitmap_heap_scan()
+{
+    // Test a bitmap heap scan returns the records of an index range once each in record id
+    // order, reading each page they are on no more than once, also for a record id added
+    // twice, several ranges together and no range at all
+    std::cout << "------- test_bitmap_heap_scan -------" << std::endl;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        int low = 1000;
+        int high = 2999;
+        {
+            BitmapHeapScan heapScan(relationName, bufMgr);
+            checkPassFail((int)heapScan.addRange(&index, &low, GTE, &high, LTE), 2000)
+            checkPassFail((int)heapScan.addRange(&index, &low, GT, &high, LT), 1998)
+            bufMgr->getBufStats().clear();
+            checkPassFail(bitmapRecords(heapScan, low, high), 2000)
+            checkPassFail((bufMgr->getBufStats().diskreads <= (int)heapScan.pageCount()), true)
+        }
+        {
+            BitmapHeapScan heapScan(relationName, bufMgr);
+            int otherLow = 5000;
+            int otherHigh = 5299;
+            heapScan.addRange(&index, &low, GTE, &low, LTE);
+            heapScan.addRange(&index, &otherLow, GTE, &otherHigh, LTE);
+            checkPassFail(bitmapRecords(heapScan, low, otherHigh), 301)
+        }
+        {
+            BitmapHeapScan heapScan(relationName, bufMgr);
+            int none = 20000;
+            checkPassFail((int)heapScan.addRange(&index, &none, GTE, &none, LTE), 0)
+            checkPassFail(bitmapRecords(heapScan, low, high), 0)
+        }
+    }
+    File::remove(intIndexName);
+}
+
+void test_statistics()
+{
+    // Test the estimates of an index analyzed when it is bulk loaded are close to the entries of
+    // ranges, follow inserts until it is analyzed again, pick up a key repeated many times and
+    // are kept while the index is closed, hold up when analyze() samples the leaves, and that a
+    // STRING index is estimated too
+    std::cout << "------- test_statistics -------" << std::endl;
+    double fullEstimate;
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail((int)index.getDistinctKeyEstimate(), 10000)
+        int lows[] = {0, 25, 1000, 4321, 9990, -500};
+        int highs[] = {9999, 40, 8999, 4321, 12000, 300};
+        for(int i = 0; i < 6; i++)
+        {
+            checkPassFail(estimateClose(&index, &lows[i], GTE, &highs[i], LTE, 2), true)
+            checkPassFail(estimateClose(&index, &lows[i], GT, &highs[i], LT, 2), true)
+        }
+
+        // estimates scale with the entries inserted, a repeated key shows once analyzed
+        int key = 777;
+        RecordId rid;
+        rid.page_number = 1;
+        for(rid.slot_number = 1; rid.slot_number <= 2000; rid.slot_number++)
+            index.insertEntry(&key, rid);
+        int low = 0;
+        int high = 9999;
+        checkPassFail((std::abs(index.estimateRange(&low, GTE, &high, LTE) - 12000) < 1), true)
+        checkPassFail(estimateClose(&index, &key, GTE, &key, LTE, 10), false)
+        index.analyze();
+        checkPassFail(estimateClose(&index, &key, GTE, &key, LTE, 1), true)
+        checkPassFail(estimateClose(&index, &low, GTE, &key, LT, 10), true)
+        checkPassFail(estimateClose(&index, &key, GT, &high, LTE, 10), true)
+        checkPassFail((int)index.getDistinctKeyEstimate(), 10000)
+        fullEstimate = index.estimateRange(&low, GTE, &high, LTE);
+    }
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        int low = 0;
+        int high = 9999;
+        checkPassFail((index.estimateRange(&low, GTE, &high, LTE) == fullEstimate), true)
+    }
+    File::remove(intIndexName);
+
+    {
+        // an index of more leaves than analyze() reads is estimated from a sample of them
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        RecordId rid;
+        rid.page_number = 1;
+        rid.slot_number = 1;
+        int count = 4 * ANALYZE_SAMPLE_LEAVES * LeafNodeInt::CAPACITY;
+        for(int i = 10000; i < 10000 + count; i++)
+            index.insertEntry(&i, rid);
+        bufMgr->getBufStats().clear();
+        index.analyze();
+        checkPassFail((bufMgr->getBufStats().accesses < 2 * ANALYZE_SAMPLE_LEAVES), true)
+        int low = 0;
+        int high = 10000 + count;
+        checkPassFail(estimateClose(&index, &low, GTE, &high, LT, 1), true)
+        low = 10000 + count / 4;
+        high = 10000 + count / 2;
+        checkPassFail(estimateClose(&index, &low, GTE, &high, LT, count / 100), true)
+        checkPassFail((std::abs((double)index.getDistinctKeyEstimate() - (10000 + count)) < count / 100), true)
+    }
+    File::remove(intIndexName);
+
+    {
+        BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+        char low[STRINGSIZE];
+        char high[STRINGSIZE];
+        sprintf(low, "%05d string record", 0);
+        sprintf(high, "%05d string record", 9999);
+        checkPassFail(estimateClose(&index, low, GTE, high, LTE, 1), true)
+        checkPassFail((int)index.getDistinctKeyEstimate(), 10000)
+    }
+    File::remove(stringIndexName);
+}
+
+void test_hash_index()
+{
+    // Test a hash index finds the record of every key the B+ tree finds, splitting buckets as
+    // it grows, keeps the duplicates of a key on an overflow chain, deletes them, reads one
+    // page per lookup once reopened, rejects a file built otherwise, and finds double and
+    // string keys
+    std::cout << "------- test_hash_index -------" << std::endl;
+    std::string hashIndexName;
+    {
+        BTreeIndex tree(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        HashIndex index(relationName, hashIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail((int)index.getEntryCount(), 10000)
+        checkPassFail((index.getGlobalDepth() >= 4), true)
+        int mismatches = 0;
+        for (int key = 0; key < 10000; key++)
+        {
+            std::vector<RecordId> hashRids;
+            std::vector<RecordId> treeRids;
+            tree.lookup(&key, treeRids);
+            if (index.lookup(&key, hashRids) != 1 || !(hashRids[0] == treeRids[0]))
+                mismatches++;
+        }
+        checkPassFail(mismatches, 0)
+        std::vector<RecordId> rids;
+        int missing = 20000;
+        checkPassFail((int)index.lookup(&missing, rids), 0)
+
+        // duplicates of one key cannot be split apart
+        int duplicate = 10000;
+        for (int j = 0; j < 2000; j++)
+        {
+            RecordId rid;
+            rid.page_number = 5000 + j / 100;
+            rid.slot_number = j % 100;
+            index.insertEntry(&duplicate, rid);
+        }
+        checkPassFail((int)index.lookup(&duplicate, rids), 2000)
+        checkPassFail((index.getGlobalDepth() < MAX_GLOBAL_DEPTH), true)
+        for (int j = 0; j < 2000; j++)
+            index.deleteEntry(&duplicate, rids[j]);
+        std::vector<RecordId> remaining;
+        checkPassFail((int)index.lookup(&duplicate, remaining), 0)
+        bool thrown = false;
+        try
+        {
+            index.deleteEntry(&duplicate, rids[0]);
+        }
+        catch(NoSuchKeyFoundException e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+    }
+    {
+        HashIndex index(relationName, hashIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail((int)index.getEntryCount(), 10000)
+        std::vector<RecordId> rids;
+        int key = 1234;
+        bufMgr->getBufStats().clear();
+        checkPassFail((int)index.lookup(&key, rids), 1)
+        checkPassFail(bufMgr->getBufStats().diskreads, 1)
+    }
+    bool rejected = false;
+    try
+    {
+        HashIndex index(relationName, hashIndexName, bufMgr, offsetof(tuple,i), DOUBLE);
+    }
+    catch(BadIndexInfoException e)
+    {
+        rejected = true;
+    }
+    checkPassFail(rejected, true)
+    File::remove(hashIndexName);
+    File::remove(intIndexName);
+
+    {
+        HashIndex index(relationName, hashIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+        std::vector<RecordId> rids;
+        double key = 4321;
+        checkPassFail((int)index.lookup(&key, rids), 1)
+        double negativeZero = -0.0;
+        checkPassFail((int)index.lookup(&negativeZero, rids), 1)
+    }
+    File::remove(hashIndexName);
+
+    {
+        HashIndex index(relationName, hashIndexName, bufMgr, offsetof(tuple,s), STRING);
+        std::vector<RecordId> rids;
+        char key[STRINGSIZE];
+        int found = 0;
+        for (int i = 0; i < 10000; i += 7)
+        {
+            sprintf(key, "%05d string record", i);
+            found += index.lookup(key, rids);
+        }
+        checkPassFail(found, 1429)
+    }
+    File::remove(hashIndexName);
+}
+
+void test_learned_lookup()
+{
+    // Test lookups through a learned model of the leaves find every duplicate of keys spread
+    // quadratically and nothing for keys in between, with a model of a few KB, that a reopened
+    // index reads the model it was built with instead of the leaves, that an insert turns the
+    // model off and lookups then descend to the same record ids, that the changed index is
+    // trained again when reopened, but not once splits left its leaves out of page order, and
+    // that only INTEGER indexes take a model
+    std::cout << "------- test_learned_lookup -------" << std::endl;
+    std::size_t modelSize = 0;
+    for (int open = 0; open < 2; open++)
+    {
+        bufMgr->getBufStats().clear();
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFAULT_FILL_FACTOR,
+                         DEFAULT_SORT_FRAMES, PLAIN_LEAVES, false, true);
+        checkPassFail(index.isLearned(), true)
+        checkPassFail((index.getLearnedModelSize() < 4096), true)
+        if (open == 0)
+            modelSize = index.getLearnedModelSize();
+        else
+        {
+            checkPassFail((index.getLearnedModelSize() == modelSize), true)
+            checkPassFail((bufMgr->getBufStats().accesses < 5), true)
+        }
+        std::vector<RecordId> rids;
+        int found = 0;
+        int between = 0;
+        for (int j = 0; j < 10000; j++)
+        {
+            int key = j * j;
+            found += index.lookup(&key, rids);
+            key = j * j + 1;
+            if (j > 0)
+                between += index.lookup(&key, rids);
+        }
+        checkPassFail(found, 30000)
+        checkPassFail(between, 0)
+        int below = -5;
+        int above = 100000000;
+        checkPassFail((int)index.lookup(&below, rids), 0)
+        checkPassFail((int)index.lookup(&above, rids), 0)
+    }
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFAULT_FILL_FACTOR,
+                         DEFAULT_SORT_FRAMES, PLAIN_LEAVES, false, true);
+        std::vector<RecordId> learned;
+        int key = 4567 * 4567;
+        index.lookup(&key, learned);
+        RecordId rid;
+        rid.page_number = 5000;
+        rid.slot_number = 0;
+        // past the highest key, into the last leaf, which has room
+        int inserted = 100000000;
+        index.insertEntry(&inserted, rid);
+        checkPassFail(index.isLearned(), false)
+        std::vector<RecordId> descended;
+        checkPassFail((int)index.lookup(&key, descended), 3)
+        checkPassFail((learned == descended), true)
+        checkPassFail((int)index.lookup(&inserted, descended), 1)
+    }
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFAULT_FILL_FACTOR,
+                         DEFAULT_SORT_FRAMES, PLAIN_LEAVES, false, true);
+        checkPassFail(index.isLearned(), true)
+        std::vector<RecordId> rids;
+        int found = 0;
+        for (int j = 0; j < 10000; j++)
+        {
+            int key = j * j;
+            found += index.lookup(&key, rids);
+        }
+        int inserted = 100000000;
+        found += index.lookup(&inserted, rids);
+        checkPassFail(found, 30001)
+    }
+    {
+        // split leaves go to new pages, past the pages of the leaves right of them
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFAULT_FILL_FACTOR,
+                         DEFAULT_SORT_FRAMES, PLAIN_LEAVES, false, true);
+        int inserted = -1;
+        RecordId rid;
+        rid.page_number = 5001;
+        for (rid.slot_number = 0; rid.slot_number < 2000; rid.slot_number++)
+            index.insertEntry(&inserted, rid);
+    }
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFAULT_FILL_FACTOR,
+                         DEFAULT_SORT_FRAMES, PLAIN_LEAVES, false, true);
+        checkPassFail(index.isLearned(), false)
+        std::vector<RecordId> rids;
+        int found = 0;
+        for (int j = 0; j < 10000; j++)
+        {
+            int key = j * j;
+            found += index.lookup(&key, rids);
+        }
+        int inserted = -1;
+        found += index.lookup(&inserted, rids);
+        int last = 100000000;
+        found += index.lookup(&last, rids);
+        checkPassFail(found, 32001)
+    }
+    File::remove(intIndexName);
+
+    bool rejected = false;
+    try
+    {
+        BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, DEFAULT_FILL_FACTOR,
+                               DEFAULT_SORT_FRAMES, PLAIN_LEAVES, false, true);
+    }
+    catch(BadIndexInfoException e)
+    {
+        rejected = true;
+    }
+    checkPassFail(rejected, true)
+}
+
+// -----------------------------------------------------------------------------
+// ridBefore
+// -----------------------------------------------------------------------------
+
+bool ridBefore(const RecordId &r1, const RecordId &r2)
+{
+    return r1.page_number != r2.page_number ? r1.page_number < r2.page_number : r1.slot_number < r2.slot_number;
+}
+
+// -----------------------------------------------------------------------------
+// concurrentInserts
+// -----------------------------------------------------------------------------
+
+void concurrentInserts(ConcurrentWork *work)
+{
+    // Insert the keys with the record id of the key they are equal to modulo 10000
+    for(int i = work->first; i <= work->last; i += work->step)
+        work->index->insertEntry(&i, (*work->rids)[i % 10000]);
+}
+
+// -----------------------------------------------------------------------------
+// concurrentStringInserts
+// -----------------------------------------------------------------------------
+
+void concurrentStringInserts(ConcurrentWork *work)
+{
+    // Insert the keys as the string attribute of a tuple with the key would have it
+    char key[STRINGSIZE + 1];
+    for(int i = work->first; i <= work->last; i += work->step)
+    {
+        sprintf(key, "%05d string record", i);
+        work->index->insertEntry(key, (*work->rids)[i % 10000]);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// concurrentDeletes
+// -----------------------------------------------------------------------------
+
+void concurrentDeletes(ConcurrentWork *work)
+{
+    // Delete the keys, each of which is in the tree
+    for(int i = work->first; i <= work->last; i += work->step)
+    {
+        try
+        {
+            work->index->deleteEntry(&i, (*work->rids)[i]);
+        }
+        catch(NoSuchKeyFoundException e)
+        {
+            work->errors++;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// concurrentLookups
+// -----------------------------------------------------------------------------
+
+void concurrentLookups(ConcurrentWork *work)
+{
+    // Look the keys up a few times over, each must be found once with its record id
+    std::vector<RecordId> found;
+    for(int round = 0; round < 5; round++)
+    {
+        for(int i = work->first; i <= work->last; i += work->step)
+        {
+            found.clear();
+            if(work->index->lookup(&i, found) != 1 || found[0].page_number != (*work->rids)[i].page_number ||
+               found[0].slot_number != (*work->rids)[i].slot_number)
+                work->errors++;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// concurrentChurn
+// -----------------------------------------------------------------------------
+
+void concurrentChurn(ConcurrentWork *work)
+{
+    // Add a second entry for each of the keys, with the record id of the next key, and
+    // delete them all again, a few times over
+    for(int round = 0; round < 4; round++)
+    {
+        for(int i = work->first; i <= work->last; i += work->step)
+            work->index->insertEntry(&i, (*work->rids)[(i + 1) % 10000]);
+        for(int i = work->first; i <= work->last; i += work->step)
+        {
+            try
+            {
+                work->index->deleteEntry(&i, (*work->rids)[(i + 1) % 10000]);
+            }
+            catch(NoSuchKeyFoundException e)
+            {
+                work->errors++;
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// concurrentScans
+// -----------------------------------------------------------------------------
+
+void concurrentScans(ConcurrentWork *work)
+{
+    // Scan the keys a few times over, up and down, in batches of step entries: keys must
+    // come in order, and the entry of each key with its own record id, which stays in the
+    // tree, exactly once
+    RecordId rids[64];
+    int keys[64];
+    for(int round = 0; round < 8; round++)
+    {
+        ScanDirection direction = (round % 2 == 0) ? ASCENDING : DESCENDING;
+        IndexCursor cursor = work->index->openScan(&work->first, GTE, &work->last, LTE, direction);
+        std::vector<int> seen(work->last - work->first + 1, 0);
+        int previous = (direction == ASCENDING) ? work->first : work->last;
+        int count;
+        while((count = cursor.scanNextBatch(rids, keys, work->step)) > 0)
+        {
+            for(int i = 0; i < count; i++)
+            {
+                if(direction == ASCENDING ? keys[i] < previous : keys[i] > previous)
+                    work->errors++;
+                previous = keys[i];
+                const RecordId &own = (*work->rids)[keys[i]];
+                if(rids[i].page_number == own.page_number && rids[i].slot_number == own.slot_number)
+                    seen[keys[i] - work->first]++;
+            }
+        }
+        cursor.endScan();
+        for(std::size_t i = 0; i < seen.size(); i++)
+            if(seen[i] != 1)
+                work->errors++;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// coveringChurn
+// -----------------------------------------------------------------------------
+
+void coveringChurn(ConcurrentWork *work)
+{
+    // Add last entries with i of first to a covering index on i including d and s, d counting
+    // up from 1, and delete them all again, a few times over
+    for(int round = 0; round < 4; round++)
+    {
+        RecordId rid;
+        rid.page_number = 1;
+        for(int j = 1; j <= work->last; j++)
+        {
+            CompositeKey key = CompositeKey().add(work->first).add((double)j).add("churned string record");
+            rid.slot_number = j;
+            work->index->insertEntry(&key, rid);
+        }
+        for(int j = 1; j <= work->last; j++)
+        {
+            CompositeKey key = CompositeKey().add(work->first).add((double)j).add("churned string record");
+            rid.slot_number = j;
+            try
+            {
+                work->index->deleteEntry(&key, rid);
+            }
+            catch(NoSuchKeyFoundException e)
+            {
+                work->errors++;
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// coveringLookups
+// -----------------------------------------------------------------------------
+
+void coveringLookups(ConcurrentWork *work)
+{
+    // Look up 3 in a covering index on i, which has 1000 entries, last times over
+    CompositeKey three = CompositeKey().add(3);
+    std::vector<RecordId> found;
+    for(int round = 0; round < work->last; round++)
+    {
+        found.clear();
+        if(work->index->lookup(&three, found) != 1000)
+            work->errors++;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// indexFilePages
+// -----------------------------------------------------------------------------
+
+int indexFilePages()
+{
+    // Pages allocated in the index file, from its size on disk
+    std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+    return indexFile.tellg() / Page::SIZE;
+}
+
+// -----------------------------------------------------------------------------
+// insertRelationInRange
+// -----------------------------------------------------------------------------
+
+void insertRelationInRange(BTreeIndex *index, int left, int right)
+{
+    // Append tuples valued left to right to the relation and insert them into the index
+    memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+    Page new_page = file1->allocatePage(new_page_number);
+    std::vector<RecordId> ridVec;
+    std::vector<int> keyVec;
+
+    for(int i = left; i <= right; i++ )
+    {
+        sprintf(record1.s, "%05d string record", i);
+        record1.i = i;
+        record1.d = (double)i;
+        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+        while(1)
+        {
+            try
+            {
+                RecordId new_rid = new_page.insertRecord(new_data);
+                ridVec.push_back(new_rid);
+                keyVec.push_back(i);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+                file1->writePage(new_page_number, new_page);
+                new_page = file1->allocatePage(new_page_number);
+            }
+        }
+    }
+
+    file1->writePage(new_page_number, new_page);
+
+    for(size_t i = 0; i < ridVec.size(); i++ )
+    {
+        index->insertEntry(&keyVec[i], ridVec[i]);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// forwardCreateRelationInRange
+// -----------------------------------------------------------------------------
+
+void forwardCreateRelationInRange(int left, int right)
+{
+    std::vector<RecordId> ridVec;
+    // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+
+    file1 = new PageFile(relationName, true);
+
+     
+    memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+    Page new_page = file1->allocatePage(new_page_number);
+
+    // Insert a bunch of tuples into the relation.
+    for(int i = left; i <= right; i++ )
+    {
+        sprintf(record1.s, "%05d string record", i);
+        record1.i = i;
+        record1.d = (double)i;
+        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+        while(1)
+        {
+            try
+            {
+                new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+                file1->writePage(new_page_number, new_page);
+                new_page = file1->allocatePage(new_page_number);
+            }
+        }
     }
+
+    file1->writePage(new_page_number, new_page);
 }
 
+// -----------------------------------------------------------------------------
+// duplicateCreateRelationInSize
+// -----------------------------------------------------------------------------
 
-void test_size_10000()
+void duplicateCreateRelationInSize(int size, int distinct)
 {
-    // Test for the given size 10000
-    std::cout << "----- test_size_10000 -----" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
 
-    checkPassFail(intScan(&index,25,GT,40,LT), 14)
-    checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
-    checkPassFail(intScan(&index,-3,GT,3,LT), 3)
-    checkPassFail(intScan(&index,996,GT,1001,LT), 4)
-    checkPassFail(intScan(&index,0,GT,1,LT), 0)
-    checkPassFail(intScan(&index,300,GT,400,LT), 99)
-    checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
-}
+    file1 = new PageFile(relationName, true);
 
-void test_no_split()
-{
-    // Test for a small given size, for which the root will not split
-    std::cout << "---------- test_no_split ---------" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+    Page new_page = file1->allocatePage(new_page_number);
 
-    checkPassFail(intScan(&index,25,GT,40,LT), 14)
-    checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
-    checkPassFail(intScan(&index,-3,GT,3,LT), 3)
-    checkPassFail(intScan(&index,200,GTE,250,LTE), 51)
-    checkPassFail(intScan(&index,0,GT,1,LT), 0)
-    checkPassFail(intScan(&index,300,GT,400,LT), 0)
-    checkPassFail(intScan(&index,3000,GTE,4000,LT), 0)
-}
-void test_huge_num()
-{
-    // Test for huge data
-    std::cout << "---------- testHugeNum ---------- " << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    // Insert tuples valued 0 to distinct - 1 over and over.
+    for(int i = 0; i < size; i++ )
+    {
+        sprintf(record1.s, "%05d string record", i % distinct);
+        record1.i = i % distinct;
+        record1.d = (double)(i % distinct);
+        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
-    checkPassFail(intScan(&index,25,GT,40,LT), 14)
-    checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
-    checkPassFail(intScan(&index,-3,GT,3,LT), 3)
-    checkPassFail(intScan(&index,996,GT,1001,LT), 4)
-    checkPassFail(intScan(&index,0,GT,1,LT), 0)
-    checkPassFail(intScan(&index,300,GT,400,LT), 99)
-    checkPassFail(intScan(&index,0,GTE, 1000000,LT), 1000000)
+        while(1)
+        {
+            try
+            {
+                new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+                file1->writePage(new_page_number, new_page);
+                new_page = file1->allocatePage(new_page_number);
+            }
+        }
+    }
+
+    file1->writePage(new_page_number, new_page);
 }
 
-void test_range()
-{
-    // Test for given a range for creating relation
-    std::cout << "----------- test_range -----------" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-    checkPassFail(intScan(&index,25,GT,40,LT), 14)
-    checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
-    checkPassFail(intScan(&index,-3,GT,3,LT), 5)
-    checkPassFail(intScan(&index,-300,GTE,300,LTE), 601)
-    checkPassFail(intScan(&index,0,GT,1,LT), 0)
-    checkPassFail(intScan(&index,300,GT,400,LT), 99)
-    checkPassFail(intScan(&index,-1,GTE,0,LT), 1)
-}
-void test_split()
+// -----------------------------------------------------------------------------
+// squaresCreateRelationInSize
+// -----------------------------------------------------------------------------
+
+void squaresCreateRelationInSize(int size, int repeats)
 {
-    // Test for the root just split
-    std::cout << "----------- test_range -----------" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
 
-    checkPassFail(intScan(&index,430,GTE,432,LTE), 3)
-    checkPassFail(intScan(&index,431,GT,432,LTE), 1)
-    checkPassFail(intScan(&index,0,GT,432,LTE), 432)
+    file1 = new PageFile(relationName, true);
+
+    memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+    Page new_page = file1->allocatePage(new_page_number);
+
+    // Insert tuples valued with the squares of 0 to size / repeats - 1, each repeats times.
+    for(int i = 0; i < size; i++ )
+    {
+        int val = (i / repeats) * (i / repeats);
+        sprintf(record1.s, "%05d string record", i / repeats);
+        record1.i = val;
+        record1.d = (double)val;
+        std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+        while(1)
+        {
+            try
+            {
+                new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+                file1->writePage(new_page_number, new_page);
+                new_page = file1->allocatePage(new_page_number);
+            }
+        }
+    }
+
+    file1->writePage(new_page_number, new_page);
 }
+
 // -----------------------------------------------------------------------------
-// forwardCreateRelationInRange
+// compositeCreateRelationInSize
 // -----------------------------------------------------------------------------
 
-void forwardCreateRelationInRange(int left, int right)
+void compositeCreateRelationInSize(int size, int distinct)
 {
-    std::vector<RecordId> ridVec;
     // destroy any old copies of relation file
     try
     {
@@ -380,17 +2983,17 @@ void forwardCreateRelationInRange(int left, int right)
 
     file1 = new PageFile(relationName, true);
 
-     
     memset(record1.s, ' ', sizeof(record1.s));
     PageId new_page_number;
     Page new_page = file1->allocatePage(new_page_number);
 
-    // Insert a bunch of tuples into the relation.
-    for(int i = left; i <= right; i++ )
+    // Insert tuples valued 0 to distinct - 1 over and over, with d counting the rounds from
+    // -size / (2 * distinct) on.
+    for(int i = 0; i < size; i++ )
     {
         sprintf(record1.s, "%05d string record", i);
-        record1.i = i;
-        record1.d = (double)i;
+        record1.i = i % distinct;
+        record1.d = (double)(i / distinct - size / (2 * distinct));
         std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
         while(1)
@@ -752,6 +3355,24 @@ void indexTests()
   	catch(FileNotFoundException e)
   	{
   	}
+
+    doubleTests();
+		try
+		{
+			File::remove(doubleIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+
+    stringTests();
+		try
+		{
+			File::remove(stringIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
   }
 }
 
@@ -776,20 +3397,115 @@ void intTests()
 
 int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
 {
-  RecordId scanRid;
-	Page *curPage;
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	return scanCount(index, &lowVal, lowOp, &highVal, highOp);
+}
+
+int intKeys(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, ScanDirection direction, std::vector<int> &keys)
+{
+	// Keys of the range in the order the scan returns them, read a leaf at a time
+	keys.clear();
+	int batch[LeafNodeInt::CAPACITY];
+	RecordId rids[LeafNodeInt::CAPACITY];
+	try
+	{
+		IndexCursor cursor = index->openScan(&lowVal, lowOp, &highVal, highOp, direction);
+		int count;
+		while((count = cursor.scanNextBatch(rids, batch, LeafNodeInt::CAPACITY)) > 0)
+			keys.insert(keys.end(), batch, batch + count);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+	}
+	return keys.size();
+}
+
+// -----------------------------------------------------------------------------
+// doubleTests
+// -----------------------------------------------------------------------------
 
+void doubleTests()
+{
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+
+	// run some tests
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(doubleScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(doubleScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(doubleScan(&index,0,GT,1,LT), 0)
+	checkPassFail(doubleScan(&index,300,GT,400,LT), 99)
+	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(doubleScan(&index,24.5,GT,30.5,LT), 6)
+}
+
+int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal, Operator highOp)
+{
   std::cout << "Scan for ";
   if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
   std::cout << lowVal << "," << highVal;
   if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
   std::cout << std::endl;
 
+	return scanCount(index, &lowVal, lowOp, &highVal, highOp);
+}
+
+// -----------------------------------------------------------------------------
+// stringTests
+// -----------------------------------------------------------------------------
+
+void stringTests()
+{
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(stringScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(stringScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
+	checkPassFail(stringScan(&index,300,GT,400,LT), 99)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+}
+
+int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	// keys are the first STRINGSIZE characters of the records' strings
+  char lowValStr[100];
+  char highValStr[100];
+  sprintf(lowValStr,"%05d string record",lowVal);
+  sprintf(highValStr,"%05d string record",highVal);
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowValStr << "," << highValStr;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	return scanCount(index, lowValStr, lowOp, highValStr, highOp);
+}
+
+// -----------------------------------------------------------------------------
+// scanCount
+// -----------------------------------------------------------------------------
+
+int scanCount(BTreeIndex * index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
   int numResults = 0;
 	
 	try
 	{
-  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+  	index->startScan(lowVal, lowOp, highVal, highOp);
 	}
 	catch(NoSuchKeyFoundException e)
 	{
@@ -835,6 +3551,119 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 }
 
 
+// -----------------------------------------------------------------------------
+// estimateClose
+// -----------------------------------------------------------------------------
+
+bool estimateClose(BTreeIndex *index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp, double tolerance)
+{
+    // True if the estimate of the range is within tolerance of the entries it holds
+    double estimate = index->estimateRange(lowVal, lowOp, highVal, highOp);
+    double actual = index->countRange(lowVal, lowOp, highVal, highOp);
+    std::cout << "Estimate " << estimate << " for " << actual << " entries" << std::endl;
+    return std::abs(estimate - actual) <= tolerance;
+}
+
+// -----------------------------------------------------------------------------
+// bitmapRecords
+// -----------------------------------------------------------------------------
+
+int bitmapRecords(BitmapHeapScan &heapScan, int lowVal, int highVal)
+{
+    // Number of records the scan returns, or -1 if one is out of [lowVal, highVal], they are not
+    // in record id order or they are on more pages than the scan holds
+    int count = 0;
+    std::uint32_t pages = 0;
+    RecordId last;
+    last.page_number = 0;
+    last.slot_number = 0;
+    try
+    {
+        while(1)
+        {
+            RecordId rid;
+            heapScan.scanNext(rid);
+            std::string recordStr = heapScan.getRecord();
+            RECORD record = *(reinterpret_cast<const RECORD*>(recordStr.data()));
+            if(record.i < lowVal || record.i > highVal || !ridBefore(last, rid))
+                return -1;
+            if(rid.page_number != last.page_number)
+                pages++;
+            last = rid;
+            count++;
+        }
+    }
+    catch(EndOfFileException e)
+    {
+    }
+    return pages == heapScan.pageCount() ? count : -1;
+}
+
+// -----------------------------------------------------------------------------
+// coveredMatches
+// -----------------------------------------------------------------------------
+
+int coveredMatches(BTreeIndex *index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp)
+{
+    // Number of entries the scan finds whose attributes in the index match the record, which
+    // is only read to check them. Attributes the index does not hold are left zero.
+    int matches = 0;
+    RecordId rid;
+    Page *page;
+    index->startScan(lowVal, lowOp, highVal, highOp);
+    try
+    {
+        while(1)
+        {
+            RECORD covered;
+            memset(&covered, 0, sizeof(covered));
+            index->scanNextRecord(rid, &covered);
+            bufMgr->readPage(file1, rid.page_number, page);
+            RECORD record = *(reinterpret_cast<const RECORD*>(page->getRecord(rid).data()));
+            bufMgr->unPinPage(file1, rid.page_number, false);
+            bool withPayload = covered.s[0] != 0;
+            if(covered.i == record.i && (!withPayload || (covered.d == record.d && strcmp(covered.s, record.s) == 0)))
+                matches++;
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    index->endScan();
+    return matches;
+}
+
+// -----------------------------------------------------------------------------
+// compositeMatches
+// -----------------------------------------------------------------------------
+
+int compositeMatches(BTreeIndex *index, const CompositeKey &low, Operator lowOp, const CompositeKey &high, Operator highOp,
+                     int i, double lowD, double highD)
+{
+    // Number of records the scan finds that have the given i and a d in [lowD, highD]
+    int matches = 0;
+    RecordId rid;
+    Page *page;
+    index->startScan(&low, lowOp, &high, highOp);
+    try
+    {
+        while(1)
+        {
+            index->scanNext(rid);
+            bufMgr->readPage(file1, rid.page_number, page);
+            RECORD record = *(reinterpret_cast<const RECORD*>(page->getRecord(rid).data()));
+            bufMgr->unPinPage(file1, rid.page_number, false);
+            if(record.i == i && record.d >= lowD && record.d <= highD)
+                matches++;
+        }
+    }
+    catch(IndexScanCompletedException e)
+    {
+    }
+    index->endScan();
+    return matches;
+}
+
 // -----------------------------------------------------------------------------
 // errorTests
 // -----------------------------------------------------------------------------
@@ -0,0 +1,224 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Version counter guarding one node of a B+ tree for optimistic lock coupling.
+ *
+ * Readers take no lock. They get the version with readLock() before looking at the node and
+ * check with validate() that it is unchanged before using what they read, restarting their
+ * operation otherwise. A writer locks the node by setting the low bit of the version and bumps
+ * the version when it unlocks, so every reader that overlapped the change fails validation.
+ * Readers only ever load the version, so they never write the cache line it is in.
+ */
+class NodeLatch {
+ public:
+  NodeLatch() : version(0) {}
+
+  /**
+   * Version of the node to validate against, once no writer holds it.
+   */
+  std::uint64_t readLock() const {
+    std::uint64_t v = version.load(std::memory_order_acquire);
+    while (v & LOCKED) {
+      std::this_thread::yield();
+      v = version.load(std::memory_order_acquire);
+    }
+    return v;
+  }
+
+  /**
+   * True if the node is still at version v, so what was read from it since is consistent.
+   */
+  bool validate(const std::uint64_t v) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version.load(std::memory_order_relaxed) == v;
+  }
+
+  /**
+   * Locks the node if it is still at version v. Returns false, without waiting or locking, if
+   * it changed or is locked.
+   */
+  bool tryUpgrade(const std::uint64_t v) {
+    std::uint64_t expected = v;
+    return version.compare_exchange_strong(expected, v + LOCKED, std::memory_order_acquire);
+  }
+
+  /**
+   * Locks the node if no writer holds it. Returns false, without waiting, otherwise.
+   */
+  bool tryWriteLock() {
+    std::uint64_t v = version.load(std::memory_order_relaxed);
+    return !(v & LOCKED) && tryUpgrade(v);
+  }
+
+  /**
+   * Locks the node, waiting for the writer holding it.
+   */
+  void writeLock() {
+    while (!tryUpgrade(readLock()))
+      ;
+  }
+
+  /**
+   * Unlocks the node after changing it, failing the validation of readers that overlapped.
+   */
+  void writeUnlock() { version.fetch_add(LOCKED, std::memory_order_release); }
+
+  /**
+   * Unlocks a node that was not changed, leaving readers that overlapped valid.
+   */
+  void writeUnlockUnchanged() { version.fetch_sub(LOCKED, std::memory_order_release); }
+
+ private:
+  static const std::uint64_t LOCKED = 1;
+
+  std::atomic<std::uint64_t> version;
+};
+
+/**
+ * @brief Latch held shared by any number of threads or exclusively by one, waiting by yielding.
+ * A thread waiting for it exclusively keeps new shared holders out, so it is not starved.
+ */
+class SharedLatch {
+ public:
+  SharedLatch() : state(0), exclusiveWaiters(0) {}
+
+  void lockShared() {
+    while (true) {
+      int s = state.load(std::memory_order_relaxed);
+      if (s != EXCLUSIVE && exclusiveWaiters.load(std::memory_order_relaxed) == 0 &&
+          state.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+        return;
+      std::this_thread::yield();
+    }
+  }
+
+  void unlockShared() { state.fetch_sub(1, std::memory_order_release); }
+
+  void lockExclusive() {
+    exclusiveWaiters.fetch_add(1, std::memory_order_relaxed);
+    int expected = 0;
+    while (!state.compare_exchange_weak(expected, EXCLUSIVE, std::memory_order_acquire)) {
+      expected = 0;
+      std::this_thread::yield();
+    }
+    exclusiveWaiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void unlockExclusive() { state.store(0, std::memory_order_release); }
+
+ private:
+  static const int EXCLUSIVE = -1;
+
+  /**
+   * Number of shared holders, or EXCLUSIVE.
+   */
+  std::atomic<int> state;
+
+  /**
+   * Threads waiting to hold the latch exclusively.
+   */
+  std::atomic<int> exclusiveWaiters;
+};
+
+/**
+ * @brief An entry of type T for every page of an index file, by page number: the NodeLatch of
+ * every node, or the frame of every node kept pinned.
+ *
+ * Entries live in blocks allocated on first use, value-initialized, behind a two level
+ * directory, so the table grows with the file without ever moving an entry and lookups need
+ * no lock.
+ */
+template <class T>
+class PageTable {
+ public:
+  PageTable() {
+    for (int i = 0; i < DIRECTORY_SIZE; i++)
+      directory[i].store(NULL, std::memory_order_relaxed);
+  }
+
+  ~PageTable() {
+    for (int i = 0; i < DIRECTORY_SIZE; i++) {
+      std::atomic<T *> *blocks = directory[i].load(std::memory_order_relaxed);
+      if (blocks == NULL)
+        continue;
+      for (int j = 0; j < DIRECTORY_SIZE; j++)
+        delete[] blocks[j].load(std::memory_order_relaxed);
+      delete[] blocks;
+    }
+  }
+
+  /**
+   * Entry of the page.
+   */
+  T &operator[](const PageId pageNo) {
+    std::atomic<T *> *blocks = getOrCreate(directory[pageNo >> (BLOCK_BITS + DIRECTORY_BITS)]);
+    T *block = getOrCreate(blocks[(pageNo >> BLOCK_BITS) & (DIRECTORY_SIZE - 1)]);
+    return block[pageNo & (BLOCK_SIZE - 1)];
+  }
+
+ private:
+  static const int BLOCK_BITS = 12;
+  static const int BLOCK_SIZE = 1 << BLOCK_BITS;
+  static const int DIRECTORY_BITS = 10;
+  static const int DIRECTORY_SIZE = 1 << DIRECTORY_BITS;
+
+  PageTable(const PageTable &) = delete;
+  PageTable &operator=(const PageTable &) = delete;
+
+  /**
+   * Entry of a directory slot, allocated by the first thread that finds it empty.
+   */
+  static std::atomic<T *> *getOrCreate(std::atomic<std::atomic<T *> *> &slot) {
+    std::atomic<T *> *entry = slot.load(std::memory_order_acquire);
+    if (entry != NULL)
+      return entry;
+    std::atomic<T *> *created = new std::atomic<T *>[DIRECTORY_SIZE];
+    for (int i = 0; i < DIRECTORY_SIZE; i++)
+      created[i].store(NULL, std::memory_order_relaxed);
+    if (slot.compare_exchange_strong(entry, created, std::memory_order_acq_rel))
+      return created;
+    delete[] created;
+    return entry;
+  }
+
+  /**
+   * Block of entries in a slot, allocated by the first thread that finds it empty.
+   */
+  static T *getOrCreate(std::atomic<T *> &slot) {
+    T *entry = slot.load(std::memory_order_acquire);
+    if (entry != NULL)
+      return entry;
+    T *created = new T[BLOCK_SIZE]();
+    if (slot.compare_exchange_strong(entry, created, std::memory_order_acq_rel))
+      return created;
+    delete[] created;
+    return entry;
+  }
+
+  /**
+   * Blocks of entries, DIRECTORY_SIZE per directory entry, covering the 32 bit page numbers.
+   */
+  std::atomic<std::atomic<T *> *> directory[DIRECTORY_SIZE];
+};
+
+/**
+ * @brief The NodeLatch of every page of an index file, by page number.
+ */
+typedef PageTable<NodeLatch> NodeLatchTable;
+
+}
@@ -0,0 +1,388 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string.h>
+
+#include "btree.h"
+#include "node_search.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Node layout for keys of a fixed size T, stored in the LeafNode<T> and
+ * NonLeafNode<T> structures.
+ *
+ * A node layout is the set of static operations BTreeIndex uses to read and change the
+ * nodes of one key type, so the tree algorithms never touch a node structure directly.
+ * Every layout provides:
+ *
+ * - Key, the type keys are searched and passed around as, and SortKey, the fixed size
+ *   type the external sort of a new index works on, with keyFromPointer() and
+ *   keyFromSortKey() to build keys.
+ * - Leaf operations: initLeaf(), leafCount(), getRightSib() / setRightSib(),
+ *   getLeftSib() / setLeftSib(), leafHighKey() / setLeafHighKey() and leafPastHighKey()
+ *   for the B-link right move, leafLowerBound() / leafUpperBound(), compareLeafKey(),
+ *   leafKey(), leafRid(), leafCopy() for batched scans, leafInsert() (false when the
+ *   leaf has no room), splitLeaf(), leafAppend() for bulk loading, and leafRemove(),
+ *   leafFill() and leafMerge() for deletes.
+ * - Non-leaf operations: initNonLeaf(), nonLeafLevel(), nonLeafCount(), childAt(),
+ *   nonLeafRightSib() / setNonLeafRightSib(), nonLeafHighKey() / setNonLeafHighKey() and
+ *   nonLeafPastHighKey(), childLowerBound() / childUpperBound(), nonLeafInsert() (false
+ *   when the node has no room), nonLeafHasRoom(), splitNonLeaf(), nonLeafAppend() for bulk loading, and nonLeafKey(),
+ *   nonLeafSetKey(), nonLeafRemove(), nonLeafRemoveFirst(), nonLeafPrepend(),
+ *   nonLeafFill() and nonLeafMerge() for deletes. Operations that add bytes to a node
+ *   return false and leave it unchanged when it has no room.
+ * - Subtree counts: every child of a non-leaf node comes with the number of entries under it,
+ *   given to the operations that add a child and moved along with it by the others, and read
+ *   and changed with childCount(), setChildCount() and addChildCount().
+ * - separatorBetween(), the key a parent uses to tell two neighbouring children apart.
+ */
+template <class T>
+struct FixedLayout {
+  typedef T Key;
+  typedef T SortKey;
+  typedef LeafNode<T> Leaf;
+  typedef NonLeafNode<T> NonLeaf;
+
+  static Key keyFromPointer(const void *key) { return KeyTraits<T>::fromPointer(key); }
+  static Key keyFromSortKey(const SortKey &key) { return key; }
+
+  // LEAF NODES
+
+  static void initLeaf(Page *page) {
+    Leaf *node = (Leaf *)page;
+    node->isLeaf = 1;
+    node->key_count = 0;
+    node->rightSibPageNo = 0;
+    node->leftSibPageNo = 0;
+  }
+
+  static Key leafHighKey(Page *page) { return ((Leaf *)page)->highKey; }
+  static void setLeafHighKey(Page *page, const Key &key) { ((Leaf *)page)->highKey = key; }
+
+  /**
+   * True if the leaf has a right sibling and the key belongs in it or further right: if the key
+   * is not below the high key for an insert (upper), above it for the first entry with the key.
+   */
+  static bool leafPastHighKey(Page *page, const Key &key, const bool upper) {
+    Leaf *node = (Leaf *)page;
+    return node->rightSibPageNo != 0 && (upper ? !(key < node->highKey) : node->highKey < key);
+  }
+
+  static int leafCount(Page *page) { return ((Leaf *)page)->key_count; }
+  static PageId getRightSib(Page *page) { return ((Leaf *)page)->rightSibPageNo; }
+  static void setRightSib(Page *page, const PageId pageNo) { ((Leaf *)page)->rightSibPageNo = pageNo; }
+  static PageId getLeftSib(Page *page) { return ((Leaf *)page)->leftSibPageNo; }
+  static void setLeftSib(Page *page, const PageId pageNo) { ((Leaf *)page)->leftSibPageNo = pageNo; }
+
+  static int leafLowerBound(Page *page, const Key &key) {
+    Leaf *node = (Leaf *)page;
+    return NodeSearch::lowerBound(node->keyArray, node->key_count, key);
+  }
+
+  static int leafUpperBound(Page *page, const Key &key) {
+    Leaf *node = (Leaf *)page;
+    return NodeSearch::upperBound(node->keyArray, node->key_count, key);
+  }
+
+  /**
+   * Negative, zero or positive as entry i of the leaf is less than, equal to or greater than key.
+   */
+  static int compareLeafKey(Page *page, const int i, const Key &key) {
+    const T &stored = ((Leaf *)page)->keyArray[i];
+    return stored < key ? -1 : (key < stored ? 1 : 0);
+  }
+
+  static Key leafKey(Page *page, const int i) { return ((Leaf *)page)->keyArray[i]; }
+  static RecordId leafRid(Page *page, const int i) { return ((Leaf *)page)->ridArray[i]; }
+
+  /**
+   * Copies count entries of the leaf from entry i on, or from entry i down if descending, the
+   * record ids to rids and, unless keys is null, the keys to keys as an array of T.
+   */
+  static void leafCopy(Page *page, const int i, const int count, RecordId *rids, void *keys, const bool descending) {
+    Leaf *node = (Leaf *)page;
+    if (descending) {
+      for (int j = 0; j < count; j++)
+        rids[j] = node->ridArray[i - j];
+      if (keys != NULL)
+        for (int j = 0; j < count; j++)
+          ((T *)keys)[j] = node->keyArray[i - j];
+      return;
+    }
+    memcpy(rids, node->ridArray + i, count * sizeof(RecordId));
+    if (keys != NULL)
+      memcpy(keys, node->keyArray + i, count * sizeof(T));
+  }
+
+  /**
+   * Inserts the entry after the keys not greater than key. Returns false if the leaf is full.
+   */
+  static bool leafInsert(Page *page, const Key &key, const RecordId rid) {
+    Leaf *node = (Leaf *)page;
+    if (node->key_count == Leaf::CAPACITY)
+      return false;
+    int i = NodeSearch::upperBound(node->keyArray, node->key_count, key);
+    memmove(&node->keyArray[i + 1], &node->keyArray[i], (node->key_count - i) * sizeof(T));
+    memmove(&node->ridArray[i + 1], &node->ridArray[i], (node->key_count - i) * sizeof(RecordId));
+    node->keyArray[i] = key;
+    node->ridArray[i] = rid;
+    node->key_count++;
+    return true;
+  }
+
+  /**
+   * Moves the upper half of a full leaf to the newly allocated page newPage and inserts the
+   * entry into the half it belongs to. Sibling links are left to the caller.
+   */
+  static void splitLeaf(Page *page, Page *newPage, const Key &key, const RecordId rid) {
+    Leaf *node = (Leaf *)page;
+    Leaf *newLeaf = (Leaf *)newPage;
+    initLeaf(newPage);
+    int middle = Leaf::CAPACITY / 2;
+    memcpy(&newLeaf->keyArray[0], &node->keyArray[middle], (Leaf::CAPACITY - middle) * sizeof(T));
+    memcpy(&newLeaf->ridArray[0], &node->ridArray[middle], (Leaf::CAPACITY - middle) * sizeof(RecordId));
+    node->key_count = middle;
+    newLeaf->key_count = Leaf::CAPACITY - middle;
+    if (key < newLeaf->keyArray[0])
+      leafInsert(page, key, rid);
+    else
+      leafInsert(newPage, key, rid);
+  }
+
+  /**
+   * Appends an entry not less than any in the leaf, unless that fills more than fillFactor of it.
+   */
+  static bool leafAppend(Page *page, const Key &key, const RecordId rid, const double fillFactor) {
+    Leaf *node = (Leaf *)page;
+    if (node->key_count >= std::max(1, (int)(fillFactor * Leaf::CAPACITY)))
+      return false;
+    node->keyArray[node->key_count] = key;
+    node->ridArray[node->key_count] = rid;
+    node->key_count++;
+    return true;
+  }
+
+  /**
+   * Removes entry i of the leaf.
+   */
+  static void leafRemove(Page *page, const int i) {
+    Leaf *node = (Leaf *)page;
+    memmove(&node->keyArray[i], &node->keyArray[i + 1], (node->key_count - i - 1) * sizeof(T));
+    memmove(&node->ridArray[i], &node->ridArray[i + 1], (node->key_count - i - 1) * sizeof(RecordId));
+    node->key_count--;
+  }
+
+  /**
+   * Fraction of the space of the leaf in use.
+   */
+  static double leafFill(Page *page) { return (double)((Leaf *)page)->key_count / Leaf::CAPACITY; }
+
+  /**
+   * Appends the entries of right, whose keys are not less than those of left, to left.
+   * Returns false if they do not fit. Sibling links are left to the caller.
+   */
+  static bool leafMerge(Page *left, Page *right) {
+    Leaf *node = (Leaf *)left;
+    Leaf *other = (Leaf *)right;
+    if (node->key_count + other->key_count > Leaf::CAPACITY)
+      return false;
+    memcpy(&node->keyArray[node->key_count], &other->keyArray[0], other->key_count * sizeof(T));
+    memcpy(&node->ridArray[node->key_count], &other->ridArray[0], other->key_count * sizeof(RecordId));
+    node->key_count += other->key_count;
+    return true;
+  }
+
+  // NON-LEAF NODES
+
+  static void initNonLeaf(Page *page, const int level, const PageId firstChild, const std::uint32_t firstCount) {
+    NonLeaf *node = (NonLeaf *)page;
+    node->isLeaf = 0;
+    node->level = level;
+    node->key_count = 0;
+    node->rightSibPageNo = 0;
+    node->pageNoArray[0] = firstChild;
+    node->countArray[0] = firstCount;
+  }
+
+  static PageId nonLeafRightSib(Page *page) { return ((NonLeaf *)page)->rightSibPageNo; }
+  static void setNonLeafRightSib(Page *page, const PageId pageNo) { ((NonLeaf *)page)->rightSibPageNo = pageNo; }
+  static Key nonLeafHighKey(Page *page) { return ((NonLeaf *)page)->highKey; }
+  static void setNonLeafHighKey(Page *page, const Key &key) { ((NonLeaf *)page)->highKey = key; }
+
+  /**
+   * Like leafPastHighKey(), for a non-leaf node.
+   */
+  static bool nonLeafPastHighKey(Page *page, const Key &key, const bool upper) {
+    NonLeaf *node = (NonLeaf *)page;
+    return node->rightSibPageNo != 0 && (upper ? !(key < node->highKey) : node->highKey < key);
+  }
+
+  static int nonLeafLevel(Page *page) { return ((NonLeaf *)page)->level; }
+  static int nonLeafCount(Page *page) { return ((NonLeaf *)page)->key_count; }
+  static PageId childAt(Page *page, const int i) { return ((NonLeaf *)page)->pageNoArray[i]; }
+  static std::uint32_t childCount(Page *page, const int i) { return ((NonLeaf *)page)->countArray[i]; }
+  static void setChildCount(Page *page, const int i, const std::uint32_t count) { ((NonLeaf *)page)->countArray[i] = count; }
+
+  /**
+   * Adds delta to the count of child i atomically, so writers that only change the count may
+   * share the node.
+   */
+  static void addChildCount(Page *page, const int i, const int delta) {
+    __atomic_fetch_add(&((NonLeaf *)page)->countArray[i], (std::uint32_t)delta, __ATOMIC_RELAXED);
+  }
+
+  static int childLowerBound(Page *page, const Key &key) {
+    NonLeaf *node = (NonLeaf *)page;
+    return NodeSearch::lowerBound(node->keyArray, node->key_count, key);
+  }
+
+  static int childUpperBound(Page *page, const Key &key) {
+    NonLeaf *node = (NonLeaf *)page;
+    return NodeSearch::upperBound(node->keyArray, node->key_count, key);
+  }
+
+  /**
+   * Inserts a separator with the child right of it, which has count entries under it. Returns
+   * false if the node is full.
+   */
+  static bool nonLeafInsert(Page *page, const Key &separator, const PageId child, const std::uint32_t count) {
+    NonLeaf *node = (NonLeaf *)page;
+    if (node->key_count == NonLeaf::CAPACITY)
+      return false;
+    int i = NodeSearch::upperBound(node->keyArray, node->key_count, separator);
+    memmove(&node->keyArray[i + 1], &node->keyArray[i], (node->key_count - i) * sizeof(T));
+    memmove(&node->pageNoArray[i + 2], &node->pageNoArray[i + 1], (node->key_count - i) * sizeof(PageId));
+    memmove(&node->countArray[i + 2], &node->countArray[i + 1], (node->key_count - i) * sizeof(std::uint32_t));
+    node->keyArray[i] = separator;
+    node->pageNoArray[i + 1] = child;
+    node->countArray[i + 1] = count;
+    node->key_count++;
+    return true;
+  }
+
+  /**
+   * True if any separator can be inserted into the node without splitting it.
+   */
+  static bool nonLeafHasRoom(Page *page) { return ((NonLeaf *)page)->key_count < NonLeaf::CAPACITY; }
+
+  /**
+   * Moves the keys right of the middle one of a full node to the newly allocated page newPage,
+   * which gets the level of the node, and inserts the separator and its child, with count
+   * entries under it, into the half it belongs to.
+   * The middle key moves up and is returned in pushUp.
+   */
+  static void splitNonLeaf(Page *page, Page *newPage, const Key &separator, const PageId child, const std::uint32_t count,
+                           Key &pushUp) {
+    NonLeaf *node = (NonLeaf *)page;
+    NonLeaf *newNode = (NonLeaf *)newPage;
+    int splitIndex = NonLeaf::CAPACITY / 2;
+    newNode->isLeaf = 0;
+    newNode->level = node->level;
+    memcpy(&newNode->keyArray[0], &node->keyArray[splitIndex + 1], (NonLeaf::CAPACITY - splitIndex - 1) * sizeof(T));
+    memcpy(&newNode->pageNoArray[0], &node->pageNoArray[splitIndex + 1], (NonLeaf::CAPACITY - splitIndex) * sizeof(PageId));
+    memcpy(&newNode->countArray[0], &node->countArray[splitIndex + 1], (NonLeaf::CAPACITY - splitIndex) * sizeof(std::uint32_t));
+    newNode->key_count = NonLeaf::CAPACITY - splitIndex - 1;
+    node->key_count = splitIndex;
+    pushUp = node->keyArray[splitIndex];
+    if (separator < pushUp)
+      nonLeafInsert(page, separator, child, count);
+    else
+      nonLeafInsert(newPage, separator, child, count);
+  }
+
+  /**
+   * Appends a separator not less than any in the node with the child right of it, unless
+   * that gives the node more than fillFactor of its children.
+   */
+  static bool nonLeafAppend(Page *page, const Key &separator, const PageId child, const std::uint32_t count,
+                            const double fillFactor) {
+    NonLeaf *node = (NonLeaf *)page;
+    if (node->key_count + 1 >= std::max(2, (int)(fillFactor * (NonLeaf::CAPACITY + 1))))
+      return false;
+    node->keyArray[node->key_count] = separator;
+    node->pageNoArray[node->key_count + 1] = child;
+    node->countArray[node->key_count + 1] = count;
+    node->key_count++;
+    return true;
+  }
+
+  static Key nonLeafKey(Page *page, const int i) { return ((NonLeaf *)page)->keyArray[i]; }
+
+  static bool nonLeafSetKey(Page *page, const int i, const Key &separator) {
+    ((NonLeaf *)page)->keyArray[i] = separator;
+    return true;
+  }
+
+  /**
+   * Removes separator i and the child right of it.
+   */
+  static void nonLeafRemove(Page *page, const int i) {
+    NonLeaf *node = (NonLeaf *)page;
+    memmove(&node->keyArray[i], &node->keyArray[i + 1], (node->key_count - i - 1) * sizeof(T));
+    memmove(&node->pageNoArray[i + 1], &node->pageNoArray[i + 2], (node->key_count - i - 1) * sizeof(PageId));
+    memmove(&node->countArray[i + 1], &node->countArray[i + 2], (node->key_count - i - 1) * sizeof(std::uint32_t));
+    node->key_count--;
+  }
+
+  /**
+   * Removes the first child and the separator right of it.
+   */
+  static void nonLeafRemoveFirst(Page *page) {
+    NonLeaf *node = (NonLeaf *)page;
+    memmove(&node->keyArray[0], &node->keyArray[1], (node->key_count - 1) * sizeof(T));
+    memmove(&node->pageNoArray[0], &node->pageNoArray[1], node->key_count * sizeof(PageId));
+    memmove(&node->countArray[0], &node->countArray[1], node->key_count * sizeof(std::uint32_t));
+    node->key_count--;
+  }
+
+  /**
+   * Makes child, with count entries under it, the first child, left of separator, which goes
+   * before every other separator.
+   */
+  static bool nonLeafPrepend(Page *page, const Key &separator, const PageId child, const std::uint32_t count) {
+    NonLeaf *node = (NonLeaf *)page;
+    if (node->key_count == NonLeaf::CAPACITY)
+      return false;
+    memmove(&node->keyArray[1], &node->keyArray[0], node->key_count * sizeof(T));
+    memmove(&node->pageNoArray[1], &node->pageNoArray[0], (node->key_count + 1) * sizeof(PageId));
+    memmove(&node->countArray[1], &node->countArray[0], (node->key_count + 1) * sizeof(std::uint32_t));
+    node->keyArray[0] = separator;
+    node->pageNoArray[0] = child;
+    node->countArray[0] = count;
+    node->key_count++;
+    return true;
+  }
+
+  /**
+   * Fraction of the space of the node in use.
+   */
+  static double nonLeafFill(Page *page) { return (double)(((NonLeaf *)page)->key_count + 1) / (NonLeaf::CAPACITY + 1); }
+
+  /**
+   * Appends separator, pulled down from the parent, and the separators and children of right
+   * to left. Returns false if they do not fit.
+   */
+  static bool nonLeafMerge(Page *left, const Key &separator, Page *right) {
+    NonLeaf *node = (NonLeaf *)left;
+    NonLeaf *other = (NonLeaf *)right;
+    if (node->key_count + 1 + other->key_count > NonLeaf::CAPACITY)
+      return false;
+    node->keyArray[node->key_count] = separator;
+    memcpy(&node->keyArray[node->key_count + 1], &other->keyArray[0], other->key_count * sizeof(T));
+    memcpy(&node->pageNoArray[node->key_count + 1], &other->pageNoArray[0], (other->key_count + 1) * sizeof(PageId));
+    memcpy(&node->countArray[node->key_count + 1], &other->countArray[0], (other->key_count + 1) * sizeof(std::uint32_t));
+    node->key_count += other->key_count + 1;
+    return true;
+  }
+
+  static Key separatorBetween(const Key &left, const Key &right) { return right; }
+};
+
+}
@@ -0,0 +1,213 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "node_search.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NODE_SEARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Keys left for the SSE2 compares once the binary search has narrowed the range.
+ */
+const int SSE_WINDOW = 16;
+
+/**
+ * Keys left for the AVX2 compares once the binary search has narrowed the range.
+ */
+const int AVX2_WINDOW = 32;
+
+/**
+ * Branchless binary search narrowing [base, base + n] down to at most window keys that
+ * still need to be compared. The position searched for is always in the returned range.
+ * With upper set it looks for the first key greater than key, otherwise for the first
+ * key not less than key.
+ */
+template <bool upper>
+inline const int *narrow(const int *base, int &n, const int key, const int window) {
+  while (n > window) {
+    int half = n / 2;
+    bool right = upper ? (base[half] <= key) : (base[half] < key);
+    base = right ? base + half : base;
+    n -= half;
+  }
+  return base;
+}
+
+/**
+ * Number of keys among the first n of base that come before the searched position.
+ */
+template <bool upper>
+inline int countBefore(const int *base, const int n, const int key) {
+  int before = 0;
+  for (int i = 0; i < n; i++)
+    before += upper ? (base[i] <= key) : (base[i] < key);
+  return before;
+}
+
+template <bool upper>
+int boundBinary(const int *keys, const int count, const int key) {
+  if (count == 0)
+    return 0;
+  int n = count;
+  const int *base = narrow<upper>(keys, n, key, 1);
+  return (base - keys) + countBefore<upper>(base, 1, key);
+}
+
+#ifdef NODE_SEARCH_X86
+
+/**
+ * Moves a narrowed range of n keys back so that it holds a full window of keys. The keys
+ * skipped over all come before the searched position, and the ones past the range all
+ * come after it, so a full window can be counted without a tail loop.
+ */
+inline const int *widen(const int *keys, const int count, const int *base, const int window) {
+  const int *last = keys + count - window;
+  return base < last ? base : last;
+}
+
+template <bool upper>
+int boundSse(const int *keys, const int count, const int key) {
+  int n = count;
+  const int *base = narrow<upper>(keys, n, key, SSE_WINDOW);
+  if (count < SSE_WINDOW)
+    return countBefore<upper>(keys, count, key);
+  base = widen(keys, count, base, SSE_WINDOW);
+  __m128i keyVec = _mm_set1_epi32(key);
+  int mask = 0;
+  for (int i = 0; i < SSE_WINDOW; i += 4) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(base + i));
+    // lanes before the searched position, inverted for upper
+    __m128i lanes = upper ? _mm_cmpgt_epi32(block, keyVec) : _mm_cmpgt_epi32(keyVec, block);
+    mask |= _mm_movemask_ps(_mm_castsi128_ps(lanes)) << i;
+  }
+  int before = __builtin_popcount(mask);
+  return (base - keys) + (upper ? SSE_WINDOW - before : before);
+}
+
+template <bool upper>
+__attribute__((target("avx2")))
+int boundAvx2(const int *keys, const int count, const int key) {
+  int n = count;
+  const int *base = narrow<upper>(keys, n, key, AVX2_WINDOW);
+  if (count < AVX2_WINDOW)
+    return countBefore<upper>(keys, count, key);
+  base = widen(keys, count, base, AVX2_WINDOW);
+  __m256i keyVec = _mm256_set1_epi32(key);
+  int mask = 0;
+  for (int i = 0; i < AVX2_WINDOW; i += 8) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(base + i));
+    // lanes before the searched position, inverted for upper
+    __m256i lanes = upper ? _mm256_cmpgt_epi32(block, keyVec) : _mm256_cmpgt_epi32(keyVec, block);
+    mask |= _mm256_movemask_ps(_mm256_castsi256_ps(lanes)) << i;
+  }
+  int before = __builtin_popcount(mask);
+  return (base - keys) + (upper ? AVX2_WINDOW - before : before);
+}
+
+#endif
+
+}
+
+int NodeSearch::lowerBoundBinary(const int *keys, const int count, const int key) {
+  return boundBinary<false>(keys, count, key);
+}
+
+int NodeSearch::upperBoundBinary(const int *keys, const int count, const int key) {
+  return boundBinary<true>(keys, count, key);
+}
+
+#ifdef NODE_SEARCH_X86
+
+int NodeSearch::lowerBoundSse(const int *keys, const int count, const int key) {
+  return boundSse<false>(keys, count, key);
+}
+
+int NodeSearch::upperBoundSse(const int *keys, const int count, const int key) {
+  return boundSse<true>(keys, count, key);
+}
+
+int NodeSearch::lowerBoundAvx2(const int *keys, const int count, const int key) {
+  return boundAvx2<false>(keys, count, key);
+}
+
+int NodeSearch::upperBoundAvx2(const int *keys, const int count, const int key) {
+  return boundAvx2<true>(keys, count, key);
+}
+
+bool NodeSearch::hasAvx2() {
+  // may run before the constructors that set up the CPU model
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+int NodeSearch::lowerBoundSse(const int *keys, const int count, const int key) {
+  return boundBinary<false>(keys, count, key);
+}
+
+int NodeSearch::upperBoundSse(const int *keys, const int count, const int key) {
+  return boundBinary<true>(keys, count, key);
+}
+
+int NodeSearch::lowerBoundAvx2(const int *keys, const int count, const int key) {
+  return boundBinary<false>(keys, count, key);
+}
+
+int NodeSearch::upperBoundAvx2(const int *keys, const int count, const int key) {
+  return boundBinary<true>(keys, count, key);
+}
+
+bool NodeSearch::hasAvx2() {
+  return false;
+}
+
+#endif
+
+void NodeSearch::selectImplementation() {
+#ifdef NODE_SEARCH_X86
+  if (hasAvx2()) {
+    lowerBoundImpl.store(&NodeSearch::lowerBoundAvx2, std::memory_order_relaxed);
+    upperBoundImpl.store(&NodeSearch::upperBoundAvx2, std::memory_order_relaxed);
+    return;
+  }
+#endif
+  // the SSE2 kernels do not beat the binary search on node-sized arrays (see search_bench)
+  lowerBoundImpl.store(&NodeSearch::lowerBoundBinary, std::memory_order_relaxed);
+  upperBoundImpl.store(&NodeSearch::upperBoundBinary, std::memory_order_relaxed);
+}
+
+int NodeSearch::resolveLowerBound(const int *keys, const int count, const int key) {
+  selectImplementation();
+  return lowerBound(keys, count, key);
+}
+
+int NodeSearch::resolveUpperBound(const int *keys, const int count, const int key) {
+  selectImplementation();
+  return upperBound(keys, count, key);
+}
+
+const char *NodeSearch::implementationName() {
+  if (lowerBoundImpl.load(std::memory_order_relaxed) == &NodeSearch::resolveLowerBound)
+    selectImplementation();
+  if (lowerBoundImpl.load(std::memory_order_relaxed) == &NodeSearch::lowerBoundAvx2)
+    return "avx2";
+  return "binary";
+}
+
+// resolved on first use, so searches made by other static initializers work too; constant
+// initialized, so they are set before any of those run
+std::atomic<NodeSearchFunc> NodeSearch::lowerBoundImpl(&NodeSearch::resolveLowerBound);
+std::atomic<NodeSearchFunc> NodeSearch::upperBoundImpl(&NodeSearch::resolveUpperBound);
+
+}
@@ -0,0 +1,136 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+
+namespace badgerdb {
+
+/**
+ * @brief Signature shared by all implementations of the node search kernels.
+ *
+ * @param keys   Sorted array of keys.
+ * @param count  Number of keys in the array.
+ * @param key    Key searched for.
+ * @return  Position of the first key in keys satisfying the search, count if there is none.
+ */
+typedef int (*NodeSearchFunc)(const int *keys, const int count, const int key);
+
+/**
+ * @brief Search kernels used on the key arrays of B+ tree nodes.
+ *
+ * Every kernel for int keys has a portable branchless binary search implementation and, on
+ * x86, SIMD implementations that narrow the range with the binary search and count the keys
+ * of the last few cache lines with SSE2 or AVX2 compares. The implementation used by
+ * lowerBound() and upperBound() is picked on first use: AVX2 if the CPU supports it,
+ * otherwise the binary search. Threads making their first search at once each pick the same
+ * implementation and store it atomically. Keys of other types go through std::lower_bound and
+ * std::upper_bound.
+ */
+class NodeSearch {
+ public:
+  /**
+   * Position of the first key not less than key (std::lower_bound).
+   */
+  static int lowerBound(const int *keys, const int count, const int key) {
+    return lowerBoundImpl.load(std::memory_order_relaxed)(keys, count, key);
+  }
+
+  /**
+   * Position of the first key greater than key (std::upper_bound).
+   */
+  static int upperBound(const int *keys, const int count, const int key) {
+    return upperBoundImpl.load(std::memory_order_relaxed)(keys, count, key);
+  }
+
+  /**
+   * Position of the first key not less than key, for key types without a dedicated kernel.
+   */
+  template <class T>
+  static int lowerBound(const T *keys, const int count, const T &key) {
+    return std::lower_bound(keys, keys + count, key) - keys;
+  }
+
+  /**
+   * Position of the first key greater than key, for key types without a dedicated kernel.
+   */
+  template <class T>
+  static int upperBound(const T *keys, const int count, const T &key) {
+    return std::upper_bound(keys, keys + count, key) - keys;
+  }
+
+  /**
+   * Branchless binary search implementation of lowerBound().
+   */
+  static int lowerBoundBinary(const int *keys, const int count, const int key);
+
+  /**
+   * Branchless binary search implementation of upperBound().
+   */
+  static int upperBoundBinary(const int *keys, const int count, const int key);
+
+  /**
+   * SSE2 implementation of lowerBound(). Falls back to the binary search off x86.
+   */
+  static int lowerBoundSse(const int *keys, const int count, const int key);
+
+  /**
+   * SSE2 implementation of upperBound(). Falls back to the binary search off x86.
+   */
+  static int upperBoundSse(const int *keys, const int count, const int key);
+
+  /**
+   * AVX2 implementation of lowerBound(). Only call if hasAvx2() is true.
+   */
+  static int lowerBoundAvx2(const int *keys, const int count, const int key);
+
+  /**
+   * AVX2 implementation of upperBound(). Only call if hasAvx2() is true.
+   */
+  static int upperBoundAvx2(const int *keys, const int count, const int key);
+
+  /**
+   * True if the CPU running the program supports AVX2.
+   */
+  static bool hasAvx2();
+
+  /**
+   * Name of the implementation picked for lowerBound() and upperBound().
+   */
+  static const char *implementationName();
+
+ private:
+  /**
+   * Points lowerBoundImpl and upperBoundImpl at the best implementation for the CPU.
+   */
+  static void selectImplementation();
+
+  /**
+   * Initial lowerBoundImpl; selects the implementation and forwards to it.
+   */
+  static int resolveLowerBound(const int *keys, const int count, const int key);
+
+  /**
+   * Initial upperBoundImpl; selects the implementation and forwards to it.
+   */
+  static int resolveUpperBound(const int *keys, const int count, const int key);
+
+  /**
+   * Implementation behind lowerBound(), read and written relaxed: it only ever changes from the
+   * resolver to the one implementation selectImplementation() picks.
+   */
+  static std::atomic<NodeSearchFunc> lowerBoundImpl;
+
+  /**
+   * Implementation behind upperBound(), like lowerBoundImpl.
+   */
+  static std::atomic<NodeSearchFunc> upperBoundImpl;
+};
+
+}
@@ -0,0 +1,294 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "packed_layout.h"
+#include "bit_pack.h"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+namespace badgerdb {
+
+namespace {
+
+typedef PackedLeafNodeInt Leaf;
+
+/**
+ * Key and record of a leaf entry, decoded from a leaf that is about to be repacked.
+ */
+typedef RIDKeyPair<int> LeafEntry;
+
+/**
+ * Bytes of the data area entries may take, short of the padding BitPack reads past them.
+ */
+const int USABLE_BYTES = Leaf::DATA_SIZE - BitPack::PADDING;
+
+/**
+ * Widest entry: a full key delta, a full page delta and a full slot.
+ */
+const int MAX_ENTRY_BITS = 32 + 32 + 8 * sizeof(SlotId);
+
+/**
+ * Entries a leaf may hold. A split puts the entry it inserts with at most half of the others,
+ * and that half has to fit however much the entry widens it, so a leaf never holds more than
+ * twice the entries of MAX_ENTRY_BITS that fit.
+ */
+const int MAX_ENTRIES = 2 * (USABLE_BYTES * 8 / MAX_ENTRY_BITS) - 2;
+
+/**
+ * Entries unpacked at once by leafCopy().
+ */
+const int COPY_CHUNK = 256;
+
+unsigned char *packedData(Leaf *node) { return (unsigned char *)node->data; }
+int entryBits(const Leaf *node) { return node->keyBits + node->pageBits + node->slotBits; }
+int packedBytes(const int count, const int stride) { return (count * stride + 7) / 8; }
+
+/**
+ * Bit position of the field at offset in entry i. Kept inside the data area, so a reader
+ * that overlapped a writer and gets a mix of old and new widths reads garbage it will not
+ * validate rather than past the page.
+ */
+int fieldPosition(const Leaf *node, const int i, const int offset) {
+  return std::min(i * entryBits(node) + offset, USABLE_BYTES * 8);
+}
+
+int keyAt(Leaf *node, const int i) {
+  return (int)((std::uint32_t)node->baseKey + BitPack::get(packedData(node), fieldPosition(node, i, 0), node->keyBits));
+}
+
+/**
+ * True if the entry can be stored with the bases and widths of the leaf.
+ */
+bool holds(const Leaf *node, const int key, const RecordId rid) {
+  std::int64_t keyDelta = (std::int64_t)key - node->baseKey;
+  return keyDelta >= 0 && keyDelta <= BitPack::mask(node->keyBits) && rid.page_number >= node->basePage &&
+         rid.page_number - node->basePage <= BitPack::mask(node->pageBits) && rid.slot_number <= BitPack::mask(node->slotBits);
+}
+
+void writeEntry(Leaf *node, const int i, const int key, const RecordId rid) {
+  int position = i * entryBits(node);
+  BitPack::put(packedData(node), position, node->keyBits, (std::uint32_t)key - (std::uint32_t)node->baseKey);
+  position += node->keyBits;
+  BitPack::put(packedData(node), position, node->pageBits, rid.page_number - node->basePage);
+  position += node->pageBits;
+  BitPack::put(packedData(node), position, node->slotBits, rid.slot_number);
+}
+
+/**
+ * lowerBound (upper false) or upperBound (upper true) of key in a leaf, searching the packed
+ * key deltas.
+ */
+int searchLeaf(Leaf *node, const int key, const bool upper) {
+  int count = node->key_count;
+  std::int64_t delta = (std::int64_t)key - node->baseKey;
+  if (count == 0 || delta < 0 || (delta == 0 && !upper))
+    return 0;
+  if (delta > BitPack::mask(node->keyBits))
+    return count;
+  int low = 0;
+  int high = count;
+  while (low < high) {
+    int middle = (low + high) / 2;
+    std::int64_t stored = BitPack::get(packedData(node), fieldPosition(node, middle, 0), node->keyBits);
+    if (upper ? stored <= delta : stored < delta)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+void decodeLeaf(Page *page, std::vector<LeafEntry> &entries) {
+  int count = PackedLayout::leafCount(page);
+  std::vector<RecordId> rids(count);
+  std::vector<int> keys(count);
+  PackedLayout::leafCopy(page, 0, count, rids.data(), keys.data(), false);
+  for (int i = 0; i < count; i++) {
+    LeafEntry entry;
+    entry.set(rids[i], keys[i]);
+    entries.push_back(entry);
+  }
+}
+
+/**
+ * Replaces the entries of the leaf with entries begin to end, in key order, packed in the
+ * fewest bits that hold them. Returns false, leaving the leaf unchanged, if they do not fit.
+ */
+bool encodeLeaf(Leaf *node, const std::vector<LeafEntry> &entries, const int begin, const int end) {
+  int count = end - begin;
+  int baseKey = count == 0 ? 0 : entries[begin].key;
+  PageId basePage = count == 0 ? 0 : entries[begin].rid.page_number;
+  PageId lastPage = basePage;
+  SlotId lastSlot = 0;
+  for (int i = begin; i < end; i++) {
+    basePage = std::min(basePage, entries[i].rid.page_number);
+    lastPage = std::max(lastPage, entries[i].rid.page_number);
+    lastSlot = std::max(lastSlot, entries[i].rid.slot_number);
+  }
+  int keyBits = count == 0 ? 0 : BitPack::bitsFor((std::uint32_t)entries[end - 1].key - (std::uint32_t)baseKey);
+  int pageBits = BitPack::bitsFor(lastPage - basePage);
+  int slotBits = BitPack::bitsFor(lastSlot);
+  if (count > MAX_ENTRIES || packedBytes(count, keyBits + pageBits + slotBits) > USABLE_BYTES)
+    return false;
+
+  node->key_count = count;
+  node->baseKey = baseKey;
+  node->basePage = basePage;
+  node->keyBits = keyBits;
+  node->pageBits = pageBits;
+  node->slotBits = slotBits;
+  memset(node->data, 0, packedBytes(count, entryBits(node)) + BitPack::PADDING);
+  for (int i = begin; i < end; i++)
+    writeEntry(node, i - begin, entries[i].key, entries[i].rid);
+  return true;
+}
+
+}
+
+// LEAF NODES
+
+void PackedLayout::initLeaf(Page *page) {
+  Leaf *node = (Leaf *)page;
+  node->isLeaf = 1;
+  node->format = PACKED_LEAVES;
+  node->key_count = 0;
+  node->rightSibPageNo = 0;
+  node->leftSibPageNo = 0;
+  node->baseKey = 0;
+  node->basePage = 0;
+  node->keyBits = 0;
+  node->pageBits = 0;
+  node->slotBits = 0;
+  node->padding = 0;
+}
+
+bool PackedLayout::leafPastHighKey(Page *page, const Key &key, const bool upper) {
+  Leaf *node = (Leaf *)page;
+  return node->rightSibPageNo != 0 && (upper ? !(key < node->highKey) : node->highKey < key);
+}
+
+int PackedLayout::leafLowerBound(Page *page, const Key &key) { return searchLeaf((Leaf *)page, key, false); }
+
+int PackedLayout::leafUpperBound(Page *page, const Key &key) { return searchLeaf((Leaf *)page, key, true); }
+
+int PackedLayout::compareLeafKey(Page *page, const int i, const Key &key) {
+  int stored = keyAt((Leaf *)page, i);
+  return stored < key ? -1 : (key < stored ? 1 : 0);
+}
+
+PackedLayout::Key PackedLayout::leafKey(Page *page, const int i) { return keyAt((Leaf *)page, i); }
+
+RecordId PackedLayout::leafRid(Page *page, const int i) {
+  Leaf *node = (Leaf *)page;
+  RecordId rid;
+  rid.page_number = node->basePage + BitPack::get(packedData(node), fieldPosition(node, i, node->keyBits), node->pageBits);
+  rid.slot_number = BitPack::get(packedData(node), fieldPosition(node, i, node->keyBits + node->pageBits), node->slotBits);
+  return rid;
+}
+
+void PackedLayout::leafCopy(Page *page, const int i, const int count, RecordId *rids, void *keys, const bool descending) {
+  Leaf *node = (Leaf *)page;
+  int stride = entryBits(node);
+  int lowest = descending ? i - count + 1 : i;
+  if (lowest < 0 || (lowest + count) * stride > USABLE_BYTES * 8) {
+    // only a reader that overlapped a writer asks for entries past the data area
+    memset(rids, 0, count * sizeof(RecordId));
+    if (keys != NULL)
+      memset(keys, 0, count * sizeof(int));
+    return;
+  }
+  std::uint32_t keyChunk[COPY_CHUNK];
+  std::uint32_t pageChunk[COPY_CHUNK];
+  std::uint32_t slotChunk[COPY_CHUNK];
+  for (int done = 0; done < count; done += COPY_CHUNK) {
+    int n = std::min(COPY_CHUNK, count - done);
+    // the chunk is unpacked in entry order either way
+    int first = descending ? i - done - n + 1 : i + done;
+    BitPack::unpack(packedData(node), stride, 0, node->keyBits, first, n, node->baseKey, keyChunk);
+    BitPack::unpack(packedData(node), stride, node->keyBits, node->pageBits, first, n, node->basePage, pageChunk);
+    BitPack::unpack(packedData(node), stride, node->keyBits + node->pageBits, node->slotBits, first, n, 0, slotChunk);
+    for (int j = 0; j < n; j++) {
+      int out = descending ? done + n - 1 - j : done + j;
+      rids[out].page_number = pageChunk[j];
+      rids[out].slot_number = slotChunk[j];
+      if (keys != NULL)
+        ((int *)keys)[out] = (int)keyChunk[j];
+    }
+  }
+}
+
+bool PackedLayout::leafInsert(Page *page, const Key &key, const RecordId rid) {
+  Leaf *node = (Leaf *)page;
+  int count = node->key_count;
+  if (count >= MAX_ENTRIES)
+    return false;
+  // an entry after the others that the widths hold is written in place
+  if (count > 0 && !(key < keyAt(node, count - 1)) && holds(node, key, rid) &&
+      packedBytes(count + 1, entryBits(node)) <= USABLE_BYTES) {
+    writeEntry(node, count, key, rid);
+    node->key_count++;
+    return true;
+  }
+  std::vector<LeafEntry> entries;
+  decodeLeaf(page, entries);
+  LeafEntry entry;
+  entry.set(rid, key);
+  entries.insert(entries.begin() + searchLeaf(node, key, true), entry);
+  return encodeLeaf(node, entries, 0, entries.size());
+}
+
+void PackedLayout::splitLeaf(Page *page, Page *newPage, const Key &key, const RecordId rid) {
+  std::vector<LeafEntry> entries;
+  decodeLeaf(page, entries);
+  LeafEntry entry;
+  entry.set(rid, key);
+  int position = searchLeaf((Leaf *)page, key, true);
+  entries.insert(entries.begin() + position, entry);
+  // neither half exceeds the entries of MAX_ENTRY_BITS that fit, see MAX_ENTRIES
+  int middle = entries.size() / 2;
+  initLeaf(newPage);
+  encodeLeaf((Leaf *)page, entries, 0, middle);
+  encodeLeaf((Leaf *)newPage, entries, middle, entries.size());
+}
+
+bool PackedLayout::leafAppend(Page *page, const Key &key, const RecordId rid, const double fillFactor) {
+  Leaf *node = (Leaf *)page;
+  int count = node->key_count;
+  if (count > 0 && (count + 1 > std::max(1, (int)(fillFactor * MAX_ENTRIES)) ||
+                    packedBytes(count + 1, entryBits(node)) > fillFactor * USABLE_BYTES))
+    return false;
+  return leafInsert(page, key, rid);
+}
+
+void PackedLayout::leafRemove(Page *page, const int i) {
+  Leaf *node = (Leaf *)page;
+  if (i == node->key_count - 1) {
+    node->key_count--;
+    return;
+  }
+  std::vector<LeafEntry> entries;
+  decodeLeaf(page, entries);
+  entries.erase(entries.begin() + i);
+  // fewer entries never need wider fields
+  encodeLeaf(node, entries, 0, entries.size());
+}
+
+double PackedLayout::leafFill(Page *page) {
+  Leaf *node = (Leaf *)page;
+  return std::max((double)node->key_count / MAX_ENTRIES, (double)packedBytes(node->key_count, entryBits(node)) / USABLE_BYTES);
+}
+
+bool PackedLayout::leafMerge(Page *left, Page *right) {
+  std::vector<LeafEntry> entries;
+  decodeLeaf(left, entries);
+  decodeLeaf(right, entries);
+  return encodeLeaf((Leaf *)left, entries, 0, entries.size());
+}
+
+}
@@ -0,0 +1,58 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include "btree.h"
+#include "node_layout.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Node layout for INTEGER keys with leaves in the PACKED_LEAVES format, stored in the
+ * PackedLeafNodeInt structure. Non-leaf nodes are those of FixedLayout<int>. See FixedLayout
+ * for the operations a layout provides.
+ *
+ * Keys and the pages of records are stored as deltas from the lowest of the leaf (frame of
+ * reference) and slots as they are, each bit-packed in the fewest bits that hold them for the
+ * whole leaf, so a leaf whose keys and records are close together holds several times the
+ * entries of a LeafNodeInt. Entries keep fixed widths, so any of them is read directly and
+ * searches stay binary; scans unpack a run of entries at once with BitPack::unpack().
+ *
+ * An entry appended after the others with widths that still hold it is written in place.
+ * Any other change repacks the leaf, which makes inserts into the middle of a leaf slower
+ * than with LeafNodeInt: the format suits indexes read far more often than written.
+ */
+struct PackedLayout : FixedLayout<int> {
+  typedef PackedLeafNodeInt Leaf;
+
+  // LEAF NODES
+
+  static void initLeaf(Page *page);
+  static int leafCount(Page *page) { return ((Leaf *)page)->key_count; }
+  static PageId getRightSib(Page *page) { return ((Leaf *)page)->rightSibPageNo; }
+  static void setRightSib(Page *page, const PageId pageNo) { ((Leaf *)page)->rightSibPageNo = pageNo; }
+  static PageId getLeftSib(Page *page) { return ((Leaf *)page)->leftSibPageNo; }
+  static void setLeftSib(Page *page, const PageId pageNo) { ((Leaf *)page)->leftSibPageNo = pageNo; }
+  static Key leafHighKey(Page *page) { return ((Leaf *)page)->highKey; }
+  static void setLeafHighKey(Page *page, const Key &key) { ((Leaf *)page)->highKey = key; }
+  static bool leafPastHighKey(Page *page, const Key &key, const bool upper);
+  static int leafLowerBound(Page *page, const Key &key);
+  static int leafUpperBound(Page *page, const Key &key);
+  static int compareLeafKey(Page *page, const int i, const Key &key);
+  static Key leafKey(Page *page, const int i);
+  static RecordId leafRid(Page *page, const int i);
+  static void leafCopy(Page *page, const int i, const int count, RecordId *rids, void *keys, const bool descending);
+  static bool leafInsert(Page *page, const Key &key, const RecordId rid);
+  static void splitLeaf(Page *page, Page *newPage, const Key &key, const RecordId rid);
+  static bool leafAppend(Page *page, const Key &key, const RecordId rid, const double fillFactor);
+  static void leafRemove(Page *page, const int i);
+  static double leafFill(Page *page);
+  static bool leafMerge(Page *left, Page *right);
+};
+
+}
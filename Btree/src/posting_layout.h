@@ -0,0 +1,451 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "btree.h"
+#include "node_layout.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Node layout for keys of a fixed size T that repeat many times, with leaves storing
+ * each key once followed by its posting list in the PostingLeafNode<T> structure. Non-leaf
+ * nodes are those of FixedLayout<T>. See FixedLayout for the operations a layout provides.
+ *
+ * A leaf still has one entry per record, numbered in (key, record id) order, so the tree
+ * algorithms see it as they see any other leaf. An entry takes three bytes: the slot of its
+ * record and the distance of the record's page from the base page of its group, against
+ * twelve for a key and a RecordId in a LeafNode<int>. A key whose records lie further apart
+ * than MAX_PAGE_DELTA pages gets more than one group, and a key with more records than a leaf
+ * holds goes on in the leaves to its right like other duplicates, its key stored once in each.
+ */
+template <class T>
+struct PostingLayout : FixedLayout<T> {
+  typedef T Key;
+  typedef PostingLeafNode<T> Leaf;
+  typedef PostingGroup<T> Group;
+
+  /**
+   * Bytes of a packed record id.
+   */
+  static const int RID_SIZE = 3;
+
+  /**
+   * Bits of a packed record id holding the slot, enough for every slot of a page. The page
+   * delta takes the bits above them.
+   */
+  static const int SLOT_BITS = 11;
+
+  /**
+   * Largest page delta a packed record id holds.
+   */
+  static const std::uint32_t MAX_PAGE_DELTA = (1 << (RID_SIZE * 8 - SLOT_BITS)) - 1;
+
+  // LEAF NODES
+
+  static void initLeaf(Page *page) {
+    Leaf *node = (Leaf *)page;
+    node->isLeaf = 1;
+    node->key_count = 0;
+    node->group_count = 0;
+    node->rightSibPageNo = 0;
+    node->leftSibPageNo = 0;
+  }
+
+  static Key leafHighKey(Page *page) { return ((Leaf *)page)->highKey; }
+  static void setLeafHighKey(Page *page, const Key &key) { ((Leaf *)page)->highKey = key; }
+
+  static bool leafPastHighKey(Page *page, const Key &key, const bool upper) {
+    Leaf *node = (Leaf *)page;
+    return node->rightSibPageNo != 0 && (upper ? !(key < node->highKey) : node->highKey < key);
+  }
+
+  static int leafCount(Page *page) { return ((Leaf *)page)->key_count; }
+  static PageId getRightSib(Page *page) { return ((Leaf *)page)->rightSibPageNo; }
+  static void setRightSib(Page *page, const PageId pageNo) { ((Leaf *)page)->rightSibPageNo = pageNo; }
+  static PageId getLeftSib(Page *page) { return ((Leaf *)page)->leftSibPageNo; }
+  static void setLeftSib(Page *page, const PageId pageNo) { ((Leaf *)page)->leftSibPageNo = pageNo; }
+
+  static int leafLowerBound(Page *page, const Key &key) { return groupStart(page, groupLowerBound(page, key)); }
+  static int leafUpperBound(Page *page, const Key &key) { return groupStart(page, groupUpperBound(page, key)); }
+
+  static int compareLeafKey(Page *page, const int i, const Key &key) {
+    T stored = group(page, groupOf(page, i)).key;
+    return stored < key ? -1 : (key < stored ? 1 : 0);
+  }
+
+  static Key leafKey(Page *page, const int i) { return group(page, groupOf(page, i)).key; }
+  static RecordId leafRid(Page *page, const int i) { return ridAt(page, group(page, groupOf(page, i)), i); }
+
+  /**
+   * Walks the groups along with the entries instead of looking up the group of each.
+   */
+  static void leafCopy(Page *page, const int i, const int count, RecordId *rids, void *keys, const bool descending) {
+    if (count == 0)
+      return;
+    int g = groupOf(page, i);
+    Group current = group(page, g);
+    int end = groupStart(page, g + 1);
+    for (int j = 0; j < count; j++) {
+      int entry = descending ? i - j : i + j;
+      while (entry < current.first) {
+        end = current.first;
+        current = group(page, --g);
+      }
+      while (entry >= end) {
+        current = group(page, ++g);
+        end = groupStart(page, g + 1);
+      }
+      rids[j] = ridAt(page, current, entry);
+      if (keys != NULL)
+        ((T *)keys)[j] = current.key;
+    }
+  }
+
+  /**
+   * Inserts the entry after the entries with lower keys, or the same key and a lower record
+   * id. Returns false if the leaf is full.
+   */
+  static bool leafInsert(Page *page, const Key &key, const RecordId rid) {
+    int low = groupLowerBound(page, key);
+    int g = groupUpperBound(page, key) - 1;
+    // the last group of the key not starting after the record
+    while (g >= low && ridLess(rid, ridAt(page, group(page, g), group(page, g).first)))
+      g--;
+    if (g >= low) {
+      if (rid.page_number - group(page, g).basePage <= MAX_PAGE_DELTA)
+        return insertIntoGroup(page, g, rid);
+      return insertGroup(page, g + 1, key, rid);
+    }
+    // below every record of the key, the first group of which takes it if not too far off
+    if (low < groupUpperBound(page, key)) {
+      Group first = group(page, low);
+      if (ridAt(page, first, groupStart(page, low + 1) - 1).page_number - rid.page_number <= MAX_PAGE_DELTA) {
+        if (freeBytes(page) < RID_SIZE)
+          return false;
+        rebase(page, low, rid.page_number);
+        return insertIntoGroup(page, low, rid);
+      }
+    }
+    return insertGroup(page, low, key, rid);
+  }
+
+  /**
+   * Moves the upper half of the entries of a full leaf to the newly allocated page newPage and
+   * inserts the entry into the half it belongs to. Sibling links are left to the caller.
+   */
+  static void splitLeaf(Page *page, Page *newPage, const Key &key, const RecordId rid) {
+    std::vector<RIDKeyPair<T> > entries;
+    decode(page, entries);
+    RIDKeyPair<T> entry;
+    entry.set(rid, key);
+    entries.insert(std::upper_bound(entries.begin(), entries.end(), entry, entryLess), entry);
+    int middle = entries.size() / 2;
+    initLeaf(newPage);
+    encode(page, entries, 0, middle);
+    encode(newPage, entries, middle, entries.size());
+  }
+
+  /**
+   * Adds an entry not less than any in the leaf, unless that fills more than fillFactor of it.
+   */
+  static bool leafAppend(Page *page, const Key &key, const RecordId rid, const double fillFactor) {
+    if (leafCount(page) > 0 && usedBytes(page) + sizeof(Group) + RID_SIZE > fillFactor * Leaf::DATA_SIZE)
+      return false;
+    return leafInsert(page, key, rid);
+  }
+
+  /**
+   * Removes entry i of the leaf, and its group if that was its last entry.
+   */
+  static void leafRemove(Page *page, const int i) {
+    Leaf *node = (Leaf *)page;
+    int g = groupOf(page, i);
+    bool emptied = groupStart(page, g + 1) - group(page, g).first == 1;
+    unsigned char *rids = ridArray(page);
+    memmove(rids + RID_SIZE, rids, i * RID_SIZE);
+    node->key_count--;
+    shiftGroups(page, g + 1, -1);
+    if (emptied) {
+      memmove(node->data + g * sizeof(Group), node->data + (g + 1) * sizeof(Group), (node->group_count - g - 1) * sizeof(Group));
+      node->group_count--;
+    }
+  }
+
+  /**
+   * Fraction of the space of the leaf in use.
+   */
+  static double leafFill(Page *page) { return (double)usedBytes(page) / Leaf::DATA_SIZE; }
+
+  /**
+   * Adds the entries of right, whose keys are not less than those of left, to left. Returns
+   * false if they do not fit. Sibling links are left to the caller.
+   */
+  static bool leafMerge(Page *left, Page *right) {
+    std::vector<RIDKeyPair<T> > entries;
+    decode(left, entries);
+    int leftCount = entries.size();
+    decode(right, entries);
+    // records of a key shared by the two leaves need not be in order across them
+    std::inplace_merge(entries.begin(), entries.begin() + leftCount, entries.end(), entryLess);
+    return encode(left, entries, 0, entries.size());
+  }
+
+  // GROUPS
+
+  static Group group(Page *page, const int g) {
+    Group result;
+    memcpy(&result, ((Leaf *)page)->data + g * sizeof(Group), sizeof(Group));
+    return result;
+  }
+
+  static void setGroup(Page *page, const int g, const Group &value) {
+    memcpy(((Leaf *)page)->data + g * sizeof(Group), &value, sizeof(Group));
+  }
+
+  /**
+   * First entry of group g, the number of entries if g is past the last group.
+   */
+  static int groupStart(Page *page, const int g) {
+    return g < ((Leaf *)page)->group_count ? group(page, g).first : ((Leaf *)page)->key_count;
+  }
+
+  /**
+   * Group of entry i: the last group starting at or before it.
+   */
+  static int groupOf(Page *page, const int i) {
+    int low = 0;
+    int high = ((Leaf *)page)->group_count - 1;
+    while (low < high) {
+      int middle = (low + high + 1) / 2;
+      if (group(page, middle).first <= i)
+        low = middle;
+      else
+        high = middle - 1;
+    }
+    return low;
+  }
+
+  /**
+   * First group with a key not less than key, the number of groups if there is none.
+   */
+  static int groupLowerBound(Page *page, const Key &key) {
+    int low = 0;
+    int high = ((Leaf *)page)->group_count;
+    while (low < high) {
+      int middle = (low + high) / 2;
+      if (group(page, middle).key < key)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    return low;
+  }
+
+  /**
+   * First group with a key greater than key, the number of groups if there is none.
+   */
+  static int groupUpperBound(Page *page, const Key &key) {
+    int low = 0;
+    int high = ((Leaf *)page)->group_count;
+    while (low < high) {
+      int middle = (low + high) / 2;
+      if (key < group(page, middle).key)
+        high = middle;
+      else
+        low = middle + 1;
+    }
+    return low;
+  }
+
+  /**
+   * Adds delta to the first entry of the groups from g on.
+   */
+  static void shiftGroups(Page *page, const int g, const int delta) {
+    for (int h = g; h < ((Leaf *)page)->group_count; h++) {
+      Group shifted = group(page, h);
+      shifted.first += delta;
+      setGroup(page, h, shifted);
+    }
+  }
+
+  /**
+   * Lowers the base page of group g to basePage, which no record of the group is more than
+   * MAX_PAGE_DELTA above.
+   */
+  static void rebase(Page *page, const int g, const PageId basePage) {
+    Group rebased = group(page, g);
+    unsigned char *rids = ridArray(page);
+    for (int i = rebased.first; i < groupStart(page, g + 1); i++)
+      packRid(rids + i * RID_SIZE, pageDeltaAt(rids + i * RID_SIZE) + rebased.basePage - basePage, slotAt(rids + i * RID_SIZE));
+    rebased.basePage = basePage;
+    setGroup(page, g, rebased);
+  }
+
+  /**
+   * Inserts a record into group g, whose pages it is not more than MAX_PAGE_DELTA above the
+   * base of, after the lower record ids of the group.
+   */
+  static bool insertIntoGroup(Page *page, const int g, const RecordId rid) {
+    if (freeBytes(page) < RID_SIZE)
+      return false;
+    Group target = group(page, g);
+    int low = target.first;
+    int high = groupStart(page, g + 1);
+    while (low < high) {
+      int middle = (low + high) / 2;
+      if (ridLess(rid, ridAt(page, target, middle)))
+        high = middle;
+      else
+        low = middle + 1;
+    }
+    insertRid(page, low, rid.page_number - target.basePage, rid.slot_number);
+    shiftGroups(page, g + 1, 1);
+    return true;
+  }
+
+  /**
+   * Inserts a new group g holding only the record.
+   */
+  static bool insertGroup(Page *page, const int g, const Key &key, const RecordId rid) {
+    Leaf *node = (Leaf *)page;
+    if (freeBytes(page) < (int)(sizeof(Group) + RID_SIZE))
+      return false;
+    Group created;
+    memset(&created, 0, sizeof(Group));
+    created.key = key;
+    created.basePage = rid.page_number;
+    created.first = groupStart(page, g);
+    memmove(node->data + (g + 1) * sizeof(Group), node->data + g * sizeof(Group), (node->group_count - g) * sizeof(Group));
+    node->group_count++;
+    setGroup(page, g, created);
+    insertRid(page, created.first, 0, rid.slot_number);
+    shiftGroups(page, g + 1, 1);
+    return true;
+  }
+
+  // RECORD IDS
+
+  /**
+   * Packed record id of entry 0, at the end of the data area, followed by those of the other
+   * entries.
+   */
+  static unsigned char *ridArray(Page *page) {
+    Leaf *node = (Leaf *)page;
+    return (unsigned char *)node->data + Leaf::DATA_SIZE - node->key_count * RID_SIZE;
+  }
+
+  static void packRid(unsigned char *packed, const std::uint32_t pageDelta, const SlotId slot) {
+    std::uint32_t bits = (pageDelta << SLOT_BITS) | slot;
+    packed[0] = bits;
+    packed[1] = bits >> 8;
+    packed[2] = bits >> 16;
+  }
+
+  static std::uint32_t packedBits(const unsigned char *packed) { return packed[0] | (packed[1] << 8) | (packed[2] << 16); }
+  static std::uint32_t pageDeltaAt(const unsigned char *packed) { return packedBits(packed) >> SLOT_BITS; }
+  static SlotId slotAt(const unsigned char *packed) { return packedBits(packed) & ((1 << SLOT_BITS) - 1); }
+
+  static RecordId ridAt(Page *page, const Group &owner, const int i) {
+    const unsigned char *packed = ridArray(page) + i * RID_SIZE;
+    RecordId rid;
+    rid.page_number = owner.basePage + pageDeltaAt(packed);
+    rid.slot_number = slotAt(packed);
+    return rid;
+  }
+
+  /**
+   * Makes room for a record id at entry i, moving the entries before it towards the groups.
+   */
+  static void insertRid(Page *page, const int i, const std::uint32_t pageDelta, const SlotId slot) {
+    unsigned char *rids = ridArray(page);
+    memmove(rids - RID_SIZE, rids, i * RID_SIZE);
+    packRid(rids + (i - 1) * RID_SIZE, pageDelta, slot);
+    ((Leaf *)page)->key_count++;
+  }
+
+  static bool ridLess(const RecordId &r1, const RecordId &r2) {
+    return r1.page_number != r2.page_number ? r1.page_number < r2.page_number : r1.slot_number < r2.slot_number;
+  }
+
+  static bool entryLess(const RIDKeyPair<T> &e1, const RIDKeyPair<T> &e2) {
+    return e1.key < e2.key || (!(e2.key < e1.key) && ridLess(e1.rid, e2.rid));
+  }
+
+  static int usedBytes(Page *page) {
+    Leaf *node = (Leaf *)page;
+    return node->group_count * (int)sizeof(Group) + node->key_count * RID_SIZE;
+  }
+
+  static int freeBytes(Page *page) { return Leaf::DATA_SIZE - usedBytes(page); }
+
+  // WHOLE LEAVES
+
+  /**
+   * Appends the entries of the leaf to entries.
+   */
+  static void decode(Page *page, std::vector<RIDKeyPair<T> > &entries) {
+    int count = leafCount(page);
+    std::vector<RecordId> rids(count);
+    std::vector<T> keys(count);
+    leafCopy(page, 0, count, rids.data(), keys.data(), false);
+    for (int i = 0; i < count; i++) {
+      RIDKeyPair<T> entry;
+      entry.set(rids[i], keys[i]);
+      entries.push_back(entry);
+    }
+  }
+
+  /**
+   * Replaces the entries of the leaf with entries begin to end, in (key, record id) order.
+   * Returns false, leaving the leaf unchanged, if they do not fit.
+   */
+  static bool encode(Page *page, const std::vector<RIDKeyPair<T> > &entries, const int begin, const int end) {
+    Leaf *node = (Leaf *)page;
+    int groups = 0;
+    PageId basePage = 0;
+    for (int i = begin; i < end; i++)
+      if (startsGroup(entries, i, begin, basePage)) {
+        groups++;
+        basePage = entries[i].rid.page_number;
+      }
+    if (groups * (int)sizeof(Group) + (end - begin) * RID_SIZE > Leaf::DATA_SIZE)
+      return false;
+
+    node->key_count = end - begin;
+    node->group_count = 0;
+    unsigned char *rids = ridArray(page);
+    Group current;
+    memset(&current, 0, sizeof(Group));
+    for (int i = begin; i < end; i++) {
+      if (startsGroup(entries, i, begin, current.basePage)) {
+        current.key = entries[i].key;
+        current.basePage = entries[i].rid.page_number;
+        current.first = i - begin;
+        setGroup(page, node->group_count++, current);
+      }
+      packRid(rids + (i - begin) * RID_SIZE, entries[i].rid.page_number - current.basePage, entries[i].rid.slot_number);
+    }
+    return true;
+  }
+
+  /**
+   * True if entry i needs a group of its own after the group of the entry before it, based at basePage.
+   */
+  static bool startsGroup(const std::vector<RIDKeyPair<T> > &entries, const int i, const int begin, const PageId basePage) {
+    return i == begin || entries[i - 1].key < entries[i].key || entries[i].rid.page_number - basePage > MAX_PAGE_DELTA;
+  }
+};
+
+static_assert( Page::DATA_SIZE / sizeof( PageSlot ) < ( 1 << PostingLayout<int>::SLOT_BITS ), "slots of a page must fit in SLOT_BITS" );
+
+}
@@ -0,0 +1,82 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "btree.h"
+#include "node_search.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Microbenchmarks of the node search kernels on node-sized key arrays
+// -----------------------------------------------------------------------------
+
+/**
+ * Number of searches timed for every kernel and node size.
+ */
+const int probes = 2000000;
+
+/**
+ * The linear scan the tree used before the kernels, for comparison.
+ */
+int upperBoundLinear(const int *keys, const int count, const int key)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (keys[i] > key)
+			return i;
+	}
+	return count;
+}
+
+void bench(const char *name, NodeSearchFunc search, const std::vector<int> &keys, const std::vector<int> &lookups)
+{
+	long checksum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < lookups.size(); i++)
+		checksum += search(&keys[0], keys.size(), lookups[i]);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	std::cout << "  " << name << ": " << ns / lookups.size() << " ns/search (checksum " << checksum << ")" << std::endl;
+}
+
+void benchNodeSize(const char *node, const int size)
+{
+	// sorted keys with gaps so that half of the searches miss
+	std::vector<int> keys(size);
+	for (int i = 0; i < size; i++)
+		keys[i] = 2 * i;
+	std::vector<int> lookups(probes);
+	for (int i = 0; i < probes; i++)
+		lookups[i] = random() % (2 * size + 2) - 1;
+
+	std::cout << node << " (" << size << " keys)" << std::endl;
+	bench("linear upperBound ", &upperBoundLinear, keys, lookups);
+	bench("binary lowerBound ", &NodeSearch::lowerBoundBinary, keys, lookups);
+	bench("binary upperBound ", &NodeSearch::upperBoundBinary, keys, lookups);
+	bench("sse2   lowerBound ", &NodeSearch::lowerBoundSse, keys, lookups);
+	bench("sse2   upperBound ", &NodeSearch::upperBoundSse, keys, lookups);
+	if (NodeSearch::hasAvx2())
+	{
+		bench("avx2   lowerBound ", &NodeSearch::lowerBoundAvx2, keys, lookups);
+		bench("avx2   upperBound ", &NodeSearch::upperBoundAvx2, keys, lookups);
+	}
+	bench("picked lowerBound ", &NodeSearch::lowerBound, keys, lookups);
+}
+
+int main(int argc, char **argv)
+{
+	std::cout << "picked implementation: " << NodeSearch::implementationName() << std::endl;
+	benchNodeSize("leaf", LeafNodeInt::CAPACITY);
+	benchNodeSize("non-leaf", NonLeafNodeInt::CAPACITY);
+	benchNodeSize("half full leaf", LeafNodeInt::CAPACITY / 2);
+	return 0;
+}
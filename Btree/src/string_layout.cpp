@@ -0,0 +1,660 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "string_layout.h"
+
+#include <algorithm>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Key and record of a leaf entry, decoded from a node that is about to be rewritten.
+ */
+typedef std::pair<std::string, RecordId> LeafEntry;
+
+const int LEAF_SLOT_SIZE = sizeof(LeafSlotString);
+const int NON_LEAF_SLOT_SIZE = sizeof(NonLeafSlotString);
+
+LeafSlotString *leafSlots(LeafNodeString *node) { return (LeafSlotString *)node->data; }
+NonLeafSlotString *nonLeafSlots(NonLeafNodeString *node) { return (NonLeafSlotString *)node->data; }
+
+/**
+ * Compares two byte strings like std::string::compare.
+ */
+int compareBytes(const char *a, const size_t aLength, const char *b, const size_t bLength) {
+  int c = memcmp(a, b, std::min(aLength, bLength));
+  if (c != 0)
+    return c;
+  return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
+
+/**
+ * Length of the longest common prefix of two byte strings.
+ */
+size_t commonPrefix(const char *a, const size_t aLength, const char *b, const size_t bLength) {
+  size_t length = std::min(aLength, bLength);
+  size_t i = 0;
+  while (i < length && a[i] == b[i])
+    i++;
+  return i;
+}
+
+/**
+ * Index splitting items of the given sizes into two runs of about the same size, both
+ * non-empty if there are two items or more.
+ */
+int balancedSplit(const std::vector<int> &sizes) {
+  int total = 0;
+  for (size_t i = 0; i < sizes.size(); i++)
+    total += sizes[i];
+  int left = 0;
+  for (int i = 0; i + 1 < (int)sizes.size(); i++) {
+    left += sizes[i];
+    if (2 * left >= total)
+      return i + 1;
+  }
+  return std::max(1, (int)sizes.size() - 1);
+}
+
+// LEAF NODES
+
+/**
+ * lowerBound (upper false) or upperBound (upper true) of key in a leaf. The key is compared
+ * with the prefix once and with the suffixes of the slots in the binary search.
+ */
+int searchLeaf(LeafNodeString *node, const std::string &key, const bool upper) {
+  const size_t prefixLength = node->prefixLength;
+  int c = memcmp(node->data + node->prefixOffset, key.data(), std::min(prefixLength, key.size()));
+  // every key of the leaf starts with the prefix
+  if (c > 0 || (c == 0 && key.size() < prefixLength))
+    return 0;
+  if (c < 0)
+    return node->key_count;
+  const char *rest = key.data() + prefixLength;
+  const size_t restLength = key.size() - prefixLength;
+  LeafSlotString *slots = leafSlots(node);
+  int low = 0;
+  int high = node->key_count;
+  while (low < high) {
+    int middle = (low + high) / 2;
+    int cmp = compareBytes(node->data + slots[middle].offset, slots[middle].length, rest, restLength);
+    if (cmp < 0 || (upper && cmp == 0))
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+void decodeLeaf(LeafNodeString *node, std::vector<LeafEntry> &entries) {
+  std::string prefix(node->data + node->prefixOffset, node->prefixLength);
+  LeafSlotString *slots = leafSlots(node);
+  entries.reserve(node->key_count + 1);
+  for (int i = 0; i < node->key_count; i++)
+    entries.push_back(LeafEntry(prefix + std::string(node->data + slots[i].offset, slots[i].length), slots[i].rid));
+}
+
+/**
+ * Bytes of the data area entries [first, last) take once encoded.
+ */
+int encodedLeafSize(const std::vector<LeafEntry> &entries, const int first, const int last) {
+  if (first == last)
+    return 0;
+  const std::string &low = entries[first].first;
+  const std::string &high = entries[last - 1].first;
+  int prefixLength = commonPrefix(low.data(), low.size(), high.data(), high.size());
+  int size = prefixLength;
+  for (int i = first; i < last; i++)
+    size += LEAF_SLOT_SIZE + entries[i].first.size() - prefixLength;
+  return size;
+}
+
+/**
+ * Rewrites the slots and key bytes of a leaf with the sorted entries [first, last), which
+ * must fit. The prefix becomes the one shared by the first and last key, hence by all.
+ */
+void encodeLeaf(LeafNodeString *node, const std::vector<LeafEntry> &entries, const int first, const int last) {
+  int prefixLength = 0;
+  if (first < last) {
+    const std::string &low = entries[first].first;
+    const std::string &high = entries[last - 1].first;
+    prefixLength = commonPrefix(low.data(), low.size(), high.data(), high.size());
+  }
+  int heapStart = LeafNodeString::DATA_SIZE - prefixLength;
+  if (prefixLength > 0)
+    memcpy(node->data + heapStart, entries[first].first.data(), prefixLength);
+  node->prefixOffset = heapStart;
+  node->prefixLength = prefixLength;
+
+  LeafSlotString *slots = leafSlots(node);
+  for (int i = first; i < last; i++) {
+    const std::string &key = entries[i].first;
+    int length = key.size() - prefixLength;
+    heapStart -= length;
+    memcpy(node->data + heapStart, key.data() + prefixLength, length);
+    slots[i - first].rid = entries[i].second;
+    slots[i - first].offset = heapStart;
+    slots[i - first].length = length;
+  }
+  node->key_count = last - first;
+  node->heapStart = heapStart;
+  node->heapBytes = LeafNodeString::DATA_SIZE - heapStart;
+}
+
+void compactLeaf(LeafNodeString *node) {
+  std::vector<LeafEntry> entries;
+  decodeLeaf(node, entries);
+  encodeLeaf(node, entries, 0, entries.size());
+}
+
+// NON-LEAF NODES
+
+int searchNonLeaf(NonLeafNodeString *node, const std::string &key, const bool upper) {
+  NonLeafSlotString *slots = nonLeafSlots(node);
+  int low = 0;
+  int high = node->key_count;
+  while (low < high) {
+    int middle = (low + high) / 2;
+    int cmp = compareBytes(node->data + slots[middle].offset, slots[middle].length, key.data(), key.size());
+    if (cmp < 0 || (upper && cmp == 0))
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+/**
+ * Reads the separators of a node and its children with their counts, children[i] being left of
+ * separators[i].
+ */
+void decodeNonLeaf(NonLeafNodeString *node, std::vector<std::string> &separators, std::vector<PageId> &children,
+                   std::vector<std::uint32_t> &counts) {
+  NonLeafSlotString *slots = nonLeafSlots(node);
+  separators.reserve(node->key_count + 1);
+  children.reserve(node->key_count + 2);
+  counts.reserve(node->key_count + 2);
+  children.push_back(node->firstChild);
+  counts.push_back(node->firstCount);
+  for (int i = 0; i < node->key_count; i++) {
+    separators.push_back(std::string(node->data + slots[i].offset, slots[i].length));
+    children.push_back(slots[i].child);
+    counts.push_back(slots[i].count);
+  }
+}
+
+/**
+ * Rewrites a node with the separators [first, last) and the children [first, last].
+ */
+void encodeNonLeaf(NonLeafNodeString *node, const std::vector<std::string> &separators,
+                   const std::vector<PageId> &children, const std::vector<std::uint32_t> &counts, const int first,
+                   const int last) {
+  NonLeafSlotString *slots = nonLeafSlots(node);
+  int heapStart = NonLeafNodeString::DATA_SIZE;
+  node->firstChild = children[first];
+  node->firstCount = counts[first];
+  for (int i = first; i < last; i++) {
+    int length = separators[i].size();
+    heapStart -= length;
+    memcpy(node->data + heapStart, separators[i].data(), length);
+    slots[i - first].child = children[i + 1];
+    slots[i - first].count = counts[i + 1];
+    slots[i - first].offset = heapStart;
+    slots[i - first].length = length;
+  }
+  node->key_count = last - first;
+  node->heapStart = heapStart;
+  node->heapBytes = NonLeafNodeString::DATA_SIZE - heapStart;
+}
+
+void compactNonLeaf(NonLeafNodeString *node) {
+  std::vector<std::string> separators;
+  std::vector<PageId> children;
+  std::vector<std::uint32_t> counts;
+  decodeNonLeaf(node, separators, children, counts);
+  encodeNonLeaf(node, separators, children, counts, 0, separators.size());
+}
+
+}
+
+StringLayout::Key StringLayout::keyFromPointer(const void *key) {
+  const char *chars = (const char *)key;
+  return std::string(chars, strnlen(chars, STRINGSIZE));
+}
+
+StringLayout::Key StringLayout::keyFromSortKey(const SortKey &key) {
+  return std::string(key.data, strnlen(key.data, STRINGSIZE));
+}
+
+// LEAF NODES
+
+void StringLayout::initLeaf(Page *page) {
+  Leaf *node = (Leaf *)page;
+  node->isLeaf = 1;
+  node->key_count = 0;
+  node->rightSibPageNo = 0;
+  node->leftSibPageNo = 0;
+  node->highKeyLength = 0;
+  node->prefixOffset = Leaf::DATA_SIZE;
+  node->prefixLength = 0;
+  node->heapStart = Leaf::DATA_SIZE;
+  node->heapBytes = 0;
+}
+
+StringLayout::Key StringLayout::leafHighKey(Page *page) {
+  Leaf *node = (Leaf *)page;
+  return std::string(node->highKey, node->highKeyLength);
+}
+
+void StringLayout::setLeafHighKey(Page *page, const Key &key) {
+  Leaf *node = (Leaf *)page;
+  memcpy(node->highKey, key.data(), key.size());
+  node->highKeyLength = key.size();
+}
+
+bool StringLayout::leafPastHighKey(Page *page, const Key &key, const bool upper) {
+  Leaf *node = (Leaf *)page;
+  if (node->rightSibPageNo == 0)
+    return false;
+  int c = compareBytes(key.data(), key.size(), node->highKey, node->highKeyLength);
+  return upper ? c >= 0 : c > 0;
+}
+
+int StringLayout::leafLowerBound(Page *page, const Key &key) {
+  return searchLeaf((Leaf *)page, key, false);
+}
+
+int StringLayout::leafUpperBound(Page *page, const Key &key) {
+  return searchLeaf((Leaf *)page, key, true);
+}
+
+int StringLayout::compareLeafKey(Page *page, const int i, const Key &key) {
+  Leaf *node = (Leaf *)page;
+  const size_t prefixLength = node->prefixLength;
+  int c = memcmp(node->data + node->prefixOffset, key.data(), std::min(prefixLength, key.size()));
+  if (c != 0)
+    return c;
+  if (key.size() < prefixLength)
+    return 1;
+  const LeafSlotString &slot = leafSlots(node)[i];
+  return compareBytes(node->data + slot.offset, slot.length, key.data() + prefixLength, key.size() - prefixLength);
+}
+
+StringLayout::Key StringLayout::leafKey(Page *page, const int i) {
+  Leaf *node = (Leaf *)page;
+  const LeafSlotString &slot = leafSlots(node)[i];
+  std::string key(node->data + node->prefixOffset, node->prefixLength);
+  key.append(node->data + slot.offset, slot.length);
+  return key;
+}
+
+RecordId StringLayout::leafRid(Page *page, const int i) {
+  return leafSlots((Leaf *)page)[i].rid;
+}
+
+void StringLayout::leafCopy(Page *page, const int i, const int count, RecordId *rids, void *keys, const bool descending) {
+  Leaf *node = (Leaf *)page;
+  const LeafSlotString *slots = leafSlots(node);
+  const int step = descending ? -1 : 1;
+  for (int j = 0; j < count; j++)
+    rids[j] = slots[i + j * step].rid;
+  if (keys == NULL)
+    return;
+  const size_t prefixLength = node->prefixLength;
+  char *out = (char *)keys;
+  memset(out, 0, (size_t)count * STRINGSIZE);
+  for (int j = 0; j < count; j++, out += STRINGSIZE) {
+    const LeafSlotString &slot = slots[i + j * step];
+    memcpy(out, node->data + node->prefixOffset, prefixLength);
+    memcpy(out + prefixLength, node->data + slot.offset, slot.length);
+  }
+}
+
+bool StringLayout::leafInsert(Page *page, const Key &key, const RecordId rid) {
+  Leaf *node = (Leaf *)page;
+  const size_t prefixLength = node->prefixLength;
+  if (node->key_count == 0 ||
+      commonPrefix(node->data + node->prefixOffset, prefixLength, key.data(), key.size()) < prefixLength) {
+    // the prefix of the leaf changes, write every key again
+    std::vector<LeafEntry> entries;
+    decodeLeaf(node, entries);
+    entries.insert(entries.begin() + leafUpperBound(page, key), LeafEntry(key, rid));
+    if (encodedLeafSize(entries, 0, entries.size()) > Leaf::DATA_SIZE)
+      return false;
+    encodeLeaf(node, entries, 0, entries.size());
+    return true;
+  }
+
+  int length = key.size() - prefixLength;
+  int needed = LEAF_SLOT_SIZE + length;
+  if (node->heapStart - node->key_count * LEAF_SLOT_SIZE < needed) {
+    if (Leaf::DATA_SIZE - node->key_count * LEAF_SLOT_SIZE - node->heapBytes < needed)
+      return false;
+    // compacting recomputes the prefix, which may have grown since keys were removed
+    compactLeaf(node);
+    return leafInsert(page, key, rid);
+  }
+  int i = leafUpperBound(page, key);
+  LeafSlotString *slots = leafSlots(node);
+  memmove(&slots[i + 1], &slots[i], (node->key_count - i) * LEAF_SLOT_SIZE);
+  node->heapStart -= length;
+  memcpy(node->data + node->heapStart, key.data() + prefixLength, length);
+  slots[i].rid = rid;
+  slots[i].offset = node->heapStart;
+  slots[i].length = length;
+  node->key_count++;
+  node->heapBytes += length;
+  return true;
+}
+
+void StringLayout::splitLeaf(Page *page, Page *newPage, const Key &key, const RecordId rid) {
+  Leaf *node = (Leaf *)page;
+  std::vector<LeafEntry> entries;
+  decodeLeaf(node, entries);
+  entries.insert(entries.begin() + leafUpperBound(page, key), LeafEntry(key, rid));
+
+  // split where the larger half is smallest once both halves are prefix compressed again,
+  // a key that shortens the prefix of the leaf may have to go alone
+  int count = entries.size();
+  std::vector<int> keyBytes(count + 1, 0);
+  for (int i = 0; i < count; i++)
+    keyBytes[i + 1] = keyBytes[i] + entries[i].first.size();
+  int middle = count / 2;
+  int bestSize = Leaf::DATA_SIZE * 2;
+  for (int i = 1; i < count; i++) {
+    int leftPrefix = commonPrefix(entries[0].first.data(), entries[0].first.size(),
+                                  entries[i - 1].first.data(), entries[i - 1].first.size());
+    int rightPrefix = commonPrefix(entries[i].first.data(), entries[i].first.size(),
+                                   entries[count - 1].first.data(), entries[count - 1].first.size());
+    int leftSize = leftPrefix + keyBytes[i] + i * (LEAF_SLOT_SIZE - leftPrefix);
+    int rightSize = rightPrefix + keyBytes[count] - keyBytes[i] + (count - i) * (LEAF_SLOT_SIZE - rightPrefix);
+    if (std::max(leftSize, rightSize) < bestSize) {
+      bestSize = std::max(leftSize, rightSize);
+      middle = i;
+    }
+  }
+
+  initLeaf(newPage);
+  encodeLeaf(node, entries, 0, middle);
+  encodeLeaf((Leaf *)newPage, entries, middle, count);
+}
+
+bool StringLayout::leafAppend(Page *page, const Key &key, const RecordId rid, const double fillFactor) {
+  Leaf *node = (Leaf *)page;
+  if (node->key_count > 0) {
+    const int prefixLength = node->prefixLength;
+    const int shared = commonPrefix(node->data + node->prefixOffset, prefixLength, key.data(), key.size());
+    // every suffix grows by what the prefix loses
+    int size = (node->key_count + 1) * LEAF_SLOT_SIZE + node->heapBytes - prefixLength +
+               node->key_count * (prefixLength - shared) + key.size();
+    if (size > fillFactor * Leaf::DATA_SIZE)
+      return false;
+  }
+  return leafInsert(page, key, rid);
+}
+
+void StringLayout::leafRemove(Page *page, const int i) {
+  Leaf *node = (Leaf *)page;
+  LeafSlotString *slots = leafSlots(node);
+  // the key bytes stay in the heap until the leaf is compacted
+  node->heapBytes -= slots[i].length;
+  memmove(&slots[i], &slots[i + 1], (node->key_count - i - 1) * LEAF_SLOT_SIZE);
+  node->key_count--;
+}
+
+double StringLayout::leafFill(Page *page) {
+  Leaf *node = (Leaf *)page;
+  return (double)(node->key_count * LEAF_SLOT_SIZE + node->heapBytes) / Leaf::DATA_SIZE;
+}
+
+bool StringLayout::leafMerge(Page *left, Page *right) {
+  std::vector<LeafEntry> entries;
+  decodeLeaf((Leaf *)left, entries);
+  decodeLeaf((Leaf *)right, entries);
+  if (encodedLeafSize(entries, 0, entries.size()) > Leaf::DATA_SIZE)
+    return false;
+  encodeLeaf((Leaf *)left, entries, 0, entries.size());
+  return true;
+}
+
+// NON-LEAF NODES
+
+void StringLayout::initNonLeaf(Page *page, const int level, const PageId firstChild, const std::uint32_t firstCount) {
+  NonLeaf *node = (NonLeaf *)page;
+  node->isLeaf = 0;
+  node->level = level;
+  node->key_count = 0;
+  node->firstChild = firstChild;
+  node->firstCount = firstCount;
+  node->rightSibPageNo = 0;
+  node->highKeyLength = 0;
+  node->heapStart = NonLeaf::DATA_SIZE;
+  node->heapBytes = 0;
+}
+
+PageId StringLayout::childAt(Page *page, const int i) {
+  NonLeaf *node = (NonLeaf *)page;
+  return i == 0 ? node->firstChild : nonLeafSlots(node)[i - 1].child;
+}
+
+std::uint32_t StringLayout::childCount(Page *page, const int i) {
+  NonLeaf *node = (NonLeaf *)page;
+  return i == 0 ? node->firstCount : nonLeafSlots(node)[i - 1].count;
+}
+
+void StringLayout::setChildCount(Page *page, const int i, const std::uint32_t count) {
+  NonLeaf *node = (NonLeaf *)page;
+  (i == 0 ? node->firstCount : nonLeafSlots(node)[i - 1].count) = count;
+}
+
+void StringLayout::addChildCount(Page *page, const int i, const int delta) {
+  NonLeaf *node = (NonLeaf *)page;
+  __atomic_fetch_add(i == 0 ? &node->firstCount : &nonLeafSlots(node)[i - 1].count, (std::uint32_t)delta, __ATOMIC_RELAXED);
+}
+
+StringLayout::Key StringLayout::nonLeafHighKey(Page *page) {
+  NonLeaf *node = (NonLeaf *)page;
+  return std::string(node->highKey, node->highKeyLength);
+}
+
+void StringLayout::setNonLeafHighKey(Page *page, const Key &key) {
+  NonLeaf *node = (NonLeaf *)page;
+  memcpy(node->highKey, key.data(), key.size());
+  node->highKeyLength = key.size();
+}
+
+bool StringLayout::nonLeafPastHighKey(Page *page, const Key &key, const bool upper) {
+  NonLeaf *node = (NonLeaf *)page;
+  if (node->rightSibPageNo == 0)
+    return false;
+  int c = compareBytes(key.data(), key.size(), node->highKey, node->highKeyLength);
+  return upper ? c >= 0 : c > 0;
+}
+
+int StringLayout::childLowerBound(Page *page, const Key &key) {
+  return searchNonLeaf((NonLeaf *)page, key, false);
+}
+
+int StringLayout::childUpperBound(Page *page, const Key &key) {
+  return searchNonLeaf((NonLeaf *)page, key, true);
+}
+
+bool StringLayout::nonLeafInsert(Page *page, const Key &separator, const PageId child, const std::uint32_t count) {
+  NonLeaf *node = (NonLeaf *)page;
+  int length = separator.size();
+  int needed = NON_LEAF_SLOT_SIZE + length;
+  if (node->heapStart - node->key_count * NON_LEAF_SLOT_SIZE < needed) {
+    if (NonLeaf::DATA_SIZE - node->key_count * NON_LEAF_SLOT_SIZE - node->heapBytes < needed)
+      return false;
+    compactNonLeaf(node);
+  }
+  int i = childUpperBound(page, separator);
+  NonLeafSlotString *slots = nonLeafSlots(node);
+  memmove(&slots[i + 1], &slots[i], (node->key_count - i) * NON_LEAF_SLOT_SIZE);
+  node->heapStart -= length;
+  memcpy(node->data + node->heapStart, separator.data(), length);
+  slots[i].child = child;
+  slots[i].count = count;
+  slots[i].offset = node->heapStart;
+  slots[i].length = length;
+  node->key_count++;
+  node->heapBytes += length;
+  return true;
+}
+
+bool StringLayout::nonLeafHasRoom(Page *page) {
+  // separators are never longer than a key
+  NonLeaf *node = (NonLeaf *)page;
+  return NonLeaf::DATA_SIZE - node->key_count * NON_LEAF_SLOT_SIZE - node->heapBytes >= NON_LEAF_SLOT_SIZE + STRINGSIZE;
+}
+
+void StringLayout::splitNonLeaf(Page *page, Page *newPage, const Key &separator, const PageId child,
+                                const std::uint32_t count, Key &pushUp) {
+  NonLeaf *node = (NonLeaf *)page;
+  std::vector<std::string> separators;
+  std::vector<PageId> children;
+  std::vector<std::uint32_t> counts;
+  decodeNonLeaf(node, separators, children, counts);
+  int i = childUpperBound(page, separator);
+  separators.insert(separators.begin() + i, separator);
+  children.insert(children.begin() + i + 1, child);
+  counts.insert(counts.begin() + i + 1, count);
+
+  std::vector<int> sizes(separators.size());
+  for (size_t j = 0; j < separators.size(); j++)
+    sizes[j] = NON_LEAF_SLOT_SIZE + separators[j].size();
+  int middle = balancedSplit(sizes);
+
+  // the separator at middle moves up, the ones right of it go to the new node
+  pushUp = separators[middle];
+  initNonLeaf(newPage, node->level, children[middle + 1], counts[middle + 1]);
+  encodeNonLeaf(node, separators, children, counts, 0, middle);
+  encodeNonLeaf((NonLeaf *)newPage, separators, children, counts, middle + 1, separators.size());
+}
+
+bool StringLayout::nonLeafAppend(Page *page, const Key &separator, const PageId child, const std::uint32_t count,
+                                 const double fillFactor) {
+  NonLeaf *node = (NonLeaf *)page;
+  int size = (node->key_count + 1) * NON_LEAF_SLOT_SIZE + node->heapBytes + separator.size();
+  if (node->key_count > 0 && size > fillFactor * NonLeaf::DATA_SIZE)
+    return false;
+  return nonLeafInsert(page, separator, child, count);
+}
+
+StringLayout::Key StringLayout::nonLeafKey(Page *page, const int i) {
+  NonLeaf *node = (NonLeaf *)page;
+  const NonLeafSlotString &slot = nonLeafSlots(node)[i];
+  return std::string(node->data + slot.offset, slot.length);
+}
+
+bool StringLayout::nonLeafSetKey(Page *page, const int i, const Key &separator) {
+  NonLeaf *node = (NonLeaf *)page;
+  NonLeafSlotString &slot = nonLeafSlots(node)[i];
+  int length = separator.size();
+  if (length <= slot.length) {
+    // shorter separators are written over the old one
+    memcpy(node->data + slot.offset, separator.data(), length);
+    node->heapBytes -= slot.length - length;
+    slot.length = length;
+    return true;
+  }
+  if (node->heapStart - node->key_count * NON_LEAF_SLOT_SIZE < length) {
+    std::vector<std::string> separators;
+    std::vector<PageId> children;
+    std::vector<std::uint32_t> counts;
+    decodeNonLeaf(node, separators, children, counts);
+    if (NON_LEAF_SLOT_SIZE * node->key_count + node->heapBytes - slot.length + length > NonLeaf::DATA_SIZE)
+      return false;
+    separators[i] = separator;
+    encodeNonLeaf(node, separators, children, counts, 0, separators.size());
+    return true;
+  }
+  node->heapStart -= length;
+  memcpy(node->data + node->heapStart, separator.data(), length);
+  node->heapBytes += length - slot.length;
+  slot.offset = node->heapStart;
+  slot.length = length;
+  return true;
+}
+
+void StringLayout::nonLeafRemove(Page *page, const int i) {
+  NonLeaf *node = (NonLeaf *)page;
+  NonLeafSlotString *slots = nonLeafSlots(node);
+  node->heapBytes -= slots[i].length;
+  memmove(&slots[i], &slots[i + 1], (node->key_count - i - 1) * NON_LEAF_SLOT_SIZE);
+  node->key_count--;
+}
+
+void StringLayout::nonLeafRemoveFirst(Page *page) {
+  NonLeaf *node = (NonLeaf *)page;
+  node->firstChild = nonLeafSlots(node)[0].child;
+  node->firstCount = nonLeafSlots(node)[0].count;
+  nonLeafRemove(page, 0);
+}
+
+bool StringLayout::nonLeafPrepend(Page *page, const Key &separator, const PageId child, const std::uint32_t count) {
+  NonLeaf *node = (NonLeaf *)page;
+  PageId oldFirst = node->firstChild;
+  std::uint32_t oldFirstCount = node->firstCount;
+  int length = separator.size();
+  int needed = NON_LEAF_SLOT_SIZE + length;
+  if (node->heapStart - node->key_count * NON_LEAF_SLOT_SIZE < needed) {
+    if (NonLeaf::DATA_SIZE - node->key_count * NON_LEAF_SLOT_SIZE - node->heapBytes < needed)
+      return false;
+    compactNonLeaf(node);
+  }
+  NonLeafSlotString *slots = nonLeafSlots(node);
+  memmove(&slots[1], &slots[0], node->key_count * NON_LEAF_SLOT_SIZE);
+  node->heapStart -= length;
+  memcpy(node->data + node->heapStart, separator.data(), length);
+  slots[0].child = oldFirst;
+  slots[0].count = oldFirstCount;
+  slots[0].offset = node->heapStart;
+  slots[0].length = length;
+  node->firstChild = child;
+  node->firstCount = count;
+  node->key_count++;
+  node->heapBytes += length;
+  return true;
+}
+
+double StringLayout::nonLeafFill(Page *page) {
+  NonLeaf *node = (NonLeaf *)page;
+  return (double)(node->key_count * NON_LEAF_SLOT_SIZE + node->heapBytes) / NonLeaf::DATA_SIZE;
+}
+
+bool StringLayout::nonLeafMerge(Page *left, const Key &separator, Page *right) {
+  NonLeaf *node = (NonLeaf *)left;
+  NonLeaf *other = (NonLeaf *)right;
+  int size = (node->key_count + 1 + other->key_count) * NON_LEAF_SLOT_SIZE + node->heapBytes + separator.size() + other->heapBytes;
+  if (size > NonLeaf::DATA_SIZE)
+    return false;
+  std::vector<std::string> separators;
+  std::vector<PageId> children;
+  std::vector<std::uint32_t> counts;
+  decodeNonLeaf(node, separators, children, counts);
+  separators.push_back(separator);
+  std::vector<std::string> rightSeparators;
+  decodeNonLeaf(other, rightSeparators, children, counts);
+  separators.insert(separators.end(), rightSeparators.begin(), rightSeparators.end());
+  encodeNonLeaf(node, separators, children, counts, 0, separators.size());
+  return true;
+}
+
+StringLayout::Key StringLayout::separatorBetween(const Key &left, const Key &right) {
+  size_t shared = commonPrefix(left.data(), left.size(), right.data(), right.size());
+  if (shared < right.size())
+    return right.substr(0, shared + 1);
+  return right;
+}
+
+}
@@ -0,0 +1,100 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Node layout for STRING keys, stored in the slotted LeafNodeString and
+ * NonLeafNodeString structures. See FixedLayout for the operations a layout provides.
+ *
+ * Keys are the strings of the attribute, cut to STRINGSIZE characters, and compare byte by
+ * byte with a string sorting before the strings it is a prefix of. Leaves store the prefix
+ * shared by their keys once (prefix compression) and separators in non-leaf nodes are the
+ * shortest prefix of the right key that still sorts after the left one (suffix truncation),
+ * so a node holds as many keys as their actual bytes allow rather than a fixed number of
+ * STRINGSIZE slots.
+ */
+struct StringLayout {
+  typedef std::string Key;
+  typedef StringKey SortKey;
+  typedef LeafNodeString Leaf;
+  typedef NonLeafNodeString NonLeaf;
+
+  static Key keyFromPointer(const void *key);
+  static Key keyFromSortKey(const SortKey &key);
+
+  // LEAF NODES
+
+  static void initLeaf(Page *page);
+  static int leafCount(Page *page) { return ((Leaf *)page)->key_count; }
+  static PageId getRightSib(Page *page) { return ((Leaf *)page)->rightSibPageNo; }
+  static void setRightSib(Page *page, const PageId pageNo) { ((Leaf *)page)->rightSibPageNo = pageNo; }
+  static PageId getLeftSib(Page *page) { return ((Leaf *)page)->leftSibPageNo; }
+  static void setLeftSib(Page *page, const PageId pageNo) { ((Leaf *)page)->leftSibPageNo = pageNo; }
+  static Key leafHighKey(Page *page);
+  static void setLeafHighKey(Page *page, const Key &key);
+  static bool leafPastHighKey(Page *page, const Key &key, const bool upper);
+  static int leafLowerBound(Page *page, const Key &key);
+  static int leafUpperBound(Page *page, const Key &key);
+  static int compareLeafKey(Page *page, const int i, const Key &key);
+  static Key leafKey(Page *page, const int i);
+  static RecordId leafRid(Page *page, const int i);
+
+  /**
+   * Keys are copied to STRINGSIZE bytes each, padded with NUL characters.
+   */
+  static void leafCopy(Page *page, const int i, const int count, RecordId *rids, void *keys, const bool descending);
+  static bool leafInsert(Page *page, const Key &key, const RecordId rid);
+  static void splitLeaf(Page *page, Page *newPage, const Key &key, const RecordId rid);
+  static bool leafAppend(Page *page, const Key &key, const RecordId rid, const double fillFactor);
+  static void leafRemove(Page *page, const int i);
+  static double leafFill(Page *page);
+  static bool leafMerge(Page *left, Page *right);
+
+  // NON-LEAF NODES
+
+  static void initNonLeaf(Page *page, const int level, const PageId firstChild, const std::uint32_t firstCount);
+  static int nonLeafLevel(Page *page) { return ((NonLeaf *)page)->level; }
+  static int nonLeafCount(Page *page) { return ((NonLeaf *)page)->key_count; }
+  static PageId childAt(Page *page, const int i);
+  static std::uint32_t childCount(Page *page, const int i);
+  static void setChildCount(Page *page, const int i, const std::uint32_t count);
+  static void addChildCount(Page *page, const int i, const int delta);
+  static PageId nonLeafRightSib(Page *page) { return ((NonLeaf *)page)->rightSibPageNo; }
+  static void setNonLeafRightSib(Page *page, const PageId pageNo) { ((NonLeaf *)page)->rightSibPageNo = pageNo; }
+  static Key nonLeafHighKey(Page *page);
+  static void setNonLeafHighKey(Page *page, const Key &key);
+  static bool nonLeafPastHighKey(Page *page, const Key &key, const bool upper);
+  static int childLowerBound(Page *page, const Key &key);
+  static int childUpperBound(Page *page, const Key &key);
+  static bool nonLeafInsert(Page *page, const Key &separator, const PageId child, const std::uint32_t count);
+  static bool nonLeafHasRoom(Page *page);
+  static void splitNonLeaf(Page *page, Page *newPage, const Key &separator, const PageId child, const std::uint32_t count,
+                           Key &pushUp);
+  static bool nonLeafAppend(Page *page, const Key &separator, const PageId child, const std::uint32_t count,
+                            const double fillFactor);
+  static Key nonLeafKey(Page *page, const int i);
+  static bool nonLeafSetKey(Page *page, const int i, const Key &separator);
+  static void nonLeafRemove(Page *page, const int i);
+  static void nonLeafRemoveFirst(Page *page);
+  static bool nonLeafPrepend(Page *page, const Key &separator, const PageId child, const std::uint32_t count);
+  static double nonLeafFill(Page *page);
+  static bool nonLeafMerge(Page *left, const Key &separator, Page *right);
+
+  /**
+   * Shortest prefix of right greater than left, right itself if the two are equal.
+   */
+  static Key separatorBetween(const Key &left, const Key &right);
+};
+
+}